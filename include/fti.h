@@ -98,6 +98,31 @@
  **/
 #define FTI_SI_MAX_NUM (512L*1024L) 
 
+/** Maximum number of MPI-IO hints in the [MPIIO] section                  */
+#define FTI_MPIIO_MAX_HINTS 32
+/** Maximum length of MPI-IO hint keys and values                          */
+#define FTI_MPIIO_HINT_LEN 128
+/** Maximum block length (bytes) within MPI-IO datatypes                  */
+#define FTI_MPIIO_MAX_BLOCK (1L<<30)
+/** Initial sleep of the polling head (microseconds)                        */
+#define FTI_LISTEN_SLEEP_MIN 10
+/** Identifier of the chunk index in MPI-IO subfiles                       */
+#define FTI_MPIIO_INDEX_MAGIC "FTISFIDX"
+/** MPI-IO hints are set for writing                                       */
+#define FTI_MPIIO_WRITE 0
+/** MPI-IO hints are set for reading                                       */
+#define FTI_MPIIO_READ 1
+/** Name of the binary checkpoint metadata file                            */
+#define FTI_META_FILE "Metadata.bin"
+/** Identifier of the binary checkpoint metadata file                      */
+#define FTI_META_MAGIC "FTIMETAB"
+/** Version of the binary checkpoint metadata format                       */
+#define FTI_META_VERSION 1
+/** Initial capacity of the dataset registry and metadata variable arrays  */
+#define FTI_DATA_MIN 16
+/** Identifier of the variable index at the end of a FTI-FF file          */
+#define FTIFF_IDX_MAGIC "FTIFFIX2"
+
 /** MD5-hash: unsigned char digest length.                                 */
 #define MD5_DIGEST_LENGTH 16
 /** MD5-hash: hex converted char digest length.                            */
@@ -119,6 +144,29 @@
 #define FTI_DCP_MODE_MD5 2001
 #define FTI_DCP_MODE_CRC32 2002
 
+/** Token for uncompressed checkpoint data.                                */
+#define FTI_CODEC_NONE 0
+/** Token for zlib (deflate) compressed checkpoint data.                   */
+#define FTI_CODEC_ZLIB 1
+/** Token for LZ4 compressed checkpoint data.                              */
+#define FTI_CODEC_LZ4 2
+/** Token for uncompressed data in the layout of compressed files.         */
+#define FTI_CODEC_STORE 3
+
+/** Token for no transform of the data before compression.                 */
+#define FTI_SHUFFLE_NONE 0
+/** Token for byte-shuffled elements before compression.                   */
+#define FTI_SHUFFLE_BYTE 1
+/** Token for bit-shuffled elements before compression.                    */
+#define FTI_SHUFFLE_BIT 2
+
+/** Token for datasets checkpointed exactly.                               */
+#define FTI_BOUND_NONE 0
+/** Token for an absolute error bound of a lossy dataset.                  */
+#define FTI_BOUND_ABS 1
+/** Token for an error bound relative to the value range of the dataset.   */
+#define FTI_BOUND_REL 2
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -160,7 +208,8 @@ extern "C" {
     int lastCkptLvel;           /**< holds last successful cp level         */
     int lastCkptID;             /**< holds last successful cp ID            */
     int countVar;               /**< counts datasets written                */
-    int isWritten[FTI_BUFS];    /**< holds IDs of datasets in cp file       */
+    bool* isWritten;            /**< TRUE for datasets (by index) in cp file*/
+    int isWrittenSize;          /**< number of entries in isWritten         */
     double t0;                  /**< timing for CP statistics               */
     double t1;                  /**< timing for CP statistics               */
     char fh[FTI_ICP_FH_SIZE];   /**< generic fh container                   */
@@ -185,6 +234,7 @@ extern "C" {
     long timestamp; /**< time when ckpt was created in ns (CLOCK_REALTIME)  */
     long dcpSize;   /**< how much actually written by rank                  */
     long dataSize;  /**< total size of protected data (excluding meta data) */
+    long codec;     /**< codec of the data (FTI_CODEC_NONE if uncompressed) */
   } FTIFF_metaInfo;
 
   /** @typedef    FTIT_DataDiffHash
@@ -230,6 +280,8 @@ extern "C" {
     long nbHashes;      /**< holds the number of hashes for data chunk        */
     FTIT_DataDiffHash* dataDiffHash; /**< dCP meta data for data chunk        */
     char *cptr;         /**< pointer to memory address of container origin    */
+    int owner;          /**< rank storing the chunk (-1 if this rank, dedup)  */
+    bool hashed;        /**< TRUE if 'hash' is the MD5 of the chunk (dedup)   */
   } FTIFF_dbvar;
 
   /** @typedef    FTIFF_db
@@ -249,6 +301,76 @@ extern "C" {
     struct FTIFF_db *next;      /**< link to next datablock                   */
   } FTIFF_db;
 
+  /** @typedef    FTIFF_idxHeader
+   *  @brief      Header of the FTI-FF variable index.
+   *
+   *  (For FTI-FF only)
+   *  The variable index is stored after the last datablock of the file.
+   *  The header is followed by 'nbVar' FTIFF_idxVar entries and 'nbChunk'
+   *  FTIFF_idxChunk entries. 'hash' covers both tables.
+   *
+   */
+  typedef struct FTIFF_idxHeader {
+    char magic[8];          /**< FTIFF_IDX_MAGIC                              */
+    int32_t nbVar;          /**< number of variables in the index             */
+    int32_t nbChunk;        /**< number of data chunks in the index           */
+    unsigned char hash[MD5_DIGEST_LENGTH];  /**< hash of the index tables     */
+  } FTIFF_idxHeader;
+
+  /** @typedef    FTIFF_idxVar
+   *  @brief      Variable entry of the FTI-FF variable index.
+   *
+   *  (For FTI-FF only)
+   *  The chunks of the variable are the entries [first, first+count) of
+   *  the chunk table. Entries are ordered by dataset index.
+   *
+   */
+  typedef struct FTIFF_idxVar {
+    int32_t id;             /**< id of protected variable                     */
+    int32_t first;          /**< first chunk of the variable                  */
+    int32_t count;          /**< number of chunks of the variable             */
+    int32_t reserved;       /**< padding                                      */
+  } FTIFF_idxVar;
+
+  /** @typedef    FTIFF_idxChunk
+   *  @brief      Chunk entry of the FTI-FF variable index.
+   *
+   *  (For FTI-FF only)
+   *  A chunk with an 'owner' is not stored in this file but in the file of
+   *  rank 'owner' of the same checkpoint, where the chunk entry with the
+   *  same hash and size and no owner locates it.
+   *
+   */
+  typedef struct FTIFF_idxChunk {
+    int64_t fptr;           /**< file pointer offset                          */
+    int64_t dptr;           /**< data pointer offset                          */
+    int64_t size;           /**< chunk size                                   */
+    int64_t csize;          /**< chunk size in file (compressed data)         */
+    int32_t owner;          /**< rank storing the chunk (-1 if this file)     */
+    int32_t reserved;       /**< padding                                      */
+    unsigned char hash[MD5_DIGEST_LENGTH];  /**< hash of the chunk            */
+  } FTIFF_idxChunk;
+
+  /** @typedef    FTIFF_idx
+   *  @brief      FTI-FF variable index in memory.
+   *
+   *  (For FTI-FF only)
+   *  'buffer' holds the index as it is stored in the file, 'var' and
+   *  'chunk' point to its tables. 'lookup' is an open addressing table
+   *  of the variable entries by id.
+   *
+   */
+  typedef struct FTIFF_idx {
+    char* buffer;           /**< serialized index                             */
+    long size;              /**< size of the serialized index                 */
+    int nbVar;              /**< number of variables                          */
+    int nbChunk;            /**< number of data chunks                        */
+    FTIFF_idxVar* var;      /**< variable table                               */
+    FTIFF_idxChunk* chunk;  /**< chunk table                                  */
+    int* lookup;            /**< variable entries by id, -1 if free           */
+    int lookupSize;         /**< size of 'lookup' (power of two)              */
+  } FTIFF_idx;
+
   /*---------------------------------------------------------------------------
     New types
     ---------------------------------------------------------------------------*/
@@ -368,6 +490,9 @@ extern "C" {
     FTIT_H5Group*   h5group;            /**< Group of this dataset                          */
     bool            isDevicePtr;        /**<True if this data are stored in a device memory */
     void            *devicePtr;         /**<Pointer to data in the device                   */
+    bool            compress;           /**< TRUE if compressed in compressed levels.       */
+    int             boundMode;          /**< Error bound mode (FTI_BOUND_*).                */
+    double          bound;              /**< Error bound of the lossy mode.                 */
 
   } FTIT_dataset;
 
@@ -383,11 +508,35 @@ extern "C" {
     long*            pfs;                /**< Partner file size.                    */
     char*            ckptFile;           /**< Ckpt file name. [FTI_BUFS]            */
     char*            currentL4CkptFile;  /**< Current Ckpt file name. [FTI_BUFS]    */        
-    int*             nbVar;              /**< Number of variables. [FTI_BUFS]       */
-    int*             varID;              /**< Variable id for size.[FTI_BUFS]       */
-    long*            varSize;            /**< Variable size. [FTI_BUFS]             */
+    int*             nbVar;              /**< Number of variables. [nbProc]         */
+    int*             varID;              /**< Variable id for size.[varMax*nbProc]  */
+    long*            varSize;            /**< Variable size. [varMax*nbProc]        */
+    int              varMax;             /**< Variables per process in the arrays.  */
+    int              nbProc;             /**< Processes in the arrays.              */
   } FTIT_metadata;
 
+  /** @typedef    FTIT_dataIdxEntry
+   *  @brief      Entry of the dataset index.
+   *
+   *  This type maps a dataset ID to its position in the dataset registry.
+   */
+  typedef struct FTIT_dataIdxEntry {
+    int             id;                 /**< Dataset ID.                    */
+    int             idx;                /**< Index in FTI_Data, -1 if free. */
+  } FTIT_dataIdxEntry;
+
+  /** @typedef    FTIT_readPiece
+   *  @brief      Part of a file read by FTI_ReadPieces.
+   *
+   *  The pieces hashed into the same digest are hashed in array order.
+   */
+  typedef struct FTIT_readPiece {
+    char*           dst;                /**< Destination buffer.            */
+    long            offset;             /**< Offset in the file.            */
+    long            size;               /**< Number of bytes.               */
+    int             digest;             /**< Digest updated, -1 for none.   */
+  } FTIT_readPiece;
+
   /** @typedef    FTIT_execution
    *  @brief      Execution metadata.
    *
@@ -397,14 +546,18 @@ extern "C" {
     char            id[FTI_BUFS];       /**< Execution ID.                  */
     int             ckpt;               /**< Checkpoint flag.               */
     int             reco;               /**< Recovery flag.                 */
+    bool            recoVerified;       /**< TRUE if recovery file verified.*/
     int             ckptLvel;           /**< Checkpoint level.              */
     int             ckptIntv;           /**< Ckpt. interval in minutes.     */
     int             lastCkptLvel;       /**< Last checkpoint level.         */
     int             wasLastOffline;     /**< TRUE if last ckpt. offline.    */
+    double          lastWriteTime;      /**< Write time of last offline ckpt*/
     double          iterTime;           /**< Current wall time.             */
     double          lastIterTime;       /**< Time spent in the last iter.   */
     double          meanIterTime;       /**< Mean iteration time.           */
     double          globMeanIter;       /**< Global mean iteration time.    */
+    double          iterSyncSum;        /**< Sum of mean iter. times.       */
+    MPI_Request     iterSyncReq;        /**< Pending mean iter. time sync.  */
     double          totalIterTime;      /**< Total main loop time spent.    */
     unsigned int    syncIter;           /**< To check mean iter. time.      */
     int             syncIterMax;        /**< Maximal synch. intervall.      */
@@ -417,6 +570,9 @@ extern "C" {
     unsigned int    ckptLast;           /**< Iteration for last checkpoint. */
     long            ckptSize;           /**< Checkpoint size.               */
     unsigned int    nbVar;              /**< Number of protected variables. */
+    unsigned int    nbVarMax;           /**< Capacity of the dataset array. */
+    FTIT_dataIdxEntry* dataIdx;         /**< Dataset ID to index table.     */
+    int             dataIdxSize;        /**< Size of the dataset ID table.  */
     unsigned int    nbVarStored;        /**< Nr. prot. var. stored in file  */
     unsigned int    nbType;             /**< Number of data types.          */
     int             nbGroup;            /**< Number of protected groups.    */
@@ -426,13 +582,17 @@ extern "C" {
     FTIFF_db         *firstdb;          /**< Pointer to first datablock     */
     FTIFF_db         *lastdb;           /**< Pointer to first datablock     */
     FTIFF_metaInfo  FTIFFMeta;          /**< File meta data for FTI-FF      */
+    FTIFF_idx       FTIFFIdx;           /**< Variable index for FTI-FF      */
     FTIT_type**     FTI_Type;           /**< Pointer to FTI_Types           */
     FTIT_H5Group**  H5groups;           /**< HDF5 root group.               */
     FTIT_StageInfo* stageInfo;          /**< root of staging requests       */
     FTIT_iCPInfo    iCPInfo;            /**< meta info iCP                  */
     MPI_Comm        globalComm;         /**< Global communicator.           */
     MPI_Comm        groupComm;          /**< Group communicator.            */
+    MPI_Comm        nodeAppComm;        /**< Application procs of the node. */
     MPI_Comm        nodeComm;
+    MPI_Comm        subfileComm;        /**< MPI-IO subfile communicator.   */
+    MPI_Comm        postComm;           /**< Post-processing communicator.  */
 #ifdef GPUSUPPORT    
     cudaStream_t    cStream;            /**< CUDA stream.                   */
     cudaEvent_t     cEvents[2];         /**< CUDA event.                    */
@@ -440,6 +600,63 @@ extern "C" {
 #endif
   } FTIT_execution;
 
+  /** @typedef    FTIT_mpiioHint
+   *  @brief      MPI-IO hint passed to MPI_Info.
+   *
+   *  This type stores one key/value pair from the [MPIIO] section.
+   */
+  typedef struct FTIT_mpiioHint {
+    char            key[FTI_MPIIO_HINT_LEN];    /**< Hint name.             */
+    char            val[FTI_MPIIO_HINT_LEN];    /**< Hint value.            */
+  } FTIT_mpiioHint;
+
+  /** @typedef    FTIT_mpiioIndex
+   *  @brief      Header of the chunk index of an MPI-IO subfile.
+   *
+   *  The header is followed by the offsets (MPI_Offset) of all chunks.
+   */
+  typedef struct FTIT_mpiioIndex {
+    char            magic[8];           /**< FTI_MPIIO_INDEX_MAGIC          */
+    int32_t         nbChunks;           /**< Number of chunks in the file   */
+    int32_t         reserved;           /**< Padding                        */
+  } FTIT_mpiioIndex;
+
+  /** @typedef    FTIT_metaHeader
+   *  @brief      Header of the binary checkpoint metadata file.
+   *
+   *  The header is followed by the offsets (int64_t) of the records of all
+   *  process slots (0 for slots without record, e.g. heads) and the records.
+   *  A slot is the position of the process in the node list.
+   */
+  typedef struct FTIT_metaHeader {
+    char            magic[8];           /**< FTI_META_MAGIC                 */
+    int32_t         version;            /**< FTI_META_VERSION               */
+    int32_t         nbSlots;            /**< Number of process slots        */
+    int32_t         nodeSize;           /**< Processes per node             */
+    int32_t         groupSize;          /**< Nodes per group                */
+    int32_t         ckptID;             /**< Checkpoint ID                  */
+    int32_t         ckptLvel;           /**< Checkpoint level               */
+  } FTIT_metaHeader;
+
+  /** @typedef    FTIT_metaRecord
+   *  @brief      Metadata of one process in the binary metadata file.
+   *
+   *  The record is followed by the sizes (int64_t) and the IDs (int32_t)
+   *  of the protected variables, padded to 8 bytes.
+   */
+  typedef struct FTIT_metaRecord {
+    char            ckptFile[FTI_BUFS]; /**< Ckpt file name.                */
+    char            checksum[MD5_DIGEST_STRING_LENGTH];      /**< Ckpt file */
+    char            ptnerChecksum[MD5_DIGEST_STRING_LENGTH]; /**< Partner   */
+    char            rsChecksum[MD5_DIGEST_STRING_LENGTH];    /**< RS file   */
+    char            reserved[5];        /**< Padding                        */
+    int64_t         fs;                 /**< File size.                     */
+    int64_t         pfs;                /**< Partner file size.             */
+    int64_t         maxFs;              /**< Maximum file size in group.    */
+    int32_t         nbVar;              /**< Number of variables.           */
+    int32_t         reserved2;          /**< Padding                        */
+  } FTIT_metaRecord;
+
   /** @typedef    FTIT_configuration
    *  @brief      Configuration metadata.
    *
@@ -450,6 +667,16 @@ extern "C" {
     bool            dcpEnabled;         /**< Enable differential ckpt.      */
     bool            keepL4Ckpt;         /**< TRUE if l4 ckpts to keep       */        
     bool            keepHeadsAlive;     /**< TRUE if heads return           */
+    bool            asyncPostCkpt;      /**< Post-process in a thread.      */
+    bool            ckptAutotune;       /**< Young/Daly ckpt. intervals.    */
+    bool            shmAggregation;     /**< TRUE for node aggregation      */
+    bool            metaIniExport;      /**< Also write INI metadata files  */
+    bool            ffCompactL4;        /**< Compact FTI-FF layout at L4.   */
+    bool            dedup;              /**< Node-local chunk deduplication.*/
+    long            dedupMinSize;       /**< Min. chunk size for dedup.     */
+    bool            verifyOnLoad;       /**< Verify ckpt. files on load.    */
+    bool            lazyRecovery;       /**< Restore data on first touch.   */
+    long            shmAggrSize;        /**< Node segment size per process  */
     int             dcpMode;            /**< dCP mode.                      */
     int             dcpBlockSize;       /**< Block size for dCP hash        */
     char            cfgFile[FTI_BUFS];  /**< Configuration file name.       */
@@ -466,6 +693,19 @@ extern "C" {
     int             stageTag;           /**< MPI tag for staging comm.      */
     int             finalTag;           /**< MPI tag for finalize comm.     */
     int             generalTag;         /**< MPI tag for general comm.      */
+    int             listenSleepMax;     /**< Max. head poll sleep (0: wait) */
+    int             headThreads;        /**< Post-processing threads/head.  */
+    int             stageStreams;       /**< Concurrent stage transfers.    */
+    int             stageChunkSize;     /**< Stage transfer chunk size.     */
+    int             nodeBwLimit;        /**< Background I/O limit (MB/s).   */
+    int             ffCompactThld;      /**< FTI-FF containers per variable.*/
+    int             compressCodec;      /**< Codec of compressed levels.    */
+    int             compressLevel;      /**< Compression level of codec.    */
+    int             compressThreads;    /**< Compression threads/process.   */
+    int             recoverThreads;     /**< Reading threads at restart.    */
+    int             compressBlockSize;  /**< Compression block size.        */
+    int             compressShuffle;    /**< Shuffle before compression.    */
+    bool            compressDelta;      /**< XOR delta before compression.  */
     int             test;               /**< TRUE if local test.            */
     int             l3WordSize;         /**< RS encoding word size.         */
     int             ioMode;             /**< IO mode for L4 ckpt.           */
@@ -476,6 +716,14 @@ extern "C" {
     char            lTmpDir[FTI_BUFS];  /**< Local temporary directory.     */
     char            gTmpDir[FTI_BUFS];  /**< Global temporary directory.    */
     char            mTmpDir[FTI_BUFS];  /**< Metadata temporary directory.  */
+    int             nbMpiioHints;       /**< Number of MPI-IO hints.        */
+    FTIT_mpiioHint  mpiioHints[FTI_MPIIO_MAX_HINTS]; /**< MPI-IO hints.     */
+    bool            mpiioCollective;    /**< TRUE for collective MPI-IO     */
+    int             mpiioSubfileNodes;  /**< Nodes per subfile (0: off)     */
+    bool            mpiioCalibrate;     /**< TRUE to calibrate MPI-IO hints */
+    bool            mpiioCalibLoaded;   /**< TRUE if calibration was loaded */
+    long            mpiioCalibSize;     /**< Bytes per rank for calibration */
+    char            mpiioCalibFile[FTI_BUFS]; /**< Calibration cache file.  */
 #ifdef GPUSUPPORT    
     size_t          cHostBufSize;       /**< Host buffer size for GPU data. */
 #endif
@@ -524,11 +772,14 @@ extern "C" {
     bool            isDcp;              /**< TRUE if dCP requested                  */
     bool            hasDcp;             /**< TRUE if execution has already a dCP    */
     bool            hasCkpt;            /**< TRUE if level has ckpt                 */        
+    bool            isCompressed;       /**< TRUE if level data is compressed.      */
     int             isInline;           /**< TRUE if work is inline.                */
     int             ckptIntv;           /**< Checkpoint interval.                   */
     int             ckptCnt;            /**< Checkpoint counter.                    */
     int             ckptDcpIntv;        /**< Checkpoint interval.                   */
     int             ckptDcpCnt;         /**< Checkpoint counter.                    */
+    int             mtbf;               /**< MTBF for autotuning (in min.).         */
+    double          ckptCost;           /**< Smoothed ckpt. cost (in sec.).         */
 
   } FTIT_checkpoint;
 
@@ -605,6 +856,8 @@ extern "C" {
   int FTI_Snapshot();
   int FTI_Finalize();
   int FTI_RecoverVar(int id);
+  int FTI_SetCompression(int id, int enable);
+  int FTI_SetErrorBound(int id, int mode, double bound);
   int FTI_InitICP(int id, int level, bool activate);
   int FTI_AddVarICP( int varID ); 
   int FTI_FinalizeICP(); 
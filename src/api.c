@@ -63,7 +63,7 @@ static FTIT_execution FTI_Exec;
 static FTIT_topology FTI_Topo;
 
 /** Array of datasets and all their internal information.                  */
-static FTIT_dataset FTI_Data[FTI_BUFS];
+static FTIT_dataset* FTI_Data;
 
 /** SDC injection model and all the required information.                  */
 static FTIT_injection FTI_Inje;
@@ -133,7 +133,7 @@ int FTI_Init(char* configFile, MPI_Comm globalComm)
         return FTI_NSCS;
     }
     FTI_Try(FTI_InitGroupsAndTypes(&FTI_Exec), "malloc arrays for groups and types.");
-    FTI_Try(FTI_InitBasicTypes(FTI_Data), "create the basic data types.");
+    FTI_Try(FTI_InitBasicTypes(), "create the basic data types.");
     if (FTI_Topo.myRank == 0) {
         FTI_Try(FTI_UpdateConf(&FTI_Conf, &FTI_Exec, FTI_Exec.reco), "update configuration file.");
     }
@@ -150,6 +150,20 @@ int FTI_Init(char* configFile, MPI_Comm globalComm)
     if( FTI_Conf.stagingEnabled ) {
         FTI_InitStage( &FTI_Exec, &FTI_Conf, &FTI_Topo );
     }
+    if( FTI_Conf.shmAggregation ) {
+        FTI_InitShm( &FTI_Conf, &FTI_Exec, &FTI_Topo );
+    }
+    if( FTI_Topo.amIaHead && FTI_Conf.headThreads > 1 ) {
+        FTI_InitHeadThreads( &FTI_Conf, &FTI_Topo );
+    }
+    if( !FTI_Topo.amIaHead && ((FTI_Conf.compressCodec != FTI_CODEC_NONE && FTI_Conf.compressThreads > 1) ||
+                (FTI_Exec.reco && FTI_Conf.recoverThreads > 1)) ) {
+        FTI_InitAppThreads( &FTI_Conf, &FTI_Exec );
+    }
+    if( FTI_Conf.asyncPostCkpt ) {
+        FTI_InitPostThread( &FTI_Conf, &FTI_Exec );
+    }
+    FTI_InitThrottle( &FTI_Conf, &FTI_Topo );
     FTI_Exec.initSCES = 1;
     if (FTI_Topo.amIaHead) { // If I am a FTI dedicated process
         if (FTI_Exec.reco) {
@@ -175,6 +189,9 @@ int FTI_Init(char* configFile, MPI_Comm globalComm)
         if( FTI_Conf.dcpEnabled ) {
             FTI_InitDcp( &FTI_Conf, &FTI_Exec, FTI_Data );
         }
+        if ( FTI_Conf.mpiioCalibrate ) {
+            FTI_Try(FTI_CalibrateMpiio(&FTI_Conf, &FTI_Exec, &FTI_Topo), "calibrate MPI-IO hints.");
+        }
         if (FTI_Exec.reco) {
             res = FTI_Try(FTI_RecoverFiles(&FTI_Conf, &FTI_Exec, &FTI_Topo, FTI_Ckpt), "recover the checkpoint files.");
             if (FTI_Conf.ioMode == FTI_IO_FTIFF && res == FTI_SCES) {
@@ -698,54 +715,63 @@ int FTI_Protect(int id, void* ptr, long count, FTIT_type type)
     return res;
 #endif
 
-  int i;
-  for (i = 0; i < FTI_BUFS; i++) {
-    if (id == FTI_Data[i].id) { //Search for dataset with given id
-      long prevSize = FTI_Data[i].size;
+  int i = FTI_GetDataIdx(&FTI_Exec, id);
+  if (i != -1) { //Search for dataset with given id
+    long prevSize = FTI_Data[i].size;
 #ifdef GPUSUPPORT
-      if ( ptrInfo.type == FTIT_PTRTYPE_CPU) {
-        FTI_Data[i].isDevicePtr = false;
-        FTI_Data[i].devicePtr= NULL;
-        FTI_Data[i].ptr = ptr;
-      }
-      else if( ptrInfo.type == FTIT_PTRTYPE_GPU ){
-        FTI_Data[i].isDevicePtr = true;
-        FTI_Data[i].devicePtr= ptr;
-        FTI_Data[i].ptr = NULL; //(void *) malloc (type.size *count);
-        if (FTI_Conf.ioMode == FTI_IO_FTIFF || FTI_Conf.ioMode == FTI_IO_HDF5){
-          FTI_Data[i].ptr = (void *) malloc (type.size *count);
-          if (FTI_Data[i].ptr == NULL){
-            FTI_Print("Could Not Allocate Extra Buffer for GPU data\n",FTI_EROR);
-            return FTI_NSCS;
-          }
-        } 
-      }
-      else{
-          FTI_Print("ptr Should be either a device location or a cpu location\n",FTI_EROR);
-          FTI_Data[i].ptr = NULL; //(void *) malloc (type.size *count);
-          return FTI_NSCS;
-      }
-#else            
+    if ( ptrInfo.type == FTIT_PTRTYPE_CPU) {
       FTI_Data[i].isDevicePtr = false;
       FTI_Data[i].devicePtr= NULL;
       FTI_Data[i].ptr = ptr;
-#endif  
-      FTI_Data[i].count = count;
-      FTI_Data[i].type = FTI_Exec.FTI_Type[type.id];
-      FTI_Data[i].eleSize = type.size;
-      FTI_Data[i].size = type.size * count;
-      FTI_Data[i].dimLength[0] = count;
-      FTI_Exec.ckptSize = FTI_Exec.ckptSize + ((type.size * count) - prevSize);
-      sprintf(str, "Variable ID %d reseted. Current ckpt. size per rank is %.2fMB.", id, (float) FTI_Exec.ckptSize / (1024.0 * 1024.0));
-      FTI_Print(str, FTI_DBUG);
-      return FTI_SCES;
     }
+    else if( ptrInfo.type == FTIT_PTRTYPE_GPU ){
+      FTI_Data[i].isDevicePtr = true;
+      FTI_Data[i].devicePtr= ptr;
+      FTI_Data[i].ptr = NULL; //(void *) malloc (type.size *count);
+      if (FTI_Conf.ioMode == FTI_IO_FTIFF || FTI_Conf.ioMode == FTI_IO_HDF5){
+        FTI_Data[i].ptr = (void *) malloc (type.size *count);
+        if (FTI_Data[i].ptr == NULL){
+          FTI_Print("Could Not Allocate Extra Buffer for GPU data\n",FTI_EROR);
+          return FTI_NSCS;
+        }
+      } 
+    }
+    else{
+        FTI_Print("ptr Should be either a device location or a cpu location\n",FTI_EROR);
+        FTI_Data[i].ptr = NULL; //(void *) malloc (type.size *count);
+        return FTI_NSCS;
+    }
+#else            
+    FTI_Data[i].isDevicePtr = false;
+    FTI_Data[i].devicePtr= NULL;
+    FTI_Data[i].ptr = ptr;
+#endif  
+    FTI_Data[i].count = count;
+    FTI_Data[i].type = FTI_Exec.FTI_Type[type.id];
+    FTI_Data[i].eleSize = type.size;
+    FTI_Data[i].size = type.size * count;
+    FTI_Data[i].dimLength[0] = count;
+    FTI_Exec.ckptSize = FTI_Exec.ckptSize + ((type.size * count) - prevSize);
+    sprintf(str, "Variable ID %d reseted. Current ckpt. size per rank is %.2fMB.", id, (float) FTI_Exec.ckptSize / (1024.0 * 1024.0));
+    FTI_Print(str, FTI_DBUG);
+    return FTI_SCES;
   }
   //Id could not be found in datasets
 
-  //If too many variables exit FTI.
-  if (FTI_Exec.nbVar >= FTI_BUFS) {
-    FTI_Print("Unable to register variable. Too many variables already registered.", FTI_WARN);
+  //Grow the dataset array if it is full
+  if (FTI_Exec.nbVar >= FTI_Exec.nbVarMax) {
+    unsigned int nbVarMax = (FTI_Exec.nbVarMax > 0) ? FTI_Exec.nbVarMax * 2 : FTI_DATA_MIN;
+    FTIT_dataset* data = realloc(FTI_Data, nbVarMax * sizeof(FTIT_dataset));
+    if (data == NULL) {
+      FTI_Print("Unable to register variable. Cannot grow the dataset array.", FTI_WARN);
+      return FTI_NSCS;
+    }
+    memset(&data[FTI_Exec.nbVar], 0x0, (nbVarMax - FTI_Exec.nbVar) * sizeof(FTIT_dataset));
+    FTI_Data = data;
+    FTI_Exec.nbVarMax = nbVarMax;
+  }
+  if (FTI_AddDataIdx(&FTI_Exec, id, FTI_Exec.nbVar) != FTI_SCES) {
+    FTI_Print("Unable to register variable.", FTI_WARN);
     return FTI_NSCS;
   }
 
@@ -790,6 +816,9 @@ int FTI_Protect(int id, void* ptr, long count, FTIT_type type)
   FTI_Data[FTI_Exec.nbVar].rank = 1;
   FTI_Data[FTI_Exec.nbVar].dimLength[0] = FTI_Data[FTI_Exec.nbVar].count;
   FTI_Data[FTI_Exec.nbVar].h5group = FTI_Exec.H5groups[0];
+  FTI_Data[FTI_Exec.nbVar].compress = true;
+  FTI_Data[FTI_Exec.nbVar].boundMode = FTI_BOUND_NONE;
+  FTI_Data[FTI_Exec.nbVar].bound = 0;
   sprintf(FTI_Data[FTI_Exec.nbVar].name, "Dataset_%d", id);
   FTI_Exec.ckptSize = FTI_Exec.ckptSize + (type.size * count);
   sprintf(str, "Variable ID %d to protect. Current ckpt. size per rank is %.2fMB. isDevice %d Device: %p CPU: %p", id, (float) FTI_Exec.ckptSize / (1024.0 * 1024.0), FTI_Data[FTI_Exec.nbVar].isDevicePtr, FTI_Data[FTI_Exec.nbVar].devicePtr,FTI_Data[FTI_Exec.nbVar].ptr);
@@ -831,38 +860,36 @@ int FTI_DefineDataset(int id, int rank, int* dimLength, char* name, FTIT_H5Group
 
     char str[FTI_BUFS]; //For console output
 
-    int i;
-    for (i = 0; i < FTI_BUFS; i++) {
-        if (id == FTI_Data[i].id) { //Search for dataset with given id
-            //check if size is correct
-            int expectedSize = 1;
-            int j;
-            for (j = 0; j < rank; j++) {
-                expectedSize *= dimLength[j]; //compute the number of elements
-            }
+    int i = FTI_GetDataIdx(&FTI_Exec, id);
+    if (i != -1) { //Search for dataset with given id
+        //check if size is correct
+        int expectedSize = 1;
+        int j;
+        for (j = 0; j < rank; j++) {
+            expectedSize *= dimLength[j]; //compute the number of elements
+        }
 
-            if (rank > 0) {
-                if (expectedSize != FTI_Data[i].count) {
-                    sprintf(str, "Trying to define datasize: number of elements %d, but the dataset count is %ld.", expectedSize, FTI_Data[i].count);
-                    FTI_Print(str, FTI_WARN);
-                    return FTI_NSCS;
-                }
-                FTI_Data[i].rank = rank;
-                for (j = 0; j < rank; j++) {
-                    FTI_Data[i].dimLength[j] = dimLength[j];
-                }
+        if (rank > 0) {
+            if (expectedSize != FTI_Data[i].count) {
+                sprintf(str, "Trying to define datasize: number of elements %d, but the dataset count is %ld.", expectedSize, FTI_Data[i].count);
+                FTI_Print(str, FTI_WARN);
+                return FTI_NSCS;
             }
-
-            if (h5group != NULL) {
-                FTI_Data[i].h5group = FTI_Exec.H5groups[h5group->id];
+            FTI_Data[i].rank = rank;
+            for (j = 0; j < rank; j++) {
+                FTI_Data[i].dimLength[j] = dimLength[j];
             }
+        }
 
-            if (name != NULL) {
-                strncpy(FTI_Data[i].name, name, FTI_BUFS);
-            }
-            
-            return FTI_SCES;
+        if (h5group != NULL) {
+            FTI_Data[i].h5group = FTI_Exec.H5groups[h5group->id];
         }
+
+        if (name != NULL) {
+            snprintf(FTI_Data[i].name, FTI_BUFS, "%s", name);
+        }
+        
+        return FTI_SCES;
     }
 
     sprintf(str, "The dataset #%d not initialized. Use FTI_Protect first.", id);
@@ -871,6 +898,98 @@ int FTI_DefineDataset(int id, int rank, int* dimLength, char* name, FTIT_H5Group
 }
 
 
+/*-------------------------------------------------------------------------*/
+/**
+    @brief      Includes or excludes a dataset from compression.
+    @param      id              ID of the dataset.
+    @param      enable          0 to store the dataset uncompressed.
+    @return     integer         FTI_SCES if successful.
+
+    Protected datasets are compressed in the levels enabled with
+    'Basic:compress_lX'. Datasets that do not compress well (e.g. random
+    data) can be excluded to save the compression time.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_SetCompression(int id, int enable)
+{
+    if (FTI_Exec.initSCES == 0) {
+        FTI_Print("FTI is not initialized.", FTI_WARN);
+        return FTI_NSCS;
+    }
+
+    int i = FTI_GetDataIdx(&FTI_Exec, id);
+    if (i == -1) {
+        char str[FTI_BUFS];
+        sprintf(str, "The dataset #%d not initialized. Use FTI_Protect first.", id);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NSCS;
+    }
+    FTI_Data[i].compress = (enable != 0);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+    @brief      Sets the error bound of a lossy dataset.
+    @param      id              ID of the dataset.
+    @param      mode            FTI_BOUND_ABS, FTI_BOUND_REL or FTI_BOUND_NONE.
+    @param      bound           Error bound (absolute or relative).
+    @return     integer         FTI_SCES if successful.
+
+    Datasets of type FTI_SFLT or FTI_DBLE may be checkpointed with a loss
+    of precision in the levels enabled with 'Basic:compress_lX'. After a
+    recovery from such a level, every element differs from its checkpointed
+    value by at most 'bound' (FTI_BOUND_ABS) or 'bound' times the value
+    range of the dataset (FTI_BOUND_REL). Non-finite values are restored
+    exactly. The other levels always store the dataset exactly.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_SetErrorBound(int id, int mode, double bound)
+{
+    char str[FTI_BUFS];
+    if (FTI_Exec.initSCES == 0) {
+        FTI_Print("FTI is not initialized.", FTI_WARN);
+        return FTI_NSCS;
+    }
+
+    int i = FTI_GetDataIdx(&FTI_Exec, id);
+    if (i == -1) {
+        sprintf(str, "The dataset #%d not initialized. Use FTI_Protect first.", id);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NSCS;
+    }
+    if (mode == FTI_BOUND_NONE) {
+        FTI_Data[i].boundMode = FTI_BOUND_NONE;
+        FTI_Data[i].bound = 0;
+        return FTI_SCES;
+    }
+    if (mode != FTI_BOUND_ABS && mode != FTI_BOUND_REL) {
+        sprintf(str, "Unknown error bound mode %d for dataset #%d.", mode, id);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NSCS;
+    }
+    if (FTI_Data[i].type->id != FTI_SFLT.id && FTI_Data[i].type->id != FTI_DBLE.id) {
+        sprintf(str, "The dataset #%d is not of type FTI_SFLT or FTI_DBLE, it is checkpointed exactly.", id);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NSCS;
+    }
+    if (!(bound > 0)) {
+        sprintf(str, "The error bound of dataset #%d must be positive.", id);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NSCS;
+    }
+    if (FTI_Conf.compressCodec == FTI_CODEC_NONE) {
+        sprintf(str, "No compressed level is set, dataset #%d is checkpointed exactly.", id);
+        FTI_Print(str, FTI_INFO);
+    }
+    FTI_Data[i].boundMode = mode;
+    FTI_Data[i].bound = bound;
+    return FTI_SCES;
+}
+
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      Returns size saved in metadata of variable
@@ -893,7 +1012,7 @@ long FTI_GetStoredSize(int id)
 
     int i;
     //Search first in temporary metadata (always the newest)
-    for (i = 0; i < FTI_BUFS; i++) {
+    for (i = 0; i < FTI_Exec.meta[0].nbVar[0]; i++) {
         if (FTI_Exec.meta[0].varID[i] == id) {
             if (FTI_Exec.meta[0].varSize[i] != 0) {
                 return FTI_Exec.meta[0].varSize[i];
@@ -903,7 +1022,7 @@ long FTI_GetStoredSize(int id)
     }
     //If couldn't find in temporary metadata, search in last level checkpoint
     //(this means no checkpoint was taken in current execution)
-    for (i = 0; i < FTI_BUFS; i++) {
+    for (i = 0; i < FTI_Exec.meta[FTI_Exec.ckptLvel].nbVar[0]; i++) {
         if (FTI_Exec.meta[FTI_Exec.ckptLvel].varID[i] == id) {
             return FTI_Exec.meta[FTI_Exec.ckptLvel].varSize[i];
         }
@@ -931,26 +1050,23 @@ void* FTI_Realloc(int id, void* ptr)
     FTI_Print("Trying to reallocate dataset.", FTI_DBUG);
     if (FTI_Exec.reco) {
         char str[FTI_BUFS];
-        int i;
-        for (i = 0; i < FTI_BUFS; i++) {
-            if (id == FTI_Data[i].id) {
-                long oldSize = FTI_Data[i].size;
-                FTI_Data[i].size = FTI_Exec.meta[FTI_Exec.ckptLvel].varSize[i];
-                sprintf(str, "Reallocated size: %ld", FTI_Data[i].size);
+        int i = FTI_GetDataIdx(&FTI_Exec, id);
+        if (i != -1) {
+            long oldSize = FTI_Data[i].size;
+            FTI_Data[i].size = FTI_Exec.meta[FTI_Exec.ckptLvel].varSize[i];
+            sprintf(str, "Reallocated size: %ld", FTI_Data[i].size);
+            FTI_Print(str, FTI_DBUG);
+            if (FTI_Data[i].size == 0) {
+                sprintf(str, "Cannot allocate 0 size.");
                 FTI_Print(str, FTI_DBUG);
-                if (FTI_Data[i].size == 0) {
-                    sprintf(str, "Cannot allocate 0 size.");
-                    FTI_Print(str, FTI_DBUG);
-                    return ptr;
-                }
-                ptr = realloc (ptr, FTI_Data[i].size);
-                FTI_Data[i].ptr = ptr;
-                FTI_Data[i].count = FTI_Data[i].size / FTI_Data[i].eleSize;
-                FTI_Exec.ckptSize += FTI_Data[i].size - oldSize;
-                sprintf(str, "Dataset #%d reallocated.", FTI_Data[i].id);
-                FTI_Print(str, FTI_INFO);
-                break;
+                return ptr;
             }
+            ptr = realloc (ptr, FTI_Data[i].size);
+            FTI_Data[i].ptr = ptr;
+            FTI_Data[i].count = FTI_Data[i].size / FTI_Data[i].eleSize;
+            FTI_Exec.ckptSize += FTI_Data[i].size - oldSize;
+            sprintf(str, "Dataset #%d reallocated.", FTI_Data[i].id);
+            FTI_Print(str, FTI_INFO);
         }
     }
     else {
@@ -1098,6 +1214,27 @@ int FTI_Checkpoint(int id, int level)
         level -= 4; 
     }
 
+    // the protected data must be entirely restored by a lazy recovery
+    FTI_LazyWait();
+
+    // the post-processing thread reads ckptID and FTI_Ckpt until it is joined
+    double t0 = MPI_Wtime(); //Start time
+    if (FTI_Exec.wasLastOffline == 1) { // Block until previous checkpoint is done (Async. work)
+        double postTime;
+        int lastLevel = FTI_WaitPostCkpt(&FTI_Conf, &FTI_Exec, &FTI_Topo, &postTime);
+        if (lastLevel != FTI_NSCS) { //Head sends level of checkpoint if post-processing succeed, FTI_NSCS Otherwise
+            FTI_Exec.lastCkptLvel = lastLevel; //Store last successful post-processing checkpoint level
+            sprintf(str, "LastCkptLvel of asynchronous post-processing: %d", lastLevel);
+            FTI_Print(str, FTI_DBUG);
+            FTI_AutotuneIntv(&FTI_Conf, &FTI_Exec, FTI_Ckpt, lastLevel, FTI_Exec.lastWriteTime + postTime);
+        } else {
+            FTI_Print("Asynchronous post-processing of previous checkpoint failed.", FTI_WARN);
+        }
+    }
+
+    // the recovery is over, compress with 'compress_threads' threads
+    FTI_ShrinkAppThreads( &FTI_Conf );
+
     int ckptFirst = !FTI_Exec.ckptID; //ckptID = 0 if first checkpoint
     FTI_Exec.ckptID = id;
 
@@ -1116,19 +1253,6 @@ int FTI_Checkpoint(int id, int level)
         level = 4;
     }
 
-    double t0 = MPI_Wtime(); //Start time
-    if (FTI_Exec.wasLastOffline == 1) { // Block until previous checkpoint is done (Async. work)
-        int lastLevel;
-        MPI_Recv(&lastLevel, 1, MPI_INT, FTI_Topo.headRank, FTI_Conf.generalTag, FTI_Exec.globalComm, MPI_STATUS_IGNORE);
-        if (lastLevel != FTI_NSCS) { //Head sends level of checkpoint if post-processing succeed, FTI_NSCS Otherwise
-            FTI_Exec.lastCkptLvel = lastLevel; //Store last successful post-processing checkpoint level
-            sprintf(str, "LastCkptLvel received from head: %d", lastLevel);
-            FTI_Print(str, FTI_DBUG);
-        } else {
-            FTI_Print("Head failed to do post-processing after previous checkpoint.", FTI_WARN);
-        }
-    }
-    
     double t1 = MPI_Wtime(); //Time after waiting for head to done previous post-processing
     int lastCkptLvel = FTI_Exec.ckptLvel; //Store last successful writing checkpoint level in case of failure
     FTI_Exec.ckptLvel = level; //For FTI_WriteCkpt
@@ -1157,7 +1281,11 @@ int FTI_Checkpoint(int id, int level)
 
     // FTIFF: send meta info to the heads
     FTIFF_headInfo *headInfo;
-    if (!FTI_Ckpt[FTI_Exec.ckptLvel].isInline) { // If postCkpt. work is Async. then send message
+    if (!FTI_Ckpt[FTI_Exec.ckptLvel].isInline && FTI_Conf.asyncPostCkpt && res == FTI_SCES) { // Async. post-processing without heads
+        FTI_Exec.wasLastOffline = 1;
+        res = FTI_Try(FTI_StartPostThread(&FTI_Conf, &FTI_Exec, &FTI_Topo, FTI_Ckpt), "start the post-processing thread.");
+    }
+    else if (!FTI_Ckpt[FTI_Exec.ckptLvel].isInline && !FTI_Conf.asyncPostCkpt) { // If postCkpt. work is Async. then send message
         FTI_Exec.wasLastOffline = 1;
         // Head needs ckpt. ID to determine ckpt file name.
         int value = FTI_BASE + FTI_Exec.ckptLvel; //Token to send to head
@@ -1207,6 +1335,13 @@ int FTI_Checkpoint(int id, int level)
     sprintf(str, "Ckpt. ID %d (L%d) (%.2f MB/proc) taken in %.2f sec. (Wt:%.2fs, Wr:%.2fs, Ps:%.2fs)",
             FTI_Exec.ckptID, FTI_Exec.ckptLvel, FTI_Exec.ckptSize / (1024.0 * 1024.0), t3 - t0, t1 - t0, t2 - t1, t3 - t2);
     FTI_Print(str, FTI_INFO);
+
+    // the cost of an offline post-processing is known once it is waited for
+    if (FTI_Exec.wasLastOffline) {
+        FTI_Exec.lastWriteTime = t2 - t1;
+    } else {
+        FTI_AutotuneIntv(&FTI_Conf, &FTI_Exec, FTI_Ckpt, FTI_Exec.ckptLvel, t3 - t1);
+    }
     
     if ( FTI_Conf.dcpEnabled && FTI_Ckpt[4].isDcp ) {
         
@@ -1294,9 +1429,15 @@ int FTI_InitICP(int id, int level, bool activate)
     if ( !activate ) {
         return FTI_SCES;
     }
+
+    // the protected data must be entirely restored by a lazy recovery
+    FTI_LazyWait();
    
     // reset iCP meta info (i.e. set counter to zero etc.)
+    free( FTI_Exec.iCPInfo.isWritten );
     memset( &(FTI_Exec.iCPInfo), 0x0, sizeof(FTIT_iCPInfo) );
+    FTI_Exec.iCPInfo.isWritten = calloc( FTI_Exec.nbVarMax, sizeof(bool) );
+    FTI_Exec.iCPInfo.isWrittenSize = FTI_Exec.nbVarMax;
 
     // init iCP status with failure
     FTI_Exec.iCPInfo.status = FTI_ICP_FAIL;
@@ -1321,6 +1462,24 @@ int FTI_InitICP(int id, int level, bool activate)
         level -= 4; 
     }
 
+    // the post-processing thread reads ckptID and FTI_Ckpt until it is joined
+    FTI_Exec.iCPInfo.t0 = MPI_Wtime(); //Start time
+    if (FTI_Exec.wasLastOffline == 1) { // Block until previous checkpoint is done (Async. work)
+        double postTime;
+        int lastLevel = FTI_WaitPostCkpt(&FTI_Conf, &FTI_Exec, &FTI_Topo, &postTime);
+        if (lastLevel != FTI_NSCS) { //Head sends level of checkpoint if post-processing succeed, FTI_NSCS Otherwise
+            FTI_Exec.lastCkptLvel = lastLevel; //Store last successful post-processing checkpoint level
+            sprintf(str, "LastCkptLvel of asynchronous post-processing: %d", lastLevel);
+            FTI_Print(str, FTI_DBUG);
+            FTI_AutotuneIntv(&FTI_Conf, &FTI_Exec, FTI_Ckpt, lastLevel, FTI_Exec.lastWriteTime + postTime);
+        } else {
+            FTI_Print("Asynchronous post-processing of previous checkpoint failed.", FTI_WARN);
+        }
+    }
+
+    // the recovery is over, compress with 'compress_threads' threads
+    FTI_ShrinkAppThreads( &FTI_Conf );
+
     FTI_Exec.iCPInfo.lastCkptID = FTI_Exec.ckptID;
     FTI_Exec.iCPInfo.isFirstCp = !FTI_Exec.ckptID; //ckptID = 0 if first checkpoint
     FTI_Exec.ckptID = id;
@@ -1340,19 +1499,6 @@ int FTI_InitICP(int id, int level, bool activate)
         level = 4;
     }
 
-    FTI_Exec.iCPInfo.t0 = MPI_Wtime(); //Start time
-    if (FTI_Exec.wasLastOffline == 1) { // Block until previous checkpoint is done (Async. work)
-        int lastLevel;
-        MPI_Recv(&lastLevel, 1, MPI_INT, FTI_Topo.headRank, FTI_Conf.generalTag, FTI_Exec.globalComm, MPI_STATUS_IGNORE);
-        if (lastLevel != FTI_NSCS) { //Head sends level of checkpoint if post-processing succeed, FTI_NSCS Otherwise
-            FTI_Exec.lastCkptLvel = lastLevel; //Store last successful post-processing checkpoint level
-            sprintf(str, "LastCkptLvel received from head: %d", lastLevel);
-            FTI_Print(str, FTI_DBUG);
-        } else {
-            FTI_Print("Head failed to do post-processing after previous checkpoint.", FTI_WARN);
-        }
-    }
-
     FTI_Exec.iCPInfo.t1 = MPI_Wtime(); //Time after waiting for head to done previous post-processing
     FTI_Exec.iCPInfo.lastCkptLvel = FTI_Exec.ckptLvel; //Store last successful writing checkpoint level in case of failure
     FTI_Exec.ckptLvel = level; //For FTI_WriteCkpt
@@ -1481,24 +1627,28 @@ int FTI_AddVarICP( int varID )
 
     char str[FTI_BUFS];
 
-    bool validID = false;
-    
-    int i;
     // check if dataset with 'varID' exists.
-    for(i=0; i<FTI_Exec.nbVar; ++i) {
-        validID |= (FTI_Data[i].id == varID);
-    }
-    if( !validID ) {
+    int idx = FTI_GetDataIdx(&FTI_Exec, varID);
+    if( idx == -1 ) {
         snprintf( str, FTI_BUFS, "FTI_AddVarICP: dataset ID: %d is invalid!", varID );
         FTI_Print(str, FTI_WARN);
         return FTI_NSCS;
     }
     
-    // check if dataset was not already written.
-    for(i=0; i<FTI_Exec.iCPInfo.countVar; ++i) {
-        validID &= !(FTI_Exec.iCPInfo.isWritten[i] == varID);
+    // datasets protected after FTI_InitICP are not in the written flags yet.
+    if( idx >= FTI_Exec.iCPInfo.isWrittenSize ) {
+        bool* isWritten = realloc( FTI_Exec.iCPInfo.isWritten, FTI_Exec.nbVarMax * sizeof(bool) );
+        if( isWritten == NULL ) {
+            FTI_Print("FTI_AddVarICP: cannot allocate the written flags.", FTI_EROR);
+            return FTI_NSCS;
+        }
+        memset( &isWritten[FTI_Exec.iCPInfo.isWrittenSize], 0x0, (FTI_Exec.nbVarMax - FTI_Exec.iCPInfo.isWrittenSize) * sizeof(bool) );
+        FTI_Exec.iCPInfo.isWritten = isWritten;
+        FTI_Exec.iCPInfo.isWrittenSize = FTI_Exec.nbVarMax;
     }
-    if( !validID ) {
+
+    // check if dataset was not already written.
+    if( FTI_Exec.iCPInfo.isWritten[idx] ) {
         snprintf( str, FTI_BUFS, "Dataset with ID: %d was already successfully written!", varID );
         FTI_Print(str, FTI_WARN);
         return FTI_NSCS;
@@ -1538,7 +1688,8 @@ int FTI_AddVarICP( int varID )
     }
 
     if ( res == FTI_SCES ) {
-        FTI_Exec.iCPInfo.isWritten[FTI_Exec.iCPInfo.countVar++] = varID;
+        FTI_Exec.iCPInfo.isWritten[idx] = true;
+        FTI_Exec.iCPInfo.countVar++;
     }
 
     return res;
@@ -1666,7 +1817,11 @@ int FTI_FinalizeICP()
 
     // FTIFF: send meta info to the heads
     FTIFF_headInfo *headInfo;
-    if (!FTI_Ckpt[FTI_Exec.ckptLvel].isInline) { // If postCkpt. work is Async. then send message
+    if (!FTI_Ckpt[FTI_Exec.ckptLvel].isInline && FTI_Conf.asyncPostCkpt && FTI_Exec.iCPInfo.status != FTI_ICP_FAIL) { // Async. post-processing without heads
+        FTI_Exec.wasLastOffline = 1;
+        resPP = FTI_Try(FTI_StartPostThread(&FTI_Conf, &FTI_Exec, &FTI_Topo, FTI_Ckpt), "start the post-processing thread.");
+    }
+    else if (!FTI_Ckpt[FTI_Exec.ckptLvel].isInline && !FTI_Conf.asyncPostCkpt) { // If postCkpt. work is Async. then send message
         FTI_Exec.wasLastOffline = 1;
         // Head needs ckpt. ID to determine ckpt file name.
         int value = FTI_BASE + FTI_Exec.ckptLvel; //Token to send to head
@@ -1714,6 +1869,13 @@ int FTI_FinalizeICP()
                 FTI_Exec.ckptID, FTI_Exec.ckptLvel, FTI_Exec.ckptSize / (1024.0 * 1024.0), t3 - FTI_Exec.iCPInfo.t0, FTI_Exec.iCPInfo.t1 - FTI_Exec.iCPInfo.t0, t2 - FTI_Exec.iCPInfo.t1, t3 - t2);
         FTI_Print(str, FTI_INFO);
 
+        // the cost of an offline post-processing is known once it is waited for
+        if (FTI_Exec.wasLastOffline) {
+            FTI_Exec.lastWriteTime = t2 - FTI_Exec.iCPInfo.t1;
+        } else {
+            FTI_AutotuneIntv(&FTI_Conf, &FTI_Exec, FTI_Ckpt, FTI_Exec.ckptLvel, t3 - FTI_Exec.iCPInfo.t1);
+        }
+
         if ( FTI_Conf.dcpEnabled && FTI_Ckpt[4].isDcp ) {
 
             long norder_data, norder_dcp;
@@ -1771,6 +1933,9 @@ int FTI_FinalizeICP()
     }
 
     FTI_Exec.iCPInfo.status = FTI_ICP_NINI;
+    free( FTI_Exec.iCPInfo.isWritten );
+    FTI_Exec.iCPInfo.isWritten = NULL;
+    FTI_Exec.iCPInfo.isWrittenSize = 0;
 
     return FTI_SCES;
 }
@@ -1800,7 +1965,7 @@ static int copyDataToDevice(){
 int FTI_Recover()
 {
   if ( FTI_Conf.ioMode == FTI_IO_FTIFF ) {
-    int ret = FTI_Try(FTIFF_Recover( &FTI_Exec, FTI_Data, FTI_Ckpt ), "Recovering from Checkpoint");
+    int ret = FTI_Try(FTIFF_Recover( &FTI_Exec, FTI_Data, FTI_Ckpt, &FTI_Conf ), "Recovering from Checkpoint");
     copyDataToDevice();
     return ret;
   }
@@ -1860,56 +2025,11 @@ int FTI_Recover()
     sprintf(str, "Trying to load FTI checkpoint file (%s)...", fn);
     FTI_Print(str, FTI_DBUG);
 
-    FILE* fd = fopen(fn, "rb");
-    if (fd == NULL) {
-        sprintf(str, "Could not open FTI checkpoint file. (%s)...", fn);
-        FTI_Print(str, FTI_EROR);
+    if (FTI_LoadCkptFile(&FTI_Conf, &FTI_Exec, &FTI_Topo, FTI_Ckpt, FTI_Data, fn, -1) != FTI_SCES) {
+        FTI_Print("Could not read FTI checkpoint file.", FTI_EROR);
         return FTI_NREC;
     }
 
-#ifdef GPUSUPPORT
-  for (i = 0; i < FTI_Exec.nbVar; i++) {
-    if (FTI_Data[i].isDevicePtr){
-      FTI_Data[i].ptr = (void *) malloc(FTI_Data[i].size);
-      if (!(FTI_Data[i].ptr)){
-        FTI_Print("RECOVER:: Could not Allocate memory on host",FTI_EROR );
-        return FTI_NREC;
-      }
-    }
-
-
-    fread(FTI_Data[i].ptr, 1, FTI_Data[i].size, fd);
-    if (ferror(fd)) {
-      FTI_Print("Could not read FTI checkpoint file.", FTI_EROR);
-      fclose(fd);
-      return FTI_NREC;
-    }
-
-    if (FTI_Data[i].isDevicePtr){
-      int res;
-      res = FTI_Try(FTI_copy_to_device(FTI_Data[i].devicePtr, FTI_Data[i].ptr, FTI_Data[i].size, &FTI_Exec), "copying data to GPU");
-      if (res == FTI_NSCS) {
-        return FTI_NSCS;
-      }
-      free(FTI_Data[i].ptr);
-      FTI_Data[i].ptr = NULL;
-    }
-  }      
-#else
-  for (i = 0; i < FTI_Exec.nbVar; i++) {
-    fread(FTI_Data[i].ptr, 1, FTI_Data[i].size, fd);
-    if (ferror(fd)) {
-      FTI_Print("Could not read FTI checkpoint file.", FTI_EROR);
-      fclose(fd);
-      return FTI_NREC;
-    }
-  }      
-#endif    
-  if (fclose(fd) != 0) {
-    FTI_Print("Could not close FTI checkpoint file.", FTI_EROR);
-    return FTI_NREC;
-  }
-
   FTI_Exec.reco = 0;
 
   return FTI_SCES;
@@ -2006,6 +2126,12 @@ int FTI_Finalize()
         if ( FTI_Conf.stagingEnabled ) {
             FTI_FinalizeStage( &FTI_Exec, &FTI_Topo, &FTI_Conf );
         }
+        if ( FTI_Conf.shmAggregation ) {
+            FTI_FinalizeShm( &FTI_Conf, &FTI_Topo );
+        }
+        if ( FTI_Conf.headThreads > 1 ) {
+            FTI_FinalizeWorkerThreads();
+        }
         MPI_Barrier(FTI_Exec.globalComm);
         if ( !FTI_Conf.keepHeadsAlive ) { 
             MPI_Finalize();
@@ -2047,10 +2173,18 @@ int FTI_Finalize()
   }
 #endif
 
+    // complete a pending synchronization of the iteration time
+    if (FTI_Exec.iterSyncReq != MPI_REQUEST_NULL) {
+        MPI_Wait(&FTI_Exec.iterSyncReq, MPI_STATUS_IGNORE);
+    }
+
+    // complete a pending lazy recovery
+    FTI_LazyWait();
+
     // If there is remaining work to do for last checkpoint
     if (FTI_Exec.wasLastOffline == 1) {
-        int lastLevel;
-        MPI_Recv(&lastLevel, 1, MPI_INT, FTI_Topo.headRank, FTI_Conf.generalTag, FTI_Exec.globalComm, MPI_STATUS_IGNORE);
+        double postTime;
+        int lastLevel = FTI_WaitPostCkpt(&FTI_Conf, &FTI_Exec, &FTI_Topo, &postTime);
         if (lastLevel != FTI_NSCS) { //Head sends level of checkpoint if post-processing succeed, FTI_NSCS Otherwise
             FTI_Exec.lastCkptLvel = lastLevel;
         }
@@ -2068,6 +2202,10 @@ int FTI_Finalize()
     if ( FTI_Conf.stagingEnabled ) {
         FTI_FinalizeStage( &FTI_Exec, &FTI_Topo, &FTI_Conf );
     }
+    // collective with the head (after it processed the last checkpoint)
+    if ( FTI_Conf.shmAggregation ) {
+        FTI_FinalizeShm( &FTI_Conf, &FTI_Topo );
+    }
 
     // If we need to keep the last checkpoint and there was a checkpoint
     if ( FTI_Conf.saveLastCkpt && ( FTI_Exec.ckptID > 0 ) ) {
@@ -2120,12 +2258,28 @@ int FTI_Finalize()
     if (FTI_Conf.dcpEnabled) {
         FTI_FinalizeDcp( &FTI_Conf, &FTI_Exec );
     }
+    if ( FTI_Conf.asyncPostCkpt ) {
+        FTI_FinalizePostThread( &FTI_Exec );
+    }
+    if ( FTI_GetThreadCount() > 1 ) {
+        FTI_FinalizeWorkerThreads();
+    }
+    if ( FTI_Exec.nodeAppComm != MPI_COMM_NULL ) {
+        MPI_Comm_free( &FTI_Exec.nodeAppComm );
+    }
 
     FTI_FreeMeta(&FTI_Exec);
     FTI_FreeTypesAndGroups(&FTI_Exec);
     if( FTI_Conf.ioMode == FTI_IO_FTIFF ) {
         FTIFF_FreeDbFTIFF(FTI_Exec.lastdb);
-    }
+        FTIFF_FreeIdx(&FTI_Exec);
+    }
+    free(FTI_Data);
+    FTI_Data = NULL;
+    FTI_Exec.nbVarMax = 0;
+    free(FTI_Exec.dataIdx);
+    FTI_Exec.dataIdx = NULL;
+    FTI_Exec.dataIdxSize = 0;
     MPI_Barrier(FTI_Exec.globalComm);
     FTI_Print("FTI has been finalized.", FTI_INFO);
     return FTI_SCES;
@@ -2167,19 +2321,27 @@ int FTI_RecoverVar(int id)
         return FTI_NSCS;
     }
 
+    int idx = FTI_GetDataIdx(&FTI_Exec, id);
+    if (idx == -1) {
+        FTI_Print("Variables must be protected before they can be recovered.", FTI_EROR);
+        return FTI_NREC;
+    }
+    //Datasets are stored in the order in which they are protected
+    int pos = FTI_GetMetaVarIdx(&FTI_Exec.meta[FTI_Exec.ckptLvel], id, idx);
+    if (pos == -1) {
+        char str[FTI_BUFS];
+        sprintf(str, "Protected variable (ID %d) is not in the checkpoint.", id);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NREC;
+    }
+
     //Check if sizes of protected variables matches
-    int i;
-    for (i = 0; i < FTI_Exec.nbVar; i++) {
-        if (id == FTI_Exec.meta[FTI_Exec.ckptLvel].varID[i]) {
-            if (FTI_Data[i].size != FTI_Exec.meta[FTI_Exec.ckptLvel].varSize[i]) {
-                char str[FTI_BUFS];
-                sprintf(str, "Cannot recover %ld bytes to protected variable (ID %d) size: %ld",
-                        FTI_Exec.meta[FTI_Exec.ckptLvel].varSize[i], FTI_Exec.meta[FTI_Exec.ckptLvel].varID[i],
-                        FTI_Data[i].size);
-                FTI_Print(str, FTI_WARN);
-                return FTI_NREC;
-            }
-        }
+    if (FTI_Data[idx].size != FTI_Exec.meta[FTI_Exec.ckptLvel].varSize[pos]) {
+        char str[FTI_BUFS];
+        sprintf(str, "Cannot recover %ld bytes to protected variable (ID %d) size: %ld",
+                FTI_Exec.meta[FTI_Exec.ckptLvel].varSize[pos], id, FTI_Data[idx].size);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NREC;
     }
 
 #ifdef ENABLE_HDF5 //If HDF5 is installed
@@ -2203,36 +2365,10 @@ int FTI_RecoverVar(int id)
     sprintf(str, "Trying to load FTI checkpoint file (%s)...", fn);
     FTI_Print(str, FTI_DBUG);
 
-    FILE* fd = fopen(fn, "rb");
-    if (fd == NULL) {
-        FTI_Print("Could not open FTI checkpoint file.", FTI_EROR);
-        return FTI_NREC;
-    }
-
-    long offset = 0;
-    for (i = 0; i < FTI_Exec.nbVar; i++) {
-        if (id == FTI_Exec.meta[FTI_Exec.ckptLvel].varID[i]) {
-            sprintf(str, "Recovering var %d ", id);
-            FTI_Print(str, FTI_DBUG);
-            fseek(fd, offset, SEEK_SET);
-            fread(FTI_Data[i].ptr, 1, FTI_Data[i].size, fd);
-            if (ferror(fd)) {
-                FTI_Print("Could not read FTI checkpoint file.", FTI_EROR);
-                fclose(fd);
-                return FTI_NREC;
-            }
-            break;
-        }
-        offset += FTI_Exec.meta[FTI_Exec.ckptLvel].varSize[i];
-    }
-
-    if (i == FTI_Exec.nbVar) {
-        FTI_Print("Variables must be protected before they can be recovered.", FTI_EROR);
-        fclose(fd);
-        return FTI_NREC;
-    }
-    if (fclose(fd) != 0) {
-        FTI_Print("Could not close FTI checkpoint file.", FTI_EROR);
+    sprintf(str, "Recovering var %d ", id);
+    FTI_Print(str, FTI_DBUG);
+    if (FTI_LoadCkptFile(&FTI_Conf, &FTI_Exec, &FTI_Topo, FTI_Ckpt, FTI_Data, fn, idx) != FTI_SCES) {
+        FTI_Print("Could not read FTI checkpoint file.", FTI_EROR);
         return FTI_NREC;
     }
 
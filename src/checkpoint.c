@@ -57,6 +57,13 @@
   recomputes the checkpoint interval in iterations and corrects the next
   checkpointing iteration based on the observed mean iteration duration.
 
+  The global mean iteration time is reduced with MPI_Iallreduce. The
+  reduction is started at a synchronization iteration and completed at
+  the next call, so the processes only wait for each other if they are
+  more than one iteration apart. Since all processes complete the
+  reduction at the same iteration, they all agree on the next
+  checkpointing iteration.
+
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_UpdateIterTime(FTIT_execution* FTI_Exec)
@@ -68,11 +75,11 @@ int FTI_UpdateIterTime(FTIT_execution* FTI_Exec)
     if (FTI_Exec->ckptIcnt > 0) {
         FTI_Exec->lastIterTime = FTI_Exec->iterTime - last;
         FTI_Exec->totalIterTime = FTI_Exec->totalIterTime + FTI_Exec->lastIterTime;
-        if (FTI_Exec->ckptIcnt % FTI_Exec->syncIter == 0) {
-            FTI_Exec->meanIterTime = FTI_Exec->totalIterTime / FTI_Exec->ckptIcnt;
-            MPI_Allreduce(&FTI_Exec->meanIterTime, &FTI_Exec->globMeanIter, 1, MPI_DOUBLE, MPI_SUM, FTI_COMM_WORLD);
+        // complete the synchronization started in the previous call
+        if (FTI_Exec->iterSyncReq != MPI_REQUEST_NULL) {
+            MPI_Wait(&FTI_Exec->iterSyncReq, MPI_STATUS_IGNORE);
             MPI_Comm_size(FTI_COMM_WORLD, &nbProcs);
-            FTI_Exec->globMeanIter = FTI_Exec->globMeanIter / nbProcs;
+            FTI_Exec->globMeanIter = FTI_Exec->iterSyncSum / nbProcs;
             if (FTI_Exec->globMeanIter > 60) {
                 FTI_Exec->ckptIntv = 1;
             }
@@ -83,9 +90,12 @@ int FTI_UpdateIterTime(FTIT_execution* FTI_Exec)
             if (FTI_Exec->ckptLast == 0) {
                 res = res + 1;
             }
-            if (res >= FTI_Exec->ckptIcnt) {
-                FTI_Exec->ckptNext = res;
+            // the interval is known one iteration late, a check that
+            // became due in the meantime is done in this call
+            if (res <= FTI_Exec->ckptIcnt) {
+                res = FTI_Exec->ckptIcnt + 1;
             }
+            FTI_Exec->ckptNext = res;
             snprintf(str, FTI_BUFS, "Current iter : %d ckpt intv. : %d . Next ckpt. at iter. %d . Sync. intv. : %d",
                     FTI_Exec->ckptIcnt, FTI_Exec->ckptIntv, FTI_Exec->ckptNext, FTI_Exec->syncIter);
             FTI_Print(str, FTI_DBUG);
@@ -101,11 +111,86 @@ int FTI_UpdateIterTime(FTIT_execution* FTI_Exec)
 
             }
         }
+        if (FTI_Exec->ckptIcnt % FTI_Exec->syncIter == 0) {
+            // 'meanIterTime' is the send buffer until the next call
+            FTI_Exec->meanIterTime = FTI_Exec->totalIterTime / FTI_Exec->ckptIcnt;
+            MPI_Iallreduce(&FTI_Exec->meanIterTime, &FTI_Exec->iterSyncSum, 1, MPI_DOUBLE, MPI_SUM,
+                    FTI_COMM_WORLD, &FTI_Exec->iterSyncReq);
+        }
     }
     FTI_Exec->ckptIcnt++; // Increment checkpoint loop counter
     return FTI_SCES;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It sets the interval of a level to the Young/Daly optimum.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Ckpt        Checkpoint metadata.
+  @param      level           Level of the checkpoint just taken.
+  @param      cost            Write and post-processing time on this process.
+  @return     integer         FTI_SCES if successful.
+
+  The cost C of a level is the maximum duration over all the processes,
+  averaged with the previous cost of the level. With the mean time
+  between failures M of the level, the interval is set to Daly's
+  estimate of the optimum
+
+    T = sqrt(2CM) * (1 + sqrt(C/2M)/3 + C/18M) - C    if C < 2M
+    T = M                                             otherwise
+
+  which is Young's sqrt(2CM) for C << M. The interval is rounded to
+  minutes and the next checkpoint of the level is rescheduled to the
+  next multiple of it. The wait for the previous post-processing is not
+  part of the cost. An offline post-processing (head or thread) is added
+  when it is waited for, with the duration it reports. Must be called by
+  all the application processes.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_AutotuneIntv(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_checkpoint* FTI_Ckpt, int level, double cost)
+{
+    char str[FTI_BUFS];
+    if (!FTI_Conf->ckptAutotune || level < 1 || level > 4) {
+        return FTI_SCES;
+    }
+    // dCP checkpoints do not tell the cost of a full L4 checkpoint
+    if (FTI_Ckpt[level].ckptIntv <= 0 || FTI_Ckpt[level].mtbf <= 0 || FTI_Ckpt[level].isDcp) {
+        return FTI_SCES;
+    }
+
+    double maxCost;
+    MPI_Allreduce(&cost, &maxCost, 1, MPI_DOUBLE, MPI_MAX, FTI_COMM_WORLD);
+    if (FTI_Ckpt[level].ckptCost > 0) {
+        FTI_Ckpt[level].ckptCost = 0.5 * (FTI_Ckpt[level].ckptCost + maxCost);
+    }
+    else {
+        FTI_Ckpt[level].ckptCost = maxCost;
+    }
+
+    double C = FTI_Ckpt[level].ckptCost;
+    double M = 60.0 * FTI_Ckpt[level].mtbf;
+    double T = M;
+    if (C < 2 * M) {
+        T = sqrt(2 * C * M) * (1 + sqrt(C / (2 * M)) / 3 + C / (18 * M)) - C;
+    }
+    int intv = (int)rint(T / 60);
+    if (intv < 1) {
+        intv = 1;
+    }
+
+    if (intv != FTI_Ckpt[level].ckptIntv) {
+        FTI_Ckpt[level].ckptIntv = intv;
+        FTI_Ckpt[level].ckptCnt = FTI_Exec->minuteCnt / intv + 1;
+        snprintf(str, FTI_BUFS, "L%d ckpt. interval set to %d min. (cost: %.2f sec., MTBF: %d min.)",
+                level, intv, C, FTI_Ckpt[level].mtbf);
+        FTI_Print(str, FTI_INFO);
+    }
+    return FTI_SCES;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      It writes the checkpoint data in the target file.
@@ -219,6 +304,11 @@ int FTI_WriteCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
                 break;
 #endif
             default:
+                // node aggregation: the head writes the file from shared memory
+                if (FTI_Conf->shmAggregation && FTI_ShmWriteCkpt(FTI_Conf, FTI_Exec, FTI_Ckpt, FTI_Data) == FTI_SCES) {
+                    res = FTI_SCES;
+                    break;
+                }
                 res = FTI_Try(FTI_WritePosix(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt, FTI_Data),"write checkpoint.");
                 break;
         }
@@ -293,7 +383,7 @@ int FTI_PostCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 
     //Check if all processes done post-processing correctly
     int allRes;
-    MPI_Allreduce(&res, &allRes, 1, MPI_INT, MPI_SUM, FTI_COMM_WORLD);
+    MPI_Allreduce(&res, &allRes, 1, MPI_INT, MPI_SUM, FTI_Exec->postComm);
     if (allRes != FTI_SCES) {
         FTI_Print("Error postprocessing checkpoint. Discarding current checkpoint...", FTI_WARN);
         FTI_Clean(FTI_Conf, FTI_Topo, FTI_Ckpt, 0); //Remove temporary files
@@ -353,7 +443,7 @@ int FTI_PostCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
             }
         }
     }
-    MPI_Barrier(FTI_COMM_WORLD); //barrier needed to wait for process to rename directories (new temporary could be needed in next checkpoint)
+    MPI_Barrier(FTI_Exec->postComm); //barrier needed to wait for process to rename directories (new temporary could be needed in next checkpoint)
 
     double t3 = MPI_Wtime(); //Renaming directories time
 
@@ -367,6 +457,61 @@ int FTI_PostCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     return FTI_SCES;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Waits for the asynchronous post-processing of the last ckpt.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      postTime        Duration of the post-processing.
+  @return     integer         Level post-processed, FTI_NSCS if it failed.
+
+  The post-processing is done either by the head or, without heads, by
+  the post-processing thread of the application process. The head sends
+  the level and the duration of its post-processing in one message.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_WaitPostCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, double* postTime)
+{
+    int lastLevel;
+    if (FTI_Conf->asyncPostCkpt) {
+        lastLevel = FTI_JoinPostThread(postTime);
+    }
+    else {
+        double reply[2];
+        MPI_Recv(reply, 2, MPI_DOUBLE, FTI_Topo->headRank, FTI_Conf->generalTag, FTI_Exec->globalComm, MPI_STATUS_IGNORE);
+        lastLevel = (int)reply[0];
+        *postTime = reply[1];
+    }
+    return lastLevel;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Cancels and frees the persistent requests of the head.
+  @param      reqs            Requests.
+  @param      nbReqs          Number of requests.
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_FreeListenRequests(MPI_Request* reqs, int nbReqs)
+{
+    int i;
+    for (i = 0; i < nbReqs; i++) {
+        if (reqs[i] == MPI_REQUEST_NULL) {
+            continue;
+        }
+        int done;
+        MPI_Test(&reqs[i], &done, MPI_STATUS_IGNORE);
+        if (!done) {
+            MPI_Cancel(&reqs[i]);
+            MPI_Wait(&reqs[i], MPI_STATUS_IGNORE);
+        }
+        MPI_Request_free(&reqs[i]);
+    }
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      It listens for checkpoint notifications.
@@ -379,81 +524,151 @@ int FTI_PostCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   and takes the required actions after notification. This function is only
   executed by the head of the nodes and its complementary with the
   FTI_Checkpoint function in terms of communications.
+
+  The head keeps one persistent receive per application process for the
+  checkpoint and the finalize notifications, and one for stage requests,
+  and blocks in MPI_Waitsome until one of them completes. If
+  'Advanced:listen_sleep_max' is set, the requests are polled with
+  MPI_Testsome instead, sleeping between polls with an exponential backoff
+  up to that many microseconds (for MPI libraries that busy-poll inside
+  MPI_Waitsome).
+
+  Stage requests are queued and transferred chunk by chunk while no
+  checkpoint request is pending (see 'FTI_ProgressStage'). In the
+  meantime, the requests are polled with MPI_Testsome as well.
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_Listen(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt)
 {
+    char str[FTI_BUFS];
+    int nbApprocs = FTI_Topo->nbApprocs;
+
+    // requests: [0,n) ckpt tokens, [n,2n) finalize tokens, 2n stage request
+    int nbReqs = 2 * nbApprocs + 1;
+    int stageIdx = 2 * nbApprocs;
+    MPI_Request* reqs = talloc(MPI_Request, nbReqs);
+    MPI_Status* statuses = talloc(MPI_Status, nbReqs);
+    int* indices = talloc(int, nbReqs);
+    int* tokens = talloc(int, 2 * nbApprocs);
+    char* stageBuf = NULL;
 
-    MPI_Status ckpt_status;         int ckpt_flag = 0;
-    MPI_Status stage_status;        int stage_flag = 0;
-    MPI_Status finalize_status;     int finalize_flag = 0;
+    int i;
+    for (i = 0; i < nbApprocs; i++) {
+        MPI_Recv_init(&tokens[i], 1, MPI_INT, FTI_Topo->body[i], FTI_Conf->ckptTag, FTI_Exec->globalComm, &reqs[i]);
+        MPI_Recv_init(&tokens[nbApprocs + i], 1, MPI_INT, FTI_Topo->body[i], FTI_Conf->finalTag, FTI_Exec->globalComm, &reqs[nbApprocs + i]);
+        MPI_Start(&reqs[i]);
+        MPI_Start(&reqs[nbApprocs + i]);
+    }
+    reqs[stageIdx] = MPI_REQUEST_NULL;
+    if ( FTI_Conf->stagingEnabled ) {
+        stageBuf = talloc(char, FTI_SI_REQ_SIZE);
+        MPI_Recv_init(stageBuf, FTI_SI_REQ_SIZE, MPI_BYTE, MPI_ANY_SOURCE, FTI_Conf->stageTag, FTI_Exec->nodeComm, &reqs[stageIdx]);
+        MPI_Start(&reqs[stageIdx]);
+    }
+
+    int ckptCnt = 0, finalCnt = 0, stagePending = 0;
+    long sleepUs = FTI_LISTEN_SLEEP_MIN;
 
     FTI_Print("Head starts listening...", FTI_DBUG);
     while (1) { //heads can stop only by receiving FTI_ENDW
 
-        FTI_Print("Head waits for message...", FTI_DBUG);
+        int outcount;
+        // staging is interrupted as soon as a checkpoint token arrives
+        int doStage = stagePending && (ckptCnt == 0);
+        if ( FTI_Conf->listenSleepMax > 0 || doStage ) {
+            MPI_Testsome(nbReqs, reqs, &outcount, indices, statuses);
+            if ( outcount == 0 && doStage ) {
+                stagePending = FTI_ProgressStage( FTI_Conf, FTI_Exec, FTI_Topo );
+                continue;
+            }
+            if ( outcount == 0 ) {
+                struct timespec pause;
+                pause.tv_sec = sleepUs / 1000000L;
+                pause.tv_nsec = (sleepUs % 1000000L) * 1000L;
+                nanosleep(&pause, NULL);
+                sleepUs = (2 * sleepUs < FTI_Conf->listenSleepMax) ? 2 * sleepUs : FTI_Conf->listenSleepMax;
+                continue;
+            }
+            sleepUs = FTI_LISTEN_SLEEP_MIN;
+        } else {
+            MPI_Waitsome(nbReqs, reqs, &outcount, indices, statuses);
+        }
 
-        MPI_Iprobe( MPI_ANY_SOURCE, FTI_Conf->finalTag, FTI_Exec->globalComm, &finalize_flag, &finalize_status );
-        if ( FTI_Conf->stagingEnabled ) {
-            MPI_Iprobe( MPI_ANY_SOURCE, FTI_Conf->stageTag, FTI_Exec->nodeComm, &stage_flag, &stage_status );
+        int stageSource = -1;
+        for (i = 0; i < outcount; i++) {
+            if ( indices[i] < nbApprocs ) {
+                ckptCnt++;
+            } else if ( indices[i] < stageIdx ) {
+                finalCnt++;
+            } else {
+                stageSource = statuses[i].MPI_SOURCE;
+            }
         }
-        MPI_Iprobe( MPI_ANY_SOURCE, FTI_Conf->ckptTag, FTI_Exec->globalComm, &ckpt_flag, &ckpt_status );
-        if( ckpt_flag ) {
 
-            // head will process the whole checkpoint
-            // (treated second due to priority)
-            FTI_HandleCkptRequest( FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt ); 
-            ckpt_flag = 0;
-            continue;
+        // head will process the whole checkpoint
+        // (treated first due to priority)
+        if ( ckptCnt == nbApprocs ) {
+            FTI_HandleCkptRequest( FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt, tokens );
+            ckptCnt = 0;
+            for (i = 0; i < nbApprocs; i++) {
+                MPI_Start(&reqs[i]);
+            }
+        }
+
+        // stage requests are only queued here
+        if ( stageSource >= 0 ) {
+            if ( FTI_HandleStageRequest( FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt, stageBuf, stageSource ) == FTI_SCES ) {
+                stagePending = 1;
+            }
+            MPI_Start(&reqs[stageIdx]);
+        }
 
-        } 
+        if ( finalCnt == nbApprocs ) {
 
-        if ( stage_flag ) {
-            
-            // head will process each unstage request on its own
-            // [A MAYBE: we could interrupt the unstageing process if 
-            // we receive a checkpoint request.]
-            FTI_HandleStageRequest( FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt, stage_status.MPI_SOURCE );
-            stage_flag = 0;
-            continue;
+            // process all pending staging requests before finalize
+            int stageFlag = 1;
+            MPI_Status stageStatus;
+            while ( reqs[stageIdx] != MPI_REQUEST_NULL && stageFlag ) {
+                MPI_Test(&reqs[stageIdx], &stageFlag, &stageStatus);
+                if ( stageFlag ) {
+                    FTI_HandleStageRequest( FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt, stageBuf, stageStatus.MPI_SOURCE );
+                    MPI_Start(&reqs[stageIdx]);
+                }
+            }
+            while ( FTI_ProgressStage( FTI_Conf, FTI_Exec, FTI_Topo ) > 0 );
 
-        } 
-
-        // the 'continue' statement ensures that we first process all
-        // checkpoint and staging request before we call finalize.
-        if ( finalize_flag ) {
-            
-            char str[FTI_BUFS];
-            FTI_Print("Head waits for message...", FTI_DBUG);
-            
-            int val = 0, i;
-            for (i = 0; i < FTI_Topo->nbApprocs; i++) { // Iterate on the application processes in the node
-                int buf;
-                MPI_Recv(&buf, 1, MPI_INT, FTI_Topo->body[i], FTI_Conf->finalTag, FTI_Exec->globalComm, MPI_STATUS_IGNORE);
-                snprintf(str, FTI_BUFS, "The head received a %d message", buf);
+            int val = 0;
+            for (i = 0; i < nbApprocs; i++) { // Iterate on the application processes in the node
+                snprintf(str, FTI_BUFS, "The head received a %d message", tokens[nbApprocs + i]);
                 FTI_Print(str, FTI_DBUG);
-                val += buf;
+                val += tokens[nbApprocs + i];
             }
 
-            val /= FTI_Topo->nbApprocs;
+            val /= nbApprocs;
 
             if ( val != FTI_ENDW) { // If we were asked to finalize
                 FTI_Print( "Inconsistency in Finalize request.", FTI_WARN );
             }
-            
+
+            // communicators may be freed during finalize
+            FTI_FreeListenRequests(reqs, nbReqs);
+            free(reqs);
+            free(statuses);
+            free(indices);
+            free(tokens);
+            free(stageBuf);
+
             FTI_Print("Head stopped listening.", FTI_DBUG);
             FTI_Finalize();
 
-            if ( FTI_Conf->keepHeadsAlive ) {
-                break;
-            }
+            // will be reached only if keepHeadsAlive is TRUE
+            break;
 
         }
 
     }
 
-    // will be reached only if keepHeadsAlive is TRUE
     return FTI_SCES;
 
 }
@@ -465,11 +680,12 @@ int FTI_Listen(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   @param      FTI_Exec        Execution metadata.
   @param      FTI_Topo        Topology metadata.
   @param      FTI_Ckpt        Checkpoint metadata.
+  @param      tokens          Tokens received from the application processes.
   @return     integer         FTI_SCES if successful.
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_HandleCkptRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
-        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt)
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, int* tokens)
 {   
     char str[FTI_BUFS]; //For console output
     int flags[7]; //Increment index if get corresponding value from application process
@@ -478,10 +694,8 @@ int FTI_HandleCkptRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
     for (i = 0; i < 7; i++) { // Initialize flags
         flags[i] = 0;
     }
-    FTI_Print("Head waits for message...", FTI_DBUG);
     for (i = 0; i < FTI_Topo->nbApprocs; i++) { // Iterate on the application processes in the node
-        int buf;
-        MPI_Recv(&buf, 1, MPI_INT, FTI_Topo->body[i], FTI_Conf->ckptTag, FTI_Exec->globalComm, MPI_STATUS_IGNORE);
+        int buf = tokens[i];
         snprintf(str, FTI_BUFS, "The head received a %d message", buf);
         FTI_Print(str, FTI_DBUG);
         flags[buf - FTI_BASE] = flags[buf - FTI_BASE] + 1;
@@ -513,8 +727,12 @@ int FTI_HandleCkptRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
             FTI_Exec->meta[0].fs[k] = headInfo[i].fs;
             FTI_Exec->meta[0].pfs[k] = headInfo[i].pfs;
             isDcpCnt += headInfo[i].isDcp;
-            MPI_Recv(&(FTI_Exec->meta[0].varID[k * FTI_BUFS]), headInfo[i].nbVar, MPI_INT, FTI_Topo->body[i], FTI_Conf->generalTag, FTI_Exec->globalComm, MPI_STATUS_IGNORE);
-            MPI_Recv(&(FTI_Exec->meta[0].varSize[k * FTI_BUFS]), headInfo[i].nbVar, MPI_LONG, FTI_Topo->body[i], FTI_Conf->generalTag, FTI_Exec->globalComm, MPI_STATUS_IGNORE);
+            if ( FTI_ReserveMetaVar(&(FTI_Exec->meta[0]), headInfo[i].nbVar) != FTI_SCES ) {
+                free(headInfo);
+                return FTI_NSCS;
+            }
+            MPI_Recv(&(FTI_Exec->meta[0].varID[k * FTI_Exec->meta[0].varMax]), headInfo[i].nbVar, MPI_INT, FTI_Topo->body[i], FTI_Conf->generalTag, FTI_Exec->globalComm, MPI_STATUS_IGNORE);
+            MPI_Recv(&(FTI_Exec->meta[0].varSize[k * FTI_Exec->meta[0].varMax]), headInfo[i].nbVar, MPI_LONG, FTI_Topo->body[i], FTI_Conf->generalTag, FTI_Exec->globalComm, MPI_STATUS_IGNORE);
             strncpy(&(FTI_Exec->meta[0].ckptFile[k * FTI_BUFS]), headInfo[i].ckptFile , FTI_BUFS);
             sscanf(&(FTI_Exec->meta[0].ckptFile[k * FTI_BUFS]), "Ckpt%d", &FTI_Exec->ckptID);
         }
@@ -535,6 +753,11 @@ int FTI_HandleCkptRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
     //Check if checkpoint was written correctly by all processes
     int res = (FTI_Exec->ckptLvel == 6) ? FTI_NSCS : FTI_SCES;
 
+    // node aggregation: write the local files of the checkpoints in shared memory
+    if ( FTI_Conf->shmAggregation && res == FTI_SCES ) {
+        res = FTI_Try(FTI_ShmFlushLocal(FTI_Conf, FTI_Exec, FTI_Topo), "write local checkpoint files from shared memory.");
+    }
+
     // check for consistency of dCP request (isDcpCnt is 0 if dCP is disabled)
     if ( (isDcpCnt > 0) && (isDcpCnt < FTI_Topo->nbApprocs) ) {
         FTI_Print( "dCP was requested by some but not all ranks, discarding checkpoint request!", FTI_WARN );
@@ -542,6 +765,7 @@ int FTI_HandleCkptRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
     }
     int allRes;
     MPI_Allreduce(&res, &allRes, 1, MPI_INT, MPI_SUM, FTI_COMM_WORLD);
+    double t0 = MPI_Wtime();
     if (allRes == FTI_SCES) { //If checkpoint was written correctly do post-processing
         res = FTI_Try(FTI_PostCkpt(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt), "postprocess the checkpoint.");
         if (res == FTI_SCES) {
@@ -553,8 +777,9 @@ int FTI_HandleCkptRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
         FTI_Clean(FTI_Conf, FTI_Topo, FTI_Ckpt, 0); //Remove temporary files
         res = FTI_NSCS;
     }
+    double reply[2] = { res, MPI_Wtime() - t0 }; // level and post-processing time
     for (i = 0; i < FTI_Topo->nbApprocs; i++) { // Send msg. to avoid checkpoint collision
-        MPI_Send(&res, 1, MPI_INT, FTI_Topo->body[i], FTI_Conf->generalTag, FTI_Exec->globalComm);
+        MPI_Send(reply, 2, MPI_DOUBLE, FTI_Topo->body[i], FTI_Conf->generalTag, FTI_Exec->globalComm);
     }
     return FTI_SCES;
 }
@@ -674,29 +899,25 @@ int FTI_WriteMPI(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 
     write_info.FTI_Conf = FTI_Conf;
 
-    // enable collective buffer optimization
+    // set MPI-IO hints ([MPIIO] section and calibration)
     MPI_Info info;
-    MPI_Info_create(&info);
-    MPI_Info_set(info, "romio_cb_write", "enable");
-
-    // TODO enable to set stripping unit in the config file (Maybe also other hints)
-    // set stripping unit to 4MB
-    MPI_Info_set(info, "stripping_unit", "4194304");
+    FTI_CreateMpiioInfo(FTI_Conf, &info, FTI_MPIIO_WRITE);
 
     MPI_Offset chunkSize = FTI_Exec->ckptSize;
 
-    // collect chunksizes of other ranks
-    MPI_Offset* chunkSizes = talloc(MPI_Offset, FTI_Topo->nbApprocs * FTI_Topo->nbNodes);
-    MPI_Allgather(&chunkSize, 1, MPI_OFFSET, chunkSizes, 1, MPI_OFFSET, FTI_COMM_WORLD);
+    // one shared file, or one subfile per group of nodes
+    MPI_Comm fileComm = FTI_MpiioComm(FTI_Conf, FTI_Exec, FTI_Topo);
+    int fileRank;
+    MPI_Comm_rank(fileComm, &fileRank);
 
     char gfn[FTI_BUFS], ckptFile[FTI_BUFS];
-    snprintf(ckptFile, FTI_BUFS, "Ckpt%d-mpiio.fti", FTI_Exec->ckptID);
+    FTI_MpiioFileName(FTI_Conf, FTI_Exec, FTI_Topo, ckptFile);
     snprintf(gfn, FTI_BUFS, "%s/%s", FTI_Conf->gTmpDir, ckptFile);
     // open parallel file (collective call)
     //    MPI_File pfh;
 
 #ifdef LUSTRE
-    if (FTI_Topo->splitRank == 0) {
+    if (fileRank == 0) {
         res = llapi_file_create(gfn, FTI_Conf->stripeUnit, FTI_Conf->stripeOffset, FTI_Conf->stripeFactor, 0);
         if (res) {
             char error_msg[FTI_BUFS];
@@ -711,7 +932,7 @@ int FTI_WriteMPI(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         }
     }
 #endif
-    res = MPI_File_open(FTI_COMM_WORLD, gfn, MPI_MODE_WRONLY|MPI_MODE_CREATE, info, &(write_info.pfh));
+    res = MPI_File_open(fileComm, gfn, MPI_MODE_WRONLY|MPI_MODE_CREATE, info, &(write_info.pfh));
 
     // check if successful
     if (res != 0) {
@@ -720,17 +941,42 @@ int FTI_WriteMPI(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         MPI_Error_string(res, mpi_err, &reslen);
         snprintf(str, FTI_BUFS, "unable to create file [MPI ERROR - %i] %s", res, mpi_err);
         FTI_Print(str, FTI_EROR);
-        free(chunkSizes);
+        MPI_Info_free(&info);
         return FTI_NSCS;
     }
 
-    // set file offset
-    write_info.offset = 0;
+    // set file offset (collect chunksizes of the other ranks of the file)
+    if (FTI_MpiioOffsets(FTI_Conf, FTI_Exec, FTI_Topo, write_info.pfh, &chunkSize, 1,
+                &write_info.offset) != FTI_SCES) {
+        MPI_File_close(&write_info.pfh);
+        MPI_Info_free(&info);
+        return FTI_NSCS;
+    }
     int i;
-    for (i = 0; i < FTI_Topo->splitRank; i++) {
-        write_info.offset += chunkSizes[i];
+
+    // collective write of all datasets (data on the GPU is written per dataset)
+    if (FTI_Conf->mpiioCollective) {
+        int hasDevicePtr = 0, anyDevicePtr;
+        for (i = 0; i < FTI_Exec->nbVar; i++) {
+            hasDevicePtr |= FTI_Data[i].isDevicePtr;
+        }
+        MPI_Allreduce(&hasDevicePtr, &anyDevicePtr, 1, MPI_INT, MPI_MAX, FTI_COMM_WORLD);
+        if (!anyDevicePtr) {
+            write_info.err = FTI_MpiioWriteAll(FTI_Exec, FTI_Data, write_info.pfh, write_info.offset, info);
+            MPI_File_close(&write_info.pfh);
+            MPI_Info_free(&info);
+            if (write_info.err != MPI_SUCCESS) {
+                errno = 0;
+                int reslen;
+                MPI_Error_string(write_info.err, mpi_err, &reslen);
+                snprintf(str, FTI_BUFS, "Failed to write protected data collectively to PFS [MPI ERROR - %i] %s", write_info.err, mpi_err);
+                FTI_Print(str, FTI_EROR);
+                return FTI_NSCS;
+            }
+            return FTI_SCES;
+        }
+        FTI_Print("Protected data on the GPU, collective MPI-IO write disabled.", FTI_DBUG);
     }
-    free(chunkSizes);
 
     for (i = 0; i < FTI_Exec->nbVar; i++) {
         // determine the type of data pointer
@@ -0,0 +1,1560 @@
+/**
+ *  Copyright (c) 2017 Leonardo A. Bautista-Gomez
+ *  All rights reserved
+ *
+ *  FTI - A multi-level checkpointing library for C/C++/Fortran applications
+ *
+ *  Revision 1.0 : Fault Tolerance Interface (FTI)
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  @file   compress.c
+ *  @date   October, 2018
+ *  @brief  Block compression of the checkpoint data.
+ *
+ *  A data chunk is compressed in blocks of 'Advanced:compress_block_size'
+ *  bytes, which are (de-)compressed in parallel by the worker threads.
+ *  The compressed stream is laid out as follows:
+ *
+ *      [block 0][block 1]...[block n-1][csize[0..n-1]][n][blockSize][filter]
+ *
+ *  where csize are uint32_t and the trailer allows to locate every block.
+ *  A block that does not shrink is stored raw (csize == raw block size).
+ *
+ *  Before compression, the elements of a block may be transformed to
+ *  expose the redundancy of floating-point data to the codec: every
+ *  element may be XORed with the previous one ('Advanced:compress_delta')
+ *  and the bytes, or bits, of equal significance may be grouped together
+ *  ('Advanced:compress_shuffle'). The filter word of the trailer holds
+ *  the element size and the transform, thus the stream can be restored
+ *  without any dataset information.
+ *
+ *  Datasets of floats or doubles with an error bound (FTI_SetErrorBound)
+ *  are quantized instead: every element is predicted from the previous
+ *  restored element and the difference is stored as an integer multiple
+ *  of twice the bound. Elements that cannot be quantized within the bound
+ *  (e.g. NaN) are stored exactly after the codes. The transformed blocks
+ *  have a variable length, thus the trailer of such streams also holds
+ *  the length of every block before compression and the absolute bound:
+ *
+ *      [blocks][csize[0..n-1]][len[0..n-1]][bound][n][blockSize][filter]
+ *
+ *  A length of 0 marks a block that is stored raw instead of quantized.
+ */
+
+#include "interface.h"
+#include <math.h>
+#ifdef FTI_LZ4
+#   include <lz4.h>
+#endif
+// x86-64 always has SSE2, AVX2 is selected at run time if available
+#if defined(__SSE2__) && !defined(FTI_NOSIMD)
+#   include <emmintrin.h>
+#   define FTI_SHUFFLE_SSE2
+#   if defined(__x86_64__) && defined(__GNUC__) && \
+        (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#       include <immintrin.h>
+#       define FTI_SHUFFLE_AVX2
+#       define FTI_TARGET_AVX2 __attribute__((target("avx2")))
+#   endif
+#endif
+
+/** Number of blocks per worker thread compressed before writing.          */
+#define FTI_COMPRESS_WINDOW 4
+/** Number of uint32_t in the trailer of a stream besides the block sizes.  */
+#define FTI_COMPRESS_TRAILER 3
+/** Flag of the filter word for the XOR delta of consecutive elements.     */
+#define FTI_FILTER_DELTA 0x10
+/** Flag of the filter word for quantized (error-bounded) elements.        */
+#define FTI_FILTER_QUANT 0x20
+/** Code of an element stored exactly in a quantized block.                */
+#define FTI_QUANT_ESCAPE 0xFFFFFFFFu
+/** Limit of the quantization codes (zigzag encoded below 2^31).           */
+#define FTI_QUANT_MAX 1073741824.0
+
+/** @typedef    FTIT_blockJob
+ *  @brief      Blocks of a data chunk (de-)compressed by the workers.
+ */
+typedef struct FTIT_blockJob {
+    int             codec;              /**< Codec of the blocks.           */
+    int             level;              /**< Compression level.             */
+    long            blockSize;          /**< Raw block size.                */
+    int             eleSize;            /**< Element size (filter).         */
+    int             shuffle;            /**< Shuffle (FTI_SHUFFLE_*).       */
+    int             delta;              /**< TRUE if XOR delta.             */
+    char*           tmp;                /**< Transformed blocks (filter).   */
+    long            tmpStride;          /**< Slot size in tmp.              */
+    int             quant;              /**< TRUE if quantized.             */
+    double          eb;                 /**< Absolute error bound (quant).  */
+    uint32_t*       len;                /**< Quantized block lengths.       */
+    char*           rec;                /**< Restored blocks (quant).       */
+    long            size;               /**< Raw size of the data chunk.    */
+    char*           raw;                /**< Raw data chunk.                */
+    char*           buf;                /**< Compressed blocks.             */
+    long            stride;             /**< Slot size in buf (compress).   */
+    long*           offset;             /**< Block offsets in buf (decomp.) */
+    uint32_t*       csize;              /**< Compressed block sizes.        */
+    long            first;              /**< First block of the window.     */
+} FTIT_blockJob;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Checks if a codec is available in this build.
+  @param      codec           Codec (FTI_CODEC_*).
+  @return     integer         1 if available, 0 otherwise.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_CodecAvailable(int codec)
+{
+    switch (codec) {
+        case FTI_CODEC_NONE:
+            return 1;
+#ifndef FTI_NOZLIB
+        case FTI_CODEC_ZLIB:
+            return 1;
+#endif
+#ifdef FTI_LZ4
+        case FTI_CODEC_LZ4:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the maximum compressed size of a block.
+  @param      codec           Codec (FTI_CODEC_*).
+  @param      size            Raw block size.
+  @return     long            Maximum size of the compressed block.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_CodecBound(int codec, long size)
+{
+    switch (codec) {
+#ifndef FTI_NOZLIB
+        case FTI_CODEC_ZLIB:
+            return (long) compressBound((uLong) size);
+#endif
+#ifdef FTI_LZ4
+        case FTI_CODEC_LZ4:
+            return (long) LZ4_compressBound((int) size);
+#endif
+        default:
+            return size;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Compresses one block.
+  @param      codec           Codec (FTI_CODEC_*).
+  @param      level           Compression level.
+  @param      src             Raw block.
+  @param      size            Raw block size.
+  @param      dst             Buffer of FTI_CodecBound(codec, size) bytes.
+  @return     long            Compressed size, -1 if not compressed.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_CodecCompress(int codec, int level, const char* src, long size, char* dst)
+{
+    switch (codec) {
+#ifndef FTI_NOZLIB
+        case FTI_CODEC_ZLIB: {
+            uLongf dlen = compressBound((uLong) size);
+            if (compress2((Bytef*) dst, &dlen, (const Bytef*) src, (uLong) size, level) != Z_OK) {
+                return -1;
+            }
+            return (long) dlen;
+        }
+#endif
+#ifdef FTI_LZ4
+        case FTI_CODEC_LZ4: {
+            int dlen = LZ4_compress_default(src, dst, (int) size, LZ4_compressBound((int) size));
+            return (dlen > 0) ? (long) dlen : -1;
+        }
+#endif
+        default:
+            return -1;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Decompresses one block.
+  @param      codec           Codec (FTI_CODEC_*).
+  @param      src             Compressed block.
+  @param      csize           Compressed block size.
+  @param      dst             Destination of the raw block.
+  @param      size            Raw block size.
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_CodecDecompress(int codec, const char* src, long csize, char* dst, long size)
+{
+    switch (codec) {
+#ifndef FTI_NOZLIB
+        case FTI_CODEC_ZLIB: {
+            uLongf dlen = (uLongf) size;
+            if (uncompress((Bytef*) dst, &dlen, (const Bytef*) src, (uLong) csize) != Z_OK || dlen != (uLongf) size) {
+                return FTI_NSCS;
+            }
+            return FTI_SCES;
+        }
+#endif
+#ifdef FTI_LZ4
+        case FTI_CODEC_LZ4:
+            return (LZ4_decompress_safe(src, dst, (int) csize, (int) size) == size) ? FTI_SCES : FTI_NSCS;
+#endif
+        default:
+            return FTI_NSCS;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Transposes the 8x8 bit matrix held in a 64-bit word.
+  @param      x               Byte k of x is row k of the matrix.
+  @return     uint64_t        Transposed matrix.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline uint64_t FTI_Transpose8x8(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x = x ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x = x ^ t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x = x ^ t ^ (t << 28);
+    return x;
+}
+
+#ifdef FTI_SHUFFLE_SSE2
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Checks if the SIMD kernels handle an element size.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline int FTI_SimdEleSize(int ele)
+{
+    return ele == 2 || ele == 4 || ele == 8 || ele == 16;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Loads 16 elements and splits them in ele byte planes.
+  @param      s               Source elements (16 * ele bytes).
+  @param      ele             Element size (FTI_SimdEleSize).
+  @param      v               Byte plane b of the 16 elements in v[b].
+
+  Every round separates the even from the odd bytes of pairs of vectors,
+  after log2(ele) rounds the bytes of equal significance are together.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline void FTI_LoadPlanesSSE2(const unsigned char* s, int ele, __m128i* v)
+{
+    const __m128i lo = _mm_set1_epi16(0x00FF);
+    __m128i w[16];
+    int k, r;
+    for (k = 0; k < ele; k++) {
+        v[k] = _mm_loadu_si128((const __m128i*) (s + 16 * k));
+    }
+    for (r = 1; r < ele; r <<= 1) {
+        for (k = 0; k < ele / 2; k++) {
+            __m128i a = v[2 * k];
+            __m128i b = v[2 * k + 1];
+            w[k] = _mm_packus_epi16(_mm_and_si128(a, lo), _mm_and_si128(b, lo));
+            w[k + ele / 2] = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        }
+        for (k = 0; k < ele; k++) {
+            v[k] = w[k];
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reverts FTI_LoadPlanesSSE2 and stores the 16 elements.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline void FTI_StorePlanesSSE2(unsigned char* d, int ele, __m128i* v)
+{
+    __m128i w[16];
+    int k, r;
+    for (r = 1; r < ele; r <<= 1) {
+        for (k = 0; k < ele / 2; k++) {
+            w[2 * k] = _mm_unpacklo_epi8(v[k], v[k + ele / 2]);
+            w[2 * k + 1] = _mm_unpackhi_epi8(v[k], v[k + ele / 2]);
+        }
+        for (k = 0; k < ele; k++) {
+            v[k] = w[k];
+        }
+    }
+    for (k = 0; k < ele; k++) {
+        _mm_storeu_si128((__m128i*) (d + 16 * k), v[k]);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      XORs the bytes of a plane with the previous ones.
+  @param      p               16 bytes of a byte plane.
+  @param      prev            Byte preceding p, updated to the last of p.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline __m128i FTI_DeltaSSE2(__m128i p, unsigned char* prev)
+{
+    __m128i q = _mm_xor_si128(p, _mm_or_si128(_mm_slli_si128(p, 1), _mm_cvtsi32_si128(*prev)));
+    *prev = (unsigned char) (_mm_extract_epi16(p, 7) >> 8);
+    return q;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reverts FTI_DeltaSSE2 (prefix XOR of the bytes).
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline __m128i FTI_UndeltaSSE2(__m128i q, unsigned char* prev)
+{
+    q = _mm_xor_si128(q, _mm_slli_si128(q, 1));
+    q = _mm_xor_si128(q, _mm_slli_si128(q, 2));
+    q = _mm_xor_si128(q, _mm_slli_si128(q, 4));
+    q = _mm_xor_si128(q, _mm_slli_si128(q, 8));
+    q = _mm_xor_si128(q, _mm_set1_epi8((char) *prev));
+    *prev = (unsigned char) (_mm_extract_epi16(q, 7) >> 8);
+    return q;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Byte shuffles the elements by groups of 16 (SSE2).
+  @return     long            Number of elements shuffled.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_ByteShuffleSSE2(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+    unsigned char prev[16] = { 0 };
+    __m128i v[16];
+    long i;
+    int b;
+    for (i = 0; i + 16 <= n; i += 16) {
+        FTI_LoadPlanesSSE2(s + i * ele, ele, v);
+        for (b = 0; b < ele; b++) {
+            __m128i p = (delta) ? FTI_DeltaSSE2(v[b], &prev[b]) : v[b];
+            _mm_storeu_si128((__m128i*) (d + b * n + i), p);
+        }
+    }
+    return i;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Byte unshuffles the elements by groups of 16 (SSE2).
+  @return     long            Number of elements restored.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_ByteUnshuffleSSE2(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+    unsigned char prev[16] = { 0 };
+    __m128i v[16];
+    long i;
+    int b;
+    for (i = 0; i + 16 <= n; i += 16) {
+        for (b = 0; b < ele; b++) {
+            v[b] = _mm_loadu_si128((const __m128i*) (s + b * n + i));
+            if (delta) {
+                v[b] = FTI_UndeltaSSE2(v[b], &prev[b]);
+            }
+        }
+        FTI_StorePlanesSSE2(d + i * ele, ele, v);
+    }
+    return i;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Bit shuffles the elements by groups of 16 (SSE2).
+  @param      n8              Number of elements rounded down to 8.
+  @return     long            Number of elements shuffled.
+
+  The most significant bits of the 16 bytes of a byte plane are gathered
+  by a mask move, the plane is then shifted left by one bit. The bits of
+  up to 8 groups are collected before they are stored, since the 8 * ele
+  bit planes are far apart in the destination.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_BitShuffleSSE2(const unsigned char* s, unsigned char* d,
+        long n, long n8, int ele, int delta)
+{
+    unsigned char prev[16] = { 0 };
+    uint16_t bits[16][8][8];
+    long stride = n8 / 8;
+    __m128i v[16];
+    long i = 0;
+    int b, k, g;
+    while (i + 16 <= n8) {
+        int nb = (i + 128 <= n8) ? 8 : 1;
+        for (g = 0; g < nb; g++) {
+            FTI_LoadPlanesSSE2(s + (i + 16 * g) * ele, ele, v);
+            for (b = 0; b < ele; b++) {
+                __m128i p = (delta) ? FTI_DeltaSSE2(v[b], &prev[b]) : v[b];
+                for (k = 7; k >= 0; k--) {
+                    bits[b][k][g] = (uint16_t) _mm_movemask_epi8(p);
+                    p = _mm_add_epi8(p, p);
+                }
+            }
+        }
+        for (b = 0; b < ele; b++) {
+            for (k = 0; k < 8; k++) {
+                memcpy(d + b * n + k * stride + i / 8, bits[b][k], nb * sizeof(uint16_t));
+            }
+        }
+        i += 16 * nb;
+    }
+    return i;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Bit unshuffles the elements by groups of 16 (SSE2).
+  @param      n8              Number of elements rounded down to 8.
+  @return     long            Number of elements restored.
+
+  The 16 bits of a bit plane are spread to the 16 bytes of a vector and
+  compared with the bit selected by each byte.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_BitUnshuffleSSE2(const unsigned char* s, unsigned char* d,
+        long n, long n8, int ele, int delta)
+{
+    const __m128i sel = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+    unsigned char prev[16] = { 0 };
+    long stride = n8 / 8;
+    __m128i v[16];
+    long i;
+    int b, k;
+    for (i = 0; i + 16 <= n8; i += 16) {
+        for (b = 0; b < ele; b++) {
+            const unsigned char* plane = s + b * n + i / 8;
+            __m128i p = _mm_setzero_si128();
+            for (k = 0; k < 8; k++) {
+                uint16_t m;
+                memcpy(&m, plane + k * stride, sizeof(m));
+                __m128i x = _mm_cvtsi32_si128(m);
+                x = _mm_unpacklo_epi8(x, x);
+                x = _mm_unpacklo_epi16(x, x);
+                x = _mm_unpacklo_epi32(x, x);
+                x = _mm_cmpeq_epi8(_mm_and_si128(x, sel), sel);
+                p = _mm_or_si128(p, _mm_and_si128(x, _mm_set1_epi8((char) (1 << k))));
+            }
+            v[b] = (delta) ? FTI_UndeltaSSE2(p, &prev[b]) : p;
+        }
+        FTI_StorePlanesSSE2(d + i * ele, ele, v);
+    }
+    return i;
+}
+#endif
+
+#ifdef FTI_SHUFFLE_AVX2
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Loads 32 elements and splits them in ele byte planes (AVX2).
+
+  As FTI_LoadPlanesSSE2, the packs work within 128-bit lanes, thus the
+  64-bit words are reordered after every round.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline FTI_TARGET_AVX2 void FTI_LoadPlanesAVX2(const unsigned char* s, int ele, __m256i* v)
+{
+    const __m256i lo = _mm256_set1_epi16(0x00FF);
+    __m256i w[16];
+    int k, r;
+    for (k = 0; k < ele; k++) {
+        v[k] = _mm256_loadu_si256((const __m256i*) (s + 32 * k));
+    }
+    for (r = 1; r < ele; r <<= 1) {
+        for (k = 0; k < ele / 2; k++) {
+            __m256i a = v[2 * k];
+            __m256i b = v[2 * k + 1];
+            w[k] = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(a, lo),
+                        _mm256_and_si256(b, lo)), 0xD8);
+            w[k + ele / 2] = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(a, 8),
+                        _mm256_srli_epi16(b, 8)), 0xD8);
+        }
+        for (k = 0; k < ele; k++) {
+            v[k] = w[k];
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reverts FTI_LoadPlanesAVX2 and stores the 32 elements.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline FTI_TARGET_AVX2 void FTI_StorePlanesAVX2(unsigned char* d, int ele, __m256i* v)
+{
+    __m256i w[16];
+    int k, r;
+    for (r = 1; r < ele; r <<= 1) {
+        for (k = 0; k < ele / 2; k++) {
+            __m256i a = _mm256_permute4x64_epi64(v[k], 0xD8);
+            __m256i b = _mm256_permute4x64_epi64(v[k + ele / 2], 0xD8);
+            w[2 * k] = _mm256_unpacklo_epi8(a, b);
+            w[2 * k + 1] = _mm256_unpackhi_epi8(a, b);
+        }
+        for (k = 0; k < ele; k++) {
+            v[k] = w[k];
+        }
+    }
+    for (k = 0; k < ele; k++) {
+        _mm256_storeu_si256((__m256i*) (d + 32 * k), v[k]);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      XORs the bytes of a plane with the previous ones (AVX2).
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline FTI_TARGET_AVX2 __m256i FTI_DeltaAVX2(__m256i p, unsigned char* prev)
+{
+    // shift the 32 bytes left by one across the lanes
+    __m256i q = _mm256_alignr_epi8(p, _mm256_permute2x128_si256(p, p, 0x08), 15);
+    q = _mm256_xor_si256(_mm256_xor_si256(p, q), _mm256_set_epi64x(0, 0, 0, *prev));
+    *prev = (unsigned char) _mm256_extract_epi8(p, 31);
+    return q;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reverts FTI_DeltaAVX2 (prefix XOR of the bytes).
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline FTI_TARGET_AVX2 __m256i FTI_UndeltaAVX2(__m256i q, unsigned char* prev)
+{
+    q = _mm256_xor_si256(q, _mm256_slli_si256(q, 1));
+    q = _mm256_xor_si256(q, _mm256_slli_si256(q, 2));
+    q = _mm256_xor_si256(q, _mm256_slli_si256(q, 4));
+    q = _mm256_xor_si256(q, _mm256_slli_si256(q, 8));
+    // carry the last byte of the low lane into the high lane
+    __m256i c = _mm256_shuffle_epi8(q, _mm256_set1_epi8(15));
+    q = _mm256_xor_si256(q, _mm256_permute2x128_si256(c, c, 0x08));
+    q = _mm256_xor_si256(q, _mm256_set1_epi8((char) *prev));
+    *prev = (unsigned char) _mm256_extract_epi8(q, 31);
+    return q;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Byte shuffles the elements by groups of 32 (AVX2).
+  @return     long            Number of elements shuffled.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static FTI_TARGET_AVX2 long FTI_ByteShuffleAVX2(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+    unsigned char prev[16] = { 0 };
+    __m256i v[16];
+    long i;
+    int b;
+    for (i = 0; i + 32 <= n; i += 32) {
+        FTI_LoadPlanesAVX2(s + i * ele, ele, v);
+        for (b = 0; b < ele; b++) {
+            __m256i p = (delta) ? FTI_DeltaAVX2(v[b], &prev[b]) : v[b];
+            _mm256_storeu_si256((__m256i*) (d + b * n + i), p);
+        }
+    }
+    return i;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Byte unshuffles the elements by groups of 32 (AVX2).
+  @return     long            Number of elements restored.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static FTI_TARGET_AVX2 long FTI_ByteUnshuffleAVX2(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+    unsigned char prev[16] = { 0 };
+    __m256i v[16];
+    long i;
+    int b;
+    for (i = 0; i + 32 <= n; i += 32) {
+        for (b = 0; b < ele; b++) {
+            v[b] = _mm256_loadu_si256((const __m256i*) (s + b * n + i));
+            if (delta) {
+                v[b] = FTI_UndeltaAVX2(v[b], &prev[b]);
+            }
+        }
+        FTI_StorePlanesAVX2(d + i * ele, ele, v);
+    }
+    return i;
+}
+#endif
+
+#ifdef FTI_SHUFFLE_SSE2
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Byte shuffles the elements with the widest SIMD kernel.
+  @return     long            Number of elements shuffled.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_ByteShuffleSIMD(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+#ifdef FTI_SHUFFLE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return FTI_ByteShuffleAVX2(s, d, n, ele, delta);
+    }
+#endif
+    return FTI_ByteShuffleSSE2(s, d, n, ele, delta);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Byte unshuffles the elements with the widest SIMD kernel.
+  @return     long            Number of elements restored.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_ByteUnshuffleSIMD(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+#ifdef FTI_SHUFFLE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return FTI_ByteUnshuffleAVX2(s, d, n, ele, delta);
+    }
+#endif
+    return FTI_ByteUnshuffleSSE2(s, d, n, ele, delta);
+}
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Byte shuffles n elements (with optional XOR delta).
+  @param      s               Source elements.
+  @param      d               Destination, ele planes of n bytes.
+  @param      n               Number of elements.
+  @param      ele             Element size.
+  @param      delta           TRUE to XOR every element with the previous.
+
+  Element sizes of 2 to 16 bytes (powers of 2) are shuffled by the SIMD
+  kernels, the remaining elements by the scalar loop. The element loop is
+  outermost so that the source is read sequentially.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline void FTI_ByteShuffle(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+    long i = 0;
+    int b;
+    if (n == 0) {
+        return;
+    }
+#ifdef FTI_SHUFFLE_SSE2
+    if (FTI_SimdEleSize(ele)) {
+        i = FTI_ByteShuffleSIMD(s, d, n, ele, delta);
+    }
+#endif
+    if (i == 0) {
+        for (b = 0; b < ele; b++) {
+            d[b * n] = s[b];
+        }
+        i = 1;
+    }
+    if (delta) {
+        for (; i < n; i++) {
+            for (b = 0; b < ele; b++) {
+                d[b * n + i] = s[i * ele + b] ^ s[(i - 1) * ele + b];
+            }
+        }
+    } else {
+        for (; i < n; i++) {
+            for (b = 0; b < ele; b++) {
+                d[b * n + i] = s[i * ele + b];
+            }
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reverts FTI_ByteShuffle.
+  @param      s               Shuffled planes.
+  @param      d               Destination of the n elements.
+  @param      n               Number of elements.
+  @param      ele             Element size.
+  @param      delta           TRUE if the elements were XOR delta encoded.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline void FTI_ByteUnshuffle(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+    long i = 0;
+    int b;
+    if (n == 0) {
+        return;
+    }
+#ifdef FTI_SHUFFLE_SSE2
+    if (FTI_SimdEleSize(ele)) {
+        i = FTI_ByteUnshuffleSIMD(s, d, n, ele, delta);
+    }
+#endif
+    if (i == 0) {
+        for (b = 0; b < ele; b++) {
+            d[b] = s[b * n];
+        }
+        i = 1;
+    }
+    if (delta) {
+        for (; i < n; i++) {
+            for (b = 0; b < ele; b++) {
+                d[i * ele + b] = s[b * n + i] ^ d[(i - 1) * ele + b];
+            }
+        }
+    } else {
+        for (; i < n; i++) {
+            for (b = 0; b < ele; b++) {
+                d[i * ele + b] = s[b * n + i];
+            }
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Bit shuffles n elements (with optional XOR delta).
+  @param      s               Source elements.
+  @param      d               Destination, ele planes of n bytes.
+  @param      n               Number of elements.
+  @param      ele             Element size.
+  @param      delta           TRUE to XOR every element with the previous.
+
+  Each byte plane is split in 8 bit planes: the bytes of 8 consecutive
+  elements form an 8x8 bit matrix that is transposed in a register. The
+  bytes of the last n % 8 elements are only byte shuffled. The SIMD
+  kernel handles the groups of 16 elements if it supports the size.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_BitShuffle(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+    long n8 = n & ~7L;
+    long stride = n8 / 8;
+    long first = 0;
+    long i;
+    int b, k;
+#ifdef FTI_SHUFFLE_SSE2
+    if (FTI_SimdEleSize(ele)) {
+        first = FTI_BitShuffleSSE2(s, d, n, n8, ele, delta);
+    }
+#endif
+    for (b = 0; b < ele; b++) {
+        const unsigned char* in = s + b;
+        unsigned char* plane = d + b * n;
+        unsigned char prev = (first > 0) ? in[(first - 1) * ele] : 0;
+        for (i = first; i < n8; i += 8) {
+            uint64_t x = 0;
+            for (k = 0; k < 8; k++) {
+                unsigned char v = in[(i + k) * ele];
+                x |= (uint64_t) (unsigned char) (delta ? v ^ prev : v) << (8 * k);
+                prev = v;
+            }
+            x = FTI_Transpose8x8(x);
+            for (k = 0; k < 8; k++) {
+                plane[k * stride + i / 8] = (unsigned char) (x >> (8 * k));
+            }
+        }
+        for (i = n8; i < n; i++) {
+            unsigned char v = in[i * ele];
+            plane[i] = delta ? v ^ prev : v;
+            prev = v;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reverts FTI_BitShuffle.
+  @param      s               Shuffled planes.
+  @param      d               Destination of the n elements.
+  @param      n               Number of elements.
+  @param      ele             Element size.
+  @param      delta           TRUE if the elements were XOR delta encoded.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_BitUnshuffle(const unsigned char* s, unsigned char* d,
+        long n, int ele, int delta)
+{
+    long n8 = n & ~7L;
+    long stride = n8 / 8;
+    long first = 0;
+    long i;
+    int b, k;
+#ifdef FTI_SHUFFLE_SSE2
+    if (FTI_SimdEleSize(ele)) {
+        first = FTI_BitUnshuffleSSE2(s, d, n, n8, ele, delta);
+    }
+#endif
+    for (b = 0; b < ele; b++) {
+        const unsigned char* plane = s + b * n;
+        unsigned char* out = d + b;
+        unsigned char prev = (first > 0) ? out[(first - 1) * ele] : 0;
+        for (i = first; i < n8; i += 8) {
+            uint64_t x = 0;
+            for (k = 0; k < 8; k++) {
+                x |= (uint64_t) plane[k * stride + i / 8] << (8 * k);
+            }
+            x = FTI_Transpose8x8(x);
+            for (k = 0; k < 8; k++) {
+                unsigned char v = (unsigned char) (x >> (8 * k));
+                prev = delta ? v ^ prev : v;
+                out[(i + k) * ele] = prev;
+            }
+        }
+        for (i = n8; i < n; i++) {
+            prev = delta ? plane[i] ^ prev : plane[i];
+            out[i * ele] = prev;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Transforms a block before compression.
+  @param      job             Block job (element size and transform).
+  @param      src             Raw block.
+  @param      dst             Destination of the transformed block.
+  @param      size            Block size.
+
+  Trailing bytes that do not form a complete element are copied as is.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_FilterBlock(FTIT_blockJob* job, const char* src, char* dst, long size)
+{
+    const unsigned char* s = (const unsigned char*) src;
+    unsigned char* d = (unsigned char*) dst;
+    int ele = job->eleSize;
+    long n = size / ele;
+    long k;
+    if (job->shuffle == FTI_SHUFFLE_NONE) {
+        // XOR delta only
+        memcpy(d, s, (n > 0) ? ele : 0);
+        for (k = ele; k < n * ele; k++) {
+            d[k] = s[k] ^ s[k - ele];
+        }
+    } else if (job->shuffle == FTI_SHUFFLE_BIT) {
+        FTI_BitShuffle(s, d, n, ele, job->delta);
+    } else {
+        // constant element sizes let the compiler specialize the kernel
+        switch (ele) {
+            case 2:
+                FTI_ByteShuffle(s, d, n, 2, job->delta);
+                break;
+            case 4:
+                FTI_ByteShuffle(s, d, n, 4, job->delta);
+                break;
+            case 8:
+                FTI_ByteShuffle(s, d, n, 8, job->delta);
+                break;
+            case 16:
+                FTI_ByteShuffle(s, d, n, 16, job->delta);
+                break;
+            default:
+                FTI_ByteShuffle(s, d, n, ele, job->delta);
+        }
+    }
+    memcpy(d + n * ele, s + n * ele, size - n * ele);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reverts FTI_FilterBlock after decompression.
+  @param      job             Block job (element size and transform).
+  @param      src             Transformed block.
+  @param      dst             Destination of the raw block.
+  @param      size            Block size.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_UnfilterBlock(FTIT_blockJob* job, const char* src, char* dst, long size)
+{
+    const unsigned char* s = (const unsigned char*) src;
+    unsigned char* d = (unsigned char*) dst;
+    int ele = job->eleSize;
+    long n = size / ele;
+    long k;
+    if (job->shuffle == FTI_SHUFFLE_NONE) {
+        memcpy(d, s, (n > 0) ? ele : 0);
+        for (k = ele; k < n * ele; k++) {
+            d[k] = s[k] ^ d[k - ele];
+        }
+    } else if (job->shuffle == FTI_SHUFFLE_BIT) {
+        FTI_BitUnshuffle(s, d, n, ele, job->delta);
+    } else {
+        switch (ele) {
+            case 2:
+                FTI_ByteUnshuffle(s, d, n, 2, job->delta);
+                break;
+            case 4:
+                FTI_ByteUnshuffle(s, d, n, 4, job->delta);
+                break;
+            case 8:
+                FTI_ByteUnshuffle(s, d, n, 8, job->delta);
+                break;
+            case 16:
+                FTI_ByteUnshuffle(s, d, n, 16, job->delta);
+                break;
+            default:
+                FTI_ByteUnshuffle(s, d, n, ele, job->delta);
+        }
+    }
+    memcpy(d + n * ele, s + n * ele, size - n * ele);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Loads a float or double element as double.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline double FTI_LoadReal(const char* ptr, int ele)
+{
+    if (ele == sizeof(float)) {
+        float f;
+        memcpy(&f, ptr, sizeof(float));
+        return (double) f;
+    }
+    double d;
+    memcpy(&d, ptr, sizeof(double));
+    return d;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Stores a double as float or double element.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline void FTI_StoreReal(char* ptr, int ele, double val)
+{
+    if (ele == sizeof(float)) {
+        float f = (float) val;
+        memcpy(ptr, &f, sizeof(float));
+    } else {
+        memcpy(ptr, &val, sizeof(double));
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Restores an element from its prediction and code.
+
+  Shared by the encoder and the decoder so that both compute the
+  restored value with the very same operations.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static inline double FTI_Dequantize(double pred, double q, double eb)
+{
+    return pred + q * (2 * eb);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Quantizes a block of floats or doubles.
+  @param      job             Block job (element size and error bound).
+  @param      src             Raw block.
+  @param      dst             Destination of the quantized block.
+  @param      rec             Destination of the restored elements.
+  @param      size            Block size.
+  @return     long            Length of the quantized block.
+
+  The codes are zigzag encoded and stored by planes of bytes of equal
+  significance, followed by the elements that are stored exactly, thus
+  the quantized block takes at most 4 * n + size bytes. If more than half
+  of the block would be stored exactly, the raw block is stored instead
+  and the length is 0.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static long FTI_QuantizeBlock(FTIT_blockJob* job, const char* src, char* dst, char* rec, long size)
+{
+    int ele = job->eleSize;
+    long n = size / ele;
+    long rem = size - n * ele;
+    unsigned char* codes = (unsigned char*) dst;
+    char* exact = dst + 4 * n;
+    double pred = 0;
+    long i;
+    for (i = 0; i < n; i++) {
+        double x = FTI_LoadReal(src + i * ele, ele);
+        double q = floor((x - pred) / (2 * job->eb) + 0.5);
+        uint32_t z = FTI_QUANT_ESCAPE;
+        // NaN fails the comparison and is stored exactly
+        if (fabs(q) < FTI_QUANT_MAX) {
+            FTI_StoreReal(rec + i * ele, ele, FTI_Dequantize(pred, q, job->eb));
+            double r = FTI_LoadReal(rec + i * ele, ele);
+            if (fabs(r - x) <= job->eb) {
+                int32_t iq = (int32_t) q;
+                z = ((uint32_t) iq << 1) ^ (uint32_t) (iq >> 31);
+                pred = r;
+            }
+        }
+        if (z == FTI_QUANT_ESCAPE) {
+            if (exact + ele - (dst + 4 * n) > size / 2) {
+                // not worth it, store the raw block
+                memcpy(dst, src, size);
+                memcpy(rec, src, size);
+                return 0;
+            }
+            memcpy(exact, src + i * ele, ele);
+            memcpy(rec + i * ele, src + i * ele, ele);
+            exact += ele;
+            pred = x;
+        }
+        codes[i] = (unsigned char) z;
+        codes[n + i] = (unsigned char) (z >> 8);
+        codes[2 * n + i] = (unsigned char) (z >> 16);
+        codes[3 * n + i] = (unsigned char) (z >> 24);
+    }
+    memcpy(exact, src + n * ele, rem);
+    memcpy(rec + n * ele, src + n * ele, rem);
+    return (exact - dst) + rem;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Restores a block quantized by FTI_QuantizeBlock.
+  @param      job             Block job (element size and error bound).
+  @param      src             Quantized block.
+  @param      len             Length of the quantized block (0 if raw).
+  @param      dst             Destination of the restored block.
+  @param      size            Block size.
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_UnquantizeBlock(FTIT_blockJob* job, const char* src, long len, char* dst, long size)
+{
+    if (len == 0) {
+        memcpy(dst, src, size);
+        return FTI_SCES;
+    }
+    int ele = job->eleSize;
+    long n = size / ele;
+    long rem = size - n * ele;
+    const unsigned char* codes = (const unsigned char*) src;
+    const char* exact = src + 4 * n;
+    double pred = 0;
+    long i;
+    if (len < 4 * n + rem) {
+        return FTI_NSCS;
+    }
+    for (i = 0; i < n; i++) {
+        uint32_t z = (uint32_t) codes[i] | ((uint32_t) codes[n + i] << 8) |
+            ((uint32_t) codes[2 * n + i] << 16) | ((uint32_t) codes[3 * n + i] << 24);
+        if (z == FTI_QUANT_ESCAPE) {
+            if (exact + ele > src + len - rem) {
+                return FTI_NSCS;
+            }
+            memcpy(dst + i * ele, exact, ele);
+            exact += ele;
+        } else {
+            int32_t iq = (int32_t) (z >> 1) ^ -(int32_t) (z & 1);
+            FTI_StoreReal(dst + i * ele, ele, FTI_Dequantize(pred, (double) iq, job->eb));
+        }
+        pred = FTI_LoadReal(dst + i * ele, ele);
+    }
+    memcpy(dst + n * ele, exact, rem);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the absolute error bound of a data chunk.
+  @param      data            Dataset of the chunk.
+  @param      raw             Raw data chunk.
+  @param      size            Size of the data chunk.
+  @return     double          Absolute error bound.
+
+  A relative bound is relative to the value range of the chunk, ignoring
+  the non-finite values.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static double FTI_GetErrorBound(FTIT_dataset* data, const char* raw, long size)
+{
+    if (data->boundMode != FTI_BOUND_REL) {
+        return data->bound;
+    }
+    int ele = data->eleSize;
+    long n = size / ele;
+    double min = 0, max = 0;
+    int first = 1;
+    long i;
+    for (i = 0; i < n; i++) {
+        double x = FTI_LoadReal(raw + i * ele, ele);
+        if (!isfinite(x)) {
+            continue;
+        }
+        if (first || x < min) {
+            min = x;
+        }
+        if (first || x > max) {
+            max = x;
+        }
+        first = 0;
+    }
+    double eb = data->bound * (max - min);
+    return (eb > 0) ? eb : data->bound;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Compresses one block of the current window (worker function).
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_CompressBlock(int i, void* arg)
+{
+    FTIT_blockJob* job = (FTIT_blockJob*) arg;
+    long blk = job->first + i;
+    long pos = blk * job->blockSize;
+    long size = (job->size - pos < job->blockSize) ? job->size - pos : job->blockSize;
+    char* slot = job->buf + i * job->stride;
+    char* src = job->raw + pos;
+    long len = size;
+    if (job->quant) {
+        src = job->tmp + i * job->tmpStride;
+        len = FTI_QuantizeBlock(job, job->raw + pos, src, job->rec + i * job->blockSize, size);
+        job->len[blk] = (uint32_t) len;
+        if (len == 0) {
+            len = size;
+        }
+    } else if (job->tmp != NULL) {
+        src = job->tmp + i * job->tmpStride;
+        FTI_FilterBlock(job, job->raw + pos, src, size);
+    }
+    long csize = FTI_CodecCompress(job->codec, job->level, src, len, slot);
+    if (csize < 0 || csize >= len) {
+        // store raw
+        memcpy(slot, src, len);
+        csize = len;
+    }
+    job->csize[blk] = (uint32_t) csize;
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Decompresses one block of the current window (worker function).
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_DecompressBlock(int i, void* arg)
+{
+    FTIT_blockJob* job = (FTIT_blockJob*) arg;
+    long blk = job->first + i;
+    long pos = blk * job->blockSize;
+    long size = (job->size - pos < job->blockSize) ? job->size - pos : job->blockSize;
+    long len = (job->quant && job->len[blk] != 0) ? job->len[blk] : size;
+    char* src = job->buf + (job->offset[blk] - job->offset[job->first]);
+    char* dst = (job->tmp != NULL) ? job->tmp + i * job->tmpStride : job->raw + pos;
+    if (job->csize[blk] == len) {
+        memcpy(dst, src, len);
+    } else if (FTI_CodecDecompress(job->codec, src, job->csize[blk], dst, len) != FTI_SCES) {
+        return FTI_NSCS;
+    }
+    if (job->quant) {
+        return FTI_UnquantizeBlock(job, dst, job->len[blk], job->raw + pos, size);
+    }
+    if (job->tmp != NULL) {
+        FTI_UnfilterBlock(job, dst, job->raw + pos, size);
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Writes a buffer at a file offset.
+  @param      fd              File descriptor.
+  @param      buf             Buffer to write.
+  @param      size            Number of bytes.
+  @param      offset          File offset.
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_PwriteAll(int fd, const char* buf, long size, long offset)
+{
+    long written = 0;
+    while (written < size) {
+        ssize_t res = pwrite(fd, buf + written, size - written, offset + written);
+        if (res == -1) {
+            return FTI_NSCS;
+        }
+        written += res;
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reads a buffer from a file offset.
+  @param      fd              File descriptor.
+  @param      buf             Destination buffer.
+  @param      size            Number of bytes.
+  @param      offset          File offset.
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_PreadAll(int fd, char* buf, long size, long offset)
+{
+    long rcount = 0;
+    while (rcount < size) {
+        ssize_t res = pread(fd, buf + rcount, size - rcount, offset + rcount);
+        if (res <= 0) {
+            return FTI_NSCS;
+        }
+        rcount += res;
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Frees the buffers of a block job.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_FreeBlockJob(FTIT_blockJob* job)
+{
+    free(job->csize);
+    free(job->offset);
+    free(job->buf);
+    free(job->tmp);
+    free(job->rec);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Compresses a data chunk and writes it to a file.
+  @param      FTI_Conf        Configuration metadata.
+  @param      codec           Codec (FTI_CODEC_NONE stores the blocks raw).
+  @param      data            Dataset of the chunk (element size, bound).
+  @param      raw             Raw data chunk.
+  @param      size            Raw size of the data chunk.
+  @param      fd              File descriptor.
+  @param      offset          File offset of the compressed stream.
+  @param      mdContext       MD5 context updated with the written bytes.
+  @param      hash            MD5 digest of the data chunk as restored,
+                              NULL if already known by the caller.
+  @return     long            Size of the compressed stream, -1 on error.
+
+  The blocks are compressed window by window by the worker threads, thus
+  the memory needed does not depend on the size of the data chunk. The
+  elements are quantized if the dataset has an error bound, otherwise
+  transformed as configured if they are at least 2 bytes. The block size
+  is then rounded down to a multiple of the element size. The digest is
+  the one of the data that a recovery restores, which differs from the
+  raw data chunk for quantized datasets.
+
+ **/
+/*-------------------------------------------------------------------------*/
+long FTI_WriteCompressed(FTIT_configuration* FTI_Conf, int codec, FTIT_dataset* data, char* raw,
+        long size, int fd, long offset, MD5_CTX* mdContext, unsigned char* hash)
+{
+    char str[FTI_BUFS];
+    FTIT_blockJob job;
+    memset(&job, 0, sizeof(job));
+    job.codec = codec;
+    job.level = FTI_Conf->compressLevel;
+    job.blockSize = FTI_Conf->compressBlockSize;
+    job.eleSize = 1;
+    job.shuffle = FTI_SHUFFLE_NONE;
+    int eleSize = data->eleSize;
+    if (codec != FTI_CODEC_NONE && data->boundMode != FTI_BOUND_NONE &&
+            (eleSize == sizeof(float) || eleSize == sizeof(double))) {
+        job.quant = 1;
+        job.eleSize = eleSize;
+        job.eb = FTI_GetErrorBound(data, raw, size);
+        job.blockSize -= job.blockSize % eleSize;
+    } else if (codec != FTI_CODEC_NONE && eleSize > 1 && eleSize <= job.blockSize &&
+            (FTI_Conf->compressShuffle != FTI_SHUFFLE_NONE || FTI_Conf->compressDelta)) {
+        job.eleSize = eleSize;
+        job.shuffle = FTI_Conf->compressShuffle;
+        job.delta = FTI_Conf->compressDelta;
+        job.blockSize -= job.blockSize % eleSize;
+    }
+    // quantized blocks hold 4 byte codes plus the exact elements
+    job.tmpStride = (job.quant) ? 2 * job.blockSize : job.blockSize;
+    job.size = size;
+    job.raw = raw;
+    job.stride = FTI_CodecBound(codec, job.tmpStride);
+
+    long nbBlocks = (size + job.blockSize - 1) / job.blockSize;
+    long window = FTI_COMPRESS_WINDOW * FTI_GetThreadCount();
+    if (window > nbBlocks) {
+        window = nbBlocks;
+    }
+    job.csize = talloc(uint32_t, 2 * nbBlocks + FTI_COMPRESS_TRAILER + 2);
+    job.len = job.csize + nbBlocks;
+    int res = (job.csize != NULL);
+    if (window > 0) {
+        job.buf = talloc(char, window * job.stride);
+        res = res && (job.buf != NULL);
+        if (job.eleSize > 1) {
+            job.tmp = talloc(char, window * job.tmpStride);
+            res = res && (job.tmp != NULL);
+        }
+        if (job.quant) {
+            job.rec = talloc(char, window * job.blockSize);
+            res = res && (job.rec != NULL);
+        }
+    }
+    if (!res) {
+        snprintf(str, FTI_BUFS, "Compression - failed to allocate %ld bytes for a window of %ld blocks.",
+                window * job.stride, window);
+        FTI_Print(str, FTI_EROR);
+        FTI_FreeBlockJob(&job);
+        return -1;
+    }
+
+    MD5_CTX dataContext;
+    if (hash != NULL) {
+        MD5_Init(&dataContext);
+    }
+    long pos = offset;
+    for (job.first = 0; job.first < nbBlocks; job.first += window) {
+        int nb = (nbBlocks - job.first < window) ? nbBlocks - job.first : window;
+        FTI_ForEachProc(0, nb, FTI_CompressBlock, &job, 0);
+        int i;
+        for (i = 0; i < nb; i++) {
+            char* slot = job.buf + i * job.stride;
+            uint32_t csize = job.csize[job.first + i];
+            if (FTI_PwriteAll(fd, slot, csize, pos) != FTI_SCES) {
+                FTI_Print("Compression - could not write compressed block.", FTI_EROR);
+                FTI_FreeBlockJob(&job);
+                return -1;
+            }
+            MD5_Update(mdContext, slot, csize);
+            pos += csize;
+            if (hash != NULL) {
+                long bpos = (job.first + i) * job.blockSize;
+                long bsize = (size - bpos < job.blockSize) ? size - bpos : job.blockSize;
+                MD5_Update(&dataContext, (job.quant) ? job.rec + i * job.blockSize : raw + bpos, bsize);
+            }
+        }
+    }
+    if (hash != NULL) {
+        MD5_Final(hash, &dataContext);
+    }
+
+    // trailer: block sizes, [lengths, bound,] number of blocks, block size and filter
+    long tsize = nbBlocks;
+    if (job.quant) {
+        tsize += nbBlocks;
+        memcpy(job.csize + tsize, &job.eb, sizeof(double));
+        tsize += 2;
+    }
+    job.csize[tsize] = (uint32_t) nbBlocks;
+    job.csize[tsize + 1] = (uint32_t) job.blockSize;
+    job.csize[tsize + 2] = ((uint32_t) job.eleSize << 8) | (uint32_t) job.shuffle |
+        (job.delta ? FTI_FILTER_DELTA : 0) | (job.quant ? FTI_FILTER_QUANT : 0);
+    tsize = (tsize + FTI_COMPRESS_TRAILER) * sizeof(uint32_t);
+    if (FTI_PwriteAll(fd, (char*) job.csize, tsize, pos) != FTI_SCES) {
+        FTI_Print("Compression - could not write block table.", FTI_EROR);
+        FTI_FreeBlockJob(&job);
+        return -1;
+    }
+    MD5_Update(mdContext, job.csize, tsize);
+    pos += tsize;
+
+    FTI_FreeBlockJob(&job);
+    return pos - offset;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reads a compressed data chunk from a file and decompresses it.
+  @param      codec           Codec the stream was written with.
+  @param      fd              File descriptor.
+  @param      offset          File offset of the compressed stream.
+  @param      csize           Size of the compressed stream.
+  @param      raw             Destination of the raw data chunk.
+  @param      size            Raw size of the data chunk.
+  @return     integer         FTI_SCES if successful.
+
+  Reads the block table from the trailer of the stream, then reads and
+  decompresses the blocks window by window with the worker threads. The
+  transform of the elements is reverted as recorded in the trailer.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_ReadCompressed(int codec, int fd, long offset, long csize, char* raw, long size)
+{
+    char str[FTI_BUFS];
+    uint32_t trailer[FTI_COMPRESS_TRAILER];
+    if (csize < (long) sizeof(trailer) ||
+            FTI_PreadAll(fd, (char*) trailer, sizeof(trailer), offset + csize - sizeof(trailer)) != FTI_SCES) {
+        FTI_Print("Compression - could not read block table.", FTI_WARN);
+        return FTI_NSCS;
+    }
+
+    FTIT_blockJob job;
+    memset(&job, 0, sizeof(job));
+    job.codec = codec;
+    job.blockSize = trailer[1];
+    job.eleSize = trailer[2] >> 8;
+    job.shuffle = trailer[2] & 0x0F;
+    job.delta = (trailer[2] & FTI_FILTER_DELTA) != 0;
+    job.quant = (trailer[2] & FTI_FILTER_QUANT) != 0;
+    job.size = size;
+    job.raw = raw;
+    long nbBlocks = trailer[0];
+    long nbWords = (job.quant) ? 2 * nbBlocks + 2 : nbBlocks;
+    long tsize = (nbWords + FTI_COMPRESS_TRAILER) * sizeof(uint32_t);
+    if (job.blockSize <= 0 || nbBlocks != (size + job.blockSize - 1) / job.blockSize || tsize > csize ||
+            job.eleSize < 1 || job.shuffle > FTI_SHUFFLE_BIT ||
+            (job.quant && job.eleSize != sizeof(float) && job.eleSize != sizeof(double))) {
+        FTI_Print("Compression - block table is inconsistent.", FTI_WARN);
+        return FTI_NSCS;
+    }
+    // a single block may be declared larger than the data chunk
+    long maxBlock = (job.blockSize < size) ? job.blockSize : size;
+    job.tmpStride = (job.quant) ? 2 * maxBlock : maxBlock;
+
+    job.csize = talloc(uint32_t, nbWords + FTI_COMPRESS_TRAILER);
+    job.offset = talloc(long, nbBlocks + 1);
+    if (job.csize == NULL || job.offset == NULL ||
+            FTI_PreadAll(fd, (char*) job.csize, tsize, offset + csize - tsize) != FTI_SCES) {
+        FTI_Print("Compression - could not read block table.", FTI_WARN);
+        FTI_FreeBlockJob(&job);
+        return FTI_NSCS;
+    }
+    if (job.quant) {
+        job.len = job.csize + nbBlocks;
+        memcpy(&job.eb, job.csize + 2 * nbBlocks, sizeof(double));
+    }
+    // blocks that do not shrink are stored raw, thus no block is larger
+    // than its length before compression, which fits in a slot of tmp
+    long i;
+    int valid = 1;
+    job.offset[0] = 0;
+    for (i = 0; i < nbBlocks; i++) {
+        long bsize = (size - i * job.blockSize < job.blockSize) ? size - i * job.blockSize : job.blockSize;
+        long len = (job.quant && job.len[i] != 0) ? job.len[i] : bsize;
+        if (len > job.tmpStride || job.csize[i] > len) {
+            valid = 0;
+        }
+        job.offset[i + 1] = job.offset[i] + job.csize[i];
+    }
+    if (!valid || job.offset[nbBlocks] + tsize != csize) {
+        FTI_Print("Compression - block table is inconsistent.", FTI_WARN);
+        FTI_FreeBlockJob(&job);
+        return FTI_NSCS;
+    }
+
+    long window = FTI_COMPRESS_WINDOW * FTI_GetThreadCount();
+    if (window > nbBlocks) {
+        window = nbBlocks;
+    }
+    // the read buffer holds the largest window of compressed blocks
+    long bufSize = 0;
+    for (i = 0; i < nbBlocks; i += window) {
+        long end = (i + window < nbBlocks) ? i + window : nbBlocks;
+        if (job.offset[end] - job.offset[i] > bufSize) {
+            bufSize = job.offset[end] - job.offset[i];
+        }
+    }
+    int res = FTI_SCES;
+    if (window > 0) {
+        job.buf = talloc(char, bufSize);
+        res = (job.buf != NULL) ? FTI_SCES : FTI_NSCS;
+        if (job.eleSize > 1) {
+            job.tmp = talloc(char, job.tmpStride * window);
+            res = (job.tmp != NULL) ? res : FTI_NSCS;
+        }
+    }
+    if (res != FTI_SCES) {
+        snprintf(str, FTI_BUFS, "Compression - failed to allocate a window of %ld blocks.", window);
+        FTI_Print(str, FTI_EROR);
+        FTI_FreeBlockJob(&job);
+        return FTI_NSCS;
+    }
+
+    for (job.first = 0; job.first < nbBlocks && res == FTI_SCES; job.first += window) {
+        int nb = (nbBlocks - job.first < window) ? nbBlocks - job.first : window;
+        long start = job.offset[job.first];
+        long len = job.offset[job.first + nb] - start;
+        if (FTI_PreadAll(fd, job.buf, len, offset + start) != FTI_SCES) {
+            FTI_Print("Compression - could not read compressed blocks.", FTI_WARN);
+            res = FTI_NSCS;
+            break;
+        }
+        if (FTI_ForEachProc(0, nb, FTI_DecompressBlock, &job, 0) != FTI_SCES) {
+            FTI_Print("Compression - could not decompress blocks.", FTI_WARN);
+            res = FTI_NSCS;
+        }
+    }
+
+    FTI_FreeBlockJob(&job);
+    return res;
+}
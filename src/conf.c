@@ -147,10 +147,19 @@ int FTI_ReadConf(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTI_Ckpt[3].ckptIntv = (int)iniparser_getint(ini, "Basic:ckpt_l3", -1);
     FTI_Ckpt[4].ckptDcpIntv = (int)iniparser_getint(ini, "Basic:dcp_l4", 0); // 0 -> disabled
     FTI_Ckpt[4].ckptIntv = (int)iniparser_getint(ini, "Basic:ckpt_l4", -1);
+    FTI_Conf->ckptAutotune = (bool)iniparser_getboolean(ini, "Basic:ckpt_autotune", 0);
+    FTI_Ckpt[1].mtbf = (int)iniparser_getint(ini, "Basic:mtbf_l1", 0);
+    FTI_Ckpt[2].mtbf = (int)iniparser_getint(ini, "Basic:mtbf_l2", 0);
+    FTI_Ckpt[3].mtbf = (int)iniparser_getint(ini, "Basic:mtbf_l3", 0);
+    FTI_Ckpt[4].mtbf = (int)iniparser_getint(ini, "Basic:mtbf_l4", 0);
     FTI_Ckpt[1].isInline = (int)1;
     FTI_Ckpt[2].isInline = (int)iniparser_getint(ini, "Basic:inline_l2", 1);
     FTI_Ckpt[3].isInline = (int)iniparser_getint(ini, "Basic:inline_l3", 1);
     FTI_Ckpt[4].isInline = (int)iniparser_getint(ini, "Basic:inline_l4", 1);
+    FTI_Ckpt[1].isCompressed = (bool)iniparser_getboolean(ini, "Basic:compress_l1", 0);
+    FTI_Ckpt[2].isCompressed = (bool)iniparser_getboolean(ini, "Basic:compress_l2", 0);
+    FTI_Ckpt[3].isCompressed = (bool)iniparser_getboolean(ini, "Basic:compress_l3", 0);
+    FTI_Ckpt[4].isCompressed = (bool)iniparser_getboolean(ini, "Basic:compress_l4", 0);
     FTI_Ckpt[1].ckptCnt  = 1;
     FTI_Ckpt[2].ckptCnt  = 1;
     FTI_Ckpt[3].ckptCnt  = 1;
@@ -161,6 +170,9 @@ int FTI_ReadConf(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 
     // Reading/setting configuration metadata
     FTI_Conf->keepHeadsAlive = (bool)iniparser_getboolean(ini, "Basic:keep_heads_alive", 0);
+    FTI_Conf->asyncPostCkpt = (bool)iniparser_getboolean(ini, "Basic:async_postckpt", 0);
+    FTI_Conf->shmAggregation = (bool)iniparser_getboolean(ini, "Basic:node_aggregation", 0);
+    FTI_Conf->shmAggrSize = (long)iniparser_getint(ini, "Basic:node_aggregation_size", 256) * 1024 * 1024;
     FTI_Conf->dcpEnabled = (bool)iniparser_getboolean(ini, "Basic:enable_dcp", 0);
     FTI_Conf->dcpMode = (int)iniparser_getint(ini, "Basic:dcp_mode", -1) + FTI_DCP_MODE_OFFSET;
     FTI_Conf->dcpBlockSize = (int)iniparser_getint(ini, "Basic:dcp_block_size", -1);
@@ -173,6 +185,25 @@ int FTI_ReadConf(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTI_Conf->stageTag = (int)iniparser_getint(ini, "Advanced:stage_tag", 406);
     FTI_Conf->finalTag = (int)iniparser_getint(ini, "Advanced:final_tag", 3107);
     FTI_Conf->generalTag = (int)iniparser_getint(ini, "Advanced:general_tag", 2612);
+    FTI_Conf->listenSleepMax = (int)iniparser_getint(ini, "Advanced:listen_sleep_max", 0);
+    FTI_Conf->headThreads = (int)iniparser_getint(ini, "Advanced:head_threads", 1);
+    FTI_Conf->stageStreams = (int)iniparser_getint(ini, "Advanced:stage_streams", 4);
+    FTI_Conf->stageChunkSize = (int)iniparser_getint(ini, "Advanced:stage_chunk_size", 32) * 1024 * 1024;
+    FTI_Conf->nodeBwLimit = (int)iniparser_getint(ini, "Advanced:node_bandwidth_limit", 0);
+    FTI_Conf->metaIniExport = (bool)iniparser_getboolean(ini, "Advanced:meta_ini_export", 0);
+    FTI_Conf->ffCompactThld = (int)iniparser_getint(ini, "Advanced:ffcompact_threshold", 4);
+    FTI_Conf->ffCompactL4 = (bool)iniparser_getboolean(ini, "Advanced:ffcompact_l4", 0);
+    FTI_Conf->dedup = (bool)iniparser_getboolean(ini, "Advanced:dedup", 0);
+    FTI_Conf->dedupMinSize = (long)iniparser_getint(ini, "Advanced:dedup_min_size", 64) * 1024;
+    FTI_Conf->verifyOnLoad = (bool)iniparser_getboolean(ini, "Advanced:verify_on_load", 0);
+    FTI_Conf->lazyRecovery = (bool)iniparser_getboolean(ini, "Advanced:lazy_recovery", 0);
+    FTI_Conf->compressCodec = (int)iniparser_getint(ini, "Advanced:compress_codec", FTI_CODEC_ZLIB);
+    FTI_Conf->compressLevel = (int)iniparser_getint(ini, "Advanced:compress_level", 1);
+    FTI_Conf->compressThreads = (int)iniparser_getint(ini, "Advanced:compress_threads", 4);
+    FTI_Conf->recoverThreads = (int)iniparser_getint(ini, "Advanced:recover_threads", 1);
+    FTI_Conf->compressBlockSize = (int)iniparser_getint(ini, "Advanced:compress_block_size", 1024) * 1024;
+    FTI_Conf->compressShuffle = (int)iniparser_getint(ini, "Advanced:compress_shuffle", FTI_SHUFFLE_BYTE);
+    FTI_Conf->compressDelta = (bool)iniparser_getboolean(ini, "Advanced:compress_delta", 0);
     FTI_Conf->test = (int)iniparser_getint(ini, "Advanced:local_test", -1);
     FTI_Conf->l3WordSize = FTI_WORD;
     FTI_Conf->ioMode = (int)iniparser_getint(ini, "Basic:ckpt_io", 0) + 1000;
@@ -185,6 +216,28 @@ int FTI_ReadConf(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTI_Conf->stripeOffset = (int)iniparser_getint(ini, "Advanced:lustre_stiping_offset", -1);
 #endif
 
+    // Reading/setting MPI-IO hints (all keys except the FTI settings)
+    FTI_Conf->nbMpiioHints = 0;
+    FTI_Conf->mpiioCollective = (bool)iniparser_getboolean(ini, "MPIIO:collective", 0);
+    FTI_Conf->mpiioSubfileNodes = (int)iniparser_getint(ini, "MPIIO:subfile_nodes", 0);
+    FTI_Conf->mpiioCalibrate = (bool)iniparser_getboolean(ini, "MPIIO:calibrate", 0);
+    FTI_Conf->mpiioCalibLoaded = false;
+    FTI_Conf->mpiioCalibSize = (long)iniparser_getint(ini, "MPIIO:calibration_size", 4) * 1024 * 1024;
+    snprintf(FTI_Conf->mpiioCalibFile, FTI_BUFS, "%s/mpiio-hints.fti", FTI_Conf->metadDir);
+    int nbHints = iniparser_getsecnkeys(ini, "mpiio");
+    char** hints = iniparser_getseckeys(ini, "mpiio");
+    int i;
+    for (i = 0; i < nbHints; i++) {
+        char* key = hints[i] + strlen("mpiio:");
+        if (strcmp(key, "collective") == 0 || strcmp(key, "subfile_nodes") == 0 ||
+                strcmp(key, "calibrate") == 0 ||
+                strcmp(key, "calibration_size") == 0) {
+            continue;
+        }
+        FTI_SetMpiioHint(FTI_Conf, key, iniparser_getstring(ini, hints[i], ""), 1);
+    }
+    free(hints);
+
     // Reading/setting execution metadata
     FTI_Exec->nbVar = 0;
     FTI_Exec->nbType = 0;
@@ -203,6 +256,7 @@ int FTI_ReadConf(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTI_Exec->lastIterTime = 0;
     FTI_Exec->totalIterTime = 0;
     FTI_Exec->meanIterTime = 0;
+    FTI_Exec->iterSyncReq = MPI_REQUEST_NULL;
     FTI_Exec->metaAlloc = 0;
     FTI_Exec->reco = (int)iniparser_getint(ini, "restart:failure", 0);
     if (FTI_Exec->reco == 0) {
@@ -331,6 +385,10 @@ CHECK_DCP_SETTING_END:
         FTI_Print("Transfer size (default = 16MB) not set in Cofiguration file.", FTI_WARN);
         FTI_Conf->transferSize = 16 * 1024 * 1024;
     }
+    if (FTI_Conf->mpiioCalibrate && (FTI_Conf->mpiioCalibSize < (1024 * 1024) || FTI_Conf->mpiioCalibSize > (1024 * 1024 * 1024))) {
+        FTI_Print("MPI-IO calibration size must be between 1MB and 1024MB. Set to default (4MB).", FTI_WARN);
+        FTI_Conf->mpiioCalibSize = 4 * 1024 * 1024;
+    }
     if (FTI_Conf->test != 0 && FTI_Conf->test != 1) {
         FTI_Print("Local test size needs to be set to 0 or 1.", FTI_WARN);
         return FTI_NSCS;
@@ -340,15 +398,34 @@ CHECK_DCP_SETTING_END:
         return FTI_NSCS;
     }
     int i;
+    if (FTI_Conf->asyncPostCkpt) {
+        int provided;
+        MPI_Query_thread(&provided);
+        if (FTI_Topo->nbHeads > 0) {
+            FTI_Print("Post-processing thread is only used without heads, async. post-processing disabled.", FTI_WARN);
+            FTI_Conf->asyncPostCkpt = false;
+        } else if (provided != MPI_THREAD_MULTIPLE) {
+            FTI_Print("Post-processing thread needs MPI_THREAD_MULTIPLE, post-processing will be inline.", FTI_WARN);
+            FTI_Conf->asyncPostCkpt = false;
+            for (i = 2; i < 5; i++) {
+                FTI_Ckpt[i].isInline = 1;
+            }
+        }
+    }
     for (i = 1; i < 5; i++) {
         if (FTI_Ckpt[i].ckptIntv == 0) {
             FTI_Ckpt[i].ckptIntv = -1;
         }
+        if (FTI_Conf->ckptAutotune && FTI_Ckpt[i].ckptIntv > 0 && FTI_Ckpt[i].mtbf <= 0) {
+            char str[FTI_BUFS];
+            snprintf(str, FTI_BUFS, "No MTBF set for level %d (mtbf_l%d), its interval is not autotuned.", i, i);
+            FTI_Print(str, FTI_WARN);
+        }
         if (FTI_Ckpt[i].isInline != 0 && FTI_Ckpt[i].isInline != 1) {
             FTI_Ckpt[i].isInline = 1;
         }
-        if (FTI_Ckpt[i].isInline == 0 && FTI_Topo->nbHeads != 1) {
-            FTI_Print("If inline is set to 0 then head should be set to 1.", FTI_WARN);
+        if (FTI_Ckpt[i].isInline == 0 && FTI_Topo->nbHeads != 1 && !FTI_Conf->asyncPostCkpt) {
+            FTI_Print("If inline is set to 0 then head or async_postckpt should be set to 1.", FTI_WARN);
             return FTI_NSCS;
         }
     }
@@ -402,6 +479,114 @@ CHECK_DCP_SETTING_END:
             FTI_Print("Variable 'Basic:ckpt_io' is not set. Set to default (POSIX).", FTI_WARN);
             break;
 
+    }
+    if (FTI_Conf->mpiioSubfileNodes < 0 || FTI_Conf->mpiioSubfileNodes > FTI_Topo->nbNodes) {
+        FTI_Print("MPI-IO subfile nodes must be between 0 and the number of nodes. Subfiling disabled.", FTI_WARN);
+        FTI_Conf->mpiioSubfileNodes = 0;
+    }
+    if ( FTI_Conf->shmAggregation ) {
+        if ( !FTI_Topo->nbHeads ) {
+            FTI_Print( "Node aggregation needs a dedicated head process, node aggregation disabled.", FTI_WARN );
+            FTI_Conf->shmAggregation = false;
+        } else if ( FTI_Conf->ioMode != FTI_IO_POSIX && FTI_Conf->ioMode != FTI_IO_MPI ) {
+            FTI_Print( "Node aggregation may only be used with POSIX or MPI-IO, node aggregation disabled.", FTI_WARN );
+            FTI_Conf->shmAggregation = false;
+        } else if ( FTI_Conf->shmAggrSize <= 0 ) {
+            FTI_Print( "Node aggregation size has to be positive, node aggregation disabled.", FTI_WARN );
+            FTI_Conf->shmAggregation = false;
+        }
+    }
+    if (FTI_Conf->headThreads < 1) {
+        FTI_Print("Number of head threads must be at least 1. Set to 1.", FTI_WARN);
+        FTI_Conf->headThreads = 1;
+    }
+    if (FTI_Conf->stageStreams < 1) {
+        FTI_Print("Number of stage streams must be at least 1. Set to 1.", FTI_WARN);
+        FTI_Conf->stageStreams = 1;
+    }
+    if (FTI_Conf->stageChunkSize <= 0) {
+        FTI_Print("Stage chunk size must be positive. Set to default (32MB).", FTI_WARN);
+        FTI_Conf->stageChunkSize = 32 * 1024 * 1024;
+    }
+    if (FTI_Conf->ffCompactThld < 0) {
+        FTI_Print("FTI-FF compaction threshold must be non-negative. Compaction disabled.", FTI_WARN);
+        FTI_Conf->ffCompactThld = 0;
+    }
+    if (FTI_Conf->dedup && FTI_Conf->ioMode != FTI_IO_FTIFF) {
+        FTI_Print("Deduplication may only be used with FTI-FF, deduplication disabled.", FTI_WARN);
+        FTI_Conf->dedup = false;
+    }
+    if (FTI_Conf->dedup && FTI_Conf->dcpEnabled) {
+        FTI_Print("dCP checkpoints are updated in place and are not deduplicated.", FTI_WARN);
+    }
+    if (FTI_Conf->verifyOnLoad && FTI_Conf->ioMode == FTI_IO_HDF5) {
+        FTI_Print("HDF5 checkpoint files are not verified on load, 'Advanced:verify_on_load' disabled.", FTI_WARN);
+        FTI_Conf->verifyOnLoad = false;
+    }
+    if (FTI_Conf->lazyRecovery && FTI_Conf->ioMode == FTI_IO_HDF5) {
+        FTI_Print("HDF5 checkpoint files are not recovered lazily, 'Advanced:lazy_recovery' disabled.", FTI_WARN);
+        FTI_Conf->lazyRecovery = false;
+    }
+    if (FTI_Conf->lazyRecovery && FTI_Conf->verifyOnLoad) {
+        FTI_Print("Lazily recovered data must be verified at FTI_Init, 'Advanced:verify_on_load' disabled.", FTI_WARN);
+        FTI_Conf->verifyOnLoad = false;
+    }
+    if (FTI_Conf->dedupMinSize < 0) {
+        FTI_Print("Deduplication minimum chunk size must be non-negative. Set to 0.", FTI_WARN);
+        FTI_Conf->dedupMinSize = 0;
+    }
+    if (FTI_Conf->mpiioCalibrate && FTI_Conf->ioMode != FTI_IO_MPI) {
+        FTI_Print("MPI-IO calibration is only performed for 'Basic:ckpt_io = 2'.", FTI_DBUG);
+        FTI_Conf->mpiioCalibrate = false;
+    }
+    bool compress = false;
+    for (i = 1; i < 5; i++) {
+        compress = compress || FTI_Ckpt[i].isCompressed;
+    }
+    if (compress) {
+        if (FTI_Conf->ioMode != FTI_IO_FTIFF) {
+            FTI_Print("Compression may only be used with FTI-FF, compression disabled.", FTI_WARN);
+            FTI_Conf->compressCodec = FTI_CODEC_NONE;
+        } else if (FTI_Conf->compressCodec == FTI_CODEC_LZ4 && !FTI_CodecAvailable(FTI_CODEC_LZ4)) {
+            FTI_Print("FTI was built without LZ4, compression falls back to zlib.", FTI_WARN);
+            FTI_Conf->compressCodec = FTI_CODEC_ZLIB;
+        } else if (FTI_Conf->compressCodec != FTI_CODEC_ZLIB && FTI_Conf->compressCodec != FTI_CODEC_LZ4) {
+            FTI_Print("Compression codec ('Advanced:compress_codec') must be 1 (zlib) or 2 (LZ4). Set to 1.", FTI_WARN);
+            FTI_Conf->compressCodec = FTI_CODEC_ZLIB;
+        }
+        if (!FTI_CodecAvailable(FTI_Conf->compressCodec)) {
+            FTI_Print("FTI was built without zlib, compression disabled.", FTI_WARN);
+            FTI_Conf->compressCodec = FTI_CODEC_NONE;
+        }
+        if (FTI_Conf->compressCodec == FTI_CODEC_NONE) {
+            for (i = 1; i < 5; i++) {
+                FTI_Ckpt[i].isCompressed = false;
+            }
+        } else if (FTI_Conf->dcpEnabled && FTI_Ckpt[4].isCompressed) {
+            FTI_Print("dCP checkpoints are updated in place and are not compressed.", FTI_WARN);
+        }
+    } else {
+        FTI_Conf->compressCodec = FTI_CODEC_NONE;
+    }
+    if (FTI_Conf->compressLevel < 1 || FTI_Conf->compressLevel > 9) {
+        FTI_Print("Compression level must be between 1 and 9. Set to 1.", FTI_WARN);
+        FTI_Conf->compressLevel = 1;
+    }
+    if (FTI_Conf->compressThreads < 1) {
+        FTI_Print("Number of compression threads must be at least 1. Set to 1.", FTI_WARN);
+        FTI_Conf->compressThreads = 1;
+    }
+    if (FTI_Conf->recoverThreads < 1) {
+        FTI_Print("Number of recovery threads must be at least 1. Set to 1.", FTI_WARN);
+        FTI_Conf->recoverThreads = 1;
+    }
+    if (FTI_Conf->compressBlockSize < 1024 || FTI_Conf->compressBlockSize > 1024 * 1024 * 1024) {
+        FTI_Print("Compression block size must be between 1KB and 1GB. Set to default (1MB).", FTI_WARN);
+        FTI_Conf->compressBlockSize = 1024 * 1024;
+    }
+    if (FTI_Conf->compressShuffle < FTI_SHUFFLE_NONE || FTI_Conf->compressShuffle > FTI_SHUFFLE_BIT) {
+        FTI_Print("Compression shuffle must be 0 (none), 1 (byte) or 2 (bit). Set to 1.", FTI_WARN);
+        FTI_Conf->compressShuffle = FTI_SHUFFLE_BYTE;
     }
         return FTI_SCES;
 }
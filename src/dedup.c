@@ -0,0 +1,248 @@
+/**
+ *  Copyright (c) 2017 Leonardo A. Bautista-Gomez
+ *  All rights reserved
+ *
+ *  FTI - A multi-level checkpointing library for C/C++/Fortran applications
+ *
+ *  Revision 1.0 : Fault Tolerance Interface (FTI)
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *  @file   dedup.c
+ *  @date   October, 2018
+ *  @brief  Node-local deduplication of FTI-FF data chunks.
+ *
+ *  Processes of a node often protect identical data (e.g. replicated
+ *  tables or parameters). Before an FTI-FF checkpoint is written, every
+ *  application process sends the MD5 fingerprint and size of its chunks
+ *  to the first process of the node, which assigns every distinct chunk
+ *  to the lowest rank holding it. Only this rank stores the chunk, the
+ *  files of the other ranks refer to it in their variable index.
+ */
+
+#include "interface.h"
+
+/** @typedef    FTIT_dedupEntry
+ *  @brief      Fingerprint of a data chunk sent to the node leader.
+ */
+typedef struct FTIT_dedupEntry {
+    unsigned char   hash[MD5_DIGEST_LENGTH]; /**< MD5 of the chunk.         */
+    int64_t         size;               /**< Chunk size.                    */
+    int32_t         rank;               /**< Rank of the process.           */
+    int32_t         pos;                /**< Position in the gathered list. */
+} FTIT_dedupEntry;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Orders fingerprints by content and rank.
+  @param      a               First entry.
+  @param      b               Second entry.
+  @return     integer         Comparison result as for qsort.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_CompareDedupEntry(const void* a, const void* b)
+{
+    const FTIT_dedupEntry* x = (const FTIT_dedupEntry*) a;
+    const FTIT_dedupEntry* y = (const FTIT_dedupEntry*) b;
+    int cmp = memcmp(x->hash, y->hash, MD5_DIGEST_LENGTH);
+    if (cmp != 0) {
+        return cmp;
+    }
+    if (x->size != y->size) {
+        return (x->size < y->size) ? -1 : 1;
+    }
+    if (x->rank != y->rank) {
+        return (x->rank < y->rank) ? -1 : 1;
+    }
+    return (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Assigns the duplicated data chunks of the node to an owner.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      active          FALSE if the checkpoint is not deduplicated.
+  @return     integer         FTI_SCES if successful.
+
+  Sets the 'owner' of every chunk of the datablock list, i.e. the rank
+  of the node whose file stores the chunk, or -1 if the chunk is stored
+  in the file of this rank. Candidates are chunks of at least
+  'Advanced:dedup_min_size' bytes in host memory whose file content is
+  a function of the data only, thus chunks of datasets with an error
+  bound are excluded. The chunk hashes are set for the candidates, which
+  are flagged as 'hashed' so that they are not hashed again when written.
+
+  This function is collective over the application processes of the
+  node, unless 'active' is FALSE, in which case all owners are reset.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_DedupChunks(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_dataset* FTI_Data, int active)
+{
+    char str[FTI_BUFS];
+    FTIFF_db* currentdb;
+    int dbvar_idx, i;
+
+    // every chunk is stored locally unless found to be a duplicate
+    int nbCand = 0;
+    for (currentdb = FTI_Exec->firstdb; currentdb != NULL; currentdb = currentdb->next) {
+        for (dbvar_idx = 0; dbvar_idx < currentdb->numvars; dbvar_idx++) {
+            FTIFF_dbvar* dbvar = &(currentdb->dbvars[dbvar_idx]);
+            FTIT_dataset* data = &FTI_Data[dbvar->idx];
+            dbvar->owner = -1;
+            dbvar->hashed = false;
+            if (dbvar->hascontent && dbvar->chunksize > 0 && dbvar->chunksize >= FTI_Conf->dedupMinSize &&
+                    !data->isDevicePtr && data->boundMode == FTI_BOUND_NONE) {
+                nbCand++;
+            }
+        }
+    }
+    if (!active || FTI_Exec->nodeAppComm == MPI_COMM_NULL) {
+        return FTI_SCES;
+    }
+
+    int nodeRank, nodeSize;
+    MPI_Comm_rank(FTI_Exec->nodeAppComm, &nodeRank);
+    MPI_Comm_size(FTI_Exec->nodeAppComm, &nodeSize);
+
+    // fingerprint the candidates
+    FTIFF_dbvar** cand = (FTIFF_dbvar**) malloc(sizeof(FTIFF_dbvar*) * (nbCand + 1));
+    FTIT_dedupEntry* mine = (FTIT_dedupEntry*) malloc(sizeof(FTIT_dedupEntry) * (nbCand + 1));
+    int* owner = (int*) malloc(sizeof(int) * (nbCand + 1));
+    if (cand == NULL || mine == NULL || owner == NULL) {
+        FTI_Print("FTI-FF: DedupChunks - failed to allocate the fingerprints, chunks are not deduplicated.", FTI_WARN);
+        nbCand = 0;
+    }
+    int n = 0;
+    for (currentdb = FTI_Exec->firstdb; currentdb != NULL && n < nbCand; currentdb = currentdb->next) {
+        for (dbvar_idx = 0; dbvar_idx < currentdb->numvars; dbvar_idx++) {
+            FTIFF_dbvar* dbvar = &(currentdb->dbvars[dbvar_idx]);
+            FTIT_dataset* data = &FTI_Data[dbvar->idx];
+            if (dbvar->hascontent && dbvar->chunksize > 0 && dbvar->chunksize >= FTI_Conf->dedupMinSize &&
+                    !data->isDevicePtr && data->boundMode == FTI_BOUND_NONE) {
+                MD5((unsigned char*) data->ptr + dbvar->dptr, dbvar->chunksize, dbvar->hash);
+                dbvar->hashed = true;
+                memcpy(mine[n].hash, dbvar->hash, MD5_DIGEST_LENGTH);
+                mine[n].size = dbvar->chunksize;
+                mine[n].rank = FTI_Topo->myRank;
+                mine[n].pos = n;
+                cand[n++] = dbvar;
+            }
+        }
+    }
+
+    // the node leader collects the fingerprints of the node
+    int* counts = NULL;
+    int* displs = NULL;
+    FTIT_dedupEntry* all = NULL;
+    int* allOwner = NULL;
+    int total = 0, ok = 1;
+    if (nodeRank == 0) {
+        counts = (int*) malloc(sizeof(int) * nodeSize);
+        displs = (int*) malloc(sizeof(int) * nodeSize);
+        ok = (counts != NULL && displs != NULL);
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, FTI_Exec->nodeAppComm);
+    if (!ok) {
+        FTI_Print("FTI-FF: DedupChunks - node leader could not allocate the fingerprints, chunks are not deduplicated.", FTI_WARN);
+        goto cleanup;
+    }
+    MPI_Gather(&nbCand, 1, MPI_INT, counts, 1, MPI_INT, 0, FTI_Exec->nodeAppComm);
+    if (nodeRank == 0) {
+        for (i = 0; i < nodeSize; i++) {
+            displs[i] = total;
+            total += counts[i];
+        }
+        all = (FTIT_dedupEntry*) malloc(sizeof(FTIT_dedupEntry) * (total + 1));
+        allOwner = (int*) malloc(sizeof(int) * (total + 1));
+        ok = (all != NULL && allOwner != NULL);
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, FTI_Exec->nodeAppComm);
+    if (!ok) {
+        FTI_Print("FTI-FF: DedupChunks - node leader could not allocate the fingerprints, chunks are not deduplicated.", FTI_WARN);
+        goto cleanup;
+    }
+
+    // entries are exchanged as bytes, counts and displacements in entries
+    if (nodeRank == 0) {
+        for (i = 0; i < nodeSize; i++) {
+            counts[i] *= sizeof(FTIT_dedupEntry);
+            displs[i] *= sizeof(FTIT_dedupEntry);
+        }
+    }
+    MPI_Gatherv(mine, nbCand * sizeof(FTIT_dedupEntry), MPI_BYTE, all, counts, displs, MPI_BYTE,
+            0, FTI_Exec->nodeAppComm);
+
+    if (nodeRank == 0) {
+        for (i = 0; i < nodeSize; i++) {
+            counts[i] /= sizeof(FTIT_dedupEntry);
+            displs[i] /= sizeof(FTIT_dedupEntry);
+        }
+        for (i = 0; i < total; i++) {
+            all[i].pos = i;
+        }
+        qsort(all, total, sizeof(FTIT_dedupEntry), FTI_CompareDedupEntry);
+
+        // the first chunk of every group of identical chunks is stored
+        int nbDup = 0, first = 0;
+        long dupSize = 0, totalSize = 0;
+        for (i = 0; i < total; i++) {
+            totalSize += all[i].size;
+            if (i > 0 && all[i].size == all[first].size &&
+                    memcmp(all[i].hash, all[first].hash, MD5_DIGEST_LENGTH) == 0) {
+                allOwner[all[i].pos] = all[first].rank;
+                dupSize += all[i].size;
+                nbDup++;
+            } else {
+                allOwner[all[i].pos] = -1;
+                first = i;
+            }
+        }
+        snprintf(str, FTI_BUFS, "FTI-FF: node %d stores %d of %d chunks (%ld of %ld bytes) only once.",
+                FTI_Topo->nodeID, nbDup, total, dupSize, totalSize);
+        FTI_Print(str, FTI_DBUG);
+    }
+    MPI_Scatterv(allOwner, counts, displs, MPI_INT, owner, nbCand, MPI_INT, 0, FTI_Exec->nodeAppComm);
+
+    for (i = 0; i < nbCand; i++) {
+        cand[i]->owner = owner[i];
+    }
+
+cleanup:
+    free(cand);
+    free(mine);
+    free(owner);
+    free(counts);
+    free(displs);
+    free(all);
+    free(allOwner);
+
+    return FTI_SCES;
+}
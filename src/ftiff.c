@@ -199,6 +199,9 @@ int FTIFF_ReadDbFTIFF( FTIT_configuration *FTI_Conf, FTIT_execution *FTI_Exec, F
         free( buffer_ser );
         // TODO create hash of data base meta data during FTIFF_UpdateDatastruct 
         // and check consistency here to prevent seg faults in case of corruption.
+
+        // the next checkpoint is a new file, its meta data must be written
+        currentdb->update = true;
         
         // advance meta data offset
         mdoffset += FTI_dbstructsize;
@@ -254,8 +257,12 @@ int FTIFF_ReadDbFTIFF( FTIT_configuration *FTI_Conf, FTIT_execution *FTI_Exec, F
             mdoffset += FTI_dbvarstructsize; //sizeof(FTIFF_dbvar);
 
             currentdbvar->hasCkpt = true;
+            currentdbvar->update = true;
             
             // init FTI meta data structure
+            if( FTI_ReserveMetaVar( &(FTI_Exec->meta[FTI_Exec->ckptLvel]), varCnt+1 ) != FTI_SCES ) {
+                return FTI_NSCS;
+            }
             if ( varCnt == 0 ) { 
                 varCnt++;
                 FTI_Exec->meta[FTI_Exec->ckptLvel].varID[0] = currentdbvar->id;
@@ -305,6 +312,23 @@ int FTIFF_ReadDbFTIFF( FTIT_configuration *FTI_Conf, FTIT_execution *FTI_Exec, F
     FTI_Exec->lastdb = currentdb;
     FTI_Exec->lastdb->next = NULL;
 
+    // load the variable index, rebuild it if missing or corrupted.
+    long idxOffset = FTI_Exec->FTIFFMeta.ckptSize;
+    if ( FTIFF_LoadIdx( FTI_Exec, fmmap + idxOffset, st.st_size - idxOffset ) != FTI_SCES ) {
+        FTI_Print("FTI-FF: ReadDbFTIFF - no valid variable index in checkpoint file, rebuilding it", FTI_DBUG);
+        if ( FTIFF_BuildIdx( FTI_Exec, NULL ) != FTI_SCES ) {
+            munmap( fmmap, st.st_size );
+            return FTI_NSCS;
+        }
+    }
+
+    // the chunks of compressed files are read through the index. The
+    // datablock list gets the layout of an uncompressed file, which is
+    // the layout FTIFF_UpdateDatastructFTIFF expects.
+    if ( FTI_Exec->FTIFFMeta.codec != FTI_CODEC_NONE ) {
+        FTIFF_LayoutDatastructFTIFF( FTI_Exec );
+    }
+
     // unmap memory.
     if ( munmap( fmmap, st.st_size ) == -1 ) {
         FTI_Print("FTI-FF: ReadDbFTIFF - unable to unmap memory", FTI_EROR);
@@ -353,7 +377,7 @@ int FTIFF_GetFileChecksum( FTIFF_metaInfo *FTIFF_Meta, FTIT_checkpoint* FTI_Ckpt
 
     // set filepointer after file meta data
     long endoffile = FTI_filemetastructsize;
-    long mdoffset;
+    long mdoffset, dboffset;
 
     int isnextdb;
 
@@ -382,6 +406,7 @@ int FTIFF_GetFileChecksum( FTIFF_metaInfo *FTIFF_Meta, FTIT_checkpoint* FTI_Ckpt
         isnextdb = 0;
 
         mdoffset = endoffile;
+        dboffset = endoffile;
 
         // get data block meta data
         buffer_ser = (char*) malloc( FTI_dbstructsize );
@@ -452,11 +477,22 @@ int FTIFF_GetFileChecksum( FTIFF_metaInfo *FTIFF_Meta, FTIT_checkpoint* FTI_Ckpt
                     currentdbvar->fptr, currentdbvar->chunksize);
             FTI_Print(str, FTI_DBUG);
 
-            if ( currentdbvar->hascontent ) {
+            if ( currentdbvar->hascontent && FTIFF_Meta->codec == FTI_CODEC_NONE ) {
                 MD5_Update(&ctx, fmmap+currentdbvar->fptr, currentdbvar->chunksize);
             }
         }
 
+        // the size of a compressed chunk follows from the offset of the next chunk.
+        if ( FTIFF_Meta->codec != FTI_CODEC_NONE ) {
+            for(dbvar_idx=0;dbvar_idx<currentdb->numvars;dbvar_idx++) {
+                currentdbvar = &(currentdb->dbvars[dbvar_idx]);
+                long csize = FTIFF_GetChunkFileSize( FTIFF_Meta, currentdb, dboffset, dbvar_idx );
+                if ( currentdbvar->hascontent && csize > 0 ) {
+                    MD5_Update(&ctx, fmmap+currentdbvar->fptr, csize);
+                }
+            }
+        }
+
         endoffile += currentdb->dbsize;
 
         if ( endoffile < FTIFF_Meta->ckptSize ) {
@@ -562,6 +598,8 @@ int FTIFF_UpdateDatastructFTIFF( FTIT_execution* FTI_Exec,
             dbvars[dbvar_idx].chunksize = FTI_Data[dbvar_idx].size;
             dbvars[dbvar_idx].hascontent = true;
             dbvars[dbvar_idx].hasCkpt = false;
+            dbvars[dbvar_idx].owner = -1;
+            dbvars[dbvar_idx].hashed = false;
             dbvars[dbvar_idx].containerid = 0;
             dbvars[dbvar_idx].containersize = FTI_Data[dbvar_idx].size;
             dbvars[dbvar_idx].cptr = FTI_Data[dbvar_idx].ptr + dbvars[dbvar_idx].dptr;
@@ -764,6 +802,8 @@ int FTIFF_UpdateDatastructFTIFF( FTIT_execution* FTI_Exec,
                         dbvars[evar_idx].chunksize = FTI_Data[pvar_idx].size;
                         dbvars[evar_idx].hascontent = true;
                         dbvars[evar_idx].hasCkpt = false;
+                        dbvars[evar_idx].owner = -1;
+                        dbvars[evar_idx].hashed = false;
                         dbvars[evar_idx].containerid = 0;
                         dbvars[evar_idx].containersize = FTI_Data[pvar_idx].size;
                         dbsize += dbvars[evar_idx].containersize; 
@@ -790,6 +830,8 @@ int FTIFF_UpdateDatastructFTIFF( FTIT_execution* FTI_Exec,
                         dbvars[evar_idx].chunksize = overflow[pvar_idx];
                         dbvars[evar_idx].hascontent = true;
                         dbvars[evar_idx].hasCkpt = false;
+                        dbvars[evar_idx].owner = -1;
+                        dbvars[evar_idx].hashed = false;
                         dbvars[evar_idx].containerid = nbContainers[pvar_idx];
                         dbvars[evar_idx].containersize = overflow[pvar_idx]; 
                         dbsize += dbvars[evar_idx].containersize; 
@@ -851,6 +893,132 @@ int FTIFF_UpdateDatastructFTIFF( FTIT_execution* FTI_Exec,
 
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Compacts the FTI-FF datablock layout if fragmented.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      FTI_Conf        Configuration metadata.
+  @return     integer         FTI_SCES if successful.
+
+  Every time a protected variable grows, a new datablock holding an
+  additional container is appended to the file. If the mean number of 
+  containers per protected variable exceeds 'Advanced:ffcompact_threshold',
+  or for L4 checkpoints if 'Advanced:ffcompact_l4' is set and any variable 
+  spans several containers, the datablock list is discarded. The following 
+  call to FTIFF_UpdateDatastructFTIFF then creates a single datablock with
+  one contiguous container per variable. For dCP, the hash arrays are 
+  discarded as well, thus the next checkpoint is a full checkpoint.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTIFF_CompactDatastructFTIFF( FTIT_execution* FTI_Exec, 
+        FTIT_dataset* FTI_Data, FTIT_configuration* FTI_Conf )
+{
+    char str[FTI_BUFS];
+
+    if( FTI_Exec->firstdb == NULL ) {
+        return FTI_SCES;
+    }
+
+    FTIFF_db *currentdb;
+    int dbvar_idx, nbBlocks = 0;
+    long nbContainers = 0;
+    for( currentdb = FTI_Exec->firstdb; currentdb != NULL; currentdb = currentdb->next ) {
+        nbContainers += currentdb->numvars;
+        nbBlocks++;
+    }
+
+    bool fragmented = ( nbContainers > FTI_Exec->nbVarStored );
+    bool compact = ( FTI_Conf->ffCompactThld > 0 ) && 
+        ( nbContainers > (long) FTI_Conf->ffCompactThld * FTI_Exec->nbVarStored );
+    compact = compact || ( FTI_Conf->ffCompactL4 && (FTI_Exec->ckptLvel == 4) && fragmented );
+    if( !compact ) {
+        return FTI_SCES;
+    }
+
+    snprintf( str, FTI_BUFS, "FTI-FF: CompactDatastructFTIFF - compacting %ld containers in %d datablocks for %d variables.",
+            nbContainers, nbBlocks, FTI_Exec->nbVarStored );
+    FTI_Print( str, FTI_DBUG );
+
+    // [FOR DCP] free hash arrays
+    if ( FTI_Conf->dcpEnabled ) {
+        for( currentdb = FTI_Exec->firstdb; currentdb != NULL; currentdb = currentdb->next ) {
+            for( dbvar_idx = 0; dbvar_idx < currentdb->numvars; dbvar_idx++ ) {
+                FTIFF_dbvar* dbvar = &(currentdb->dbvars[dbvar_idx]);
+                if( dbvar->dataDiffHash != NULL ) {
+                    if( FTI_GetDcpMode() == FTI_DCP_MODE_MD5 ) {
+                        free( dbvar->dataDiffHash[0].md5hash );
+                    }
+                    free( dbvar->dataDiffHash );
+                    dbvar->dataDiffHash = NULL;
+                }
+            }
+        }
+    }
+
+    FTIFF_FreeDbFTIFF( FTI_Exec->lastdb );
+    FTI_Exec->firstdb = NULL;
+    FTI_Exec->lastdb = NULL;
+    FTI_Exec->nbVarStored = 0;
+
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Sets the file pointers of the datablock list for uncompressed data.
+  @param      FTI_Exec        Execution metadata.
+
+  Places the containers of every datablock contiguously after the
+  datablock meta data and sets the datablock sizes accordingly. This is
+  the layout created by FTIFF_UpdateDatastructFTIFF. It is restored after 
+  writing, or reading, a compressed checkpoint file.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTIFF_LayoutDatastructFTIFF( FTIT_execution* FTI_Exec )
+{
+    FTIFF_db *currentdb;
+    int dbvar_idx;
+    long offset = FTI_filemetastructsize;
+    for( currentdb = FTI_Exec->firstdb; currentdb != NULL; currentdb = currentdb->next ) {
+        long fptr = offset + FTI_dbstructsize + (long) currentdb->numvars * FTI_dbvarstructsize;
+        for( dbvar_idx = 0; dbvar_idx < currentdb->numvars; dbvar_idx++ ) {
+            currentdb->dbvars[dbvar_idx].fptr = fptr;
+            fptr += currentdb->dbvars[dbvar_idx].containersize;
+        }
+        currentdb->dbsize = fptr - offset;
+        offset = fptr;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the size of a data chunk in the checkpoint file.
+  @param      FTIFF_Meta      FTI-FF file meta data.
+  @param      db              Datablock of the chunk.
+  @param      dboffset        File offset of the datablock.
+  @param      dbvar_idx       Index of the chunk in the datablock.
+  @return     long            Number of bytes of the chunk in the file.
+
+  In compressed files, the compressed chunks of a datablock are stored
+  contiguously, thus the size of a chunk is the distance to the next
+  chunk, or to the end of the datablock.
+
+ **/
+/*-------------------------------------------------------------------------*/
+long FTIFF_GetChunkFileSize( FTIFF_metaInfo* FTIFF_Meta, FTIFF_db* db, long dboffset, int dbvar_idx )
+{
+    FTIFF_dbvar* dbvar = &(db->dbvars[dbvar_idx]);
+    if( FTIFF_Meta->codec == FTI_CODEC_NONE ) {
+        return ( dbvar->hascontent ) ? dbvar->chunksize : 0;
+    }
+    long end = ( dbvar_idx + 1 < db->numvars ) ? (long) db->dbvars[dbvar_idx+1].fptr : dboffset + db->dbsize;
+    return end - (long) dbvar->fptr;
+}
+
+
 
 
 
@@ -897,12 +1065,20 @@ int FTIFF_WriteFTIFF(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
         FTIT_dataset* FTI_Data)
 {
+    FTIFF_CompactDatastructFTIFF( FTI_Exec, FTI_Data, FTI_Conf );
     FTIFF_UpdateDatastructFTIFF( FTI_Exec, FTI_Data, FTI_Conf );
     
     //FOR DEVELOPING 
     //FTIFF_PrintDataStructure( 0, FTI_Exec, FTI_Data );
 
     char str[FTI_BUFS], fn[FTI_BUFS], strerr[FTI_BUFS];
+
+    // dCP updates the chunks in place, thus dCP files are never compressed
+    // nor deduplicated. Collective on the node, thus before any return.
+    bool isDcp = FTI_Conf->dcpEnabled && FTI_Ckpt[4].isDcp;
+    if ( FTI_Conf->dedup ) {
+        FTI_DedupChunks( FTI_Conf, FTI_Exec, FTI_Topo, FTI_Data, !isDcp );
+    }
     
     FTI_Print("I/O mode: FTI File Format.", FTI_DBUG);
 
@@ -981,6 +1157,13 @@ int FTIFF_WriteFTIFF(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     copyDataFromDevive( FTI_Exec, FTI_Data );
 #endif    
 
+    // deduplicated files refer to chunks in the layout of compressed files
+    if ( ( FTI_Ckpt[level].isCompressed || FTI_Conf->dedup ) && !isDcp ) {
+        int codec = ( FTI_Ckpt[level].isCompressed ) ? FTI_Conf->compressCodec : FTI_CODEC_STORE;
+        return FTIFF_WriteCompressedFTIFF( FTI_Conf, FTI_Exec, FTI_Topo, FTI_Data, fd, fn, codec );
+    }
+    FTI_Exec->FTIFFMeta.codec = FTI_CODEC_NONE;
+
     do {    
 
         isnextdb = 0;
@@ -1109,6 +1292,12 @@ int FTIFF_WriteFTIFF(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 
     // has to be assigned before FTIFF_CreateMetaData call!
     FTI_Exec->ckptSize = endoffile;
+
+    // append the variable index after the last datablock
+    if ( FTIFF_WriteIdx( FTI_Exec, FTI_Data, fd ) != FTI_SCES ) {
+        close(fd);
+        return FTI_NSCS;
+    }
     
     if ( FTI_Try( FTIFF_CreateMetadata( FTI_Exec, FTI_Topo, FTI_Data, FTI_Conf ), "Create FTI-FF meta data" ) != FTI_SCES ) {
         return FTI_NSCS;
@@ -1228,108 +1417,869 @@ int FTIFF_WriteFTIFF(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
             isnextdb = 1;
         }
 
-        dbcounter++;
+        dbcounter++;
+
+    } while( isnextdb );
+ 
+    // only for printout of dCP share in FTI_Checkpoint
+    FTI_Exec->FTIFFMeta.dcpSize = dcpSize;
+    FTI_Exec->FTIFFMeta.dataSize = dataSize;
+
+    fdatasync( fd );
+    close( fd );
+
+    return FTI_SCES;
+
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Writes a compressed ckpt file using FTIFF.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      fd              File descriptor of the checkpoint file.
+  @param      fn              Name of the checkpoint file.
+  @param      codec           Codec of the file (FTI_CODEC_*).
+  @return     integer         FTI_SCES if successful.
+
+  Writes the FTI-FF file with every data chunk compressed by
+  FTI_WriteCompressed. The chunks of a datablock are stored contiguously
+  after its meta data, the file pointers and datablock sizes in the file
+  refer to the compressed chunks, while chunk and container sizes remain
+  the uncompressed sizes. The codec is stored in the file meta data and
+  the variable index holds the compressed size of every chunk. Variables
+  excluded with FTI_SetCompression, and all chunks if 'codec' is
+  FTI_CODEC_STORE, are stored raw in the same stream format. Chunks with
+  an owner (FTI_DedupChunks) are not stored, their index entry refers to
+  the file of the owner. The file is closed on return.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTIFF_WriteCompressedFTIFF(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_dataset* FTI_Data, int fd, char* fn, int codec)
+{
+    char str[FTI_BUFS], strerr[FTI_BUFS];
+    char dbbuf[FTI_BUFS], *buffer_ser = NULL;
+    int res = FTI_NSCS;
+
+    FTIFF_db *currentdb;
+    FTIFF_dbvar *currentdbvar;
+    int dbvar_idx;
+    long endoffile = FTI_filemetastructsize;
+    long dcpSize = 0, dataSize = 0, dedupSize = 0;
+
+    FTI_Exec->FTIFFMeta.codec = codec;
+
+    // MD5 context for file (only data) checksum
+    MD5_CTX mdContext;
+    MD5_Init(&mdContext);
+
+    buffer_ser = (char*) malloc( FTI_dbvarstructsize );
+    if( buffer_ser == NULL ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: WriteCompressedFTIFF - failed to allocate %d bytes for 'buffer_ser'", FTI_dbvarstructsize );
+        FTI_Print(strerr, FTI_EROR);
+        goto cleanup;
+    }
+
+    for( currentdb = FTI_Exec->firstdb; currentdb != NULL; currentdb = currentdb->next ) {
+
+        long dboffset = endoffile;
+        long mdoffset = dboffset + FTI_dbstructsize;
+        long fptr = mdoffset + (long) currentdb->numvars * FTI_dbvarstructsize;
+
+        for(dbvar_idx=0;dbvar_idx<currentdb->numvars;dbvar_idx++) {
+
+            currentdbvar = &(currentdb->dbvars[dbvar_idx]);
+            currentdbvar->fptr = fptr;
+            if( !(currentdbvar->hascontent) ) {
+                continue;
+            }
+
+            FTIT_dataset* data = &FTI_Data[currentdbvar->idx];
+            char* cptr = (char*) data->ptr + currentdbvar->dptr;
+            dataSize += currentdbvar->chunksize;
+
+            // stored in the file of another rank of the node
+            if( currentdbvar->owner >= 0 ) {
+                dedupSize += currentdbvar->chunksize;
+                continue;
+            }
+
+            // the chunk hash is the one of the data restored (lossy datasets),
+            // unless already computed by FTI_DedupChunks
+            int chunkCodec = ( data->compress && codec != FTI_CODEC_STORE ) ? codec : FTI_CODEC_NONE;
+            long csize = FTI_WriteCompressed( FTI_Conf, chunkCodec, data, cptr, currentdbvar->chunksize, fd, fptr,
+                    &mdContext, ( currentdbvar->hashed ) ? NULL : currentdbvar->hash );
+            if( csize < 0 ) {
+                snprintf(str, FTI_BUFS, "FTI-FF: WriteCompressedFTIFF - Dataset #%d could not be written to file: %s", currentdbvar->id, fn);
+                FTI_Print(str, FTI_EROR);
+                goto cleanup;
+            }
+            fptr += csize;
+            dcpSize += csize;
+
+            snprintf(str, FTI_BUFS, "FTIFF: CKPT(id:%i) id: %i, idx: %i, dptr: %ld, fptr: %ld, chunksize: %ld, compressed: %ld",
+                    FTI_Exec->ckptID, currentdbvar->id, currentdbvar->idx, currentdbvar->dptr,
+                    currentdbvar->fptr, currentdbvar->chunksize, csize);
+            FTI_Print(str, FTI_DBUG);
+        }
+        currentdb->dbsize = fptr - dboffset;
+
+        // serialize block meta data and write to file
+        if( FTIFF_SerializeDbMeta( currentdb, dbbuf ) != FTI_SCES ||
+                pwrite( fd, dbbuf, FTI_dbstructsize, dboffset ) != FTI_dbstructsize ) {
+            snprintf(strerr, FTI_BUFS, "FTI-FF: WriteCompressedFTIFF - could not write metadata in file: %s", fn);
+            FTI_Print(strerr, FTI_EROR);
+            goto cleanup;
+        }
+        for(dbvar_idx=0;dbvar_idx<currentdb->numvars;dbvar_idx++) {
+            if( FTIFF_SerializeDbVarMeta( &(currentdb->dbvars[dbvar_idx]), buffer_ser ) != FTI_SCES ||
+                    pwrite( fd, buffer_ser, FTI_dbvarstructsize, mdoffset ) != FTI_dbvarstructsize ) {
+                snprintf(strerr, FTI_BUFS, "FTI-FF: WriteCompressedFTIFF - could not write metadata in file: %s", fn);
+                FTI_Print(strerr, FTI_EROR);
+                goto cleanup;
+            }
+            mdoffset += FTI_dbvarstructsize;
+        }
+
+        endoffile = fptr;
+    }
+
+    // create string of filehash and create other file meta data
+    unsigned char fhash[MD5_DIGEST_LENGTH];
+    MD5_Final( fhash, &mdContext );
+    int ii = 0, i;
+    for(i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        sprintf(&(FTI_Exec->FTIFFMeta.checksum[ii]), "%02x", fhash[i]);
+        ii += 2;
+    }
+
+    // has to be assigned before FTIFF_CreateMetaData call!
+    FTI_Exec->ckptSize = endoffile;
+
+    // append the variable index after the last datablock
+    if ( FTIFF_WriteIdx( FTI_Exec, FTI_Data, fd ) != FTI_SCES ) {
+        goto cleanup;
+    }
+
+    if ( FTI_Try( FTIFF_CreateMetadata( FTI_Exec, FTI_Topo, FTI_Data, FTI_Conf ), "Create FTI-FF meta data" ) != FTI_SCES ) {
+        goto cleanup;
+    }
+
+    // serialize file meta data and write to file
+    free( buffer_ser );
+    buffer_ser = (char*) malloc ( FTI_filemetastructsize );
+    if( buffer_ser == NULL || FTIFF_SerializeFileMeta( &(FTI_Exec->FTIFFMeta), buffer_ser ) != FTI_SCES ||
+            pwrite( fd, buffer_ser, FTI_filemetastructsize, 0 ) != FTI_filemetastructsize ) {
+        snprintf(strerr, FTI_BUFS, "FTI-FF: WriteCompressedFTIFF - could not write file metadata in file: %s", fn);
+        FTI_Print(strerr, FTI_EROR);
+        goto cleanup;
+    }
+
+    snprintf(str, FTI_BUFS, "FTI-FF: compressed %ld bytes of data to %ld bytes (%.2f%%), %ld bytes stored by other ranks.",
+            dataSize, dcpSize, (dataSize > 0) ? 100.0 * dcpSize / dataSize : 100.0, dedupSize);
+    FTI_Print(str, FTI_DBUG);
+
+    // only for printout of dCP share in FTI_Checkpoint
+    FTI_Exec->FTIFFMeta.dcpSize = dcpSize;
+    FTI_Exec->FTIFFMeta.dataSize = dataSize;
+
+    res = FTI_SCES;
+
+cleanup:
+    // restore the layout of the uncompressed data in the datablock list
+    FTIFF_LayoutDatastructFTIFF( FTI_Exec );
+    free( buffer_ser );
+    errno = 0;
+    fdatasync( fd );
+    close( fd );
+    return res;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Assign meta data to runtime and file meta data types
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      FTI_Data        Dataset metadata.
+  @return     integer         FTI_SCES if successful.
+
+  This function gathers information about the checkpoint files in the
+  group and stores it in the respective meta data types runtime and
+  ckpt file.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTIFF_CreateMetadata( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo, 
+        FTIT_dataset* FTI_Data, FTIT_configuration* FTI_Conf )
+{
+    int i;
+
+    // FTI_Exec->ckptSize has to be assigned after successful ckpt write and before this call!
+    // the file size includes the variable index stored after the last datablock.
+    long fs = FTI_Exec->ckptSize + FTI_Exec->FTIFFIdx.size;
+    FTI_Exec->FTIFFMeta.ckptSize = FTI_Exec->ckptSize;
+    FTI_Exec->FTIFFMeta.fs = fs;
+
+    // allgather not needed for L1 checkpoint
+    if( (FTI_Exec->ckptLvel == 2) || (FTI_Exec->ckptLvel == 3) ) { 
+
+        long fileSizes[FTI_BUFS], mfs = 0;
+        MPI_Allgather(&fs, 1, MPI_LONG, fileSizes, 1, MPI_LONG, FTI_Exec->groupComm);
+        int ptnerGroupRank, i;
+        switch(FTI_Exec->ckptLvel) {
+
+            //get partner file size:
+            case 2:
+
+                ptnerGroupRank = (FTI_Topo->groupRank + FTI_Topo->groupSize - 1) % FTI_Topo->groupSize;
+                FTI_Exec->FTIFFMeta.ptFs = fileSizes[ptnerGroupRank];
+                FTI_Exec->FTIFFMeta.maxFs = -1;
+                break;
+
+                //get max file size in group 
+            case 3:
+                for (i = 0; i < FTI_Topo->groupSize; i++) {
+                    if (fileSizes[i] > mfs) {
+                        mfs = fileSizes[i]; // Search max. size
+                    }
+                }
+
+                FTI_Exec->FTIFFMeta.maxFs = mfs;
+                FTI_Exec->FTIFFMeta.ptFs = -1;
+        }     
+
+    } else {
+
+        FTI_Exec->FTIFFMeta.ptFs = -1;
+        FTI_Exec->FTIFFMeta.maxFs = -1;
+
+    }
+
+    FTI_Exec->meta[0].fs[0] = FTI_Exec->FTIFFMeta.fs;
+    FTI_Exec->meta[0].pfs[0] = FTI_Exec->FTIFFMeta.ptFs;
+    FTI_Exec->meta[0].maxFs[0] = FTI_Exec->FTIFFMeta.maxFs;
+
+    // write meta data and its hash
+    struct timespec ntime;
+    if ( clock_gettime(CLOCK_REALTIME, &ntime) == -1 ) {
+        FTI_Print("FTI-FF: FTIFF_CreateMetaData - failed to determine time, timestamp set to -1", FTI_WARN);
+        FTI_Exec->FTIFFMeta.timestamp = -1;
+    } else {
+        FTI_Exec->FTIFFMeta.timestamp = ntime.tv_sec*1000000000 + ntime.tv_nsec;
+    }
+
+    // create checksum of meta data
+    FTIFF_GetHashMetaInfo( FTI_Exec->FTIFFMeta.myHash, &(FTI_Exec->FTIFFMeta) );
+
+    //Flush metadata in case postCkpt done inline
+    FTI_Exec->meta[FTI_Exec->ckptLvel].fs[0] = FTI_Exec->meta[0].fs[0];
+    FTI_Exec->meta[FTI_Exec->ckptLvel].pfs[0] = FTI_Exec->meta[0].pfs[0];
+    FTI_Exec->meta[FTI_Exec->ckptLvel].maxFs[0] = FTI_Exec->meta[0].maxFs[0];
+    strncpy(FTI_Exec->meta[FTI_Exec->ckptLvel].ckptFile, FTI_Exec->meta[0].ckptFile, FTI_BUFS);
+    if (FTI_ReserveMetaVar(&FTI_Exec->meta[0], FTI_Exec->nbVar) != FTI_SCES) {
+        return FTI_NSCS;
+    }
+    for (i = 0; i < FTI_Exec->nbVar; i++) {
+        FTI_Exec->meta[0].varID[i] = FTI_Data[i].id;
+        FTI_Exec->meta[0].varSize[i] = FTI_Data[i].size;
+    }
+
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Builds the lookup table of the variable index by id.
+  @param      idx             Variable index.
+  @return     integer         FTI_SCES if successful.
+
+  The table is at most half full and uses the hash of the dataset index
+  (FTI_HashDataID), so a lookup does not depend on the number of
+  variables.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTIFF_HashIdx( FTIFF_idx* idx )
+{
+    int size = FTI_DATA_MIN * 2;
+    while( size < idx->nbVar * 2 ) {
+        size *= 2;
+    }
+    int* lookup = (int*) malloc( size * sizeof(int) );
+    if( lookup == NULL ) {
+        FTI_Print( "FTI-FF: HashIdx - failed to allocate the variable lookup table.", FTI_EROR );
+        return FTI_NSCS;
+    }
+    int i;
+    for( i = 0; i < size; i++ ) {
+        lookup[i] = -1;
+    }
+    for( i = 0; i < idx->nbVar; i++ ) {
+        int slot = FTI_HashDataID( idx->var[i].id, size );
+        while( lookup[slot] != -1 ) {
+            slot = (slot + 1) & (size - 1);
+        }
+        lookup[slot] = i;
+    }
+    idx->lookup = lookup;
+    idx->lookupSize = size;
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Builds the variable index from the datablock list.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Data        Dataset metadata (may be NULL).
+  @return     integer         FTI_SCES if successful.
+
+  Collects the data chunks of every protected variable from the datablock
+  list into FTI_Exec->FTIFFIdx. The chunks of one variable are stored
+  contiguously in the chunk table, in the order of the datablock list.
+  If 'FTI_Data' is NULL (recovery), variables without content keep the
+  id -1.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTIFF_BuildIdx( FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data )
+{
+    char strerr[FTI_BUFS];
+
+    FTIFF_db *currentdb;
+    FTIFF_dbvar *currentdbvar;
+    int dbvar_idx, i;
+
+    int nbVar = ( FTI_Data != NULL ) ? FTI_Exec->nbVar : 0;
+    int nbChunk = 0;
+    for( currentdb = FTI_Exec->firstdb; currentdb != NULL; currentdb = currentdb->next ) {
+        for( dbvar_idx = 0; dbvar_idx < currentdb->numvars; dbvar_idx++ ) {
+            currentdbvar = &(currentdb->dbvars[dbvar_idx]);
+            if( currentdbvar->idx >= nbVar ) {
+                nbVar = currentdbvar->idx + 1;
+            }
+            if( currentdbvar->hascontent ) {
+                nbChunk++;
+            }
+        }
+    }
+
+    long size = sizeof(FTIFF_idxHeader) + nbVar * sizeof(FTIFF_idxVar) + nbChunk * sizeof(FTIFF_idxChunk);
+    char* buffer = (char*) calloc( size, 1 );
+    if( buffer == NULL ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: BuildIdx - failed to allocate %ld bytes for the variable index", size );
+        FTI_Print( strerr, FTI_EROR );
+        return FTI_NSCS;
+    }
+    FTIFF_idxHeader* header = (FTIFF_idxHeader*) buffer;
+    FTIFF_idxVar* var = (FTIFF_idxVar*) (header + 1);
+    FTIFF_idxChunk* chunk = (FTIFF_idxChunk*) (var + nbVar);
+
+    for( i = 0; i < nbVar; i++ ) {
+        var[i].id = ( FTI_Data != NULL && i < FTI_Exec->nbVar ) ? FTI_Data[i].id : -1;
+    }
+
+    // count the chunks of each variable
+    for( currentdb = FTI_Exec->firstdb; currentdb != NULL; currentdb = currentdb->next ) {
+        for( dbvar_idx = 0; dbvar_idx < currentdb->numvars; dbvar_idx++ ) {
+            currentdbvar = &(currentdb->dbvars[dbvar_idx]);
+            var[currentdbvar->idx].id = currentdbvar->id;
+            if( currentdbvar->hascontent ) {
+                var[currentdbvar->idx].count++;
+            }
+        }
+    }
+    int first = 0;
+    for( i = 0; i < nbVar; i++ ) {
+        var[i].first = first;
+        first += var[i].count;
+        var[i].count = 0;
+    }
+
+    // fill the chunk table
+    long dboffset = FTI_filemetastructsize;
+    for( currentdb = FTI_Exec->firstdb; currentdb != NULL; currentdb = currentdb->next ) {
+        for( dbvar_idx = 0; dbvar_idx < currentdb->numvars; dbvar_idx++ ) {
+            currentdbvar = &(currentdb->dbvars[dbvar_idx]);
+            if( !(currentdbvar->hascontent) ) {
+                continue;
+            }
+            FTIFF_idxVar* v = &var[currentdbvar->idx];
+            FTIFF_idxChunk* c = &chunk[v->first + v->count++];
+            c->fptr = currentdbvar->fptr;
+            c->dptr = currentdbvar->dptr;
+            c->size = currentdbvar->chunksize;
+            c->csize = FTIFF_GetChunkFileSize( &(FTI_Exec->FTIFFMeta), currentdb, dboffset, dbvar_idx );
+            c->owner = ( FTI_Exec->FTIFFMeta.codec != FTI_CODEC_NONE ) ? currentdbvar->owner : -1;
+            memcpy( c->hash, currentdbvar->hash, MD5_DIGEST_LENGTH );
+        }
+        dboffset += currentdb->dbsize;
+    }
+
+    memcpy( header->magic, FTIFF_IDX_MAGIC, sizeof(header->magic) );
+    header->nbVar = nbVar;
+    header->nbChunk = nbChunk;
+    MD5( (unsigned char*) var, size - sizeof(FTIFF_idxHeader), header->hash );
+
+    FTIFF_idx idx = { .buffer = buffer, .size = size, .nbVar = nbVar, .nbChunk = nbChunk,
+        .var = var, .chunk = chunk };
+    if( FTIFF_HashIdx( &idx ) != FTI_SCES ) {
+        free( buffer );
+        return FTI_NSCS;
+    }
+    FTIFF_FreeIdx( FTI_Exec );
+    FTI_Exec->FTIFFIdx = idx;
+
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Validates and copies a variable index stored in a file.
+  @param      idx             Variable index to initialize.
+  @param      buffer          Index as stored in the file.
+  @param      size            Number of bytes available in 'buffer'.
+  @return     integer         FTI_SCES if successful.
+
+  On success, 'idx->buffer' and 'idx->lookup' have to be freed by the
+  caller.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTIFF_ParseIdx( FTIFF_idx* idx, char* buffer, long size )
+{
+    FTIFF_idxHeader header;
+    if( size < sizeof(FTIFF_idxHeader) ) {
+        return FTI_NSCS;
+    }
+    memcpy( &header, buffer, sizeof(FTIFF_idxHeader) );
+    if( memcmp( header.magic, FTIFF_IDX_MAGIC, sizeof(header.magic) ) != 0 ||
+            header.nbVar < 0 || header.nbChunk < 0 ) {
+        return FTI_NSCS;
+    }
+    long idxSize = sizeof(FTIFF_idxHeader) + header.nbVar * sizeof(FTIFF_idxVar) 
+        + header.nbChunk * sizeof(FTIFF_idxChunk);
+    if( idxSize > size ) {
+        return FTI_NSCS;
+    }
+
+    unsigned char hash[MD5_DIGEST_LENGTH];
+    MD5( (unsigned char*) buffer + sizeof(FTIFF_idxHeader), idxSize - sizeof(FTIFF_idxHeader), hash );
+    if( memcmp( hash, header.hash, MD5_DIGEST_LENGTH ) != 0 ) {
+        FTI_Print( "FTI-FF: LoadIdx - variable index has been corrupted.", FTI_WARN );
+        return FTI_NSCS;
+    }
+
+    char* copy = (char*) malloc( idxSize );
+    if( copy == NULL ) {
+        return FTI_NSCS;
+    }
+    memcpy( copy, buffer, idxSize );
+    FTIFF_idxVar* var = (FTIFF_idxVar*) (copy + sizeof(FTIFF_idxHeader));
+    int i;
+    for( i = 0; i < header.nbVar; i++ ) {
+        if( var[i].first < 0 || var[i].count < 0 || var[i].first + var[i].count > header.nbChunk ) {
+            free( copy );
+            return FTI_NSCS;
+        }
+    }
+
+    idx->buffer = copy;
+    idx->size = idxSize;
+    idx->nbVar = header.nbVar;
+    idx->nbChunk = header.nbChunk;
+    idx->var = var;
+    idx->chunk = (FTIFF_idxChunk*) (var + header.nbVar);
+    if( FTIFF_HashIdx( idx ) != FTI_SCES ) {
+        free( copy );
+        return FTI_NSCS;
+    }
+
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Loads the variable index stored in a checkpoint file.
+  @param      FTI_Exec        Execution metadata.
+  @param      buffer          Index as stored in the file.
+  @param      size            Number of bytes available in 'buffer'.
+  @return     integer         FTI_SCES if successful.
+
+  Validates the index stored after the last datablock and copies it into
+  FTI_Exec->FTIFFIdx. Returns FTI_NSCS if the index is missing or
+  corrupted, in which case it has to be rebuilt from the datablock list.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTIFF_LoadIdx( FTIT_execution* FTI_Exec, char* buffer, long size )
+{
+    FTIFF_idx idx;
+    if( FTIFF_ParseIdx( &idx, buffer, size ) != FTI_SCES ) {
+        return FTI_NSCS;
+    }
+    FTIFF_FreeIdx( FTI_Exec );
+    FTI_Exec->FTIFFIdx = idx;
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Writes the variable index to the checkpoint file.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      fd              File descriptor of the checkpoint file.
+  @return     integer         FTI_SCES if successful.
+
+  Builds the variable index and writes it after the last datablock, at
+  offset FTI_Exec->ckptSize. The file is truncated after the index, so
+  that an index of a previous dCP checkpoint does not remain.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTIFF_WriteIdx( FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data, int fd )
+{
+    char strerr[FTI_BUFS];
+
+    if( FTIFF_BuildIdx( FTI_Exec, FTI_Data ) != FTI_SCES ) {
+        return FTI_NSCS;
+    }
+
+    long written = 0;
+    while( written < FTI_Exec->FTIFFIdx.size ) {
+        ssize_t res = pwrite( fd, FTI_Exec->FTIFFIdx.buffer + written, 
+                FTI_Exec->FTIFFIdx.size - written, FTI_Exec->ckptSize + written );
+        if( res == -1 ) {
+            snprintf( strerr, FTI_BUFS, "FTI-FF: WriteIdx - could not write the variable index: %s", strerror(errno) );
+            FTI_Print( strerr, FTI_EROR );
+            errno = 0;
+            return FTI_NSCS;
+        }
+        written += res;
+    }
+    if( ftruncate( fd, FTI_Exec->ckptSize + FTI_Exec->FTIFFIdx.size ) == -1 ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: WriteIdx - could not truncate the checkpoint file: %s", strerror(errno) );
+        FTI_Print( strerr, FTI_EROR );
+        errno = 0;
+        return FTI_NSCS;
+    }
+
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Frees the variable index.
+  @param      FTI_Exec        Execution metadata.
+  @return     void
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTIFF_FreeIdx( FTIT_execution* FTI_Exec )
+{
+    free( FTI_Exec->FTIFFIdx.buffer );
+    free( FTI_Exec->FTIFFIdx.lookup );
+    memset( &(FTI_Exec->FTIFFIdx), 0x0, sizeof(FTIFF_idx) );
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the entry of a variable in the variable index.
+  @param      FTI_Exec        Execution metadata.
+  @param      id              Id of protected variable.
+  @param      hint            Dataset index of the variable.
+  @return     integer         Entry in the index, -1 if not stored.
+
+  The entries are ordered by dataset index, thus the entry is found
+  directly if the variables are protected in the same order as in the
+  checkpointed execution. Otherwise it is looked up by id.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTIFF_GetIdxVar( FTIT_execution* FTI_Exec, int id, int hint )
+{
+    FTIFF_idx* idx = &(FTI_Exec->FTIFFIdx);
+    if( hint >= 0 && hint < idx->nbVar && idx->var[hint].id == id ) {
+        return hint;
+    }
+    if( idx->lookupSize == 0 ) {
+        return -1;
+    }
+    int slot = FTI_HashDataID( id, idx->lookupSize );
+    while( idx->lookup[slot] != -1 ) {
+        if( idx->var[idx->lookup[slot]].id == id ) {
+            return idx->lookup[slot];
+        }
+        slot = (slot + 1) & (idx->lookupSize - 1);
+    }
+    return -1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reads a deduplicated data chunk from the file of its owner.
+  @param      chunk           Index entry of the chunk.
+  @param      fn              Name of the checkpoint file referring to it.
+  @param      destptr         Destination of the chunk.
+  @return     integer         FTI_SCES if successful.
+
+  The file of the owner is the file of rank 'chunk->owner' of the same
+  checkpoint, in the directory of 'fn'. The chunk is located in the
+  index of this file by its size and hash. The caller verifies the hash
+  of the data read.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTIFF_ReadRefChunk( FTIFF_idxChunk* chunk, char* fn, char* destptr )
+{
+    char strerr[FTI_BUFS], ofn[FTI_BUFS];
+    int res = FTI_NSCS;
+
+    // file of the owner in the same directory
+    char* base = strrchr( fn, '/' );
+    int dirLen = ( base != NULL ) ? (int) (base - fn) : 0;
+    base = ( base != NULL ) ? base + 1 : fn;
+    int ckptID;
+    if( sscanf( base, "Ckpt%d-", &ckptID ) != 1 ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: ReadRefChunk - invalid checkpoint file name '%s'.", fn );
+        FTI_Print( strerr, FTI_WARN );
+        return FTI_NSCS;
+    }
+    snprintf( ofn, FTI_BUFS, "%.*s/Ckpt%d-Rank%d.fti", dirLen, fn, ckptID, (int) chunk->owner );
+
+    int fd = open( ofn, O_RDONLY, 0 );
+    if( fd == -1 ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: ReadRefChunk - could not open '%s' for reading.", ofn );
+        FTI_Print( strerr, FTI_WARN );
+        errno = 0;
+        return FTI_NSCS;
+    }
+
+    FTIFF_metaInfo meta;
+    FTIFF_idx idx;
+    memset( &idx, 0x0, sizeof(FTIFF_idx) );
+    char* buffer = (char*) malloc( FTI_filemetastructsize );
+    unsigned char hash[MD5_DIGEST_LENGTH];
+    if( buffer == NULL || pread( fd, buffer, FTI_filemetastructsize, 0 ) != FTI_filemetastructsize ||
+            FTIFF_DeserializeFileMeta( &meta, buffer ) != FTI_SCES ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: ReadRefChunk - could not read the file meta data of '%s'.", ofn );
+        FTI_Print( strerr, FTI_WARN );
+        goto cleanup;
+    }
+    FTIFF_GetHashMetaInfo( hash, &meta );
+    if( memcmp( meta.myHash, hash, MD5_DIGEST_LENGTH ) != 0 || meta.codec == FTI_CODEC_NONE || 
+            meta.fs <= meta.ckptSize ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: ReadRefChunk - '%s' has no valid variable index.", ofn );
+        FTI_Print( strerr, FTI_WARN );
+        goto cleanup;
+    }
+
+    // load the index of the owner
+    free( buffer );
+    long size = meta.fs - meta.ckptSize;
+    buffer = (char*) malloc( size );
+    if( buffer == NULL || pread( fd, buffer, size, meta.ckptSize ) != size ||
+            FTIFF_ParseIdx( &idx, buffer, size ) != FTI_SCES ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: ReadRefChunk - could not load the variable index of '%s'.", ofn );
+        FTI_Print( strerr, FTI_WARN );
+        goto cleanup;
+    }
+
+    int i;
+    for( i = 0; i < idx.nbChunk; i++ ) {
+        FTIFF_idxChunk* c = &(idx.chunk[i]);
+        if( c->owner < 0 && c->size == chunk->size && memcmp( c->hash, chunk->hash, MD5_DIGEST_LENGTH ) == 0 ) {
+            res = FTI_ReadCompressed( meta.codec, fd, c->fptr, c->csize, destptr, c->size );
+            break;
+        }
+    }
+    if( i == idx.nbChunk ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: ReadRefChunk - data chunk not found in '%s'.", ofn );
+        FTI_Print( strerr, FTI_WARN );
+    }
+
+cleanup:
+    errno = 0;
+    free( idx.buffer );
+    free( idx.lookup );
+    free( buffer );
+    close( fd );
+    return res;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reads the data chunks of a variable listed in the index.
+  @param      FTI_Exec        Execution metadata.
+  @param      data            Dataset of the variable.
+  @param      varIdx          Entry of the variable in the variable index.
+  @param      fd              File descriptor of the checkpoint file.
+  @param      fn              Name of the checkpoint file.
+  @return     integer         FTI_SCES if successful.
+
+  Reads every chunk directly from its offset in the file, decompresses
+  it if the file is compressed, and verifies its hash. Deduplicated
+  chunks are read from the file of their owner.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTIFF_ReadIdxVar( FTIT_execution* FTI_Exec, FTIT_dataset* data, int varIdx, 
+        int fd, char* fn )
+{
+    char str[FTI_BUFS], strerr[FTI_BUFS];
+    FTIFF_idxVar* var = &(FTI_Exec->FTIFFIdx.var[varIdx]);
+    int codec = FTI_Exec->FTIFFMeta.codec;
+
+    unsigned char hash[MD5_DIGEST_LENGTH];
+    int chunk_idx;
+
+    // read the data chunks directly from their offsets in the file
+    for(chunk_idx=var->first; chunk_idx<var->first+var->count; chunk_idx++) {
+
+        FTIFF_idxChunk* chunk = &(FTI_Exec->FTIFFIdx.chunk[chunk_idx]);
+        char* destptr = (char*) data->ptr + chunk->dptr;
+
+        if ( chunk->dptr + chunk->size > data->size ) {
+            snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - data chunk of dataset with id:%i exceeds the protected size.", data->id);
+            FTI_Print(strerr, FTI_WARN);
+            return FTI_NREC;
+        }
+
+        if ( chunk->owner >= 0 ) {
+            if ( FTIFF_ReadRefChunk( chunk, fn, destptr ) != FTI_SCES ) {
+                snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - could not read dataset with id:%i from the file of rank %d.", data->id, (int) chunk->owner);
+                FTI_Print(strerr, FTI_WARN);
+                return FTI_NREC;
+            }
+        } else if ( codec != FTI_CODEC_NONE ) {
+            if ( FTI_ReadCompressed( codec, fd, chunk->fptr, chunk->csize, destptr, chunk->size ) != FTI_SCES ) {
+                snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - could not decompress dataset with id:%i from '%s'.", data->id, fn);
+                FTI_Print(strerr, FTI_WARN);
+                return FTI_NREC;
+            }
+        } else {
+            long rcount = 0;
+            while ( rcount < chunk->size ) {
+                ssize_t res = pread( fd, destptr + rcount, chunk->size - rcount, chunk->fptr + rcount );
+                if ( res <= 0 ) {
+                    snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - could not read from '%s'.", fn);
+                    FTI_Print(strerr, FTI_EROR);
+                    errno = 0;
+                    return FTI_NREC;
+                }
+                rcount += res;
+            }
+        }
+
+        // debug information
+        snprintf(str, FTI_BUFS, "FTIFF: FTIFF_RecoverVar -  chunk:%i id: %i, destptr: %ld, fptr: %ld, chunksize: %ld, "
+                "base_ptr: 0x%" PRIxPTR " ptr_pos: 0x%" PRIxPTR ".", 
+                chunk_idx - var->first, data->id, (long) chunk->dptr,
+                (long) chunk->fptr, (long) chunk->size,
+                (uintptr_t)data->ptr, (uintptr_t)destptr);
+        FTI_Print(str, FTI_DBUG);
 
-    } while( isnextdb );
- 
-    // only for printout of dCP share in FTI_Checkpoint
-    FTI_Exec->FTIFFMeta.dcpSize = dcpSize;
-    FTI_Exec->FTIFFMeta.dataSize = dataSize;
+        MD5( (unsigned char*) destptr, chunk->size, hash );
 
-    fdatasync( fd );
-    close( fd );
+        if ( memcmp( chunk->hash, hash, MD5_DIGEST_LENGTH ) != 0 ) {
+            snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - dataset with id:%i has been corrupted! Discard recovery.", data->id);
+            FTI_Print(strerr, FTI_WARN);
+            return FTI_NREC;
+        }
 
-    return FTI_SCES;
+    }
 
+    return FTI_SCES;
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief      Assign meta data to runtime and file meta data types
-  @param      FTI_Conf        Configuration metadata.
+  @brief      Reads the chunks of an uncompressed file with threads
   @param      FTI_Exec        Execution metadata.
-  @param      FTI_Topo        Topology metadata.
   @param      FTI_Data        Dataset metadata.
+  @param      fn              Path of the checkpoint file.
   @return     integer         FTI_SCES if successful.
 
-  This function gathers information about the checkpoint files in the
-  group and stores it in the respective meta data types runtime and
-  ckpt file.
+  The chunks are read straight into the protected buffers by
+  FTI_ReadPieces, each one hashed as it arrives and compared to the hash
+  stored in its meta data.
 
  **/
 /*-------------------------------------------------------------------------*/
-int FTIFF_CreateMetadata( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo, 
-        FTIT_dataset* FTI_Data, FTIT_configuration* FTI_Conf )
+static int FTIFF_ReadChunks( FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data, char *fn )
 {
-    int i;
-
-    // FTI_Exec->ckptSize has to be assigned after successful ckpt write and before this call!
-    long fs = FTI_Exec->ckptSize;
-    FTI_Exec->FTIFFMeta.ckptSize = fs;
-    FTI_Exec->FTIFFMeta.fs = fs;
-
-    // allgather not needed for L1 checkpoint
-    if( (FTI_Exec->ckptLvel == 2) || (FTI_Exec->ckptLvel == 3) ) { 
-
-        long fileSizes[FTI_BUFS], mfs = 0;
-        MPI_Allgather(&fs, 1, MPI_LONG, fileSizes, 1, MPI_LONG, FTI_Exec->groupComm);
-        int ptnerGroupRank, i;
-        switch(FTI_Exec->ckptLvel) {
-
-            //get partner file size:
-            case 2:
-
-                ptnerGroupRank = (FTI_Topo->groupRank + FTI_Topo->groupSize - 1) % FTI_Topo->groupSize;
-                FTI_Exec->FTIFFMeta.ptFs = fileSizes[ptnerGroupRank];
-                FTI_Exec->FTIFFMeta.maxFs = -1;
-                break;
-
-                //get max file size in group 
-            case 3:
-                for (i = 0; i < FTI_Topo->groupSize; i++) {
-                    if (fileSizes[i] > mfs) {
-                        mfs = fileSizes[i]; // Search max. size
-                    }
-                }
-
-                FTI_Exec->FTIFFMeta.maxFs = mfs;
-                FTI_Exec->FTIFFMeta.ptFs = -1;
-        }     
-
-    } else {
-
-        FTI_Exec->FTIFFMeta.ptFs = -1;
-        FTI_Exec->FTIFFMeta.maxFs = -1;
+    char strerr[FTI_BUFS];
 
+    int nbChunks = 0;
+    FTIFF_db *currentdb = FTI_Exec->firstdb;
+    while ( currentdb ) {
+        nbChunks += currentdb->numvars;
+        currentdb = currentdb->next;
     }
 
-    FTI_Exec->meta[0].fs[0] = FTI_Exec->FTIFFMeta.fs;
-    FTI_Exec->meta[0].pfs[0] = FTI_Exec->FTIFFMeta.ptFs;
-    FTI_Exec->meta[0].maxFs[0] = FTI_Exec->FTIFFMeta.maxFs;
+    FTIT_readPiece *pieces = talloc( FTIT_readPiece, nbChunks + 1 );
+    FTIFF_dbvar **chunks = talloc( FTIFF_dbvar*, nbChunks + 1 );
+    MD5_CTX *digests = talloc( MD5_CTX, nbChunks + 1 );
+    if ( pieces == NULL || chunks == NULL || digests == NULL ) {
+        FTI_Print( "FTI-FF: FTIFF_Recover - failed to allocate the chunk list.", FTI_EROR );
+        free( pieces );
+        free( chunks );
+        free( digests );
+        return FTI_NREC;
+    }
 
-    // write meta data and its hash
-    struct timespec ntime;
-    if ( clock_gettime(CLOCK_REALTIME, &ntime) == -1 ) {
-        FTI_Print("FTI-FF: FTIFF_CreateMetaData - failed to determine time, timestamp set to -1", FTI_WARN);
-        FTI_Exec->FTIFFMeta.timestamp = -1;
-    } else {
-        FTI_Exec->FTIFFMeta.timestamp = ntime.tv_sec*1000000000 + ntime.tv_nsec;
+    int nb = 0, dbvar_idx;
+    for ( currentdb = FTI_Exec->firstdb; currentdb; currentdb = currentdb->next ) {
+        for ( dbvar_idx = 0; dbvar_idx < currentdb->numvars; dbvar_idx++ ) {
+            FTIFF_dbvar *currentdbvar = &(currentdb->dbvars[dbvar_idx]);
+            if ( !(currentdbvar->hascontent) ) {
+                continue;
+            }
+            pieces[nb].dst = (char*) FTI_Data[currentdbvar->idx].ptr + currentdbvar->dptr;
+            pieces[nb].offset = currentdbvar->fptr;
+            pieces[nb].size = currentdbvar->chunksize;
+            pieces[nb].digest = nb;
+            chunks[nb] = currentdbvar;
+            MD5_Init( &digests[nb] );
+            nb++;
+        }
     }
 
-    // create checksum of meta data
-    FTIFF_GetHashMetaInfo( FTI_Exec->FTIFFMeta.myHash, &(FTI_Exec->FTIFFMeta) );
+    int fd = open( fn, O_RDONLY, 0 );
+    if ( fd == -1 ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: FTIFF_Recover - could not open '%s' for reading.", fn );
+        FTI_Print( strerr, FTI_EROR );
+        free( pieces );
+        free( chunks );
+        free( digests );
+        return FTI_NREC;
+    }
 
-    //Flush metadata in case postCkpt done inline
-    FTI_Exec->meta[FTI_Exec->ckptLvel].fs[0] = FTI_Exec->meta[0].fs[0];
-    FTI_Exec->meta[FTI_Exec->ckptLvel].pfs[0] = FTI_Exec->meta[0].pfs[0];
-    FTI_Exec->meta[FTI_Exec->ckptLvel].maxFs[0] = FTI_Exec->meta[0].maxFs[0];
-    strncpy(FTI_Exec->meta[FTI_Exec->ckptLvel].ckptFile, FTI_Exec->meta[0].ckptFile, FTI_BUFS);
-    for (i = 0; i < FTI_Exec->nbVar; i++) {
-        FTI_Exec->meta[0].varID[i] = FTI_Data[i].id;
-        FTI_Exec->meta[0].varSize[i] = FTI_Data[i].size;
+    int res = FTI_SCES, i;
+    if ( FTI_ReadPieces( fd, pieces, nb, digests, nb ) != FTI_SCES ) {
+        snprintf( strerr, FTI_BUFS, "FTI-FF: FTIFF_Recover - could not read '%s'.", fn );
+        FTI_Print( strerr, FTI_EROR );
+        res = FTI_NREC;
+    }
+    for ( i = 0; i < nb && res == FTI_SCES; i++ ) {
+        unsigned char hash[MD5_DIGEST_LENGTH];
+        MD5_Final( hash, &digests[i] );
+        if ( memcmp( chunks[i]->hash, hash, MD5_DIGEST_LENGTH ) != 0 ) {
+            snprintf( strerr, FTI_BUFS, "FTI-FF: FTIFF_Recover - dataset with id:%i|cnt-id:%d has been corrupted! Discard recovery.",
+                    chunks[i]->id, chunks[i]->containerid );
+            FTI_Print( strerr, FTI_WARN );
+            res = FTI_NREC;
+        }
     }
 
-    return FTI_SCES;
+    close( fd );
+    free( pieces );
+    free( chunks );
+    free( digests );
+    return res;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -1338,15 +2288,21 @@ int FTIFF_CreateMetadata( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
   @param      FTI_Exec        Execution metadata.
   @param      FTI_Ckpt        Checkpoint metadata.
   @param      FTI_Data        Dataset metadata.
+  @param      FTI_Conf        Configuration metadata.
   @return     integer         FTI_SCES if successful.
 
   This function restores the data of the protected variables to the state
   of the last checkpoint. The function is called by the API function 
-  'FTI_Recover'.
+  'FTI_Recover'. With several 'Advanced:recover_threads', uncompressed
+  chunks are read in parallel (FTIFF_ReadChunks). With
+  'Advanced:lazy_recovery', they are restored on first touch
+  (FTI_LazyAdd); their hashes are not checked, the file checksum was
+  verified at FTI_Init.
 
  **/
 /*-------------------------------------------------------------------------*/
-int FTIFF_Recover( FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data, FTIT_checkpoint *FTI_Ckpt ) 
+int FTIFF_Recover( FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data, FTIT_checkpoint *FTI_Ckpt,
+        FTIT_configuration *FTI_Conf ) 
 {
     if (FTI_Exec->initSCES == 0) {
         FTI_Print("FTI is not initialized.", FTI_WARN);
@@ -1393,6 +2349,26 @@ int FTIFF_Recover( FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data, FTIT_checkp
     }
     
     char strerr[FTI_BUFS];
+
+    // compressed chunks are located through the variable index
+    if (FTI_Exec->FTIFFMeta.codec != FTI_CODEC_NONE) {
+        int fd = open( fn, O_RDONLY, 0 );
+        if (fd == -1) {
+            snprintf( strerr, FTI_BUFS, "FTI-FF: FTIFF_Recover - could not open '%s' for reading.", fn);
+            FTI_Print(strerr, FTI_EROR);
+            return FTI_NREC;
+        }
+        for (i = 0; i < FTI_Exec->nbVar; i++) {
+            int varIdx = FTIFF_GetIdxVar( FTI_Exec, FTI_Data[i].id, i );
+            if (varIdx != -1 && FTIFF_ReadIdxVar( FTI_Exec, &FTI_Data[i], varIdx, fd, fn ) != FTI_SCES) {
+                close(fd);
+                return FTI_NREC;
+            }
+        }
+        close(fd);
+        FTI_Exec->reco = 0;
+        return FTI_SCES;
+    }
     
     // get filesize
     struct stat st;
@@ -1403,8 +2379,17 @@ int FTIFF_Recover( FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data, FTIT_checkp
         return FTI_NREC;
     }
 
-    // block size for memcpy of pointer.
-    long membs = 1024*1024*16; // 16 MB
+    // chunks read by the worker threads, unless restored lazily
+    if ( !FTI_Conf->lazyRecovery && FTI_Conf->recoverThreads > 1 && FTI_GetThreadCount() > 1 ) {
+        if ( FTIFF_ReadChunks( FTI_Exec, FTI_Data, fn ) != FTI_SCES ) {
+            return FTI_NREC;
+        }
+        FTI_Exec->reco = 0;
+        return FTI_SCES;
+    }
+
+    // block size for memcpy of pointer, hashed while in cache.
+    long membs = CHUNK_SIZE;
     long cpybuf, cpynow, cpycnt;
 
     // open checkpoint file for read only
@@ -1427,6 +2412,12 @@ int FTIFF_Recover( FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data, FTIT_checkp
     // file is mapped, we can close it.
     close(fd);
 
+    // the chunks are read in file order
+    madvise(fmmap, st.st_size, MADV_SEQUENTIAL);
+
+    // the mapping belongs to the lazy recovery once started
+    bool lazy = FTI_Conf->lazyRecovery && FTI_LazyBegin( fmmap, st.st_size ) == FTI_SCES;
+
     FTIFF_db *currentdb;
     FTIFF_dbvar *currentdbvar = NULL;
     char *destptr, *srcptr;
@@ -1459,6 +2450,11 @@ int FTIFF_Recover( FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data, FTIT_checkp
 
             srcptr = (char*) fmmap + currentdbvar->fptr;
 
+            if ( lazy ) {
+                FTI_LazyAdd( destptr, srcptr, currentdbvar->chunksize );
+                continue;
+            }
+
             MD5_Init( &mdContext );
             cpycnt = 0;
             while ( cpycnt < currentdbvar->chunksize ) {
@@ -1520,8 +2516,13 @@ int FTIFF_Recover( FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data, FTIT_checkp
 
     } while( isnextdb );
 
+    if ( lazy ) {
+        if ( FTI_LazyStart() != FTI_SCES ) {
+            return FTI_NREC;
+        }
+    }
     // unmap memory
-    if ( munmap( fmmap, st.st_size ) == -1 ) {
+    else if ( munmap( fmmap, st.st_size ) == -1 ) {
         FTI_Print("FTIFF: FTIFF_Recover - unable to unmap memory", FTI_EROR);
         errno = 0;
         return FTI_NREC;
@@ -1586,6 +2587,27 @@ int FTIFF_RecoverVar( int id, FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data,
         return FTI_NREC;
     }
 
+    if (!FTI_Exec->FTIFFIdx.buffer) {
+        FTI_Print( "FTIFF: FTIFF_RecoverVar - No variable index. Nothing to recover.", FTI_WARN );
+        return FTI_NREC;
+    }
+
+    char str[FTI_BUFS], strerr[FTI_BUFS];
+
+    int dataIdx = FTI_GetDataIdx( FTI_Exec, id );
+    if (dataIdx == -1) {
+        snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - variable with id:%i is not protected.", id );
+        FTI_Print( strerr, FTI_WARN );
+        return FTI_NREC;
+    }
+
+    // look up the data chunks of the variable in the index
+    int varIdx = FTIFF_GetIdxVar( FTI_Exec, id, dataIdx );
+    if (varIdx == -1) {
+        // variable not stored in checkpoint, nothing to recover.
+        return FTI_SCES;
+    }
+
     //Recovering from local for L4 case in FTI_Recover
     if (FTI_Exec->ckptLvel == 4) {
         snprintf(fn, FTI_BUFS, "%s/%s", FTI_Ckpt[1].dir, FTI_Exec->meta[1].ckptFile);
@@ -1594,124 +2616,23 @@ int FTIFF_RecoverVar( int id, FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data,
         snprintf(fn, FTI_BUFS, "%s/%s", FTI_Ckpt[FTI_Exec->ckptLvel].dir, FTI_Exec->meta[FTI_Exec->ckptLvel].ckptFile);
     }
 
-    char str[FTI_BUFS], strerr[FTI_BUFS];
-
     snprintf(str, FTI_BUFS, "Trying to load FTI checkpoint file (%s)...", fn);
     FTI_Print(str, FTI_DBUG);
 
-    // get filesize
-    struct stat st;
-    if (stat(fn, &st) == -1) {
-        snprintf(strerr, FTI_BUFS, "FTI-FF: FTIFF_RecoverVar - could not get stats for file: %s", fn); 
-        FTI_Print(strerr, FTI_EROR);
-        errno = 0;
-        return FTI_NREC;
-    }
-
-    // block size for memcpy of pointer.
-    long membs = 1024*1024*16; // 16 MB
-    long cpybuf, cpynow, cpycnt;
-
     // open checkpoint file for read only
     int fd = open( fn, O_RDONLY, 0 );
     if (fd == -1) {
         snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - could not open '%s' for reading.", fn);
         FTI_Print(strerr, FTI_EROR);
+        errno = 0;
         return FTI_NREC;
     }
 
-    // map file into memory
-    char* fmmap = (char*) mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
-    if (fmmap == MAP_FAILED) {
-        snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - could not map '%s' to memory.", fn);
-        FTI_Print(strerr, FTI_EROR);
-        close(fd);
-        return FTI_NREC;
-    }
+    int res = FTIFF_ReadIdxVar( FTI_Exec, &FTI_Data[dataIdx], varIdx, fd, fn );
 
-    // file is mapped, we can close it.
     close(fd);
 
-    FTIFF_db *currentdb;
-    FTIFF_dbvar *currentdbvar = NULL;
-    char *destptr, *srcptr;
-    int dbvar_idx, dbcounter=0;
-
-    // MD5 context for checksum of data chunks
-    MD5_CTX mdContext;
-    unsigned char hash[MD5_DIGEST_LENGTH];
-
-    int isnextdb;
-
-    currentdb = FTI_Exec->firstdb;
-
-    do {
-
-        isnextdb = 0;
-
-        for(dbvar_idx=0;dbvar_idx<currentdb->numvars;dbvar_idx++) {
-
-            currentdbvar = &(currentdb->dbvars[dbvar_idx]);
-
-            if (currentdbvar->id == id) {
-                // get source and destination pointer
-                destptr = (char*) FTI_Data[currentdbvar->idx].ptr + currentdbvar->dptr;
-                srcptr = (char*) fmmap + currentdbvar->fptr;
-
-                MD5_Init( &mdContext );
-                cpycnt = 0;
-                while ( cpycnt < currentdbvar->chunksize ) {
-                    cpybuf = currentdbvar->chunksize - cpycnt;
-                    cpynow = ( cpybuf > membs ) ? membs : cpybuf;
-                    cpycnt += cpynow;
-                    memcpy( destptr, srcptr, cpynow );
-                    MD5_Update( &mdContext, destptr, cpynow );
-                    destptr += cpynow;
-                    srcptr += cpynow;
-                }
-
-                // debug information
-                snprintf(str, FTI_BUFS, "FTIFF: FTIFF_RecoverVar -  dataBlock:%i/dataBlockVar%i id: %i, idx: %i"
-                        ", destptr: %ld, fptr: %ld, chunksize: %ld, "
-                        "base_ptr: 0x%" PRIxPTR " ptr_pos: 0x%" PRIxPTR ".", 
-                        dbcounter, dbvar_idx,  
-                        currentdbvar->id, currentdbvar->idx, currentdbvar->dptr,
-                        currentdbvar->fptr, currentdbvar->chunksize,
-                        (uintptr_t)FTI_Data[currentdbvar->idx].ptr, (uintptr_t)destptr);
-                FTI_Print(str, FTI_DBUG);
-
-                MD5_Final( hash, &mdContext );
-
-                if ( memcmp( currentdbvar->hash, hash, MD5_DIGEST_LENGTH ) != 0 ) {
-                    snprintf( strerr, FTI_BUFS, "FTIFF: FTIFF_RecoverVar - dataset with id:%i has been corrupted! Discard recovery.", currentdbvar->id);
-                    FTI_Print(strerr, FTI_WARN);
-                    if ( munmap( fmmap, st.st_size ) == -1 ) {
-                        FTI_Print("FTIFF: FTIFF_RecoverVar - unable to unmap memory", FTI_EROR);
-                        errno = 0;
-                    }
-                    return FTI_NREC;
-                }
-
-            }
-
-        }
-
-        if (currentdb->next) {
-            currentdb = currentdb->next;
-            isnextdb = 1;
-        }
-
-        dbcounter++;
-
-    } while( isnextdb );
-
-    // unmap memory
-    if ( munmap( fmmap, st.st_size ) == -1 ) {
-        FTI_Print("FTIFF: FTIFF_RecoverVar - unable to unmap memory", FTI_EROR);
-        errno = 0;
-    }
-
-    return FTI_SCES;
+    return res;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -1720,14 +2641,17 @@ int FTIFF_RecoverVar( int id, FTIT_execution *FTI_Exec, FTIT_dataset *FTI_Data,
   @param      FTI_Exec        Execution metadata.
   @param      FTI_Topo        Topology metadata.
   @param      FTI_Ckpt        Checkpoint metadata.
+  @param      FTI_Conf        Configuration metadata.
   @return     integer         FTI_SCES if successful.
 
   This function initializes the L1 checkpoint recovery. It checks for 
-  erasures and loads the required meta data. 
+  erasures and loads the required meta data. With 'Advanced:verify_on_load',
+  the file checksum is not computed, the data chunks are verified by
+  FTIFF_Recover instead.
  **/
 /*-------------------------------------------------------------------------*/
 int FTIFF_CheckL1RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo, 
-        FTIT_checkpoint* FTI_Ckpt )
+        FTIT_checkpoint* FTI_Ckpt, FTIT_configuration* FTI_Conf )
 {
     char str[FTI_BUFS], tmpfn[FTI_BUFS], strerr[FTI_BUFS];
     int fexist = 0, fileTarget, ckptID, fcount;
@@ -1822,15 +2746,7 @@ int FTIFF_CheckL1RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                         }
                         
                         // Read in file meta-data
-                        if ( 
-                                ( read( fd, FTIFFMeta->checksum, MD5_DIGEST_STRING_LENGTH ) == -1 )     ||
-                                ( read( fd, FTIFFMeta->myHash, MD5_DIGEST_LENGTH ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->ckptSize), sizeof(long) ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->fs), sizeof(long) ) == -1 )                    ||
-                                ( read( fd, &(FTIFFMeta->maxFs), sizeof(long) ) == -1 )                 ||
-                                ( read( fd, &(FTIFFMeta->ptFs), sizeof(long) ) == -1 )                  ||
-                                ( read( fd, &(FTIFFMeta->timestamp), sizeof(long) ) == -1 )                                     
-                            ) 
+                        if ( FTIFF_ReadFileMeta( fd, FTIFFMeta ) != FTI_SCES ) 
                         {
                             snprintf(strerr, FTI_BUFS, "FTI-FF: L1RecoveryInit - Failed to request file meta data from: %s", tmpfn);
                             FTI_Print(strerr, FTI_EROR);
@@ -1847,15 +2763,18 @@ int FTIFF_CheckL1RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                         // Check if hash of file meta-data is consistent
                         if ( memcmp( FTIFFMeta->myHash, hash, MD5_DIGEST_LENGTH ) == 0 ) {
                             
-                            unsigned char hash[MD5_DIGEST_LENGTH];
-                            FTIFF_GetFileChecksum( FTIFFMeta, FTI_Ckpt, fd, hash ); 
-                            
-                            int i;
                             char checksum[MD5_DIGEST_STRING_LENGTH];
-                            int ii = 0;
-                            for(i = 0; i < MD5_DIGEST_LENGTH; i++) {
-                                sprintf(&checksum[ii], "%02x", hash[i]);
-                                ii += 2;
+                            strncpy( checksum, FTIFFMeta->checksum, MD5_DIGEST_STRING_LENGTH );
+                            if ( !FTI_Conf->verifyOnLoad ) {
+                                unsigned char hash[MD5_DIGEST_LENGTH];
+                                FTIFF_GetFileChecksum( FTIFFMeta, FTI_Ckpt, fd, hash ); 
+
+                                int i;
+                                int ii = 0;
+                                for(i = 0; i < MD5_DIGEST_LENGTH; i++) {
+                                    sprintf(&checksum[ii], "%02x", hash[i]);
+                                    ii += 2;
+                                }
                             }
                             
                             //if ( 1 ) {
@@ -2047,15 +2966,7 @@ int FTIFF_CheckL2RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                             goto GATHER_L2INFO;
                         }
 
-                        if ( 
-                                ( read( fd, FTIFFMeta->checksum, MD5_DIGEST_STRING_LENGTH ) == -1 )     ||
-                                ( read( fd, FTIFFMeta->myHash, MD5_DIGEST_LENGTH ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->ckptSize), sizeof(long) ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->fs), sizeof(long) ) == -1 )                    ||
-                                ( read( fd, &(FTIFFMeta->maxFs), sizeof(long) ) == -1 )                 ||
-                                ( read( fd, &(FTIFFMeta->ptFs), sizeof(long) ) == -1 )                  ||
-                                ( read( fd, &(FTIFFMeta->timestamp), sizeof(long) ) == -1 )                                     
-                            ) 
+                        if ( FTIFF_ReadFileMeta( fd, FTIFFMeta ) != FTI_SCES ) 
                         {
                             snprintf(strerr, FTI_BUFS, "FTI-FF: L2RecoveryInit - Failed to request file meta data from: %s", tmpfn);
                             FTI_Print(strerr, FTI_EROR);
@@ -2156,15 +3067,7 @@ int FTIFF_CheckL2RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                             goto GATHER_L2INFO;
                         }
 
-                        if ( 
-                                ( read( fd, FTIFFMeta->checksum, MD5_DIGEST_STRING_LENGTH ) == -1 )     ||
-                                ( read( fd, FTIFFMeta->myHash, MD5_DIGEST_LENGTH ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->ckptSize), sizeof(long) ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->fs), sizeof(long) ) == -1 )                    ||
-                                ( read( fd, &(FTIFFMeta->maxFs), sizeof(long) ) == -1 )                 ||
-                                ( read( fd, &(FTIFFMeta->ptFs), sizeof(long) ) == -1 )                  ||
-                                ( read( fd, &(FTIFFMeta->timestamp), sizeof(long) ) == -1 )                                     
-                            ) 
+                        if ( FTIFF_ReadFileMeta( fd, FTIFFMeta ) != FTI_SCES ) 
                         {
                             snprintf(strerr, FTI_BUFS, "FTI-FF: L2RecoveryInit - Failed to request file meta data from: %s", tmpfn);
                             FTI_Print(strerr, FTI_EROR);
@@ -2388,15 +3291,7 @@ int FTIFF_CheckL3RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                             goto GATHER_L3INFO;
                         }
 
-                        if ( 
-                                ( read( fd, FTIFFMeta->checksum, MD5_DIGEST_STRING_LENGTH ) == -1 )     ||
-                                ( read( fd, FTIFFMeta->myHash, MD5_DIGEST_LENGTH ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->ckptSize), sizeof(long) ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->fs), sizeof(long) ) == -1 )                    ||
-                                ( read( fd, &(FTIFFMeta->maxFs), sizeof(long) ) == -1 )                 ||
-                                ( read( fd, &(FTIFFMeta->ptFs), sizeof(long) ) == -1 )                  ||
-                                ( read( fd, &(FTIFFMeta->timestamp), sizeof(long) ) == -1 )                                     
-                            ) 
+                        if ( FTIFF_ReadFileMeta( fd, FTIFFMeta ) != FTI_SCES ) 
                         {
                             snprintf(strerr, FTI_BUFS, "FTI-FF: L3RecoveryInit - Failed to request file meta data from: %s", tmpfn);
                             FTI_Print(strerr, FTI_EROR);
@@ -2495,15 +3390,7 @@ int FTIFF_CheckL3RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                             goto GATHER_L3INFO;
                         }
 
-                        if ( 
-                                ( read( fd, FTIFFMeta->checksum, MD5_DIGEST_STRING_LENGTH ) == -1 )     ||
-                                ( read( fd, FTIFFMeta->myHash, MD5_DIGEST_LENGTH ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->ckptSize), sizeof(long) ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->fs), sizeof(long) ) == -1 )                    ||
-                                ( read( fd, &(FTIFFMeta->maxFs), sizeof(long) ) == -1 )                 ||
-                                ( read( fd, &(FTIFFMeta->ptFs), sizeof(long) ) == -1 )                  ||
-                                ( read( fd, &(FTIFFMeta->timestamp), sizeof(long) ) == -1 )                                     
-                            ) 
+                        if ( FTIFF_ReadFileMeta( fd, FTIFFMeta ) != FTI_SCES ) 
                         {
                             snprintf(strerr, FTI_BUFS, "FTI-FF: L3RecoveryInit - Failed to request file meta data from: %s", tmpfn);
                             FTI_Print(strerr, FTI_EROR);
@@ -2652,15 +3539,17 @@ GATHER_L3INFO:
   @param      FTI_Exec        Execution metadata.
   @param      FTI_Topo        Topology metadata.
   @param      FTI_Ckpt        Checkpoint metadata.
-  @param      checksum        Ckpt file checksum
+  @param      FTI_Conf        Configuration metadata.
   @return     integer         FTI_SCES if successful.
 
   This function initializes the L4 checkpoint recovery. It checks for 
-  erasures and loads the required meta data. 
+  erasures and loads the required meta data. With 'Advanced:verify_on_load',
+  the file checksum is not computed, the data chunks are verified by
+  FTIFF_Recover instead.
  **/
 /*-------------------------------------------------------------------------*/
 int FTIFF_CheckL4RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo, 
-        FTIT_checkpoint* FTI_Ckpt)
+        FTIT_checkpoint* FTI_Ckpt, FTIT_configuration* FTI_Conf )
 {
     char str[FTI_BUFS], strerr[FTI_BUFS], tmpfn[FTI_BUFS];
     int fexist = 0, fileTarget, ckptID, fcount;
@@ -2752,15 +3641,7 @@ int FTIFF_CheckL4RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                         }
 
                         // Read in file meta-data
-                        if ( 
-                                ( read( fd, FTIFFMeta->checksum, MD5_DIGEST_STRING_LENGTH ) == -1 )     ||
-                                ( read( fd, FTIFFMeta->myHash, MD5_DIGEST_LENGTH ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->ckptSize), sizeof(long) ) == -1 )              ||
-                                ( read( fd, &(FTIFFMeta->fs), sizeof(long) ) == -1 )                    ||
-                                ( read( fd, &(FTIFFMeta->maxFs), sizeof(long) ) == -1 )                 ||
-                                ( read( fd, &(FTIFFMeta->ptFs), sizeof(long) ) == -1 )                  ||
-                                ( read( fd, &(FTIFFMeta->timestamp), sizeof(long) ) == -1 )                                     
-                            ) 
+                        if ( FTIFF_ReadFileMeta( fd, FTIFFMeta ) != FTI_SCES ) 
                         {
                             snprintf(strerr, FTI_BUFS, "FTI-FF: L4RecoveryInit - Failed to request file meta data from: %s", tmpfn);
                             FTI_Print(strerr, FTI_EROR);
@@ -2779,15 +3660,18 @@ int FTIFF_CheckL4RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                                 FTI_Exec->ckptID = ckptID;
                             }
                             
-                            unsigned char hash[MD5_DIGEST_LENGTH];
-                            FTIFF_GetFileChecksum( FTIFFMeta, FTI_Ckpt, fd, hash ); 
-                            
-                            int i;
                             char checksum[MD5_DIGEST_STRING_LENGTH];
-                            int ii = 0;
-                            for(i = 0; i < MD5_DIGEST_LENGTH; i++) {
-                                sprintf(&checksum[ii], "%02x", hash[i]);
-                                ii += 2;
+                            strncpy( checksum, FTIFFMeta->checksum, MD5_DIGEST_STRING_LENGTH );
+                            if ( !FTI_Conf->verifyOnLoad ) {
+                                unsigned char hash[MD5_DIGEST_LENGTH];
+                                FTIFF_GetFileChecksum( FTIFFMeta, FTI_Ckpt, fd, hash ); 
+
+                                int i;
+                                int ii = 0;
+                                for(i = 0; i < MD5_DIGEST_LENGTH; i++) {
+                                    sprintf(&checksum[ii], "%02x", hash[i]);
+                                    ii += 2;
+                                }
                             }
                             
                             if ( strcmp( checksum, FTIFFMeta->checksum ) == 0 ) {
@@ -2805,7 +3689,6 @@ int FTIFF_CheckL4RecoverInit( FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo,
                                         entry->d_name, checksum, FTIFFMeta->checksum);
                                 FTI_Print(str, FTI_WARN);
                                 close(fd);
-                                free(FTIFFMeta);
                                 closedir(L4CkptDir);
                                 goto GATHER_L4INFO;
                             }
@@ -2856,6 +3739,11 @@ void FTIFF_GetHashMetaInfo( unsigned char *hash, FTIFF_metaInfo *FTIFFMeta )
     MD5_Update( &md5Ctx, &(FTIFFMeta->fs), sizeof(long) );
     MD5_Update( &md5Ctx, &(FTIFFMeta->ptFs), sizeof(long) );
     MD5_Update( &md5Ctx, &(FTIFFMeta->maxFs), sizeof(long) );
+    // uncompressed files keep the hash of the layout without codec
+    if ( FTIFFMeta->codec != FTI_CODEC_NONE ) {
+        unsigned char codec = (unsigned char) FTIFFMeta->codec;
+        MD5_Update( &md5Ctx, &codec, sizeof(unsigned char) );
+    }
     MD5_Final( hash, &md5Ctx );
 }
 
@@ -3016,11 +3904,49 @@ int FTIFF_DeserializeFileMeta( FTIFF_metaInfo* meta, char* buffer_ser )
     memcpy( &(meta->ptFs)         , buffer_ser + pos, sizeof(long) );
     pos += sizeof(long);
     memcpy( &(meta->timestamp)    , buffer_ser + pos, sizeof(long) );
+    pos += sizeof(long);
+    meta->codec = (unsigned char) buffer_ser[pos];
+
+    // files written before the codec was introduced hold an undefined
+    // padding byte here. They are uncompressed and their hash does not
+    // cover the codec, thus treat them as FTI_CODEC_NONE.
+    if ( meta->codec != FTI_CODEC_NONE ) {
+        unsigned char hash[MD5_DIGEST_LENGTH];
+        FTIFF_GetHashMetaInfo( hash, meta );
+        if ( memcmp( hash, meta->myHash, MD5_DIGEST_LENGTH ) != 0 ) {
+            meta->codec = FTI_CODEC_NONE;
+        }
+    }
 
     return FTI_SCES;
 
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    reads FTI-FF file meta data at the current file position   
+  @param    fd            file descriptor.
+  @param    meta          FTI-FF file meta data.
+ **/
+/*-------------------------------------------------------------------------*/
+int FTIFF_ReadFileMeta( int fd, FTIFF_metaInfo* meta )
+{
+    
+    char* buffer_ser = (char*) malloc ( FTI_filemetastructsize );
+    if ( buffer_ser == NULL ) {
+        return FTI_NSCS;
+    }
+
+    int res = FTI_NSCS;
+    if ( read( fd, buffer_ser, FTI_filemetastructsize ) == FTI_filemetastructsize ) {
+        res = FTIFF_DeserializeFileMeta( meta, buffer_ser );
+    }
+    free( buffer_ser );
+
+    return res;
+
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    deserializes FTI-FF file data block meta data   
@@ -3080,6 +4006,7 @@ int FTIFF_DeserializeDbVarMeta( FTIFF_dbvar* dbvar, char* buffer_ser )
     memcpy( &(dbvar->containersize)   , buffer_ser + pos, sizeof(long));
     pos += sizeof(long);
     memcpy( dbvar->hash               , buffer_ser + pos, MD5_DIGEST_LENGTH);
+    dbvar->owner = -1;
 
     return FTI_SCES;
 
@@ -3114,6 +4041,9 @@ int FTIFF_SerializeFileMeta( FTIFF_metaInfo* meta, char* buffer_ser )
     memcpy( buffer_ser + pos, &(meta->ptFs)         , sizeof(long) );
     pos += sizeof(long);
     memcpy( buffer_ser + pos, &(meta->timestamp)    , sizeof(long) );
+    pos += sizeof(long);
+    // the codec occupies the padding byte of the original layout
+    buffer_ser[pos] = (char) meta->codec;
 
     return FTI_SCES;
 }
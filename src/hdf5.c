@@ -230,6 +230,12 @@ int FTI_RecoverHDF5(FTIT_execution* FTI_Exec, FTIT_checkpoint* FTI_Ckpt,
 int FTI_RecoverVarHDF5(FTIT_execution* FTI_Exec, FTIT_checkpoint* FTI_Ckpt,
                        FTIT_dataset* FTI_Data, int id)
 {
+    int idx = FTI_GetDataIdx(FTI_Exec, id);
+    if (idx == -1) {
+        FTI_Print("Variables must be protected before they can be recovered.", FTI_EROR);
+        return FTI_NREC;
+    }
+
     char str[FTI_BUFS], fn[FTI_BUFS];
     snprintf(fn, FTI_BUFS, "%s/%s", FTI_Ckpt[FTI_Exec->ckptLvel].dir, FTI_Exec->meta[FTI_Exec->ckptLvel].ckptFile);
 
@@ -249,19 +255,13 @@ int FTI_RecoverVarHDF5(FTIT_execution* FTI_Exec, FTIT_checkpoint* FTI_Ckpt,
         FTI_OpenGroup(FTI_Exec->H5groups[rootGroup->childrenID[i]], file_id, FTI_Exec->H5groups);
     }
 
-    for (i = 0; i < FTI_Exec->nbVar; i++) {
-        if (FTI_Data[i].id == id) {
-            break;
-        }
-    }
-
-    hid_t h5Type = FTI_Data[i].type->h5datatype;
-    if (FTI_Data[i].type->id > 10 && FTI_Data[i].type->structure == NULL) {
+    hid_t h5Type = FTI_Data[idx].type->h5datatype;
+    if (FTI_Data[idx].type->id > 10 && FTI_Data[idx].type->structure == NULL) {
         //if used FTI_InitType() save as binary
         h5Type = H5Tcopy(H5T_NATIVE_CHAR);
-        H5Tset_size(h5Type, FTI_Data[i].size);
+        H5Tset_size(h5Type, FTI_Data[idx].size);
     }
-    herr_t res = H5LTread_dataset(FTI_Data[i].h5group->h5groupID, FTI_Data[i].name, h5Type, FTI_Data[i].ptr);
+    herr_t res = H5LTread_dataset(FTI_Data[idx].h5group->h5groupID, FTI_Data[idx].name, h5Type, FTI_Data[idx].ptr);
     if (res < 0) {
         FTI_Print("Could not read FTI checkpoint file.", FTI_EROR);
         int j;
@@ -171,10 +171,9 @@ int FTI_InitMpiICP(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   FTI_Print("I/O mode: MPI-IO.", FTI_DBUG);
   char str[FTI_BUFS], mpi_err[FTI_BUFS];
 
-  // enable collective buffer optimization
+  // set MPI-IO hints ([MPIIO] section and calibration)
   MPI_Info info;
-  MPI_Info_create(&info);
-  MPI_Info_set(info, "romio_cb_write", "enable");
+  FTI_CreateMpiioInfo(FTI_Conf, &info, FTI_MPIIO_WRITE);
 
   /* 
    * update ckpt file name (neccessary for the restart!)
@@ -183,18 +182,17 @@ int FTI_InitMpiICP(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   snprintf(FTI_Exec->meta[0].ckptFile, FTI_BUFS,
       "Ckpt%d-Rank%d.fti", FTI_Exec->ckptID, FTI_Topo->myRank);
 
-  // TODO enable to set stripping unit in the config file (Maybe also other hints)
-  // set stripping unit to 4MB
-  MPI_Info_set(info, "stripping_unit", "4194304");
-
   char gfn[FTI_BUFS], ckptFile[FTI_BUFS];
-  snprintf(ckptFile, FTI_BUFS, "Ckpt%d-mpiio.fti", FTI_Exec->ckptID);
+  FTI_MpiioFileName(FTI_Conf, FTI_Exec, FTI_Topo, ckptFile);
   snprintf(gfn, FTI_BUFS, "%s/%s", FTI_Conf->gTmpDir, ckptFile);
   // open parallel file (collective call)
   MPI_File pfh;
+  MPI_Comm fileComm = FTI_MpiioComm(FTI_Conf, FTI_Exec, FTI_Topo);
+  int fileRank;
+  MPI_Comm_rank(fileComm, &fileRank);
 
 #ifdef LUSTRE
-  if (FTI_Topo->splitRank == 0) {
+  if (fileRank == 0) {
     res = llapi_file_create(gfn, FTI_Conf->stripeUnit, FTI_Conf->stripeOffset, FTI_Conf->stripeFactor, 0);
     if (res) {
       char error_msg[FTI_BUFS];
@@ -209,7 +207,7 @@ int FTI_InitMpiICP(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     }
   }
 #endif
-  res = MPI_File_open(FTI_COMM_WORLD, gfn, MPI_MODE_WRONLY|MPI_MODE_CREATE, info, &pfh);
+  res = MPI_File_open(fileComm, gfn, MPI_MODE_WRONLY|MPI_MODE_CREATE, info, &pfh);
 
   // check if successful
   if (res != 0) {
@@ -223,17 +221,13 @@ int FTI_InitMpiICP(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 
   MPI_Offset chunkSize = FTI_Exec->ckptSize;
 
-  // collect chunksizes of other ranks
-  MPI_Offset* chunkSizes = talloc(MPI_Offset, FTI_Topo->nbApprocs * FTI_Topo->nbNodes);
-  MPI_Allgather(&chunkSize, 1, MPI_OFFSET, chunkSizes, 1, MPI_OFFSET, FTI_COMM_WORLD);
-
-  // set file offset
+  // set file offset (collect chunksizes of other ranks)
   MPI_Offset offset = 0;
-  int i;
-  for (i = 0; i < FTI_Topo->splitRank; i++) {
-    offset += chunkSizes[i];
+  if (FTI_MpiioOffsets(FTI_Conf, FTI_Exec, FTI_Topo, pfh, &chunkSize, 1, &offset) != FTI_SCES) {
+    MPI_File_close(&pfh);
+    MPI_Info_free(&info);
+    return FTI_NSCS;
   }
-  free(chunkSizes);
 
   FTI_Exec->iCPInfo.offset = offset;
 
@@ -348,8 +342,12 @@ int FTI_InitFtiffICP(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
     FTIT_dataset* FTI_Data)
 {
+  FTIFF_CompactDatastructFTIFF( FTI_Exec, FTI_Data, FTI_Conf );
   FTIFF_UpdateDatastructFTIFF( FTI_Exec, FTI_Data, FTI_Conf );
 
+  // iCP writes the variables separately, thus the data is not compressed.
+  FTI_Exec->FTIFFMeta.codec = FTI_CODEC_NONE;
+
   //FOR DEVELOPING 
   //FTIFF_PrintDataStructure( 0, FTI_Exec, FTI_Data );
 
@@ -554,6 +552,12 @@ int FTI_InitFtiffICP(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   // has to be assigned before FTIFF_CreateMetaData call!
   FTI_Exec->ckptSize = endoffile;
 
+  // append the variable index after the last datablock
+  if ( FTIFF_WriteIdx( FTI_Exec, FTI_Data, fd ) != FTI_SCES ) {
+    close(fd);
+    return FTI_NSCS;
+  }
+
   if ( FTI_Try( FTIFF_CreateMetadata( FTI_Exec, FTI_Topo, FTI_Data, FTI_Conf ), "Create FTI-FF meta data" ) != FTI_SCES ) {
     return FTI_NSCS;
   }
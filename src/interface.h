@@ -82,6 +82,7 @@
 #include <inttypes.h>
 #include <dirent.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 #include <libgen.h>
@@ -110,6 +111,8 @@ int FTI_DoubleBitFlip(double *target, int bit);
 void FTI_Print(char *msg, int priority);
 
 int FTI_UpdateIterTime(FTIT_execution* FTI_Exec);
+int FTI_AutotuneIntv(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_checkpoint* FTI_Ckpt, int level, double cost);
 int FTI_WriteCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
         FTIT_dataset* FTI_Data);
@@ -126,12 +129,71 @@ int FTI_WritePosix(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_dataset* FTI_Data);
 int FTI_PostCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt);
+int FTI_WaitPostCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, double* postTime);
 int FTI_Listen(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt);
 int FTI_HandleCkptRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
-        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt);
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, int* tokens);
 int FTI_HandleStageRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
-        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, int source);
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, void* buf_ser, int source);
+
+int FTI_GetMpiioHint(FTIT_configuration* FTI_Conf, const char* key);
+int FTI_SetMpiioHint(FTIT_configuration* FTI_Conf, const char* key,
+        const char* val, int overwrite);
+int FTI_CreateMpiioInfo(FTIT_configuration* FTI_Conf, MPI_Info* info, int mode);
+int FTI_LoadMpiioCalibration(FTIT_configuration* FTI_Conf);
+int FTI_CalibrateMpiio(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo);
+int FTI_CreateMpiioDatatype(FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data,
+        MPI_Datatype* type);
+int FTI_MpiioWriteAll(FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data,
+        MPI_File pfh, MPI_Offset offset, MPI_Info info);
+MPI_Comm FTI_MpiioComm(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo);
+void FTI_MpiioFileName(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, char* ckptFile);
+int FTI_MpiioOffsets(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, MPI_File pfh, MPI_Offset* sizes, int nbChunks,
+        MPI_Offset* offsets);
+int FTI_MpiioLocateChunk(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, MPI_File pfh, MPI_Offset size, MPI_Offset* offset);
+
+int FTI_InitShm(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo);
+void FTI_FinalizeShm(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo);
+int FTI_ShmWriteCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_checkpoint* FTI_Ckpt, FTIT_dataset* FTI_Data);
+char* FTI_ShmCkptData(const char* ckptFile, long fs);
+int FTI_ShmWriteFile(int fd, const char* buf, long size);
+int FTI_ShmFlushLocal(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo);
+
+/** Post-processing of one application process by the head.                */
+typedef int (*FTIT_procFunc)(int proc, void* arg);
+int FTI_InitHeadThreads(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo);
+int FTI_InitAppThreads(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec);
+void FTI_ShrinkAppThreads(FTIT_configuration* FTI_Conf);
+void FTI_FinalizeWorkerThreads(void);
+int FTI_ForEachProc(int startProc, int endProc, FTIT_procFunc func, void* arg,
+        int useMpi);
+int FTI_GetThreadCount(void);
+int FTI_CodecAvailable(int codec);
+long FTI_WriteCompressed(FTIT_configuration* FTI_Conf, int codec, FTIT_dataset* data, char* raw,
+        long size, int fd, long offset, MD5_CTX* mdContext, unsigned char* hash);
+int FTI_ReadCompressed(int codec, int fd, long offset, long csize, char* raw, long size);
+int FTI_DedupChunks(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_dataset* FTI_Data, int active);
+int FTI_LazyBegin(char* map, long fs);
+void FTI_LazyAdd(char* dst, char* src, long size);
+int FTI_LazyStart(void);
+void FTI_LazyWait(void);
+
+int FTI_InitPostThread(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec);
+void FTI_FinalizePostThread(FTIT_execution* FTI_Exec);
+int FTI_StartPostThread(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt);
+int FTI_JoinPostThread(double* time);
 
 int FTI_UpdateConf(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         int restart);
@@ -162,7 +224,7 @@ int FTI_GetChecksums(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         char* checksum, char* ptnerChecksum, char* rsChecksum);
 int FTI_WriteRSedChecksum(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
-        int rank, char* checksum);
+        int proc, int rank, char* checksum);
 int FTI_LoadTmpMeta(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt);
 int FTI_LoadMeta(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
@@ -220,6 +282,11 @@ int FTI_CheckErasures(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         int *erased);
 int FTI_RecoverFiles(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt);
+int FTI_ReadPieces(int fd, FTIT_readPiece* pieces, int nbPieces, MD5_CTX* digests, int nbDigests);
+int FTI_HashFile(int fd, long size, MD5_CTX* mdContext);
+int FTI_LoadCkptFile(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
+        FTIT_dataset* FTI_Data, char* fn, int varIdx);
 
 int FTI_Checksum(FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data,
       FTIT_configuration* FTI_Conf, char* checksum);
@@ -227,6 +294,11 @@ int FTI_VerifyChecksum(char* fileName, char* checksumToCmp);
 int FTI_Try(int result, char* message);
 void FTI_MallocMeta(FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo);
 void FTI_FreeMeta(FTIT_execution* FTI_Exec);
+int FTI_ReserveMetaVar(FTIT_metadata* meta, int nbVar);
+int FTI_GetMetaVarIdx(FTIT_metadata* meta, int id, int hint);
+int FTI_HashDataID(int id, int size);
+int FTI_GetDataIdx(FTIT_execution* FTI_Exec, int id);
+int FTI_AddDataIdx(FTIT_execution* FTI_Exec, int id, int idx);
 void FTI_FreeTypesAndGroups(FTIT_execution* FTI_Exec);
 #ifdef ENABLE_HDF5
 void FTI_CreateComplexType(FTIT_type* ftiType, FTIT_type** FTI_Type);
@@ -236,17 +308,22 @@ void FTI_OpenGroup(FTIT_H5Group* ftiGroup, hid_t parentGroup, FTIT_H5Group** FTI
 void FTI_CloseGroup(FTIT_H5Group* ftiGroup, FTIT_H5Group** FTI_Group);
 #endif
 int FTI_InitGroupsAndTypes(FTIT_execution* FTI_Exec);
-int FTI_InitBasicTypes(FTIT_dataset* FTI_Data);
+int FTI_InitBasicTypes();
 int FTI_InitExecVars(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
         FTIT_injection* FTI_Inje);
 int FTI_RmDir(char path[FTI_BUFS], int flag);
+int FTI_CopyFile(int fd_src, int fd_dst, off_t size, size_t bs);
+int FTI_CopyFileRange(int fd_src, int fd_dst, off_t offset, off_t count, size_t bs);
+void FTI_InitThrottle(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo);
+void FTI_Throttle(size_t bytes);
+int FTI_CopyFileThrottled(int fd_src, int fd_dst, off_t size, size_t bs);
 int FTI_Clean(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo,
         FTIT_checkpoint* FTI_Ckpt, int level);
 
 int FTI_SaveTopo(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo, char *nameList);
-int FTI_ReorderNodes(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo,
-        int *nodeList, char *nameList);
+int FTI_ReorderNodes(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, int *nodeList, char *nameList);
 int FTI_BuildNodeList(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, int *nodeList, char *nameList);
 int FTI_CreateComms(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
@@ -0,0 +1,406 @@
+/**
+ *  Copyright (c) 2017 Leonardo A. Bautista-Gomez
+ *  All rights reserved
+ *
+ *  FTI - A multi-level checkpointing library for C/C++/Fortran applications
+ *
+ *  Revision 1.0 : Fault Tolerance Interface (FTI)
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *  @file   lazy.c
+ *  @date   October, 2018
+ *  @brief  Lazy recovery of the protected data with userfaultfd.
+ */
+
+#include "interface.h"
+#include <pthread.h>
+
+#ifdef FTI_UFFD
+#include <linux/userfaultfd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#endif
+
+/** Pages restored at once, on a fault or by the prefetch.                  */
+#define FTI_LAZY_PAGES 16
+
+/** @typedef    FTIT_lazyRegion
+ *  @brief      Page-aligned part of a protected buffer restored lazily.
+ */
+typedef struct FTIT_lazyRegion {
+    char*           dst;                /**< First page in the buffer.      */
+    char*           src;                /**< Data in the mapped file.       */
+    long            size;               /**< Size, multiple of the page.    */
+} FTIT_lazyRegion;
+
+static int uffd = -1;                   /**< Userfaultfd of the regions.    */
+static char* lazyMap = NULL;            /**< Mapping of the ckpt. file.     */
+static long lazyMapSize = 0;            /**< Size of the mapping.           */
+static FTIT_lazyRegion* regions = NULL; /**< Regions registered.            */
+static int nbRegions = 0;               /**< Number of regions.             */
+static int maxRegions = 0;              /**< Regions allocated.             */
+static long pageSize = 0;               /**< System page size.              */
+static pthread_t lazyThread;            /**< Restoring thread.              */
+static int lazyThreadActive = 0;        /**< 1 if lazyThread must be joined */
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Releases the mapping and the userfaultfd of a lazy recovery.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_LazyRelease(void)
+{
+    if (uffd != -1) {
+        close(uffd);
+        uffd = -1;
+    }
+    if (lazyMap != NULL && munmap(lazyMap, lazyMapSize) == -1) {
+        FTI_Print("Could not unmap FTI checkpoint file.", FTI_EROR);
+        errno = 0;
+    }
+    lazyMap = NULL;
+    lazyMapSize = 0;
+    free(regions);
+    regions = NULL;
+    nbRegions = 0;
+    maxRegions = 0;
+}
+
+#ifdef FTI_UFFD
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Fills missing pages of a region with the checkpoint data.
+  @param      dst             First page to fill.
+  @param      src             Data of the first page in the file.
+  @param      len             Size to fill, multiple of the page.
+  @return     integer         FTI_SCES if successful.
+
+  Pages already present (restored on a fault before the prefetch, or
+  the other way around) are skipped. UFFDIO_COPY wakes the threads
+  waiting on the pages it fills.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_LazyFill(char* dst, char* src, long len)
+{
+    while (len > 0) {
+        struct uffdio_copy copy;
+        copy.dst = (uintptr_t) dst;
+        copy.src = (uintptr_t) src;
+        copy.len = len;
+        copy.mode = 0;
+        if (ioctl(uffd, UFFDIO_COPY, &copy) == 0) {
+            return FTI_SCES;
+        }
+        long done = (copy.copy > 0) ? copy.copy : 0;
+        if (errno == EEXIST) {
+            done += pageSize;
+        }
+        else if (errno != EAGAIN) {
+            return FTI_NSCS;
+        }
+        dst += done;
+        src += done;
+        len -= done;
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Checks that the pages of a range were dropped.
+  @param      addr            First page of the range.
+  @param      len             Size of the range, multiple of the page.
+  @return     integer         1 if no page of the range is resident.
+
+  MADV_DONTNEED does not drop the pages of shared anonymous memory
+  (e.g. MPI_Win_allocate_shared). These pages never fault and UFFDIO_COPY
+  fails on them with EEXIST, they must be copied at once.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_LazyDropped(char* addr, long len)
+{
+    long nbPages = len / pageSize, i;
+    unsigned char* vec = (unsigned char*) malloc(nbPages);
+    if (vec == NULL) {
+        return 0;
+    }
+    int dropped = (mincore(addr, len, vec) == 0);
+    for (i = 0; i < nbPages && dropped; i++) {
+        dropped = !(vec[i] & 1);
+    }
+    free(vec);
+    return dropped;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Restores the block of pages containing a faulting address.
+  @param      addr            Address of the page fault.
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_LazyFault(char* addr)
+{
+    long block = FTI_LAZY_PAGES * pageSize;
+    int i;
+    for (i = 0; i < nbRegions; i++) {
+        FTIT_lazyRegion* reg = &regions[i];
+        if (addr >= reg->dst && addr < reg->dst + reg->size) {
+            long pos = ((addr - reg->dst) / block) * block;
+            long len = (reg->size - pos < block) ? reg->size - pos : block;
+            if (FTI_LazyFill(reg->dst + pos, reg->src + pos, len) != FTI_SCES) {
+                // do not leave the faulting thread blocked
+                struct uffdio_range range;
+                range.start = (uintptr_t) reg->dst;
+                range.len = reg->size;
+                ioctl(uffd, UFFDIO_UNREGISTER, &range);
+                return FTI_NSCS;
+            }
+            return FTI_SCES;
+        }
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Main function of the restoring thread.
+
+  Prefetches the regions in file order, one block of FTI_LAZY_PAGES
+  pages at a time, and restores the blocks touched by the application
+  in between. Once every page is present, the regions are unregistered
+  and the mapping of the file is released.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void* FTI_LazyThread(void* unused)
+{
+    char str[FTI_BUFS];
+    long block = FTI_LAZY_PAGES * pageSize;
+    long faults = 0, pos = 0;
+    int r = 0, res = FTI_SCES;
+    struct pollfd pfd;
+    pfd.fd = uffd;
+    pfd.events = POLLIN;
+
+    while (r < nbRegions) {
+        if (poll(&pfd, 1, 0) > 0) {
+            struct uffd_msg msg;
+            while (read(uffd, &msg, sizeof(msg)) == sizeof(msg)) {
+                if (msg.event == UFFD_EVENT_PAGEFAULT) {
+                    if (FTI_LazyFault((char*) (uintptr_t) msg.arg.pagefault.address) != FTI_SCES) {
+                        res = FTI_NSCS;
+                    }
+                    faults++;
+                }
+            }
+            continue;
+        }
+        FTIT_lazyRegion* reg = &regions[r];
+        long len = (reg->size - pos < block) ? reg->size - pos : block;
+        if (FTI_LazyFill(reg->dst + pos, reg->src + pos, len) != FTI_SCES) {
+            // the buffer was unmapped or the region was dropped on a fault
+            len = reg->size - pos;
+        }
+        pos += len;
+        if (pos == reg->size) {
+            struct uffdio_range range;
+            range.start = (uintptr_t) reg->dst;
+            range.len = reg->size;
+            ioctl(uffd, UFFDIO_UNREGISTER, &range);
+            pos = 0;
+            r++;
+        }
+    }
+
+    if (res != FTI_SCES) {
+        FTI_Print("Lazy recovery could not restore all the protected data.", FTI_EROR);
+    }
+    snprintf(str, FTI_BUFS, "Lazy recovery done, %ld blocks restored on page faults.", faults);
+    FTI_Print(str, FTI_DBUG);
+    FTI_LazyRelease();
+    return NULL;
+}
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Starts a lazy recovery from a mapped checkpoint file.
+  @param      map             Mapping of the checkpoint file.
+  @param      fs              Size of the mapping.
+  @return     integer         FTI_SCES if successful.
+
+  On success, the mapping belongs to the lazy recovery and is released
+  by the restoring thread. FTI_NSCS if userfaultfd is not available, the
+  caller then loads the data itself. A previous lazy recovery is
+  completed first.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_LazyBegin(char* map, long fs)
+{
+    FTI_LazyWait();
+#ifdef FTI_UFFD
+    uffd = syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+    if (uffd == -1) {
+        FTI_Print("Userfaultfd not available, the data is recovered eagerly.", FTI_WARN);
+        errno = 0;
+        return FTI_NSCS;
+    }
+    struct uffdio_api api;
+    api.api = UFFD_API;
+    api.features = 0;
+    if (ioctl(uffd, UFFDIO_API, &api) == -1) {
+        FTI_Print("Userfaultfd API not supported, the data is recovered eagerly.", FTI_WARN);
+        close(uffd);
+        uffd = -1;
+        errno = 0;
+        return FTI_NSCS;
+    }
+    pageSize = sysconf(_SC_PAGESIZE);
+    lazyMap = map;
+    lazyMapSize = fs;
+    return FTI_SCES;
+#else
+    FTI_Print("FTI built without userfaultfd, the data is recovered eagerly.", FTI_WARN);
+    return FTI_NSCS;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Restores lazily a buffer from the checkpoint file.
+  @param      dst             Buffer of the protected data.
+  @param      src             Data in the mapped checkpoint file.
+  @param      size            Size of the data.
+
+  The partial pages at both ends of the buffer, and buffers smaller
+  than a block, are copied at once. The whole pages in between are
+  registered to the userfaultfd and discarded, so that the first access
+  to each of them waits for the restoring thread. Memory that cannot be
+  registered (not anonymous), or whose pages stay resident after being
+  discarded (shared anonymous memory), is copied at once as well.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_LazyAdd(char* dst, char* src, long size)
+{
+#ifdef FTI_UFFD
+    char* first = (char*) (((uintptr_t) dst + pageSize - 1) & ~((uintptr_t) pageSize - 1));
+    char* last = (char*) (((uintptr_t) dst + size) & ~((uintptr_t) pageSize - 1));
+    if (last - first >= FTI_LAZY_PAGES * pageSize) {
+        struct uffdio_register reg;
+        reg.range.start = (uintptr_t) first;
+        reg.range.len = last - first;
+        reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+        if (nbRegions == maxRegions) {
+            int newMax = (maxRegions == 0) ? 16 : 2 * maxRegions;
+            FTIT_lazyRegion* newRegions = (FTIT_lazyRegion*) realloc(regions, sizeof(FTIT_lazyRegion) * newMax);
+            if (newRegions != NULL) {
+                regions = newRegions;
+                maxRegions = newMax;
+            }
+        }
+        if (nbRegions < maxRegions && ioctl(uffd, UFFDIO_REGISTER, &reg) == 0) {
+            if (madvise(first, last - first, MADV_DONTNEED) == 0 && FTI_LazyDropped(first, last - first)) {
+                memcpy(dst, src, first - dst);
+                memcpy(last, src + (last - dst), (dst + size) - last);
+                regions[nbRegions].dst = first;
+                regions[nbRegions].src = src + (first - dst);
+                regions[nbRegions].size = last - first;
+                nbRegions++;
+                return;
+            }
+            ioctl(uffd, UFFDIO_UNREGISTER, &reg.range);
+        }
+        errno = 0;
+    }
+#endif
+    memcpy(dst, src, size);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Starts the thread restoring the registered buffers.
+  @return     integer         FTI_SCES if successful.
+
+  Without registered buffers, or if the thread cannot be created, the
+  remaining data is restored at once.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_LazyStart(void)
+{
+    char str[FTI_BUFS];
+#ifdef FTI_UFFD
+    if (nbRegions > 0) {
+        long size = 0;
+        int i;
+        for (i = 0; i < nbRegions; i++) {
+            size += regions[i].size;
+        }
+        if (pthread_create(&lazyThread, NULL, FTI_LazyThread, NULL) == 0) {
+            lazyThreadActive = 1;
+            snprintf(str, FTI_BUFS, "Lazy recovery of %ld bytes in %d buffers started.", size, nbRegions);
+            FTI_Print(str, FTI_DBUG);
+            return FTI_SCES;
+        }
+        FTI_Print("Could not create the lazy recovery thread, the data is recovered eagerly.", FTI_WARN);
+        for (i = 0; i < nbRegions; i++) {
+            if (FTI_LazyFill(regions[i].dst, regions[i].src, regions[i].size) != FTI_SCES) {
+                snprintf(str, FTI_BUFS, "Could not restore %ld bytes of protected data.", regions[i].size);
+                FTI_Print(str, FTI_EROR);
+                FTI_LazyRelease();
+                return FTI_NREC;
+            }
+        }
+    }
+#endif
+    FTI_LazyRelease();
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Waits for the end of the current lazy recovery.
+
+  Called before a checkpoint and at finalization, so that the protected
+  data is entirely present when FTI reads it.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_LazyWait(void)
+{
+    if (lazyThreadActive) {
+        pthread_join(lazyThread, NULL);
+        lazyThreadActive = 0;
+    }
+}
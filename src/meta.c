@@ -38,6 +38,315 @@
 
 #include "interface.h"
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It returns the slot of a process in the binary metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      proc            Process in the node (only used by heads).
+  @return     integer         Slot of the process.
+
+  The slot is the position of the process in the node list. It does not
+  change at restart, since the nodes are reordered following the previous
+  topology.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_MetaSlot(FTIT_topology* FTI_Topo, int proc)
+{
+    int posInNode = (FTI_Topo->amIaHead) ? proc : FTI_Topo->groupID;
+    return FTI_Topo->nodeID * FTI_Topo->nodeSize + posInNode;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It returns the size of a record in the binary metadata.
+  @param      nbVar           Number of protected variables.
+  @return     integer         Size of the record, padded to 8 bytes.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_MetaRecordSize(int nbVar)
+{
+    int size = sizeof(FTIT_metaRecord) + nbVar * (sizeof(int64_t) + sizeof(int32_t));
+    return (size + 7) & ~7;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It maps the binary metadata file of a directory.
+  @param      dir             Metadata directory.
+  @param      len             Pointer to fill the size of the mapping.
+  @return     void*           The mapping, NULL if there is no valid file.
+
+  The mapping is read-only and must be released with munmap.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void* FTI_MapMeta(char* dir, size_t* len)
+{
+    char fn[FTI_BUFS], str[FTI_BUFS];
+    snprintf(fn, FTI_BUFS, "%s/%s", dir, FTI_META_FILE);
+    snprintf(str, FTI_BUFS, "Getting FTI metadata file (%s)...", fn);
+    FTI_Print(str, FTI_DBUG);
+
+    int fd = open(fn, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < sizeof(FTIT_metaHeader)) {
+        snprintf(str, FTI_BUFS, "Metadata file (%s) is truncated.", fn);
+        FTI_Print(str, FTI_WARN);
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        snprintf(str, FTI_BUFS, "Metadata file (%s) could NOT be mapped.", fn);
+        FTI_Print(str, FTI_WARN);
+        return NULL;
+    }
+
+    FTIT_metaHeader* header = (FTIT_metaHeader*) map;
+    if (memcmp(header->magic, FTI_META_MAGIC, sizeof(header->magic)) != 0
+            || header->version != FTI_META_VERSION || header->nbSlots < 0
+            || st.st_size < sizeof(FTIT_metaHeader) + header->nbSlots * sizeof(int64_t)) {
+        snprintf(str, FTI_BUFS, "Invalid metadata file (%s).", fn);
+        FTI_Print(str, FTI_WARN);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    *len = st.st_size;
+    return map;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It gets the record of a process from the binary metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      map             Mapping of the metadata file.
+  @param      len             Size of the mapping.
+  @param      slot            Slot of the process.
+  @return     FTIT_metaRecord* The record, NULL if it does not exist.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static FTIT_metaRecord* FTI_GetMetaRecord(FTIT_topology* FTI_Topo, void* map, size_t len, int slot)
+{
+    FTIT_metaHeader* header = (FTIT_metaHeader*) map;
+    if (header->nodeSize != FTI_Topo->nodeSize || header->groupSize != FTI_Topo->groupSize) {
+        FTI_Print("Metadata file does not match the topology.", FTI_WARN);
+        return NULL;
+    }
+    if (slot < 0 || slot >= header->nbSlots) {
+        return NULL;
+    }
+    int64_t offset = ((int64_t*) (header + 1))[slot];
+    if (offset <= 0 || offset + sizeof(FTIT_metaRecord) > len) {
+        return NULL;
+    }
+    FTIT_metaRecord* rec = (FTIT_metaRecord*) ((char*) map + offset);
+    if (rec->nbVar < 0 || offset + FTI_MetaRecordSize(rec->nbVar) > len) {
+        FTI_Print("Invalid record in metadata file.", FTI_WARN);
+        return NULL;
+    }
+    return rec;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It copies a record of the binary metadata to the execution.
+  @param      FTI_Exec        Execution metadata.
+  @param      level           Checkpoint level of the metadata.
+  @param      proc            Process in the node (0 for app. processes).
+  @param      rec             Record of the process.
+  @return     void
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_CopyMetaRecord(FTIT_execution* FTI_Exec, int level, int proc,
+        FTIT_metaRecord* rec)
+{
+    FTIT_metadata* meta = &FTI_Exec->meta[level];
+    meta->exists[proc] = 1;
+    snprintf(&meta->ckptFile[proc * FTI_BUFS], FTI_BUFS, "%s", rec->ckptFile);
+    meta->fs[proc] = rec->fs;
+    meta->pfs[proc] = rec->pfs;
+    meta->maxFs[proc] = rec->maxFs;
+
+    int64_t* varSize = (int64_t*) (rec + 1);
+    int32_t* varID = (int32_t*) (varSize + rec->nbVar);
+    if (FTI_ReserveMetaVar(meta, rec->nbVar) != FTI_SCES) {
+        meta->nbVar[proc] = 0;
+        return;
+    }
+    int k;
+    for (k = 0; k < rec->nbVar; k++) {
+        meta->varID[proc * meta->varMax + k] = varID[k];
+        meta->varSize[proc * meta->varMax + k] = varSize[k];
+    }
+    meta->nbVar[proc] = rec->nbVar;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It writes the gathered records to the binary metadata file.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      nbProcs         Number of application processes.
+  @param      slots           Slots of the processes.
+  @param      displs          Offsets of the records in the buffer.
+  @param      recs            Records of all processes.
+  @param      size            Size of the records.
+  @return     integer         FTI_SCES if successful.
+
+  This function is executed only by the rank 0 of FTI_COMM_WORLD.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_StoreMetaBin(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, int nbProcs, int* slots, int* displs,
+        char* recs, long size)
+{
+    char str[FTI_BUFS], fn[FTI_BUFS];
+    int nbSlots = FTI_Topo->nbNodes * FTI_Topo->nodeSize;
+    int64_t* offsets = calloc(nbSlots, sizeof(int64_t));
+    int64_t base = sizeof(FTIT_metaHeader) + nbSlots * sizeof(int64_t);
+    int i;
+    for (i = 0; i < nbProcs; i++) {
+        if (slots[i] < 0 || slots[i] >= nbSlots) {
+            FTI_Print("Invalid slot in the metadata records.", FTI_WARN);
+            free(offsets);
+            return FTI_NSCS;
+        }
+        offsets[slots[i]] = base + displs[i];
+    }
+
+    FTIT_metaHeader header;
+    memset(&header, 0x0, sizeof(FTIT_metaHeader));
+    memcpy(header.magic, FTI_META_MAGIC, sizeof(header.magic));
+    header.version = FTI_META_VERSION;
+    header.nbSlots = nbSlots;
+    header.nodeSize = FTI_Topo->nodeSize;
+    header.groupSize = FTI_Topo->groupSize;
+    header.ckptID = FTI_Exec->ckptID;
+    header.ckptLvel = FTI_Exec->ckptLvel;
+
+    if (mkdir(FTI_Conf->mTmpDir, 0777) == -1) {
+        if (errno != EEXIST) {
+            FTI_Print("Cannot create directory", FTI_EROR);
+        }
+    }
+
+    snprintf(fn, FTI_BUFS, "%s/%s", FTI_Conf->mTmpDir, FTI_META_FILE);
+    snprintf(str, FTI_BUFS, "Creating metadata file (%s)...", fn);
+    FTI_Print(str, FTI_DBUG);
+
+    FILE* fd = fopen(fn, "wb");
+    if (fd == NULL) {
+        FTI_Print("Metadata file could NOT be opened.", FTI_WARN);
+        free(offsets);
+        return FTI_NSCS;
+    }
+    int res = FTI_SCES;
+    if (fwrite(&header, sizeof(FTIT_metaHeader), 1, fd) != 1
+            || fwrite(offsets, sizeof(int64_t), nbSlots, fd) != nbSlots
+            || fwrite(recs, 1, size, fd) != size) {
+        FTI_Print("Metadata file could NOT be written.", FTI_WARN);
+        res = FTI_NSCS;
+    }
+    free(offsets);
+    if (fclose(fd) != 0) {
+        FTI_Print("Metadata file could NOT be closed.", FTI_WARN);
+        return FTI_NSCS;
+    }
+    return res;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It writes the binary metadata of the checkpoint.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      pfs             Partner file size.
+  @param      mfs             The maximum checkpoint file size in group.
+  @param      checksum        Checksum of the checkpoint file.
+  @param      ptnerChecksum   Checksum of the partner file.
+  @return     integer         FTI_SCES if successful.
+
+  Every process builds its record, the rank 0 of FTI_COMM_WORLD gathers
+  them and writes a single file for the checkpoint. The result is
+  broadcast, so the file exists on return if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_WriteMetaBin(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_dataset* FTI_Data, long pfs, long mfs,
+        char* checksum, char* ptnerChecksum)
+{
+    int nbVar = FTI_Exec->nbVar;
+    int recSize = FTI_MetaRecordSize(nbVar);
+    char* buf = calloc(recSize, 1);
+    FTIT_metaRecord* rec = (FTIT_metaRecord*) buf;
+    strncpy(rec->ckptFile, FTI_Exec->meta[0].ckptFile, FTI_BUFS - 1);
+    snprintf(rec->checksum, MD5_DIGEST_STRING_LENGTH, "%s", checksum);
+    snprintf(rec->ptnerChecksum, MD5_DIGEST_STRING_LENGTH, "%s", ptnerChecksum);
+    rec->fs = FTI_Exec->meta[0].fs[0];
+    rec->pfs = pfs;
+    rec->maxFs = mfs;
+    rec->nbVar = nbVar;
+    int64_t* varSize = (int64_t*) (rec + 1);
+    int32_t* varID = (int32_t*) (varSize + nbVar);
+    int i;
+    for (i = 0; i < nbVar; i++) {
+        varSize[i] = FTI_Data[i].size;
+        varID[i] = FTI_Data[i].id;
+    }
+
+    int rank, nbProcs;
+    MPI_Comm_rank(FTI_COMM_WORLD, &rank);
+    MPI_Comm_size(FTI_COMM_WORLD, &nbProcs);
+    int info[2] = { FTI_MetaSlot(FTI_Topo, 0), recSize };
+    int *allInfo = NULL, *slots = NULL, *counts = NULL, *displs = NULL;
+    char* recs = NULL;
+    if (rank == 0) {
+        allInfo = talloc(int, 2 * nbProcs);
+        slots = talloc(int, nbProcs);
+        counts = talloc(int, nbProcs);
+        displs = talloc(int, nbProcs);
+    }
+    MPI_Gather(info, 2, MPI_INT, allInfo, 2, MPI_INT, 0, FTI_COMM_WORLD);
+
+    long size = 0;
+    if (rank == 0) {
+        for (i = 0; i < nbProcs; i++) {
+            slots[i] = allInfo[2 * i];
+            counts[i] = allInfo[2 * i + 1];
+            displs[i] = size;
+            size += counts[i];
+        }
+        recs = talloc(char, size);
+    }
+    MPI_Gatherv(buf, recSize, MPI_BYTE, recs, counts, displs, MPI_BYTE, 0, FTI_COMM_WORLD);
+    free(buf);
+
+    int res = FTI_SCES;
+    if (rank == 0) {
+        res = FTI_StoreMetaBin(FTI_Conf, FTI_Exec, FTI_Topo, nbProcs, slots, displs, recs, size);
+        free(allInfo);
+        free(slots);
+        free(counts);
+        free(displs);
+        free(recs);
+    }
+    MPI_Bcast(&res, 1, MPI_INT, 0, FTI_COMM_WORLD);
+    return res;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      It gets the checksums from metadata.
@@ -60,44 +369,28 @@ int FTI_GetChecksums(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
         char* checksum, char* ptnerChecksum, char* rsChecksum)
 {
-
-    char mfn[FTI_BUFS]; //Path to the metadata file
-    char str[FTI_BUFS]; //For console output
-    if (FTI_Exec->ckptLvel == 0) {
-        snprintf(mfn, FTI_BUFS, "%s/sector%d-group%d.fti", FTI_Conf->mTmpDir, FTI_Topo->sectorID, FTI_Topo->groupID);
-    }
-    else {
-        snprintf(mfn, FTI_BUFS, "%s/sector%d-group%d.fti", FTI_Ckpt[FTI_Exec->ckptLvel].metaDir, FTI_Topo->sectorID, FTI_Topo->groupID);
-    }
-
-    snprintf(str, FTI_BUFS, "Getting FTI metadata file (%s)...", mfn);
-    FTI_Print(str, FTI_DBUG);
-    if (access(mfn, R_OK) != 0) {
+    char* dir = (FTI_Exec->ckptLvel == 0) ? FTI_Conf->mTmpDir : FTI_Ckpt[FTI_Exec->ckptLvel].metaDir;
+    size_t len;
+    void* map = FTI_MapMeta(dir, &len);
+    if (map == NULL) {
         FTI_Print("FTI metadata file NOT accessible.", FTI_WARN);
         return FTI_NSCS;
     }
-    dictionary* ini = iniparser_load(mfn);
-    if (ini == NULL) {
-        FTI_Print("Iniparser failed to parse the metadata file.", FTI_WARN);
+    FTIT_metaRecord* rec = FTI_GetMetaRecord(FTI_Topo, map, len, FTI_MetaSlot(FTI_Topo, 0));
+    if (rec == NULL) {
+        FTI_Print("Metadata of this process NOT found.", FTI_WARN);
+        munmap(map, len);
         return FTI_NSCS;
     }
 
-    //Get checksum of checkpoint file
-    snprintf(str, FTI_BUFS, "%d:Ckpt_checksum", FTI_Topo->groupRank);
-    char* checksumTemp = iniparser_getstring(ini, str, "");
-    strncpy(checksum, checksumTemp, MD5_DIGEST_STRING_LENGTH);
-
-    //Get checksum of partner checkpoint file
-    snprintf(str, FTI_BUFS, "%d:Ckpt_checksum", (FTI_Topo->groupRank + FTI_Topo->groupSize - 1) % FTI_Topo->groupSize);
-    checksumTemp = iniparser_getstring(ini, str, "");
-    strncpy(ptnerChecksum, checksumTemp, MD5_DIGEST_STRING_LENGTH);
+    strncpy(checksum, rec->checksum, MD5_DIGEST_STRING_LENGTH);
+    strncpy(ptnerChecksum, rec->ptnerChecksum, MD5_DIGEST_STRING_LENGTH);
+    strncpy(rsChecksum, rec->rsChecksum, MD5_DIGEST_STRING_LENGTH);
+    checksum[MD5_DIGEST_STRING_LENGTH - 1] = '\0';
+    ptnerChecksum[MD5_DIGEST_STRING_LENGTH - 1] = '\0';
+    rsChecksum[MD5_DIGEST_STRING_LENGTH - 1] = '\0';
 
-    //Get checksum of Reed-Salomon file
-    snprintf(str, FTI_BUFS, "%d:RSed_checksum", FTI_Topo->groupRank);
-    checksumTemp = iniparser_getstring(ini, str, "");
-    strncpy(rsChecksum, checksumTemp, MD5_DIGEST_STRING_LENGTH);
-
-    iniparser_freedict(ini);
+    munmap(map, len);
 
     return FTI_SCES;
 }
@@ -109,23 +402,47 @@ int FTI_GetChecksums(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   @param      FTI_Exec        Execution metadata.
   @param      FTI_Topo        Topology metadata.
   @param      FTI_Ckpt        Checkpoint metadata.
+  @param      proc            Process in the node (only used by heads).
   @param      rank            global rank of the process
   @param      checksum        Pointer to the checksum.
   @return     integer         FTI_SCES if successful.
 
-  This function should be executed only by one process per group. It
-  writes the RSed checksum to the metadata file.
+  This function writes the RSed checksum to the record of the process in
+  the binary metadata file. If the INI export is enabled, it is collective
+  on the group and the first process of the group rewrites the INI file.
 
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_WriteRSedChecksum(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
-        int rank, char* checksum)
+        int proc, int rank, char* checksum)
 {
     // Fake call for FTI-FF. checksum is done for the datasets.
     if (FTI_Conf->ioMode == FTI_IO_FTIFF) {return FTI_SCES;}
 
     char str[FTI_BUFS], fileName[FTI_BUFS];
+    int res = FTI_SCES;
+
+    snprintf(fileName, FTI_BUFS, "%s/%s", FTI_Conf->mTmpDir, FTI_META_FILE);
+    int mfd = open(fileName, O_RDWR);
+    if (mfd == -1) {
+        FTI_Print("Metadata file could NOT be opened.", FTI_WARN);
+        res = FTI_NSCS;
+    }
+    else {
+        int64_t offset = 0;
+        off_t pos = sizeof(FTIT_metaHeader) + FTI_MetaSlot(FTI_Topo, proc) * sizeof(int64_t);
+        if (pread(mfd, &offset, sizeof(int64_t), pos) != sizeof(int64_t) || offset <= 0
+                || pwrite(mfd, checksum, MD5_DIGEST_STRING_LENGTH,
+                    offset + offsetof(FTIT_metaRecord, rsChecksum)) != MD5_DIGEST_STRING_LENGTH) {
+            FTI_Print("RSed checksum could NOT be written to the metadata file.", FTI_WARN);
+            res = FTI_NSCS;
+        }
+        close(mfd);
+    }
+    if (!FTI_Conf->metaIniExport) {
+        return res;
+    }
 
     //Calcuate which groupID rank belongs
     int sectorID = rank / (FTI_Topo->groupSize * FTI_Topo->nodeSize);
@@ -139,7 +456,7 @@ int FTI_WriteRSedChecksum(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
     //Only first process in group save RS checksum
     if (rankInGroup) {
         free(checksums);
-        return FTI_SCES;
+        return res;
     }
 
     snprintf(fileName, FTI_BUFS, "%s/sector%d-group%d.fti", FTI_Conf->mTmpDir, FTI_Topo->sectorID, groupID);
@@ -184,7 +501,7 @@ int FTI_WriteRSedChecksum(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
 
     iniparser_freedict(ini);
 
-    return FTI_SCES;
+    return res;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -208,65 +525,32 @@ int FTI_LoadTmpMeta(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     // no metadata files for FTI-FF
     if ( FTI_Conf->ioMode == FTI_IO_FTIFF ) { return FTI_SCES; }
     if (FTI_Topo->amIaHead) { //I am a head
+        size_t len;
+        void* map = FTI_MapMeta(FTI_Conf->mTmpDir, &len);
+        if (map == NULL) {
+            FTI_Print("Temporary metadata do not exist.", FTI_WARN);
+            return FTI_NSCS;
+        }
         int j, biggestCkptID = 0; //Need to find biggest CkptID
         for (j = 1; j < FTI_Topo->nodeSize; j++) { //all body processes
-            char metaFileName[FTI_BUFS], str[FTI_BUFS];
-            snprintf(metaFileName, FTI_BUFS, "%s/sector%d-group%d.fti", FTI_Conf->mTmpDir, FTI_Topo->sectorID, j);
-            snprintf(str, FTI_BUFS, "Getting FTI metadata file (%s)...", metaFileName);
-            FTI_Print(str, FTI_DBUG);
-            if (access(metaFileName, R_OK) == 0) {
-                dictionary* ini = iniparser_load(metaFileName);
-                if (ini == NULL) {
-                    FTI_Print("Iniparser failed to parse the metadata file.", FTI_WARN);
-                    return FTI_NSCS;
-                }
-                else {
-                    FTI_Exec->meta[0].exists[j] = 1;
-
-                    snprintf(str, FTI_BUFS, "%d:Ckpt_file_name", FTI_Topo->groupRank);
-                    char* ckptFileName = iniparser_getstring(ini, str, NULL);
-                    snprintf(&FTI_Exec->meta[0].ckptFile[j * FTI_BUFS], FTI_BUFS, "%s", ckptFileName);
-
-                    //update head's ckptID
-                    sscanf(&FTI_Exec->meta[0].ckptFile[j * FTI_BUFS], "Ckpt%d", &FTI_Exec->ckptID);
-                    if (FTI_Exec->ckptID < biggestCkptID) {
-                        FTI_Exec->ckptID = biggestCkptID;
-                    }
-
-                    snprintf(str, FTI_BUFS, "%d:Ckpt_file_size", FTI_Topo->groupRank);
-                    FTI_Exec->meta[0].fs[j] = iniparser_getlint(ini, str, -1);
-
-                    snprintf(str, FTI_BUFS, "%d:Ckpt_file_size", (FTI_Topo->groupRank + FTI_Topo->groupSize - 1) % FTI_Topo->groupSize);
-                    FTI_Exec->meta[0].pfs[j] = iniparser_getlint(ini, str, -1);
-
-                    FTI_Exec->meta[0].maxFs[j] = iniparser_getlint(ini, "0:Ckpt_file_maxs", -1);
-
-                    int k;
-                    for (k = 0; k < FTI_BUFS; k++) {
-                        snprintf(str, FTI_BUFS, "%d:Var%d_id", FTI_Topo->groupRank, k);
-                        int id = iniparser_getint(ini, str, -1);
-                        if (id == -1) {
-                            //No more variables
-                            break;
-                        }
-                        //Variable exists
-                        FTI_Exec->meta[0].varID[j * FTI_BUFS + k] = id;
-
-                        snprintf(str, FTI_BUFS, "%d:Var%d_size", FTI_Topo->groupRank, k);
-                        FTI_Exec->meta[0].varSize[j * FTI_BUFS + k] = iniparser_getlint(ini, str, -1);
-                    }
-                    //Save number of variables in metadata
-                    FTI_Exec->meta[0].nbVar[j] = k;
-
-                    iniparser_freedict(ini);
-                }
-            }
-            else {
+            FTIT_metaRecord* rec = FTI_GetMetaRecord(FTI_Topo, map, len, FTI_MetaSlot(FTI_Topo, j));
+            if (rec == NULL) {
+                char str[FTI_BUFS];
                 snprintf(str, FTI_BUFS, "Temporary metadata do not exist for node process %d.", j);
                 FTI_Print(str, FTI_WARN);
+                munmap(map, len);
                 return FTI_NSCS;
             }
+            FTI_CopyMetaRecord(FTI_Exec, 0, j, rec);
+
+            //update head's ckptID
+            sscanf(&FTI_Exec->meta[0].ckptFile[j * FTI_BUFS], "Ckpt%d", &FTI_Exec->ckptID);
+            if (FTI_Exec->ckptID < biggestCkptID) {
+                FTI_Exec->ckptID = biggestCkptID;
+            }
+            biggestCkptID = FTI_Exec->ckptID;
         }
+        munmap(map, len);
     }
     return FTI_SCES;
 }
@@ -291,127 +575,42 @@ int FTI_LoadMeta(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 {
     // no metadata files for FTI-FF
     if ( FTI_Conf->ioMode == FTI_IO_FTIFF ) { return FTI_SCES; }
-    if (!FTI_Topo->amIaHead) {
-        int i;
-        for (i = 0; i < 5; i++) { //for each level
-            char metaFileName[FTI_BUFS], str[FTI_BUFS];
-            if (i == 0) {
-                snprintf(metaFileName, FTI_BUFS, "%s/sector%d-group%d.fti", FTI_Conf->mTmpDir, FTI_Topo->sectorID, FTI_Topo->groupID);
-            } else {
-                snprintf(metaFileName, FTI_BUFS, "%s/sector%d-group%d.fti", FTI_Ckpt[i].metaDir, FTI_Topo->sectorID, FTI_Topo->groupID);
-            }
-            snprintf(str, FTI_BUFS, "Getting FTI metadata file (%s)...", metaFileName);
-            FTI_Print(str, FTI_DBUG);
-            if (access(metaFileName, R_OK) == 0) {
-                dictionary* ini = iniparser_load(metaFileName);
-                if (ini == NULL) {
-                    FTI_Print("Iniparser failed to parse the metadata file.", FTI_WARN);
-                    return FTI_NSCS;
-                }
-                else {
-                    snprintf(str, FTI_BUFS, "Meta for level %d exists.", i);
-                    FTI_Print(str, FTI_DBUG);
-                    FTI_Exec->meta[i].exists[0] = 1;
-
-                    snprintf(str, FTI_BUFS, "%d:Ckpt_file_name", FTI_Topo->groupRank);
-                    char* ckptFileName = iniparser_getstring(ini, str, NULL);
-                    snprintf(FTI_Exec->meta[i].ckptFile, FTI_BUFS, "%s", ckptFileName);
-
-                    snprintf(str, FTI_BUFS, "%d:Ckpt_file_size", FTI_Topo->groupRank);
-                    FTI_Exec->meta[i].fs[0] = iniparser_getlint(ini, str, -1);
-
-                    snprintf(str, FTI_BUFS, "%d:Ckpt_file_size", (FTI_Topo->groupRank + FTI_Topo->groupSize - 1) % FTI_Topo->groupSize);
-                    FTI_Exec->meta[i].pfs[0] = iniparser_getlint(ini, str, -1);
-
-                    FTI_Exec->meta[i].maxFs[0] = iniparser_getlint(ini, "0:Ckpt_file_maxs", -1);
-
-                    int k;
-                    for (k = 0; k < FTI_BUFS; k++) {
-                        snprintf(str, FTI_BUFS, "%d:Var%d_id", FTI_Topo->groupRank, k);
-                        int id = iniparser_getint(ini, str, -1);
-                        if (id == -1) {
-                            //No more variables
-                            break;
-                        }
-                        //Variable exists
-                        FTI_Exec->meta[i].varID[k] = id;
-
-                        snprintf(str, FTI_BUFS, "%d:Var%d_size", FTI_Topo->groupRank, k);
-                        FTI_Exec->meta[i].varSize[k] = iniparser_getlint(ini, str, -1);
-                    }
-                    //Save number of variables in metadata
-                    FTI_Exec->meta[i].nbVar[0] = k;
-
-                    iniparser_freedict(ini);
-                }
+    int biggestCkptID = 0;
+    int i;
+    for (i = 0; i < 5; i++) { //for each level
+        char* dir = (i == 0) ? FTI_Conf->mTmpDir : FTI_Ckpt[i].metaDir;
+        size_t len;
+        void* map = FTI_MapMeta(dir, &len);
+        if (map == NULL) {
+            continue;
+        }
+        char str[FTI_BUFS];
+        snprintf(str, FTI_BUFS, "Meta for level %d exists.", i);
+        FTI_Print(str, FTI_DBUG);
+        if (!FTI_Topo->amIaHead) {
+            FTIT_metaRecord* rec = FTI_GetMetaRecord(FTI_Topo, map, len, FTI_MetaSlot(FTI_Topo, 0));
+            if (rec != NULL) {
+                FTI_CopyMetaRecord(FTI_Exec, i, 0, rec);
             }
         }
-    }
-    else { //I am a head
-        int biggestCkptID = 0;
-        int i;
-        for (i = 0; i < 5; i++) {        //for each level
+        else { //I am a head
             int j;
             for (j = 1; j < FTI_Topo->nodeSize; j++) { //for all body processes
-                dictionary* ini;
-                char metaFileName[FTI_BUFS], str[FTI_BUFS];
-                if (i == 0) {
-                    snprintf(metaFileName, FTI_BUFS, "%s/sector%d-group%d.fti", FTI_Conf->mTmpDir, FTI_Topo->sectorID, j);
-                } else {
-                    snprintf(metaFileName, FTI_BUFS, "%s/sector%d-group%d.fti", FTI_Ckpt[i].metaDir, FTI_Topo->sectorID, j);
+                FTIT_metaRecord* rec = FTI_GetMetaRecord(FTI_Topo, map, len, FTI_MetaSlot(FTI_Topo, j));
+                if (rec == NULL) {
+                    continue;
                 }
-                snprintf(str, FTI_BUFS, "Getting FTI metadata file (%s)...", metaFileName);
-                FTI_Print(str, FTI_DBUG);
-                if (access(metaFileName, R_OK) == 0) {
-                    ini = iniparser_load(metaFileName);
-                    if (ini == NULL) {
-                        FTI_Print("Iniparser failed to parse the metadata file.", FTI_WARN);
-                        return FTI_NSCS;
-                    }
-                    else {
-                        snprintf(str, FTI_BUFS, "Meta for level %d exists.", i);
-                        FTI_Print(str, FTI_DBUG);
-                        FTI_Exec->meta[i].exists[j] = 1;
-
-                        snprintf(str, FTI_BUFS, "%d:Ckpt_file_name", FTI_Topo->groupRank);
-                        char* ckptFileName = iniparser_getstring(ini, str, NULL);
-                        snprintf(&FTI_Exec->meta[i].ckptFile[j * FTI_BUFS], FTI_BUFS, "%s", ckptFileName);
-
-                        //update heads ckptID
-                        sscanf(&FTI_Exec->meta[i].ckptFile[j * FTI_BUFS], "Ckpt%d", &FTI_Exec->ckptID);
-                        if (FTI_Exec->ckptID < biggestCkptID) {
-                            FTI_Exec->ckptID = biggestCkptID;
-                        }
-
-                        snprintf(str, FTI_BUFS, "%d:Ckpt_file_size", FTI_Topo->groupRank);
-                        FTI_Exec->meta[i].fs[j] = iniparser_getlint(ini, str, -1);
-
-                        snprintf(str, FTI_BUFS, "%d:Ckpt_file_size", (FTI_Topo->groupRank + FTI_Topo->groupSize - 1) % FTI_Topo->groupSize);
-                        FTI_Exec->meta[i].pfs[j] = iniparser_getlint(ini, str, -1);
-
-                        FTI_Exec->meta[i].maxFs[j] = iniparser_getlint(ini, "0:Ckpt_file_maxs", -1);
-                        int k;
-                        for (k = 0; k < FTI_BUFS; k++) {
-                            snprintf(str, FTI_BUFS, "%d:Var%d_id", FTI_Topo->groupRank, k);
-                            int id = iniparser_getint(ini, str, -1);
-                            if (id == -1) {
-                                //No more variables
-                                break;
-                            }
-                            //Variable exists
-                            FTI_Exec->meta[i].varID[j * FTI_BUFS + k] = id;
-
-                            snprintf(str, FTI_BUFS, "%d:Var%d_size", FTI_Topo->groupRank, k);
-                            FTI_Exec->meta[i].varSize[j * FTI_BUFS + k] = iniparser_getlint(ini, str, -1);
-                        }
-                        //Save number of variables in metadata
-                        FTI_Exec->meta[i].nbVar[j] = k;
-
-                        iniparser_freedict(ini);
-                    }
+                FTI_CopyMetaRecord(FTI_Exec, i, j, rec);
+
+                //update heads ckptID
+                sscanf(&FTI_Exec->meta[i].ckptFile[j * FTI_BUFS], "Ckpt%d", &FTI_Exec->ckptID);
+                if (FTI_Exec->ckptID < biggestCkptID) {
+                    FTI_Exec->ckptID = biggestCkptID;
                 }
+                biggestCkptID = FTI_Exec->ckptID;
             }
         }
+        munmap(map, len);
     }
     return FTI_SCES;
 }
@@ -640,7 +839,7 @@ int FTI_WriteCkptMetaData(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief      It writes the metadata to recover the data after a failure.
+  @brief      It exports the metadata of the group to an INI file.
   @param      FTI_Conf        Configuration metadata.
   @param      FTI_Exec        Execution metadata.
   @param      FTI_Topo        Topology metadata.
@@ -653,7 +852,8 @@ int FTI_WriteCkptMetaData(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec
   @return     integer         FTI_SCES if successful.
 
   This function should be executed only by one process per group. It
-  writes the metadata file used to recover in case of failure.
+  writes the INI metadata file of the group if meta_ini_export is set.
+  The file is not read at recovery.
 
  **/
 /*-------------------------------------------------------------------------*/
@@ -761,8 +961,8 @@ int FTI_WriteMetadata(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   @return     integer         FTI_SCES if successful.
 
   This function gathers information about the checkpoint files in the
-  group (name and sizes), and creates the metadata file used to recover in
-  case of failure.
+  group (name and sizes), and creates the binary metadata file used to
+  recover in case of failure. The INI files are only written as export.
 
  **/
 /*-------------------------------------------------------------------------*/
@@ -825,13 +1025,6 @@ int FTI_CreateMetadata(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     snprintf(str, FTI_BUFS, "Max. file size in group %lu.", mfs);
     FTI_Print(str, FTI_DBUG);
 
-    char* ckptFileNames;
-    if (FTI_Topo->groupRank == 0) {
-        ckptFileNames = talloc(char, FTI_Topo->groupSize * FTI_BUFS);
-    }
-    strncpy(str, FTI_Exec->meta[0].ckptFile, FTI_BUFS); // Gather all the file names
-    MPI_Gather(str, FTI_BUFS, MPI_CHAR, ckptFileNames, FTI_BUFS, MPI_CHAR, 0, FTI_Exec->groupComm);
-
     char checksum[MD5_DIGEST_STRING_LENGTH];
     FTI_Checksum(FTI_Exec, FTI_Data, FTI_Conf, checksum);
 
@@ -842,44 +1035,64 @@ int FTI_CreateMetadata(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     }
 #endif
 
-    char* checksums;
-    if (FTI_Topo->groupRank == 0) {
-        checksums = talloc(char, FTI_Topo->groupSize * MD5_DIGEST_STRING_LENGTH);
+    // The partner file is the checkpoint file of the left process
+    char ptnerChecksum[MD5_DIGEST_STRING_LENGTH];
+    MPI_Sendrecv(checksum, MD5_DIGEST_STRING_LENGTH, MPI_CHAR, FTI_Topo->right, FTI_Conf->generalTag,
+            ptnerChecksum, MD5_DIGEST_STRING_LENGTH, MPI_CHAR, FTI_Topo->left, FTI_Conf->generalTag,
+            FTI_Exec->groupComm, MPI_STATUS_IGNORE);
+
+    int res = FTI_Try(FTI_WriteMetaBin(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Data,
+                fileSizes[FTI_Topo->left], mfs, checksum, ptnerChecksum), "write the binary metadata.");
+    if (res == FTI_NSCS) {
+        return FTI_NSCS;
     }
-    MPI_Gather(checksum, MD5_DIGEST_STRING_LENGTH, MPI_CHAR, checksums, MD5_DIGEST_STRING_LENGTH, MPI_CHAR, 0, FTI_Exec->groupComm);
 
+    if (FTI_Conf->metaIniExport) {
+        char* ckptFileNames = NULL;
+        if (FTI_Topo->groupRank == 0) {
+            ckptFileNames = talloc(char, FTI_Topo->groupSize * FTI_BUFS);
+        }
+        snprintf(str, FTI_BUFS, "%s", FTI_Exec->meta[0].ckptFile); // Gather all the file names
+        MPI_Gather(str, FTI_BUFS, MPI_CHAR, ckptFileNames, FTI_BUFS, MPI_CHAR, 0, FTI_Exec->groupComm);
 
-    //Every process has the same number of protected variables
+        char* checksums = NULL;
+        if (FTI_Topo->groupRank == 0) {
+            checksums = talloc(char, FTI_Topo->groupSize * MD5_DIGEST_STRING_LENGTH);
+        }
+        MPI_Gather(checksum, MD5_DIGEST_STRING_LENGTH, MPI_CHAR, checksums, MD5_DIGEST_STRING_LENGTH, MPI_CHAR, 0, FTI_Exec->groupComm);
 
-    int* allVarIDs;
-    long* allVarSizes;
-    if (FTI_Topo->groupRank == 0) {
-        allVarIDs = talloc(int, FTI_Topo->groupSize * FTI_Exec->nbVar);
-        allVarSizes = talloc(long, FTI_Topo->groupSize * FTI_Exec->nbVar);
-    }
-    int* myVarIDs = talloc(int, FTI_Exec->nbVar);
-    long* myVarSizes = talloc(long, FTI_Exec->nbVar);
-    for (i = 0; i < FTI_Exec->nbVar; i++) {
-        myVarIDs[i] = FTI_Data[i].id;
-        myVarSizes[i] =  FTI_Data[i].size;
-    }
-    //Gather variables IDs
-    MPI_Gather(myVarIDs, FTI_Exec->nbVar, MPI_INT, allVarIDs, FTI_Exec->nbVar, MPI_INT, 0, FTI_Exec->groupComm);
-    //Gather variables sizes
-    MPI_Gather(myVarSizes, FTI_Exec->nbVar, MPI_LONG, allVarSizes, FTI_Exec->nbVar, MPI_LONG, 0, FTI_Exec->groupComm);
-
-    free(myVarIDs);
-    free(myVarSizes);
-
-    if (FTI_Topo->groupRank == 0) { // Only one process in the group create the metadata
-        int res = FTI_Try(FTI_WriteMetadata(FTI_Conf, FTI_Exec, FTI_Topo, fileSizes, mfs,
-                    ckptFileNames, checksums, allVarIDs, allVarSizes), "write the metadata.");
-        free(allVarIDs);
-        free(allVarSizes);
-        free(ckptFileNames);
-        free(checksums);
-        if (res == FTI_NSCS) {
-            return FTI_NSCS;
+        //Every process has the same number of protected variables
+
+        int* allVarIDs = NULL;
+        long* allVarSizes = NULL;
+        if (FTI_Topo->groupRank == 0) {
+            allVarIDs = talloc(int, FTI_Topo->groupSize * FTI_Exec->nbVar);
+            allVarSizes = talloc(long, FTI_Topo->groupSize * FTI_Exec->nbVar);
+        }
+        int* myVarIDs = talloc(int, FTI_Exec->nbVar);
+        long* myVarSizes = talloc(long, FTI_Exec->nbVar);
+        for (i = 0; i < FTI_Exec->nbVar; i++) {
+            myVarIDs[i] = FTI_Data[i].id;
+            myVarSizes[i] =  FTI_Data[i].size;
+        }
+        //Gather variables IDs
+        MPI_Gather(myVarIDs, FTI_Exec->nbVar, MPI_INT, allVarIDs, FTI_Exec->nbVar, MPI_INT, 0, FTI_Exec->groupComm);
+        //Gather variables sizes
+        MPI_Gather(myVarSizes, FTI_Exec->nbVar, MPI_LONG, allVarSizes, FTI_Exec->nbVar, MPI_LONG, 0, FTI_Exec->groupComm);
+
+        free(myVarIDs);
+        free(myVarSizes);
+
+        if (FTI_Topo->groupRank == 0) { // Only one process in the group exports the metadata
+            res = FTI_Try(FTI_WriteMetadata(FTI_Conf, FTI_Exec, FTI_Topo, fileSizes, mfs,
+                        ckptFileNames, checksums, allVarIDs, allVarSizes), "export the metadata.");
+            free(allVarIDs);
+            free(allVarSizes);
+            free(ckptFileNames);
+            free(checksums);
+            if (res == FTI_NSCS) {
+                return FTI_NSCS;
+            }
         }
     }
 
@@ -889,6 +1102,10 @@ int FTI_CreateMetadata(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTI_Exec->meta[FTI_Exec->ckptLvel].maxFs[0] = FTI_Exec->meta[0].maxFs[0];
     FTI_Exec->meta[FTI_Exec->ckptLvel].nbVar[0] = FTI_Exec->meta[0].nbVar[0];
     strncpy(FTI_Exec->meta[FTI_Exec->ckptLvel].ckptFile, FTI_Exec->meta[0].ckptFile, FTI_BUFS);
+    if (FTI_ReserveMetaVar(&FTI_Exec->meta[0], FTI_Exec->nbVar) != FTI_SCES ||
+            FTI_ReserveMetaVar(&FTI_Exec->meta[FTI_Exec->ckptLvel], FTI_Exec->nbVar) != FTI_SCES) {
+        return FTI_NSCS;
+    }
     for (i = 0; i < FTI_Exec->nbVar; i++) {
         FTI_Exec->meta[0].varID[i] = FTI_Data[i].id;
         FTI_Exec->meta[0].varSize[i] = FTI_Data[i].size;
@@ -0,0 +1,617 @@
+/**
+ *  Copyright (c) 2017 Leonardo A. Bautista-Gomez
+ *  All rights reserved
+ *
+ *  FTI - A multi-level checkpointing library for C/C++/Fortran applications
+ *
+ *  Revision 1.0 : Fault Tolerance Interface (FTI)
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  @file   mpiio.c
+ *  @date   October, 2018
+ *  @brief  MPI-IO hints and their calibration.
+ */
+
+#include "interface.h"
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the size of the index at the beginning of a subfile.
+  @param      nbChunks        Number of chunks in the subfile.
+  @return     MPI_Offset      Size of the index, aligned to 4KB.
+ **/
+/*-------------------------------------------------------------------------*/
+static MPI_Offset FTI_MpiioIndexSize(int nbChunks)
+{
+    MPI_Offset size = sizeof(FTIT_mpiioIndex) + nbChunks * sizeof(MPI_Offset);
+    return (size + 4095) & ~((MPI_Offset)4095);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the index of an MPI-IO hint.
+  @param      FTI_Conf        Configuration metadata.
+  @param      key             Name of the hint.
+  @return     integer         Index in FTI_Conf->mpiioHints, -1 if not set.
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_GetMpiioHint(FTIT_configuration* FTI_Conf, const char* key)
+{
+    int i;
+    for (i = 0; i < FTI_Conf->nbMpiioHints; i++) {
+        if (strcmp(FTI_Conf->mpiioHints[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Stores an MPI-IO hint in the configuration.
+  @param      FTI_Conf        Configuration metadata.
+  @param      key             Name of the hint.
+  @param      val             Value of the hint.
+  @param      overwrite       Replace the value if the hint is already set.
+  @return     integer         FTI_SCES if successful.
+
+  Hints set by the user in the [MPIIO] section are stored first. Hints
+  from the calibration are stored afterwards without 'overwrite', so
+  that explicit settings of the user always take precedence.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_SetMpiioHint(FTIT_configuration* FTI_Conf, const char* key,
+        const char* val, int overwrite)
+{
+    char str[FTI_BUFS];
+    if (strlen(key) >= FTI_MPIIO_HINT_LEN || strlen(val) >= FTI_MPIIO_HINT_LEN) {
+        snprintf(str, FTI_BUFS, "MPI-IO hint '%s' is too long and will be ignored.", key);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NSCS;
+    }
+    int idx = FTI_GetMpiioHint(FTI_Conf, key);
+    if (idx == -1) {
+        if (FTI_Conf->nbMpiioHints == FTI_MPIIO_MAX_HINTS) {
+            snprintf(str, FTI_BUFS, "Too many MPI-IO hints (max %d), '%s' will be ignored.",
+                    FTI_MPIIO_MAX_HINTS, key);
+            FTI_Print(str, FTI_WARN);
+            return FTI_NSCS;
+        }
+        idx = FTI_Conf->nbMpiioHints++;
+    }
+    else if (!overwrite) {
+        return FTI_SCES;
+    }
+    snprintf(FTI_Conf->mpiioHints[idx].key, FTI_MPIIO_HINT_LEN, "%s", key);
+    snprintf(FTI_Conf->mpiioHints[idx].val, FTI_MPIIO_HINT_LEN, "%s", val);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Creates the MPI_Info object for MPI-IO checkpoint files.
+  @param      FTI_Conf        Configuration metadata.
+  @param      info            MPI_Info object to create.
+  @param      mode            FTI_MPIIO_WRITE or FTI_MPIIO_READ.
+  @return     integer         FTI_SCES if successful.
+
+  Collective buffering is enabled for the given access mode and the
+  striping unit is set to 4MB, unless the user configured these hints.
+  All hints of the [MPIIO] section and of the calibration are passed to
+  the MPI library. The caller has to free the object with MPI_Info_free.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_CreateMpiioInfo(FTIT_configuration* FTI_Conf, MPI_Info* info, int mode)
+{
+    if (FTI_Conf->mpiioCalibrate && !FTI_Conf->mpiioCalibLoaded) {
+        // e.g., the heads, which do not take part in the calibration
+        FTI_LoadMpiioCalibration(FTI_Conf);
+        FTI_Conf->mpiioCalibLoaded = true;
+    }
+
+    MPI_Info_create(info);
+    // enable collective buffer optimization
+    if (mode == FTI_MPIIO_READ) {
+        MPI_Info_set(*info, "romio_cb_read", "enable");
+    }
+    else {
+        MPI_Info_set(*info, "romio_cb_write", "enable");
+    }
+    // set striping unit to 4MB
+    MPI_Info_set(*info, "striping_unit", "4194304");
+
+    char str[FTI_BUFS];
+    int i;
+    for (i = 0; i < FTI_Conf->nbMpiioHints; i++) {
+        MPI_Info_set(*info, FTI_Conf->mpiioHints[i].key, FTI_Conf->mpiioHints[i].val);
+        snprintf(str, FTI_BUFS, "MPI-IO hint: %s = %s", FTI_Conf->mpiioHints[i].key,
+                FTI_Conf->mpiioHints[i].val);
+        FTI_Print(str, FTI_DBUG);
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Loads the calibrated MPI-IO hints from the cache file.
+  @param      FTI_Conf        Configuration metadata.
+  @return     integer         Number of nodes used for the calibration,
+                              FTI_NSCS if no cache file is available.
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_LoadMpiioCalibration(FTIT_configuration* FTI_Conf)
+{
+    if (access(FTI_Conf->mpiioCalibFile, R_OK) != 0) {
+        return FTI_NSCS;
+    }
+    dictionary* ini = iniparser_load(FTI_Conf->mpiioCalibFile);
+    if (ini == NULL) {
+        FTI_Print("Iniparser failed to parse the MPI-IO calibration file.", FTI_WARN);
+        return FTI_NSCS;
+    }
+    int nbNodes = iniparser_getint(ini, "Calibration:nb_nodes", FTI_NSCS);
+    int nkeys = iniparser_getsecnkeys(ini, "mpiio");
+    char** keys = iniparser_getseckeys(ini, "mpiio");
+    int i;
+    for (i = 0; i < nkeys; i++) {
+        char* val = iniparser_getstring(ini, keys[i], NULL);
+        if (val != NULL) {
+            FTI_SetMpiioHint(FTI_Conf, keys[i] + strlen("mpiio:"), val, 0);
+        }
+    }
+    free(keys);
+    iniparser_freedict(ini);
+    return nbNodes;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Measures the write time of one MPI-IO hint setting.
+  @param      FTI_Conf        Configuration metadata.
+  @param      fn              Path of the calibration file.
+  @param      buf             Data to write.
+  @param      size            Bytes per rank.
+  @param      cbNodes         Value for 'cb_nodes' (NULL to keep).
+  @param      cbBufSize       Value for 'cb_buffer_size' (NULL to keep).
+  @return     double          Slowest write time among all ranks,
+                              -1 if the file could not be written.
+ **/
+/*-------------------------------------------------------------------------*/
+static double FTI_TimeMpiioHints(FTIT_configuration* FTI_Conf, char* fn,
+        char* buf, int size, char* cbNodes, char* cbBufSize)
+{
+    MPI_Info info;
+    MPI_File pfh;
+    int rank, res, ok, allOk;
+    double t, tmax;
+
+    FTI_CreateMpiioInfo(FTI_Conf, &info, FTI_MPIIO_WRITE);
+    if (cbNodes != NULL) {
+        MPI_Info_set(info, "cb_nodes", cbNodes);
+    }
+    if (cbBufSize != NULL) {
+        MPI_Info_set(info, "cb_buffer_size", cbBufSize);
+    }
+    MPI_Comm_rank(FTI_COMM_WORLD, &rank);
+
+    MPI_Barrier(FTI_COMM_WORLD);
+    t = MPI_Wtime();
+    res = MPI_File_open(FTI_COMM_WORLD, fn, MPI_MODE_WRONLY|MPI_MODE_CREATE, info, &pfh);
+    MPI_Info_free(&info);
+    if (res != MPI_SUCCESS) {
+        return -1;
+    }
+    res = MPI_File_write_at_all(pfh, (MPI_Offset)rank * size, buf, size, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&pfh);
+    t = MPI_Wtime() - t;
+
+    ok = (res == MPI_SUCCESS);
+    MPI_Allreduce(&ok, &allOk, 1, MPI_INT, MPI_MIN, FTI_COMM_WORLD);
+    MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, FTI_COMM_WORLD);
+    if (rank == 0) {
+        MPI_File_delete(fn, MPI_INFO_NULL);
+    }
+    return (allOk) ? tmax : -1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Calibrates the MPI-IO aggregation hints.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @return     integer         FTI_SCES if successful.
+
+  This function is collective on FTI_COMM_WORLD. If the cache file in the
+  metadata directory holds a calibration for the current number of nodes,
+  the hints are taken from there. Otherwise, a few settings of 'cb_nodes'
+  and 'cb_buffer_size' are benchmarked by writing a shared file to the
+  global directory and the fastest one is stored in the cache file.
+  Hints set explicitly in the [MPIIO] section are not calibrated.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_CalibrateMpiio(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo)
+{
+    char str[FTI_BUFS];
+    int cached = FTI_NSCS;
+
+    FTI_Conf->mpiioCalibLoaded = true;
+    if (FTI_Topo->splitRank == 0) {
+        cached = FTI_LoadMpiioCalibration(FTI_Conf);
+    }
+    MPI_Bcast(&cached, 1, MPI_INT, 0, FTI_COMM_WORLD);
+    if (cached == FTI_Topo->nbNodes) {
+        if (FTI_Topo->splitRank != 0) {
+            FTI_LoadMpiioCalibration(FTI_Conf);
+        }
+        FTI_Print("MPI-IO hints loaded from calibration cache.", FTI_DBUG);
+        return FTI_SCES;
+    }
+
+    // candidate values (only for hints not set by the user)
+    char cbNodes[3][FTI_MPIIO_HINT_LEN];
+    char cbBufSize[2][FTI_MPIIO_HINT_LEN];
+    int nbCbNodes = 0, nbCbBufSize = 0, i, j;
+    if (FTI_GetMpiioHint(FTI_Conf, "cb_nodes") == -1) {
+        int div;
+        for (div = 1; div <= 4; div *= 2) {
+            int nodes = FTI_Topo->nbNodes / div;
+            if (nodes < 1 || (div > 1 && nodes == FTI_Topo->nbNodes / (div / 2))) {
+                continue;
+            }
+            snprintf(cbNodes[nbCbNodes++], FTI_MPIIO_HINT_LEN, "%d", nodes);
+        }
+    }
+    if (FTI_GetMpiioHint(FTI_Conf, "cb_buffer_size") == -1) {
+        snprintf(cbBufSize[nbCbBufSize++], FTI_MPIIO_HINT_LEN, "%d", 4 * 1024 * 1024);
+        snprintf(cbBufSize[nbCbBufSize++], FTI_MPIIO_HINT_LEN, "%d", 16 * 1024 * 1024);
+    }
+    if (nbCbNodes == 0 && nbCbBufSize == 0) {
+        FTI_Print("All calibrated MPI-IO hints are set in the configuration.", FTI_DBUG);
+        return FTI_SCES;
+    }
+
+    int size = (int)FTI_Conf->mpiioCalibSize;
+    char* buf = talloc(char, size);
+    if (buf == NULL) {
+        FTI_Print("Failed to allocate buffer for MPI-IO calibration.", FTI_WARN);
+        return FTI_NSCS;
+    }
+    memset(buf, 0x0, size);
+
+    char fn[FTI_BUFS];
+    snprintf(fn, FTI_BUFS, "%s/mpiio-calibration.tmp", FTI_Conf->glbalDir);
+    int bestNodes = -1, bestBufSize = -1;
+    double best = -1;
+    for (i = 0; i < ((nbCbNodes) ? nbCbNodes : 1); i++) {
+        for (j = 0; j < ((nbCbBufSize) ? nbCbBufSize : 1); j++) {
+            char* n = (nbCbNodes) ? cbNodes[i] : NULL;
+            char* b = (nbCbBufSize) ? cbBufSize[j] : NULL;
+            double t = FTI_TimeMpiioHints(FTI_Conf, fn, buf, size, n, b);
+            snprintf(str, FTI_BUFS, "MPI-IO calibration: cb_nodes=%s, cb_buffer_size=%s: %.3f sec.",
+                    (n) ? n : "-", (b) ? b : "-", t);
+            FTI_Print(str, FTI_DBUG);
+            if (t >= 0 && (best < 0 || t < best)) {
+                best = t;
+                bestNodes = i;
+                bestBufSize = j;
+            }
+        }
+    }
+    free(buf);
+
+    if (best < 0) {
+        FTI_Print("MPI-IO calibration failed, using configured hints.", FTI_WARN);
+        return FTI_NSCS;
+    }
+    if (nbCbNodes) {
+        FTI_SetMpiioHint(FTI_Conf, "cb_nodes", cbNodes[bestNodes], 0);
+    }
+    if (nbCbBufSize) {
+        FTI_SetMpiioHint(FTI_Conf, "cb_buffer_size", cbBufSize[bestBufSize], 0);
+    }
+    snprintf(str, FTI_BUFS, "MPI-IO calibration done (cb_nodes=%s, cb_buffer_size=%s, %.2f MB/s).",
+            (nbCbNodes) ? cbNodes[bestNodes] : "-", (nbCbBufSize) ? cbBufSize[bestBufSize] : "-",
+            ((double)size * FTI_Topo->nbApprocs * FTI_Topo->nbNodes) / (1024.0 * 1024.0 * best));
+    FTI_Print(str, FTI_INFO);
+
+    if (FTI_Topo->splitRank == 0) {
+        FILE* fd = fopen(FTI_Conf->mpiioCalibFile, "w");
+        if (fd == NULL) {
+            FTI_Print("Cannot write the MPI-IO calibration file.", FTI_WARN);
+            return FTI_SCES;
+        }
+        fprintf(fd, "[Calibration]\nnb_nodes = %d\n\n[MPIIO]\n", FTI_Topo->nbNodes);
+        if (nbCbNodes) {
+            fprintf(fd, "cb_nodes = %s\n", cbNodes[bestNodes]);
+        }
+        if (nbCbBufSize) {
+            fprintf(fd, "cb_buffer_size = %s\n", cbBufSize[bestBufSize]);
+        }
+        fclose(fd);
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Creates one memory datatype over all protected datasets.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      type            Datatype to create.
+  @return     integer         FTI_SCES if successful.
+
+  The datatype is an hindexed type of bytes with absolute displacements,
+  thus it has to be used together with MPI_BOTTOM. Datasets larger than
+  FTI_MPIIO_MAX_BLOCK bytes are split into several blocks, since the
+  block lengths of MPI datatypes are integers.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_CreateMpiioDatatype(FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data,
+        MPI_Datatype* type)
+{
+    int i, nbBlocks = 0;
+    for (i = 0; i < FTI_Exec->nbVar; i++) {
+        nbBlocks += (FTI_Data[i].size + FTI_MPIIO_MAX_BLOCK - 1) / FTI_MPIIO_MAX_BLOCK;
+    }
+    int* blockLengths = talloc(int, nbBlocks + 1);
+    MPI_Aint* displacements = talloc(MPI_Aint, nbBlocks + 1);
+    if (blockLengths == NULL || displacements == NULL) {
+        FTI_Print("Failed to allocate the MPI-IO datatype description.", FTI_EROR);
+        free(blockLengths);
+        free(displacements);
+        return FTI_NSCS;
+    }
+
+    int b = 0;
+    for (i = 0; i < FTI_Exec->nbVar; i++) {
+        long pos = 0;
+        while (pos < FTI_Data[i].size) {
+            long len = FTI_Data[i].size - pos;
+            if (len > FTI_MPIIO_MAX_BLOCK) {
+                len = FTI_MPIIO_MAX_BLOCK;
+            }
+            MPI_Get_address((char*)FTI_Data[i].ptr + pos, &displacements[b]);
+            blockLengths[b++] = (int)len;
+            pos += len;
+        }
+    }
+    MPI_Type_create_hindexed(b, blockLengths, displacements, MPI_BYTE, type);
+    MPI_Type_commit(type);
+    free(blockLengths);
+    free(displacements);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Writes all protected datasets with one collective call.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      pfh             MPI-IO file handle.
+  @param      offset          Offset of this rank in the shared file.
+  @param      info            MPI_Info passed to the file view.
+  @return     integer         MPI error code.
+
+  The file view starts at the offset of the rank, so that every rank
+  writes its chunk of the shared file at displacement zero of its view.
+  This function is collective on the communicator of the file handle.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_MpiioWriteAll(FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data,
+        MPI_File pfh, MPI_Offset offset, MPI_Info info)
+{
+    MPI_Datatype memType;
+    int count = 1;
+    int res = MPI_File_set_view(pfh, offset, MPI_BYTE, MPI_BYTE, "native", info);
+    if (res != MPI_SUCCESS) {
+        return res;
+    }
+    if (FTI_CreateMpiioDatatype(FTI_Exec, FTI_Data, &memType) != FTI_SCES) {
+        // still take part in the collective write
+        memType = MPI_BYTE;
+        count = 0;
+    }
+    res = MPI_File_write_at_all(pfh, 0, MPI_BOTTOM, count, memType, MPI_STATUS_IGNORE);
+    if (count) {
+        MPI_Type_free(&memType);
+    }
+    else if (res == MPI_SUCCESS) {
+        res = MPI_ERR_NO_MEM;
+    }
+    return res;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the communicator of the MPI-IO checkpoint file.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @return     MPI_Comm        Communicator to open the file with.
+
+  Without subfiling all processes share one file (the post-processing
+  communicator, FTI_COMM_WORLD or its duplicate). With subfiling, the
+  processes of 'mpiioSubfileNodes' consecutive nodes share one subfile.
+  The communicator is created at the first call; the key of the split
+  preserves the order of FTI_COMM_WORLD.
+
+ **/
+/*-------------------------------------------------------------------------*/
+MPI_Comm FTI_MpiioComm(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo)
+{
+    if (FTI_Conf->mpiioSubfileNodes < 1) {
+        return FTI_Exec->postComm;
+    }
+    if (FTI_Exec->subfileComm == MPI_COMM_NULL) {
+        MPI_Comm_split(FTI_Exec->postComm, FTI_Topo->nodeID / FTI_Conf->mpiioSubfileNodes,
+                FTI_Topo->splitRank, &FTI_Exec->subfileComm);
+    }
+    return FTI_Exec->subfileComm;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Sets the name of the MPI-IO checkpoint file.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      ckptFile        Buffer of size FTI_BUFS for the file name.
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_MpiioFileName(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, char* ckptFile)
+{
+    if (FTI_Conf->mpiioSubfileNodes < 1) {
+        snprintf(ckptFile, FTI_BUFS, "Ckpt%d-mpiio.fti", FTI_Exec->ckptID);
+    }
+    else {
+        snprintf(ckptFile, FTI_BUFS, "Ckpt%d-mpiio-sf%d.fti", FTI_Exec->ckptID,
+                FTI_Topo->nodeID / FTI_Conf->mpiioSubfileNodes);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Computes the file offsets of the chunks written by a process.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      pfh             MPI-IO file handle.
+  @param      sizes           Sizes of the chunks written by this process.
+  @param      nbChunks        Number of chunks (application processes).
+  @param      offsets         Computed offsets of the chunks.
+  @return     integer         FTI_SCES if successful.
+
+  The chunks of all processes are stored in the order of FTI_COMM_WORLD,
+  every process contributes the same number of chunks (a head writes the
+  chunks of all application processes of its node). With subfiling, the
+  first process of each subfile writes an index with the offsets of all
+  chunks at the beginning of the file, so that at restart every process
+  can locate its chunk without any communication. This function is
+  collective on the communicator of the file.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_MpiioOffsets(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, MPI_File pfh, MPI_Offset* sizes, int nbChunks,
+        MPI_Offset* offsets)
+{
+    MPI_Comm comm = FTI_MpiioComm(FTI_Conf, FTI_Exec, FTI_Topo);
+    int rank, nbProcs, i;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nbProcs);
+
+    int nbAll = nbProcs * nbChunks;
+    MPI_Offset* allSizes = talloc(MPI_Offset, nbAll + 1);
+    if (allSizes == NULL) {
+        FTI_Print("Failed to allocate the MPI-IO chunk sizes.", FTI_EROR);
+        return FTI_NSCS;
+    }
+    MPI_Allgather(sizes, nbChunks, MPI_OFFSET, allSizes, nbChunks, MPI_OFFSET, comm);
+
+    // exclusive prefix sum over all chunks, starting after the index
+    MPI_Offset offset = (FTI_Conf->mpiioSubfileNodes < 1) ? 0 : FTI_MpiioIndexSize(nbAll);
+    for (i = 0; i < nbAll; i++) {
+        MPI_Offset size = allSizes[i];
+        allSizes[i] = offset;
+        offset += size;
+    }
+    for (i = 0; i < nbChunks; i++) {
+        offsets[i] = allSizes[rank * nbChunks + i];
+    }
+
+    int res = MPI_SUCCESS;
+    if (FTI_Conf->mpiioSubfileNodes > 0 && rank == 0) {
+        FTIT_mpiioIndex header;
+        memset(&header, 0x0, sizeof(FTIT_mpiioIndex));
+        memcpy(header.magic, FTI_MPIIO_INDEX_MAGIC, sizeof(header.magic));
+        header.nbChunks = nbAll;
+        res = MPI_File_write_at(pfh, 0, &header, sizeof(FTIT_mpiioIndex), MPI_BYTE, MPI_STATUS_IGNORE);
+        if (res == MPI_SUCCESS) {
+            res = MPI_File_write_at(pfh, sizeof(FTIT_mpiioIndex), allSizes, nbAll * sizeof(MPI_Offset),
+                    MPI_BYTE, MPI_STATUS_IGNORE);
+        }
+    }
+    free(allSizes);
+    if (res != MPI_SUCCESS) {
+        FTI_Print("Failed to write the index of the MPI-IO subfile.", FTI_EROR);
+        return FTI_NSCS;
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Locates the chunk of this process in the MPI-IO checkpoint file.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      pfh             MPI-IO file handle.
+  @param      size            Size of the chunk of this process.
+  @param      offset          Offset of the chunk in the file.
+  @return     integer         FTI_SCES if successful.
+
+  With subfiling the offset is read from the index of the subfile,
+  otherwise it is computed from the chunk sizes of all processes.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_MpiioLocateChunk(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, MPI_File pfh, MPI_Offset size, MPI_Offset* offset)
+{
+    if (FTI_Conf->mpiioSubfileNodes < 1) {
+        return FTI_MpiioOffsets(FTI_Conf, FTI_Exec, FTI_Topo, pfh, &size, 1, offset);
+    }
+
+    MPI_Comm comm = FTI_MpiioComm(FTI_Conf, FTI_Exec, FTI_Topo);
+    int rank, nbProcs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nbProcs);
+
+    FTIT_mpiioIndex header;
+    int res = MPI_File_read_at(pfh, 0, &header, sizeof(FTIT_mpiioIndex), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (res != MPI_SUCCESS || memcmp(header.magic, FTI_MPIIO_INDEX_MAGIC, sizeof(header.magic)) != 0
+            || header.nbChunks != nbProcs) {
+        FTI_Print("Invalid index in MPI-IO subfile.", FTI_WARN);
+        return FTI_NSCS;
+    }
+    res = MPI_File_read_at(pfh, sizeof(FTIT_mpiioIndex) + rank * sizeof(MPI_Offset), offset,
+            sizeof(MPI_Offset), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (res != MPI_SUCCESS) {
+        FTI_Print("Failed to read the index of the MPI-IO subfile.", FTI_WARN);
+        return FTI_NSCS;
+    }
+    return FTI_SCES;
+}
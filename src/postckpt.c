@@ -38,6 +38,23 @@
 
 #include "interface.h"
 
+/** @typedef    FTIT_postArgs
+ *  @brief      Arguments of the post-processing of one application process.
+ */
+typedef struct FTIT_postArgs {
+    FTIT_configuration* FTI_Conf;       /**< Configuration metadata.        */
+    FTIT_execution*     FTI_Exec;       /**< Execution metadata.            */
+    FTIT_topology*      FTI_Topo;       /**< Topology metadata.             */
+    FTIT_checkpoint*    FTI_Ckpt;       /**< Checkpoint metadata.           */
+    int                 level;          /**< Level flushed from (L4).       */
+    int*                matrix;         /**< RS encoding matrix (L3).       */
+    char*               checksums;      /**< Encoded file checksums (L3).   */
+    char*               localFileNames; /**< Local file names (MPI-IO L4).  */
+    MPI_Offset*         offsets;        /**< File offsets (MPI-IO L4).      */
+    int                 startProc;      /**< First proc. (MPI-IO L4).       */
+    MPI_File            pfh;            /**< MPI-IO file handle (L4).       */
+} FTIT_postArgs;
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      It returns FTI_SCES.
@@ -69,7 +86,9 @@ int FTI_Local(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   @return     integer         FTI_SCES if successful.
 
   This function sends ckpt file to partner process. Partner should call
-  FTI_RecvPtner to receive this file.
+  FTI_RecvPtner to receive this file. The messages of each application
+  process of a head have their own tag, so that the head can exchange the
+  files of several processes concurrently.
 
  **/
 /*-------------------------------------------------------------------------*/
@@ -88,6 +107,19 @@ int FTI_SendCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec, FTIT_ch
     }
     FTI_Print(str, FTI_DBUG);
 
+    // node aggregation: send the checkpoint straight from shared memory
+    char* shmData = (postFlag) ? FTI_ShmCkptData(&FTI_Exec->meta[0].ckptFile[postFlag * FTI_BUFS], FTI_Exec->meta[0].fs[postFlag]) : NULL;
+    if (shmData != NULL) {
+        long pos = 0;
+        long fs = FTI_Exec->meta[0].fs[postFlag];
+        while (pos < fs) {
+            int sendSize = ((fs - pos) > FTI_Conf->blockSize) ? FTI_Conf->blockSize : (fs - pos);
+            MPI_Send(shmData + pos, sendSize, MPI_CHAR, destination, FTI_Conf->generalTag + postFlag, FTI_Exec->groupComm);
+            pos += sendSize;
+        }
+        return FTI_SCES;
+    }
+
     FILE* lfd = fopen(lfn, "rb");
     if (lfd == NULL) {
         FTI_Print("FTI failed to open L2 Ckpt. file.", FTI_DBUG);
@@ -109,7 +141,7 @@ int FTI_SendCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec, FTIT_ch
             return FTI_NSCS;
         }
 
-        MPI_Send(buffer, bytes, MPI_CHAR, destination, FTI_Conf->generalTag, FTI_Exec->groupComm);
+        MPI_Send(buffer, bytes, MPI_CHAR, destination, FTI_Conf->generalTag + postFlag, FTI_Exec->groupComm);
         toSend -= bytes;
     }
 
@@ -156,7 +188,7 @@ int FTI_RecvPtner(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec, FTIT_c
     unsigned long toRecv = FTI_Exec->meta[0].pfs[postFlag]; //remaining data to receive
     while (toRecv > 0) {
         int recvSize = (toRecv > FTI_Conf->blockSize) ? FTI_Conf->blockSize : toRecv;
-        MPI_Recv(buffer, recvSize, MPI_CHAR, source, FTI_Conf->generalTag, FTI_Exec->groupComm, MPI_STATUS_IGNORE);
+        MPI_Recv(buffer, recvSize, MPI_CHAR, source, FTI_Conf->generalTag + postFlag, FTI_Exec->groupComm, MPI_STATUS_IGNORE);
         fwrite(buffer, sizeof(char), recvSize, pfd);
 
         if (ferror(pfd)) {
@@ -176,6 +208,47 @@ int FTI_RecvPtner(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec, FTIT_c
     return FTI_SCES;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It copies the ckpt. file of one process to the partner node.
+  @param      proc            Node rank of the application process.
+  @param      arg             Post-processing arguments (FTIT_postArgs).
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_PtnerProc(int proc, void* arg)
+{
+    FTIT_postArgs* args = (FTIT_postArgs*) arg;
+    FTIT_configuration* FTI_Conf = args->FTI_Conf;
+    FTIT_execution* FTI_Exec = args->FTI_Exec;
+    FTIT_topology* FTI_Topo = args->FTI_Topo;
+    FTIT_checkpoint* FTI_Ckpt = args->FTI_Ckpt;
+
+    int source = FTI_Topo->left; //receive Ckpt file from this process
+    int destination = FTI_Topo->right; //send Ckpt file to this process
+    if (FTI_Topo->groupRank % 2) { //first send, then receive
+        int res = FTI_SendCkpt(FTI_Conf, FTI_Exec, FTI_Ckpt, destination, proc);
+        if (res != FTI_SCES) {
+            return FTI_NSCS;
+        }
+        res = FTI_RecvPtner(FTI_Conf, FTI_Exec, FTI_Ckpt, source, proc);
+        if (res != FTI_SCES) {
+            return FTI_NSCS;
+        }
+    } else { //first receive, then send
+        int res = FTI_RecvPtner(FTI_Conf, FTI_Exec, FTI_Ckpt, source, proc);
+        if (res != FTI_SCES) {
+            return FTI_NSCS;
+        }
+        res = FTI_SendCkpt(FTI_Conf, FTI_Exec, FTI_Ckpt, destination, proc);
+        if (res != FTI_SCES) {
+            return FTI_NSCS;
+        }
+    }
+    return FTI_SCES;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      It copies ckpt. files in to the partner node.
@@ -211,303 +284,328 @@ int FTI_Ptner(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         endProc = 1;
     }
 
-    int source = FTI_Topo->left; //receive Ckpt file from this process
-    int destination = FTI_Topo->right; //send Ckpt file to this process
-    int i;
-    for (i = startProc; i < endProc; i++) {
-        if (FTI_Topo->groupRank % 2) { //first send, then receive
-            int res = FTI_SendCkpt(FTI_Conf, FTI_Exec, FTI_Ckpt, destination, i);
-            if (res != FTI_SCES) {
-                return FTI_NSCS;
-            }
-            res = FTI_RecvPtner(FTI_Conf, FTI_Exec, FTI_Ckpt, source, i);
-            if (res != FTI_SCES) {
-                return FTI_NSCS;
-            }
-        } else { //first receive, then send
-            int res = FTI_RecvPtner(FTI_Conf, FTI_Exec, FTI_Ckpt, source, i);
-            if (res != FTI_SCES) {
-                return FTI_NSCS;
-            }
-            res = FTI_SendCkpt(FTI_Conf, FTI_Exec, FTI_Ckpt, destination, i);
-            if (res != FTI_SCES) {
-                return FTI_NSCS;
-            }
-        }
-    }
-    return FTI_SCES;
+    FTIT_postArgs args = { .FTI_Conf = FTI_Conf, .FTI_Exec = FTI_Exec,
+        .FTI_Topo = FTI_Topo, .FTI_Ckpt = FTI_Ckpt };
+    return FTI_ForEachProc(startProc, endProc, FTI_PtnerProc, &args, 1);
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief      It performs RS encoding with the ckpt. files in to the group.
-  @param      FTI_Conf        Configuration metadata.
-  @param      FTI_Exec        Execution metadata.
-  @param      FTI_Topo        Topology metadata.
-  @param      FTI_Ckpt        Checkpoint metadata.
+  @brief      It performs RS encoding with the ckpt. file of one process.
+  @param      proc            Node rank of the application process.
+  @param      arg             Post-processing arguments (FTIT_postArgs).
   @return     integer         FTI_SCES if successful.
 
-  This function performs the Reed-Solomon encoding for a given group. The
-  checkpoint files are padded to the maximum size of the largest checkpoint
-  file in the group +- the extra space to be a multiple of block size.
+  The checksum of the encoded file is stored in the checksums array of the
+  arguments; it is written to the metadata by FTI_RSenc.
 
  **/
 /*-------------------------------------------------------------------------*/
-int FTI_RSenc(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
-        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt)
+static int FTI_RSencProc(int proc, void* arg)
 {
-    FTI_Print("Starting checkpoint post-processing L3", FTI_DBUG);
-    if (FTI_Topo->amIaHead) {
-        int res = FTI_Try(FTI_LoadTmpMeta(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt), "load temporary metadata.");
-        if (res != FTI_SCES) {
-            return FTI_NSCS;
-        }
-    }
-    int startProc, endProc;
-    if (FTI_Topo->amIaHead) {
-        startProc = 1;
-        endProc = FTI_Topo->nodeSize;
+    FTIT_postArgs* args = (FTIT_postArgs*) arg;
+    FTIT_configuration* FTI_Conf = args->FTI_Conf;
+    FTIT_execution* FTI_Exec = args->FTI_Exec;
+    FTIT_topology* FTI_Topo = args->FTI_Topo;
+
+    int ckptID, rank;
+    sscanf(&FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS], "Ckpt%d-Rank%d.fti", &ckptID, &rank);
+    char lfn[FTI_BUFS], efn[FTI_BUFS];
+
+    snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Conf->lTmpDir, &FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS]);
+    snprintf(efn, FTI_BUFS, "%s/Ckpt%d-RSed%d.fti", FTI_Conf->lTmpDir, ckptID, rank);
+
+    char str[FTI_BUFS];
+    snprintf(str, FTI_BUFS, "L3 trying to access local ckpt. file (%s).", lfn);
+    FTI_Print(str, FTI_DBUG);
+
+    //all files in group must have the same size
+    long maxFs = FTI_Exec->meta[0].maxFs[proc]; //max file size in group
+
+    // node aggregation: encode the checkpoint straight from shared memory
+    long ckptFs = FTI_Exec->meta[0].fs[proc];
+    char* shmData = (FTI_Topo->amIaHead) ? FTI_ShmCkptData(&FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS], ckptFs) : NULL;
+
+    if (truncate(lfn, maxFs) == -1) {
+        FTI_Print("Error with truncate on checkpoint file", FTI_WARN);
+        return FTI_NSCS;
     }
-    else {
-        startProc = 0;
-        endProc = 1;
+
+    FILE* lfd = fopen(lfn, "rb");
+    if (lfd == NULL) {
+        FTI_Print("FTI failed to open L3 checkpoint file.", FTI_EROR);
+        return FTI_NSCS;
     }
 
-    int proc;
-    for (proc = startProc; proc < endProc; proc++) {
-        int ckptID, rank;
-        sscanf(&FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS], "Ckpt%d-Rank%d.fti", &ckptID, &rank);
-        char lfn[FTI_BUFS], efn[FTI_BUFS];
+    FILE* efd = fopen(efn, "wb");
+    if (efd == NULL) {
+        FTI_Print("FTI failed to open encoded ckpt. file.", FTI_EROR);
 
-        snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Conf->lTmpDir, &FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS]);
-        snprintf(efn, FTI_BUFS, "%s/Ckpt%d-RSed%d.fti", FTI_Conf->lTmpDir, ckptID, rank);
+        fclose(lfd);
 
-        char str[FTI_BUFS];
-        snprintf(str, FTI_BUFS, "L3 trying to access local ckpt. file (%s).", lfn);
-        FTI_Print(str, FTI_DBUG);
+        return FTI_NSCS;
+    }
 
-        //all files in group must have the same size
-        long maxFs = FTI_Exec->meta[0].maxFs[proc]; //max file size in group
+    int bs = FTI_Conf->blockSize;
+    char* myData = talloc(char, bs);
+    char* coding = talloc(char, bs);
+    char* data = talloc(char, 2 * bs);
+    int* matrix = args->matrix;
+    int i;
+    int remBsize = bs;
+    long ps = ((maxFs / bs)) * bs;
+    if (ps < maxFs) {
+        ps = ps + bs;
+    }
 
-        if (truncate(lfn, maxFs) == -1) {
-            FTI_Print("Error with truncate on checkpoint file", FTI_WARN);
-            return FTI_NSCS;
-        }
+    //for MD5 checksum
+    MD5_CTX mdContext;
+    MD5_Init (&mdContext);
 
-        FILE* lfd = fopen(lfn, "rb");
-        if (lfd == NULL) {
-            FTI_Print("FTI failed to open L3 checkpoint file.", FTI_EROR);
-            return FTI_NSCS;
+    // For each block
+    long pos = 0;
+    while (pos < ps) {
+        if ((maxFs - pos) < bs) {
+            remBsize = maxFs - pos;
         }
 
-        FILE* efd = fopen(efn, "wb");
-        if (efd == NULL) {
-            FTI_Print("FTI failed to open encoded ckpt. file.", FTI_EROR);
+        // Reading checkpoint files (zero padded up to maxFs)
+        size_t bytes;
+        if (shmData != NULL) {
+            long avail = (pos < ckptFs) ? ckptFs - pos : 0;
+            bytes = (avail < remBsize) ? avail : remBsize;
+            memcpy(myData, shmData + pos, bytes);
+            memset(myData + bytes, 0x0, remBsize - bytes);
+            bytes = remBsize;
+        }
+        else {
+            bytes = fread(myData, sizeof(char), remBsize, lfd);
+        }
+        if (ferror(lfd)) {
+            FTI_Print("FTI failed to read from L3 ckpt. file.", FTI_EROR);
 
+            free(data);
+            free(coding);
+            free(myData);
             fclose(lfd);
+            fclose(efd);
 
             return FTI_NSCS;
         }
 
-        int bs = FTI_Conf->blockSize;
-        char* myData = talloc(char, bs);
-        char* coding = talloc(char, bs);
-        char* data = talloc(char, 2 * bs);
-        int* matrix = talloc(int, FTI_Topo->groupSize* FTI_Topo->groupSize);
-
-        int i;
-        for (i = 0; i < FTI_Topo->groupSize; i++) {
-            int j;
-            for (j = 0; j < FTI_Topo->groupSize; j++) {
-                matrix[i * FTI_Topo->groupSize + j] = galois_single_divide(1, i ^ (FTI_Topo->groupSize + j), FTI_Conf->l3WordSize);
+        int dest = FTI_Topo->groupRank;
+        i = FTI_Topo->groupRank;
+        int offset = 0;
+        int init = 0;
+        int cnt = 0;
+
+        // For each encoding
+        MPI_Request reqSend, reqRecv; //used between iterations in while loop
+        while (cnt < FTI_Topo->groupSize) {
+            if (cnt == 0) {
+                memcpy(&(data[offset * bs]), myData, sizeof(char) * bytes);
+            }
+            else {
+                MPI_Wait(&reqSend, MPI_STATUS_IGNORE);
+                MPI_Wait(&reqRecv, MPI_STATUS_IGNORE);
             }
-        }
-
-
 
-        int remBsize = bs;
-        long ps = ((maxFs / bs)) * bs;
-        if (ps < maxFs) {
-            ps = ps + bs;
-        }
+            // At every loop *but* the last one we send the data
+            if (cnt != FTI_Topo->groupSize - 1) {
+                dest = (dest + FTI_Topo->groupSize - 1) % FTI_Topo->groupSize;
+                int src = (i + 1) % FTI_Topo->groupSize;
+                MPI_Isend(myData, bytes, MPI_CHAR, dest, FTI_Conf->generalTag + proc, FTI_Exec->groupComm, &reqSend);
+                MPI_Irecv(&(data[(1 - offset) * bs]), bs, MPI_CHAR, src, FTI_Conf->generalTag + proc, FTI_Exec->groupComm, &reqRecv);
+            }
 
-        //for MD5 checksum
-        MD5_CTX mdContext;
-        MD5_Init (&mdContext);
+            int matVal = matrix[FTI_Topo->groupRank * FTI_Topo->groupSize + i];
+            // First copy or xor any data that does not need to be multiplied by a factor
+            if (matVal == 1) {
+                if (init == 0) {
+                    memcpy(coding, &(data[offset * bs]), bs);
+                    init = 1;
+                }
+                else {
+                    galois_region_xor(&(data[offset * bs]), coding, bs);
+                }
+            }
 
-        // For each block
-        long pos = 0;
-        while (pos < ps) {
-            if ((maxFs - pos) < bs) {
-                remBsize = maxFs - pos;
+            // Then the data that needs to be multiplied by a factor
+            if (matVal != 0 && matVal != 1) {
+                galois_w16_region_multiply(&(data[offset * bs]), matVal, bs, coding, init);
+                init = 1;
             }
 
-            // Reading checkpoint files
-            size_t bytes = fread(myData, sizeof(char), remBsize, lfd);
-            if (ferror(lfd)) {
-                FTI_Print("FTI failed to read from L3 ckpt. file.", FTI_EROR);
+            i = (i + 1) % FTI_Topo->groupSize;
+            offset = 1 - offset;
+            cnt++;
+        }
 
-                free(data);
-                free(matrix);
-                free(coding);
-                free(myData);
-                fclose(lfd);
-                fclose(efd);
+        // Writting encoded checkpoints
+        fwrite(coding, sizeof(char), remBsize, efd);
+        MD5_Update (&mdContext, coding, remBsize);
 
-                return FTI_NSCS;
-            }
+        // Next block
+        pos = pos + bs;
+    }
 
-            int dest = FTI_Topo->groupRank;
-            i = FTI_Topo->groupRank;
-            int offset = 0;
-            int init = 0;
-            int cnt = 0;
-
-            // For each encoding
-            MPI_Request reqSend, reqRecv; //used between iterations in while loop
-            while (cnt < FTI_Topo->groupSize) {
-                if (cnt == 0) {
-                    memcpy(&(data[offset * bs]), myData, sizeof(char) * bytes);
-                }
-                else {
-                    MPI_Wait(&reqSend, MPI_STATUS_IGNORE);
-                    MPI_Wait(&reqRecv, MPI_STATUS_IGNORE);
-                }
+    // create checksum hex-string
+    unsigned char hash[MD5_DIGEST_LENGTH];
+    MD5_Final (hash, &mdContext);
 
-                // At every loop *but* the last one we send the data
-                if (cnt != FTI_Topo->groupSize - 1) {
-                    dest = (dest + FTI_Topo->groupSize - 1) % FTI_Topo->groupSize;
-                    int src = (i + 1) % FTI_Topo->groupSize;
-                    MPI_Isend(myData, bytes, MPI_CHAR, dest, FTI_Conf->generalTag, FTI_Exec->groupComm, &reqSend);
-                    MPI_Irecv(&(data[(1 - offset) * bs]), bs, MPI_CHAR, src, FTI_Conf->generalTag, FTI_Exec->groupComm, &reqRecv);
-                }
+    char* checksum = &args->checksums[proc * MD5_DIGEST_STRING_LENGTH];
+    int ii = 0;
+    for(i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        sprintf(&checksum[ii], "%02x", hash[i]);
+        ii+=2;
+    }
 
-                int matVal = matrix[FTI_Topo->groupRank * FTI_Topo->groupSize + i];
-                // First copy or xor any data that does not need to be multiplied by a factor
-                if (matVal == 1) {
-                    if (init == 0) {
-                        memcpy(coding, &(data[offset * bs]), bs);
-                        init = 1;
-                    }
-                    else {
-                        galois_region_xor(&(data[offset * bs]), coding, bs);
-                    }
-                }
+    // FTI-FF append meta data to RS file
+    if ( FTI_Conf->ioMode == FTI_IO_FTIFF ) {
 
-                // Then the data that needs to be multiplied by a factor
-                if (matVal != 0 && matVal != 1) {
-                    galois_w16_region_multiply(&(data[offset * bs]), matVal, bs, coding, init);
-                    init = 1;
-                }
+        FTIFF_metaInfo *FTIFFMeta = malloc( sizeof( FTIFF_metaInfo) );
 
-                i = (i + 1) % FTI_Topo->groupSize;
-                offset = 1 - offset;
-                cnt++;
-            }
+        // get timestamp
+        struct timespec ntime;
+        clock_gettime(CLOCK_REALTIME, &ntime);
+        FTIFFMeta->timestamp = ntime.tv_sec*1000000000 + ntime.tv_nsec;
+
+        FTIFFMeta->fs = maxFs;
+        // although not needed, we have to assign value for unique hash.
+        FTIFFMeta->ptFs = -1;
+        FTIFFMeta->maxFs = maxFs;
+        FTIFFMeta->codec = FTI_CODEC_NONE;
+        FTIFFMeta->ckptSize = FTI_Exec->meta[0].fs[proc];
+        strncpy(FTIFFMeta->checksum, checksum, MD5_DIGEST_STRING_LENGTH - 1);
+        FTIFFMeta->checksum[MD5_DIGEST_STRING_LENGTH - 1] = '\0';
 
-            // Writting encoded checkpoints
-            fwrite(coding, sizeof(char), remBsize, efd);
-            MD5_Update (&mdContext, coding, remBsize);
+        // get hash of meta data
+        FTIFF_GetHashMetaInfo( FTIFFMeta->myHash, FTIFFMeta );
 
-            // Next block
-            pos = pos + bs;
+        // serialize data block variable meta data and append to encoded file
+        char* buffer_ser = (char*) malloc ( FTI_filemetastructsize );
+        if( buffer_ser == NULL ) {
+            snprintf( str, FTI_BUFS, "FTI_RSenc - failed to allocate %d bytes for 'buffer_ser'", FTI_dbvarstructsize );
+            FTI_Print(str, FTI_EROR);
+            free(data);
+            free(coding);
+            free(myData);
+            fclose(lfd);
+            fclose(efd);
+            errno = 0;
+            return FTI_NSCS;
+        }
+        if( FTIFF_SerializeFileMeta( FTIFFMeta, buffer_ser ) != FTI_SCES ) {
+            FTI_Print("FTI_RSenc - failed to serialize 'currentdbvar'", FTI_EROR);
+            free(buffer_ser);
+            free(data);
+            free(coding);
+            free(myData);
+            fclose(lfd);
+            fclose(efd);
+            errno = 0;
+            return FTI_NSCS;
         }
+        fwrite(buffer_ser, FTI_filemetastructsize, 1, efd);
+        if ( ferror( efd ) ) {
+            snprintf(str, FTI_BUFS, "FTI_RSenc - could not write metadata in file: %s", efn);
+            FTI_Print(str, FTI_EROR);
+            errno=0;
+            free(data);
+            free(coding);
+            free(myData);
+            fclose(lfd);
+            fclose(efd);
+            return FTI_NSCS;
+        }
+        free( buffer_ser );
 
-        // create checksum hex-string
-        unsigned char hash[MD5_DIGEST_LENGTH];
-        MD5_Final (hash, &mdContext);
+    }
 
-        char checksum[MD5_DIGEST_STRING_LENGTH];
-        int ii = 0;
-        for(i = 0; i < MD5_DIGEST_LENGTH; i++) {
-            sprintf(&checksum[ii], "%02x", hash[i]);
-            ii+=2;
-        }
+    free(data);
+    free(coding);
+    free(myData);
+    fclose(lfd);
+    fclose(efd);
 
-        // FTI-FF append meta data to RS file
-        if ( FTI_Conf->ioMode == FTI_IO_FTIFF ) {
-
-            FTIFF_metaInfo *FTIFFMeta = malloc( sizeof( FTIFF_metaInfo) );
-
-            // get timestamp
-            struct timespec ntime;
-            clock_gettime(CLOCK_REALTIME, &ntime);
-            FTIFFMeta->timestamp = ntime.tv_sec*1000000000 + ntime.tv_nsec;
-
-            FTIFFMeta->fs = maxFs;
-            // although not needed, we have to assign value for unique hash.
-            FTIFFMeta->ptFs = -1;
-            FTIFFMeta->maxFs = maxFs;
-            FTIFFMeta->ckptSize = FTI_Exec->meta[0].fs[proc];
-            strncpy(FTIFFMeta->checksum, checksum, MD5_DIGEST_STRING_LENGTH);
-
-            // get hash of meta data
-            FTIFF_GetHashMetaInfo( FTIFFMeta->myHash, FTIFFMeta );
-
-            // serialize data block variable meta data and append to encoded file
-            char* buffer_ser = (char*) malloc ( FTI_filemetastructsize );
-            if( buffer_ser == NULL ) {
-                snprintf( str, FTI_BUFS, "FTI_RSenc - failed to allocate %d bytes for 'buffer_ser'", FTI_dbvarstructsize );
-                FTI_Print(str, FTI_EROR);
-                free(data);
-                free(matrix);
-                free(coding);
-                free(myData);
-                fclose(lfd);
-                fclose(efd);
-                errno = 0;
-                return FTI_NSCS;
-            }
-            if( FTIFF_SerializeFileMeta( FTIFFMeta, buffer_ser ) != FTI_SCES ) {
-                FTI_Print("FTI_RSenc - failed to serialize 'currentdbvar'", FTI_EROR);
-                free(buffer_ser);
-                free(data);
-                free(matrix);
-                free(coding);
-                free(myData);
-                fclose(lfd);
-                fclose(efd);
-                errno = 0;
-                return FTI_NSCS;
-            }
-            fwrite(buffer_ser, FTI_filemetastructsize, 1, efd);
-            if ( ferror( efd ) ) {
-                snprintf(str, FTI_BUFS, "FTI_RSenc - could not write metadata in file: %s", efn);
-                FTI_Print(str, FTI_EROR);
-                errno=0;
-                free(data);
-                free(matrix);
-                free(coding);
-                free(myData);
-                fclose(lfd);
-                fclose(efd);
-                return FTI_NSCS;
-            }
-            free( buffer_ser );
+    long fs = FTI_Exec->meta[0].fs[proc]; //ckpt file size
 
-        }
+    if (truncate(lfn, fs) == -1) {
+        FTI_Print("Error with re-truncate on checkpoint file", FTI_WARN);
+        return FTI_NSCS;
+    }
+    return FTI_SCES;
+}
 
-        free(data);
-        free(matrix);
-        free(coding);
-        free(myData);
-        fclose(lfd);
-        fclose(efd);
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It performs RS encoding with the ckpt. files in to the group.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      FTI_Ckpt        Checkpoint metadata.
+  @return     integer         FTI_SCES if successful.
 
-        long fs = FTI_Exec->meta[0].fs[proc]; //ckpt file size
+  This function performs the Reed-Solomon encoding for a given group. The
+  checkpoint files are padded to the maximum size of the largest checkpoint
+  file in the group +- the extra space to be a multiple of block size.
 
-        if (truncate(lfn, fs) == -1) {
-            FTI_Print("Error with re-truncate on checkpoint file", FTI_WARN);
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_RSenc(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt)
+{
+    FTI_Print("Starting checkpoint post-processing L3", FTI_DBUG);
+    if (FTI_Topo->amIaHead) {
+        int res = FTI_Try(FTI_LoadTmpMeta(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt), "load temporary metadata.");
+        if (res != FTI_SCES) {
             return FTI_NSCS;
         }
+    }
+    int startProc, endProc;
+    if (FTI_Topo->amIaHead) {
+        startProc = 1;
+        endProc = FTI_Topo->nodeSize;
+    }
+    else {
+        startProc = 0;
+        endProc = 1;
+    }
+
+    // the tables of the Galois field are created here, before any thread uses them
+    int* matrix = talloc(int, FTI_Topo->groupSize* FTI_Topo->groupSize);
+    int i;
+    for (i = 0; i < FTI_Topo->groupSize; i++) {
+        int j;
+        for (j = 0; j < FTI_Topo->groupSize; j++) {
+            matrix[i * FTI_Topo->groupSize + j] = galois_single_divide(1, i ^ (FTI_Topo->groupSize + j), FTI_Conf->l3WordSize);
+        }
+    }
+
+    FTIT_postArgs args = { .FTI_Conf = FTI_Conf, .FTI_Exec = FTI_Exec,
+        .FTI_Topo = FTI_Topo, .FTI_Ckpt = FTI_Ckpt, .matrix = matrix };
+    args.checksums = talloc(char, endProc * MD5_DIGEST_STRING_LENGTH);
+    int res = FTI_ForEachProc(startProc, endProc, FTI_RSencProc, &args, 1);
+    free(matrix);
+    if (res != FTI_SCES) {
+        free(args.checksums);
+        return FTI_NSCS;
+    }
 
-        int res = FTI_WriteRSedChecksum(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt, rank, checksum);
+    // collective on the group: written in order, after all encodings
+    int proc;
+    for (proc = startProc; proc < endProc; proc++) {
+        int ckptID, rank;
+        sscanf(&FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS], "Ckpt%d-Rank%d.fti", &ckptID, &rank);
+        res = FTI_WriteRSedChecksum(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt, proc, rank,
+                &args.checksums[proc * MD5_DIGEST_STRING_LENGTH]);
         if (res != FTI_SCES) {
+            free(args.checksums);
             return FTI_NSCS;
         }
-}
-
-return FTI_SCES;
+    }
+    free(args.checksums);
+    return FTI_SCES;
 }
 
 
@@ -528,13 +626,14 @@ return FTI_SCES;
 int FTI_Flush(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, int level)
 {
-    if (!FTI_Topo->amIaHead && level == 0) {
+    if (!FTI_Topo->amIaHead && level == 0 && FTI_Ckpt[4].isInline) {
         return FTI_SCES; //inline L4 saves directly to PFS (nothing to flush)
     }
 
     /**
      *  FTI_Flush is either executed by application processes during
-     *  FTI_Finalize or by the heads during FTI_PostCkpt.
+     *  FTI_Finalize, by the heads during FTI_PostCkpt or by the
+     *  post-processing thread of the application processes.
      **/
 
     char str[FTI_BUFS];
@@ -666,12 +765,107 @@ int FTI_ArchiveL4Ckpt( FTIT_configuration* FTI_Conf, FTIT_execution *FTI_Exec, F
     }
 
     // needed to avoid that the files get deleted before we can move them
-    MPI_Barrier(FTI_COMM_WORLD);
+    MPI_Barrier(FTI_Exec->postComm);
 
     return FTI_SCES;
 
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It flushes the local ckpt. file of one process using POSIX.
+  @param      proc            Node rank of the application process.
+  @param      arg             Post-processing arguments (FTIT_postArgs).
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_FlushPosixProc(int proc, void* arg)
+{
+    FTIT_postArgs* args = (FTIT_postArgs*) arg;
+    FTIT_configuration* FTI_Conf = args->FTI_Conf;
+    FTIT_execution* FTI_Exec = args->FTI_Exec;
+    FTIT_checkpoint* FTI_Ckpt = args->FTI_Ckpt;
+    int level = args->level;
+
+    char str[FTI_BUFS];
+    snprintf(str, FTI_BUFS, "Post-processing for proc %d started.", proc);
+    FTI_Print(str, FTI_DBUG);
+    char lfn[FTI_BUFS], gfn[FTI_BUFS];
+    if ( FTI_Ckpt[4].isDcp ) {
+        snprintf(gfn, FTI_BUFS, "%s/%s", FTI_Ckpt[4].dcpDir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
+    } else {
+        snprintf(gfn, FTI_BUFS, "%s/%s", FTI_Conf->gTmpDir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
+    }
+    snprintf(str, FTI_BUFS, "Global temporary file name for proc %d: %s", proc, gfn);
+    FTI_Print(str, FTI_DBUG);
+    int gfd = open(gfn, O_WRONLY|O_CREAT|O_TRUNC, (mode_t) 0600);
+
+    if (gfd == -1) {
+        FTI_Print("L4 cannot open ckpt. file in the PFS.", FTI_EROR);
+        return FTI_NSCS;
+    }
+
+    if (level == 0) {
+        if ( FTI_Ckpt[4].isDcp ) {
+            snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Ckpt[1].dcpDir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
+        } else {
+            snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Conf->lTmpDir, &FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS]);
+        }
+    }
+    else {
+        snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Ckpt[level].dir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
+    }
+    snprintf(str, FTI_BUFS, "Local file name for proc %d: %s", proc, lfn);
+    FTI_Print(str, FTI_DBUG);
+
+    // node aggregation: write the checkpoint straight from shared memory
+    char* shmData = (level == 0) ? FTI_ShmCkptData(&FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS], FTI_Exec->meta[0].fs[proc]) : NULL;
+    if (shmData != NULL) {
+        long pos = 0, fs = FTI_Exec->meta[0].fs[proc];
+        while (pos < fs) {
+            long bytes = ((fs - pos) < FTI_Conf->transferSize) ? (fs - pos) : FTI_Conf->transferSize;
+            FTI_Throttle(bytes);
+            if (FTI_ShmWriteFile(gfd, shmData + pos, bytes) != FTI_SCES) {
+                FTI_Print("L4 cannot write the ckpt. file to the PFS.", FTI_EROR);
+                close(gfd);
+                return FTI_NSCS;
+            }
+            pos += bytes;
+        }
+        if (close(gfd) != 0) {
+            FTI_Print("L4 cannot close the ckpt. file in the PFS.", FTI_EROR);
+            return FTI_NSCS;
+        }
+        return FTI_SCES;
+    }
+
+    // Open local file
+    int lfd = open(lfn, O_RDONLY);
+    if (lfd == -1) {
+        FTI_Print("L4 cannot open the checkpoint file.", FTI_EROR);
+        close(gfd);
+        return FTI_NSCS;
+    }
+
+    long fs = FTI_Exec->meta[level].fs[proc];
+    snprintf(str, FTI_BUFS, "Local file size for proc %d: %ld", proc, fs);
+    FTI_Print(str, FTI_DBUG);
+    // Checkpoint files exchange (in-kernel if the file systems allow it)
+    if (FTI_CopyFileThrottled(lfd, gfd, fs, FTI_Conf->transferSize) != FTI_SCES) {
+        FTI_Print("L4 cannot copy the ckpt. file to the PFS.", FTI_EROR);
+        close(lfd);
+        close(gfd);
+        return FTI_NSCS;
+    }
+    close(lfd);
+    if (close(gfd) != 0) {
+        FTI_Print("L4 cannot close the ckpt. file in the PFS.", FTI_EROR);
+        return FTI_NSCS;
+    }
+    return FTI_SCES;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      It flushes the local ckpt. files in to the PFS using POSIX.
@@ -690,7 +884,7 @@ int FTI_FlushPosix(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, int level)
 {
     FTI_Print("Starting checkpoint post-processing L4 using Posix IO.", FTI_DBUG);
-    int startProc, endProc, proc;
+    int startProc, endProc;
     if (FTI_Topo->amIaHead) {
         startProc = 1;
         endProc = FTI_Topo->nodeSize;
@@ -700,78 +894,91 @@ int FTI_FlushPosix(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         endProc = 1;
     }
 
-    for (proc = startProc; proc < endProc; proc++) {
-        char str[FTI_BUFS];
-        snprintf(str, FTI_BUFS, "Post-processing for proc %d started.", proc);
-        FTI_Print(str, FTI_DBUG);
-        char lfn[FTI_BUFS], gfn[FTI_BUFS];
-        if ( FTI_Ckpt[4].isDcp ) {
-            snprintf(gfn, FTI_BUFS, "%s/%s", FTI_Ckpt[4].dcpDir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
-        } else {
-            snprintf(gfn, FTI_BUFS, "%s/%s", FTI_Conf->gTmpDir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
-        }
-        snprintf(str, FTI_BUFS, "Global temporary file name for proc %d: %s", proc, gfn);
-        FTI_Print(str, FTI_DBUG);
-        FILE* gfd = fopen(gfn, "wb");
+    FTIT_postArgs args = { .FTI_Conf = FTI_Conf, .FTI_Exec = FTI_Exec,
+        .FTI_Topo = FTI_Topo, .FTI_Ckpt = FTI_Ckpt, .level = level };
+    return FTI_ForEachProc(startProc, endProc, FTI_FlushPosixProc, &args, 0);
+}
 
-        if (gfd == NULL) {
-            FTI_Print("L4 cannot open ckpt. file in the PFS.", FTI_EROR);
-            return FTI_NSCS;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It flushes the local ckpt. file of one process using MPI-I/O.
+  @param      proc            Node rank of the application process.
+  @param      arg             Post-processing arguments (FTIT_postArgs).
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_FlushMPIProc(int proc, void* arg)
+{
+    FTIT_postArgs* args = (FTIT_postArgs*) arg;
+    FTIT_configuration* FTI_Conf = args->FTI_Conf;
+    FTIT_execution* FTI_Exec = args->FTI_Exec;
+    int level = args->level;
+
+    MPI_Offset offset = args->offsets[proc - args->startProc];
+
+    // node aggregation: write the checkpoint straight from shared memory
+    char* shmData = (level == 0) ? FTI_ShmCkptData(&FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS], FTI_Exec->meta[0].fs[proc]) : NULL;
+    FILE* lfd = (shmData == NULL) ? fopen(&args->localFileNames[FTI_BUFS * proc], "rb") : NULL;
+    if (shmData == NULL && lfd == NULL) {
+        FTI_Print("L4 cannot open the checkpoint file.", FTI_EROR);
+        return FTI_NSCS;
+    }
+
+    char* readData = talloc(char, FTI_Conf->transferSize);
+    long bSize = FTI_Conf->transferSize;
+    long fs = FTI_Exec->meta[level].fs[proc];
+
+    long pos = 0;
+    // Checkpoint files exchange
+    while (pos < fs) {
+        if ((fs - pos) < FTI_Conf->transferSize) {
+            bSize = fs - pos;
         }
 
-        if (level == 0) {
-            if ( FTI_Ckpt[4].isDcp ) {
-                snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Ckpt[1].dcpDir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
-            } else {
-                snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Conf->lTmpDir, &FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS]);
-            }
+        char* src = readData;
+        size_t bytes;
+        if (shmData != NULL) {
+            src = shmData + pos;
+            bytes = bSize;
         }
         else {
-            snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Ckpt[level].dir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
+            bytes = fread(readData, sizeof(char), bSize, lfd);
         }
-        snprintf(str, FTI_BUFS, "Local file name for proc %d: %s", proc, lfn);
-        FTI_Print(str, FTI_DBUG);
-        // Open local file
-        FILE* lfd = fopen(lfn, "rb");
-        if (lfd == NULL) {
-            FTI_Print("L4 cannot open the checkpoint file.", FTI_EROR);
-            fclose(gfd);
+        if (lfd != NULL && ferror(lfd)) {
+            FTI_Print("L4 cannot read from the ckpt. file.", FTI_EROR);
+            free(readData);
+            fclose(lfd);
             return FTI_NSCS;
         }
-
-        char *readData = talloc(char, FTI_Conf->transferSize);
-        long bSize = FTI_Conf->transferSize;
-        long fs = FTI_Exec->meta[level].fs[proc];
-        snprintf(str, FTI_BUFS, "Local file size for proc %d: %ld", proc, fs);
-        FTI_Print(str, FTI_DBUG);
-        long pos = 0;
-        // Checkpoint files exchange
-        while (pos < fs) {
-            if ((fs - pos) < FTI_Conf->transferSize)
-                bSize = fs - pos;
-
-            size_t bytes = fread(readData, sizeof(char), bSize, lfd);
-            if (ferror(lfd)) {
-                FTI_Print("L4 cannot read from the ckpt. file.", FTI_EROR);
-                free(readData);
-                fclose(lfd);
-                fclose(gfd);
-                return FTI_NSCS;
-            }
-
-            fwrite(readData, sizeof(char), bytes, gfd);
-            if (ferror(gfd)) {
-                FTI_Print("L4 cannot write to the ckpt. file in the PFS.", FTI_EROR);
-                free(readData);
+        MPI_Datatype dType;
+        MPI_Type_contiguous(bytes, MPI_BYTE, &dType);
+        MPI_Type_commit(&dType);
+
+        FTI_Throttle(bytes);
+        int res = MPI_File_write_at(args->pfh, offset, src, 1, dType, MPI_STATUS_IGNORE);
+        // check if successful
+        if (res != 0) {
+            errno = 0;
+            char mpi_err[FTI_BUFS];
+            MPI_Error_string(res, mpi_err, NULL);
+            char str[FTI_BUFS];
+            snprintf(str, FTI_BUFS, "Failed to write data to PFS during MPIIO Flush [MPI ERROR - %i] %s", res, mpi_err);
+            FTI_Print(str, FTI_EROR);
+            MPI_Type_free(&dType);
+            free(readData);
+            if (lfd != NULL) {
                 fclose(lfd);
-                fclose(gfd);
-                return FTI_NSCS;
             }
-            pos = pos + bytes;
+            return FTI_NSCS;
         }
-        free(readData);
+        MPI_Type_free(&dType);
+        offset += bytes;
+        pos = pos + bytes;
+    }
+    free(readData);
+    if (lfd != NULL) {
         fclose(lfd);
-        fclose(gfd);
     }
     return FTI_SCES;
 }
@@ -795,21 +1002,21 @@ int FTI_FlushMPI(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 {
     int res;
     FTI_Print("Starting checkpoint post-processing L4 using MPI-IO.", FTI_DBUG);
-    // enable collective buffer optimization
+    // set MPI-IO hints ([MPIIO] section and calibration)
     MPI_Info info;
-    MPI_Info_create(&info);
-    MPI_Info_set(info, "romio_cb_write", "enable");
-    // TODO enable to set stripping unit in the config file (Maybe also other hints)
-    // set stripping unit to 4MB
-    MPI_Info_set(info, "stripping_unit", "4194304");
+    FTI_CreateMpiioInfo(FTI_Conf, &info, FTI_MPIIO_WRITE);
 
     // open parallel file (collective call)
     MPI_File pfh; // MPI-IO file handle
     char gfn[FTI_BUFS], str[FTI_BUFS], ckptFile[FTI_BUFS];
-    snprintf(ckptFile, FTI_BUFS, "Ckpt%d-mpiio.fti", FTI_Exec->ckptID);
+    FTI_MpiioFileName(FTI_Conf, FTI_Exec, FTI_Topo, ckptFile);
     snprintf(gfn, FTI_BUFS, "%s/%s", FTI_Conf->gTmpDir, ckptFile);
+    // one shared file, or one subfile per group of nodes
+    MPI_Comm fileComm = FTI_MpiioComm(FTI_Conf, FTI_Exec, FTI_Topo);
+    int fileRank;
+    MPI_Comm_rank(fileComm, &fileRank);
 #ifdef LUSTRE
-    if (FTI_Topo->splitRank == 0) {
+    if (fileRank == 0) {
         res = llapi_file_create(gfn, FTI_Conf->stripeUnit, FTI_Conf->stripeOffset, FTI_Conf->stripeFactor, 0);
         if (res) {
             char error_msg[FTI_BUFS];
@@ -824,7 +1031,7 @@ int FTI_FlushMPI(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         }
     }
 #endif
-    res = MPI_File_open(FTI_COMM_WORLD, gfn, MPI_MODE_WRONLY|MPI_MODE_CREATE, info, &pfh);
+    res = MPI_File_open(fileComm, gfn, MPI_MODE_WRONLY|MPI_MODE_CREATE, info, &pfh);
     if (res != 0) {
         errno = 0;
         char mpi_err[FTI_BUFS];
@@ -848,7 +1055,7 @@ int FTI_FlushMPI(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     int nbProc = endProc - startProc;
     MPI_Offset* localFileSizes = talloc(MPI_Offset, nbProc);
     char* localFileNames = talloc(char, FTI_BUFS * endProc);
-    int* splitRanks = talloc(int, endProc); //rank of process in FTI_COMM_WORLD
+    MPI_Offset* offsets = talloc(MPI_Offset, nbProc); //file offset of each local checkpoint
     for (proc = startProc; proc < endProc; proc++) {
         if (level == 0) {
             snprintf(&localFileNames[proc * FTI_BUFS], FTI_BUFS, "%s/%s", FTI_Conf->lTmpDir, &FTI_Exec->meta[0].ckptFile[proc * FTI_BUFS]);
@@ -856,88 +1063,28 @@ int FTI_FlushMPI(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         else {
             snprintf(&localFileNames[proc * FTI_BUFS], FTI_BUFS, "%s/%s", FTI_Ckpt[level].dir, &FTI_Exec->meta[level].ckptFile[proc * FTI_BUFS]);
         }
-        if (FTI_Topo->amIaHead) {
-            splitRanks[proc] = (FTI_Topo->nodeSize - 1) * FTI_Topo->nodeID + proc - 1; //determine process splitRank if head
-        }
-        else {
-            splitRanks[proc] = FTI_Topo->splitRank;
-        }
         localFileSizes[proc - startProc] = FTI_Exec->meta[level].fs[proc]; //[proc - startProc] to get index from 0
     }
 
-    MPI_Offset* allFileSizes = talloc(MPI_Offset, FTI_Topo->nbApprocs * FTI_Topo->nbNodes);
-    MPI_Allgather(localFileSizes, nbProc, MPI_OFFSET, allFileSizes, nbProc, MPI_OFFSET, FTI_COMM_WORLD);
+    // a head writes the chunks of all application processes of its node
+    res = FTI_MpiioOffsets(FTI_Conf, FTI_Exec, FTI_Topo, pfh, localFileSizes, nbProc, offsets);
     free(localFileSizes);
-
-    for (proc = startProc; proc < endProc; proc++) {
-        MPI_Offset offset = 0;
-        int i;
-        for (i = 0; i < splitRanks[proc]; i++) {
-            offset += allFileSizes[i];
-        }
-
-        FILE* lfd = fopen(&localFileNames[FTI_BUFS * proc], "rb");
-        if (lfd == NULL) {
-            FTI_Print("L4 cannot open the checkpoint file.", FTI_EROR);
-            free(localFileNames);
-            free(allFileSizes);
-            free(splitRanks);
-            return FTI_NSCS;
-        }
-
-        char* readData = talloc(char, FTI_Conf->transferSize);
-        long bSize = FTI_Conf->transferSize;
-        long fs = FTI_Exec->meta[level].fs[proc];
-
-        long pos = 0;
-        // Checkpoint files exchange
-        while (pos < fs) {
-            if ((fs - pos) < FTI_Conf->transferSize) {
-                bSize = fs - pos;
-            }
-
-            size_t bytes = fread(readData, sizeof(char), bSize, lfd);
-            if (ferror(lfd)) {
-                FTI_Print("L4 cannot read from the ckpt. file.", FTI_EROR);
-                free(localFileNames);
-                free(allFileSizes);
-                free(splitRanks);
-                free(readData);
-                fclose(lfd);
-                MPI_File_close(&pfh);
-                return FTI_NSCS;
-            }
-            MPI_Datatype dType;
-            MPI_Type_contiguous(bytes, MPI_BYTE, &dType);
-            MPI_Type_commit(&dType);
-
-            res = MPI_File_write_at(pfh, offset, readData, 1, dType, MPI_STATUS_IGNORE);
-            // check if successful
-            if (res != 0) {
-                errno = 0;
-                char mpi_err[FTI_BUFS];
-                MPI_Error_string(res, mpi_err, NULL);
-                snprintf(str, FTI_BUFS, "Failed to write data to PFS during MPIIO Flush [MPI ERROR - %i] %s", res, mpi_err);
-                FTI_Print(str, FTI_EROR);
-                free(localFileNames);
-                free(splitRanks);
-                free(allFileSizes);
-                fclose(lfd);
-                MPI_File_close(&pfh);
-                return FTI_NSCS;
-            }
-            MPI_Type_free(&dType);
-            offset += bytes;
-            pos = pos + bytes;
-        }
-        free(readData);
-        fclose(lfd);
+    if (res != FTI_SCES) {
+        free(localFileNames);
+        free(offsets);
+        MPI_File_close(&pfh);
+        return FTI_NSCS;
     }
+
+    FTIT_postArgs args = { .FTI_Conf = FTI_Conf, .FTI_Exec = FTI_Exec,
+        .FTI_Topo = FTI_Topo, .FTI_Ckpt = FTI_Ckpt, .level = level,
+        .localFileNames = localFileNames, .offsets = offsets,
+        .startProc = startProc, .pfh = pfh };
+    res = FTI_ForEachProc(startProc, endProc, FTI_FlushMPIProc, &args, 1);
     free(localFileNames);
-    free(allFileSizes);
-    free(splitRanks);
+    free(offsets);
     MPI_File_close(&pfh);
-    return FTI_SCES;
+    return res;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -1009,7 +1156,7 @@ int FTI_FlushSionlib(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         ranks[i] = splitRanks[i];
         rank_map[i] = splitRanks[i];
     }
-    int sid = sion_paropen_mapped_mpi(fn, "wb,posix", &numFiles, FTI_COMM_WORLD, &nlocaltasks, &ranks, &chunkSizes, &file_map, &rank_map, &fsblksize, NULL);
+    int sid = sion_paropen_mapped_mpi(fn, "wb,posix", &numFiles, FTI_Exec->postComm, &nlocaltasks, &ranks, &chunkSizes, &file_map, &rank_map, &fsblksize, NULL);
     if (sid == -1) {
         FTI_Print("Cannot open with sion_paropen_mapped_mpi.", FTI_EROR);
 
@@ -367,6 +367,7 @@ int FTI_Decode(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTIFFMeta->fs = maxFs;
     FTIFFMeta->ptFs = -1;
     FTIFFMeta->maxFs = maxFs;
+    FTIFFMeta->codec = FTI_CODEC_NONE;
     FTIFFMeta->ckptSize = fs;
 
     char checksum[MD5_DIGEST_STRING_LENGTH];
@@ -457,7 +458,7 @@ int FTI_RecoverL1(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt)
 {
   if (FTI_Conf->ioMode == FTI_IO_FTIFF) {
-    if ( FTIFF_CheckL1RecoverInit( FTI_Exec, FTI_Topo, FTI_Ckpt ) != FTI_SCES ) {
+    if ( FTIFF_CheckL1RecoverInit( FTI_Exec, FTI_Topo, FTI_Ckpt, FTI_Conf ) != FTI_SCES ) {
       FTI_Print("No restart possible from L1. Ckpt files missing.", FTI_DBUG);
       return FTI_NSCS;
     }
@@ -907,7 +908,7 @@ int FTI_RecoverL4Posix(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 
   // Checking erasures
   if (FTI_Conf->ioMode == FTI_IO_FTIFF) {
-    if ( FTIFF_CheckL4RecoverInit( FTI_Exec, FTI_Topo, FTI_Ckpt ) != FTI_SCES ) {
+    if ( FTIFF_CheckL4RecoverInit( FTI_Exec, FTI_Topo, FTI_Ckpt, FTI_Conf ) != FTI_SCES ) {
       FTI_Print("No restart possible from L4. Ckpt files missing.", FTI_DBUG);
       return FTI_NSCS;
     }
@@ -1038,23 +1039,21 @@ int FTI_RecoverL4Mpi(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     }
   }
 
-  // enable collective buffer optimization
+  // set MPI-IO hints ([MPIIO] section and calibration)
   MPI_Info info;
-  MPI_Info_create(&info);
-  MPI_Info_set(info, "romio_cb_read", "enable");
-
-  // set stripping unit to 4MB
-  MPI_Info_set(info, "stripping_unit", "4194304");
+  FTI_CreateMpiioInfo(FTI_Conf, &info, FTI_MPIIO_READ);
 
   snprintf(FTI_Exec->meta[1].ckptFile, FTI_BUFS, "Ckpt%d-Rank%d.fti", FTI_Exec->ckptID, FTI_Topo->myRank);
-  snprintf(FTI_Exec->meta[4].ckptFile, FTI_BUFS, "Ckpt%d-mpiio.fti", FTI_Exec->ckptID);
+  FTI_MpiioFileName(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Exec->meta[4].ckptFile);
   char gfn[FTI_BUFS], lfn[FTI_BUFS];
   snprintf(lfn, FTI_BUFS, "%s/%s", FTI_Ckpt[1].dir, FTI_Exec->meta[1].ckptFile);
   snprintf(gfn, FTI_BUFS, "%s/%s", FTI_Ckpt[4].dir, FTI_Exec->meta[4].ckptFile);
 
-  // open parallel file
+  // open parallel file (one shared file, or one subfile per group of nodes)
   MPI_File pfh;
-  int buf = MPI_File_open(FTI_COMM_WORLD, gfn, MPI_MODE_RDWR, info, &pfh);
+  MPI_Comm fileComm = FTI_MpiioComm(FTI_Conf, FTI_Exec, FTI_Topo);
+  int buf = MPI_File_open(fileComm, gfn, MPI_MODE_RDWR, info, &pfh);
+  MPI_Info_free(&info);
   // check if successful
   if (buf != 0) {
     errno = 0;
@@ -1069,36 +1068,59 @@ int FTI_RecoverL4Mpi(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     return FTI_NSCS;
   }
 
-  // collect chunksizes of other ranks
-  MPI_Offset* chunkSizes = talloc(MPI_Offset, FTI_Topo->nbApprocs*FTI_Topo->nbNodes);
-  MPI_Allgather(FTI_Exec->meta[4].fs, 1, MPI_OFFSET, chunkSizes, 1, MPI_OFFSET, FTI_COMM_WORLD);
+  // errors are recorded and agreed on at the end, the ranks of fileComm
+  // must all take part in the collective calls
+  int res = FTI_SCES;
 
+  // set file offset (from the subfile index or the chunksizes of other ranks)
   MPI_Offset offset = 0;
-  // set file offset
-  int i;
-  for (i = 0; i < FTI_Topo->splitRank; i++) {
-    offset += chunkSizes[i];
+  if (FTI_MpiioLocateChunk(FTI_Conf, FTI_Exec, FTI_Topo, pfh, FTI_Exec->meta[4].fs[0], &offset) != FTI_SCES) {
+    res = FTI_NSCS;
   }
-  free(chunkSizes);
 
-  FILE *lfd = fopen(lfn, "wb");
-  if (lfd == NULL) {
-    FTI_Print("R4 cannot open the local ckpt. file.", FTI_DBUG);
-    MPI_File_close(&pfh);
-    return FTI_NSCS;
+  FILE *lfd = NULL;
+  if (res == FTI_SCES) {
+    lfd = fopen(lfn, "wb");
+    if (lfd == NULL) {
+      FTI_Print("R4 cannot open the local ckpt. file.", FTI_DBUG);
+      res = FTI_NSCS;
+    }
   }
 
   long fs = FTI_Exec->meta[4].fs[0];
   char *readData = talloc(char, FTI_Conf->transferSize);
+  if (readData == NULL) {
+    FTI_Print("R4 cannot allocate the transfer buffer.", FTI_EROR);
+    res = FTI_NSCS;
+  }
   long bSize = FTI_Conf->transferSize;
   long pos = 0;
+  // with collective reads, all ranks have to do the same number of calls
+  long nbReads = (res == FTI_SCES) ? (fs + FTI_Conf->transferSize - 1) / FTI_Conf->transferSize : 0;
+  long maxReads = nbReads;
+  if (FTI_Conf->mpiioCollective) {
+    MPI_Allreduce(&nbReads, &maxReads, 1, MPI_LONG, MPI_MAX, fileComm);
+  }
   // Checkpoint files transfer from PFS
-  while (pos < fs) {
-    if ((fs - pos) < FTI_Conf->transferSize) {
+  while ((res == FTI_SCES && pos < fs) || maxReads > 0) {
+    // after an error, the remaining collective reads are empty
+    if (res != FTI_SCES) {
+      bSize = 0;
+    }
+    else if ((fs - pos) < FTI_Conf->transferSize) {
       bSize = fs - pos;
     }
     // read block in parallel file
-    buf = MPI_File_read_at(pfh, offset, readData, bSize, MPI_BYTE, MPI_STATUS_IGNORE);
+    if (FTI_Conf->mpiioCollective) {
+      buf = MPI_File_read_at_all(pfh, offset, readData, bSize, MPI_BYTE, MPI_STATUS_IGNORE);
+      maxReads--;
+    } else {
+      buf = MPI_File_read_at(pfh, offset, readData, bSize, MPI_BYTE, MPI_STATUS_IGNORE);
+      maxReads = 0;
+    }
+    if (res != FTI_SCES) {
+      continue;
+    }
     // check if successful
     if (buf != 0) {
       errno = 0;
@@ -1108,19 +1130,15 @@ int FTI_RecoverL4Mpi(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
       MPI_Error_string(buf, mpi_err, &reslen);
       snprintf(str, FTI_BUFS, "R4 cannot read from the ckpt. file in the PFS. [MPI ERROR - %i] %s", buf, mpi_err);
       FTI_Print(str, FTI_EROR);
-      free(readData);
-      MPI_File_close(&pfh);
-      fclose(lfd);
-      return FTI_NSCS;
+      res = FTI_NSCS;
+      continue;
     }
 
     fwrite(readData, sizeof(char), bSize, lfd);
     if (ferror(lfd)) {
       FTI_Print("R4 cannot write to the local ckpt. file.", FTI_DBUG);
-      free(readData);
-      fclose(lfd);
-      MPI_File_close(&pfh);
-      return  FTI_NSCS;
+      res = FTI_NSCS;
+      continue;
     }
 
     offset += bSize;
@@ -1128,14 +1146,19 @@ int FTI_RecoverL4Mpi(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   }
 
   free(readData);
-  fclose(lfd);
+  if (lfd != NULL) {
+    fclose(lfd);
+  }
 
   if (MPI_File_close(&pfh) != 0) {
     FTI_Print("Cannot close MPI file.", FTI_WARN);
-    return FTI_NSCS;
+    res = FTI_NSCS;
   }
 
-  return FTI_SCES;
+  // the recovery fails for all the ranks of the file if one failed
+  int allRes;
+  MPI_Allreduce(&res, &allRes, 1, MPI_INT, MPI_MIN, fileComm);
+  return (allRes == FTI_SCES) ? FTI_SCES : FTI_NSCS;
 }
 
 /*-------------------------------------------------------------------------*/
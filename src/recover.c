@@ -37,6 +37,7 @@
  */
 
 #include "interface.h"
+#include <pthread.h>
 
 /*-------------------------------------------------------------------------*/
 /**
@@ -95,6 +96,8 @@ int FTI_CheckFile(char* fn, long fs, char* checksum)
   This function detects all the erasures for L1, L2 and L3. It return the
   results in the erased array. The search for erasures is done at the
   three levels independently on the current recovery level.
+  With 'Advanced:verify_on_load', the checksums of the L1 and L4 files
+  are verified when the data is loaded (FTI_LoadCkptFile).
 
  **/
 /*-------------------------------------------------------------------------*/
@@ -120,7 +123,7 @@ int FTI_CheckErasures(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     switch (level) {
         case 1:
             snprintf(fn, FTI_BUFS, "%s/%s", FTI_Ckpt[1].dir, ckptFile);
-            buf = FTI_CheckFile(fn, fs, checksum);
+            buf = FTI_CheckFile(fn, fs, (FTI_Conf->verifyOnLoad) ? "" : checksum);
             MPI_Allgather(&buf, 1, MPI_INT, erased, 1, MPI_INT, FTI_Exec->groupComm);
             break;
         case 2:
@@ -145,7 +148,7 @@ int FTI_CheckErasures(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
             break;
         case 4:
             snprintf(fn, FTI_BUFS, "%s/%s", FTI_Ckpt[4].dir, ckptFile);
-            buf = FTI_CheckFile(fn, fs, checksum);
+            buf = FTI_CheckFile(fn, fs, (FTI_Conf->verifyOnLoad) ? "" : checksum);
             MPI_Allgather(&buf, 1, MPI_INT, erased, 1, MPI_INT, FTI_Exec->groupComm);
             break;
     }
@@ -303,3 +306,472 @@ int FTI_RecoverFiles(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         return FTI_SCES;
     }
 }
+
+/** Size of the reads issued by FTI_ReadPieces.                            */
+#define FTI_READ_PIECE (4 * 1024 * 1024)
+
+/** @typedef    FTIT_readJob
+ *  @brief      Pieces of a file read concurrently by FTI_ReadPieces.
+ */
+typedef struct FTIT_readJob {
+    int             fd;                 /**< File read.                     */
+    FTIT_readPiece* pieces;             /**< At most FTI_READ_PIECE each.   */
+    int*            next;               /**< Next piece of the same digest. */
+    char*           done;               /**< 1 once a piece is read.        */
+    MD5_CTX*        digests;            /**< Digests updated.               */
+    int*            hashNext;           /**< Next piece to hash per digest. */
+    char*           hashing;            /**< 1 while a digest is updated.   */
+    pthread_mutex_t lock;               /**< Protects done and the above.   */
+} FTIT_readJob;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reads one piece and updates its digest with the pieces read.
+  @param      p               Piece to read.
+  @param      arg             The FTIT_readJob.
+  @return     integer         FTI_SCES if successful.
+
+  The thread that reads the next piece to hash of a digest hashes it,
+  followed by the pieces after it already read by other threads, so
+  that the digest is updated in order while the data is in cache.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_ReadPiece(int p, void* arg)
+{
+    FTIT_readJob* job = (FTIT_readJob*) arg;
+    FTIT_readPiece* piece = &job->pieces[p];
+    long rcount = 0;
+    while (rcount < piece->size) {
+        ssize_t res = pread(job->fd, piece->dst + rcount, piece->size - rcount, piece->offset + rcount);
+        if (res == -1 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return FTI_NSCS;
+        }
+        rcount += res;
+    }
+    int d = piece->digest;
+    if (d < 0) {
+        return FTI_SCES;
+    }
+    pthread_mutex_lock(&job->lock);
+    job->done[p] = 1;
+    if (!job->hashing[d]) {
+        job->hashing[d] = 1;
+        int q;
+        while ((q = job->hashNext[d]) >= 0 && job->done[q]) {
+            pthread_mutex_unlock(&job->lock);
+            MD5_Update(&job->digests[d], job->pieces[q].dst, job->pieces[q].size);
+            pthread_mutex_lock(&job->lock);
+            job->hashNext[d] = job->next[q];
+        }
+        job->hashing[d] = 0;
+    }
+    pthread_mutex_unlock(&job->lock);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reads parts of a file with the worker threads.
+  @param      fd              File descriptor.
+  @param      pieces          Parts to read.
+  @param      nbPieces        Number of parts.
+  @param      digests         Digests updated with the parts read.
+  @param      nbDigests       Number of digests.
+  @return     integer         FTI_SCES if successful.
+
+  The parts are split in reads of FTI_READ_PIECE bytes, issued in
+  parallel by the threads of FTI_ForEachProc ('recover_threads' at
+  restart) straight into the destination buffers. The digests are
+  updated as the data arrives (FTI_ReadPiece), thus the reads are not
+  serialized by the verification.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_ReadPieces(int fd, FTIT_readPiece* pieces, int nbPieces, MD5_CTX* digests, int nbDigests)
+{
+    int nb = 0, i, p;
+    for (i = 0; i < nbPieces; i++) {
+        nb += (pieces[i].size + FTI_READ_PIECE - 1) / FTI_READ_PIECE;
+    }
+
+    FTIT_readJob job;
+    job.fd = fd;
+    job.pieces = talloc(FTIT_readPiece, nb + 1);
+    job.next = talloc(int, nb + 1);
+    job.done = (char*) calloc(nb + 1, sizeof(char));
+    job.digests = digests;
+    job.hashNext = talloc(int, nbDigests + 1);
+    job.hashing = (char*) calloc(nbDigests + 1, sizeof(char));
+    int* last = talloc(int, nbDigests + 1);
+    int res = FTI_NSCS;
+    if (job.pieces == NULL || job.next == NULL || job.done == NULL || job.hashNext == NULL ||
+            job.hashing == NULL || last == NULL) {
+        FTI_Print("Could not allocate the pieces of the file to read.", FTI_EROR);
+        goto done;
+    }
+
+    // pieces of a digest are chained in order
+    for (i = 0; i < nbDigests; i++) {
+        job.hashNext[i] = -1;
+        last[i] = -1;
+    }
+    p = 0;
+    for (i = 0; i < nbPieces; i++) {
+        long pos;
+        for (pos = 0; pos < pieces[i].size; pos += FTI_READ_PIECE) {
+            int d = pieces[i].digest;
+            job.pieces[p].dst = pieces[i].dst + pos;
+            job.pieces[p].offset = pieces[i].offset + pos;
+            job.pieces[p].size = (pieces[i].size - pos < FTI_READ_PIECE) ? pieces[i].size - pos : FTI_READ_PIECE;
+            job.pieces[p].digest = d;
+            job.next[p] = -1;
+            if (d >= 0) {
+                if (last[d] < 0) {
+                    job.hashNext[d] = p;
+                } else {
+                    job.next[last[d]] = p;
+                }
+                last[d] = p;
+            }
+            p++;
+        }
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    res = FTI_ForEachProc(0, nb, FTI_ReadPiece, &job, 0);
+    pthread_mutex_destroy(&job.lock);
+
+done:
+    free(job.pieces);
+    free(job.next);
+    free(job.done);
+    free(job.hashNext);
+    free(job.hashing);
+    free(last);
+    return res;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Computes the MD5 digest of a file with the worker threads.
+  @param      fd              File descriptor.
+  @param      size            Size of the file.
+  @param      mdContext       Digest updated.
+  @return     integer         FTI_SCES if successful.
+
+  The file is read through a window of two pieces per thread.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_HashFile(int fd, long size, MD5_CTX* mdContext)
+{
+    long window = 2L * FTI_READ_PIECE * FTI_GetThreadCount();
+    if (window > size) {
+        window = size;
+    }
+    char* buf = (char*) malloc(window + 1);
+    if (buf == NULL) {
+        FTI_Print("Could not allocate the buffer to hash the file.", FTI_EROR);
+        return FTI_NSCS;
+    }
+    long pos;
+    for (pos = 0; pos < size; pos += window) {
+        FTIT_readPiece piece;
+        piece.dst = buf;
+        piece.offset = pos;
+        piece.size = (size - pos < window) ? size - pos : window;
+        piece.digest = 0;
+        if (FTI_ReadPieces(fd, &piece, 1, mdContext, 1) != FTI_SCES) {
+            free(buf);
+            return FTI_NSCS;
+        }
+    }
+    free(buf);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Compares the digest of a checkpoint file to its checksum.
+  @param      mdContext       Digest of the file.
+  @param      checksum        Checksum stored in the metadata.
+  @param      fn              Path of the checkpoint file.
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_CheckDigest(MD5_CTX* mdContext, char* checksum, char* fn)
+{
+    unsigned char hash[MD5_DIGEST_LENGTH];
+    MD5_Final(hash, mdContext);
+    char fileChecksum[MD5_DIGEST_STRING_LENGTH];
+    int i, ii = 0;
+    for (i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        sprintf(&fileChecksum[ii], "%02x", hash[i]);
+        ii += 2;
+    }
+    if (strcmp(fileChecksum, checksum) != 0) {
+        char str[FTI_BUFS];
+        snprintf(str, FTI_BUFS, "Checksum do not match. \"%s\" file is corrupted. %s != %s",
+                fn, fileChecksum, checksum);
+        FTI_Print(str, FTI_WARN);
+        return FTI_NREC;
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Reads all the datasets of a checkpoint file with threads.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      fn              Path of the checkpoint file.
+  @param      checksum        Checksum to verify, NULL for none.
+  @return     integer         FTI_SCES if successful.
+
+  The datasets must all be in host memory.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_ReadCkptFile(FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data,
+        char* fn, char* checksum)
+{
+    char str[FTI_BUFS];
+    int level = FTI_Exec->ckptLvel;
+    int nbVar = FTI_Exec->meta[level].nbVar[0];
+
+    int fd = open(fn, O_RDONLY);
+    if (fd == -1) {
+        snprintf(str, FTI_BUFS, "Could not open FTI checkpoint file. (%s)...", fn);
+        FTI_Print(str, FTI_EROR);
+        return FTI_NREC;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        snprintf(str, FTI_BUFS, "Could not get the size of FTI checkpoint file. (%s)...", fn);
+        FTI_Print(str, FTI_EROR);
+        close(fd);
+        return FTI_NREC;
+    }
+    long fs = (long) st.st_size;
+
+    FTIT_readPiece* pieces = talloc(FTIT_readPiece, nbVar + 1);
+    if (pieces == NULL) {
+        FTI_Print("Could not allocate the pieces of the checkpoint file.", FTI_EROR);
+        close(fd);
+        return FTI_NREC;
+    }
+    char* tail = NULL;
+    long offset = 0;
+    int i, nb = 0;
+    for (i = 0; i < nbVar; i++) {
+        long size = FTI_Exec->meta[level].varSize[i];
+        if (offset + size > fs) {
+            snprintf(str, FTI_BUFS, "FTI checkpoint file (%s) is truncated.", fn);
+            FTI_Print(str, FTI_EROR);
+            free(pieces);
+            close(fd);
+            return FTI_NREC;
+        }
+        pieces[nb].dst = (char*) FTI_Data[i].ptr;
+        pieces[nb].offset = offset;
+        pieces[nb].size = size;
+        pieces[nb].digest = (checksum != NULL) ? 0 : -1;
+        nb++;
+        offset += size;
+    }
+    // bytes after the datasets are part of the checksum
+    if (checksum != NULL && fs > offset) {
+        tail = (char*) malloc(fs - offset);
+        if (tail == NULL) {
+            FTI_Print("Could not allocate the end of the checkpoint file.", FTI_EROR);
+            free(pieces);
+            close(fd);
+            return FTI_NREC;
+        }
+        pieces[nb].dst = tail;
+        pieces[nb].offset = offset;
+        pieces[nb].size = fs - offset;
+        pieces[nb].digest = 0;
+        nb++;
+    }
+
+    MD5_CTX mdContext;
+    MD5_Init(&mdContext);
+    int res = FTI_ReadPieces(fd, pieces, nb, &mdContext, 1);
+    if (res != FTI_SCES) {
+        snprintf(str, FTI_BUFS, "Could not read FTI checkpoint file. (%s)...", fn);
+        FTI_Print(str, FTI_EROR);
+        res = FTI_NREC;
+    }
+    else if (checksum != NULL) {
+        res = FTI_CheckDigest(&mdContext, checksum, fn);
+        FTI_Exec->recoVerified = (res == FTI_SCES);
+    }
+
+    free(tail);
+    free(pieces);
+    close(fd);
+    return res;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Loads the protected data from a checkpoint file.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      FTI_Ckpt        Checkpoint metadata.
+  @param      FTI_Data        Dataset metadata.
+  @param      fn              Path of the checkpoint file.
+  @param      varIdx          Dataset to load, -1 for all datasets.
+  @return     integer         FTI_SCES if successful.
+
+  Maps the checkpoint file (datasets stored one after the other) and
+  copies the datasets into the protected buffers, or to the device for
+  device pointers. With 'Advanced:verify_on_load', the file checksum is
+  computed in the same pass, in windows of CHUNK_SIZE bytes that are
+  still in cache after the copy, and compared to the one stored in the
+  metadata. The file is verified once per recovery, thus datasets
+  skipped are hashed as well. With several 'Advanced:recover_threads'
+  and all datasets in host memory, the file is read in parallel by
+  FTI_ReadPieces instead. With 'Advanced:lazy_recovery', the
+  datasets in host memory are restored on first touch instead
+  (FTI_LazyAdd) and the mapping is released by the restoring thread.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_LoadCkptFile(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt,
+        FTIT_dataset* FTI_Data, char* fn, int varIdx)
+{
+    char str[FTI_BUFS];
+    int level = FTI_Exec->ckptLvel;
+
+    // checksum of the file, if not verified yet
+    char checksum[MD5_DIGEST_STRING_LENGTH], ptnerChecksum[MD5_DIGEST_STRING_LENGTH], rsChecksum[MD5_DIGEST_STRING_LENGTH];
+    bool verify = FTI_Conf->verifyOnLoad && !FTI_Exec->recoVerified;
+    if (verify && (FTI_GetChecksums(FTI_Conf, FTI_Exec, FTI_Topo, FTI_Ckpt, checksum, ptnerChecksum, rsChecksum) != FTI_SCES ||
+                strlen(checksum) == 0)) {
+        FTI_Print("No checksum of the checkpoint file, it is loaded without verification.", FTI_DBUG);
+        verify = false;
+    }
+
+    // all datasets in host memory are read by the worker threads
+    bool threads = varIdx < 0 && !FTI_Conf->lazyRecovery && FTI_Conf->recoverThreads > 1 &&
+        FTI_GetThreadCount() > 1 && FTI_Exec->nbVar == FTI_Exec->meta[level].nbVar[0];
+#ifdef GPUSUPPORT
+    int j;
+    for (j = 0; j < FTI_Exec->nbVar; j++) {
+        threads = threads && !FTI_Data[j].isDevicePtr;
+    }
+#endif
+    if (threads) {
+        return FTI_ReadCkptFile(FTI_Exec, FTI_Data, fn, (verify) ? checksum : NULL);
+    }
+
+    int fd = open(fn, O_RDONLY);
+    if (fd == -1) {
+        snprintf(str, FTI_BUFS, "Could not open FTI checkpoint file. (%s)...", fn);
+        FTI_Print(str, FTI_EROR);
+        return FTI_NREC;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        snprintf(str, FTI_BUFS, "Could not get the size of FTI checkpoint file. (%s)...", fn);
+        FTI_Print(str, FTI_EROR);
+        close(fd);
+        return FTI_NREC;
+    }
+    long fs = (long) st.st_size;
+    char* map = NULL;
+    if (fs > 0) {
+        map = (char*) mmap(NULL, fs, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            snprintf(str, FTI_BUFS, "Could not map FTI checkpoint file. (%s)...", fn);
+            FTI_Print(str, FTI_EROR);
+            close(fd);
+            return FTI_NREC;
+        }
+        // the file is read once from the beginning to the end
+        madvise(map, fs, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    // the mapping belongs to the lazy recovery once started
+    bool lazy = FTI_Conf->lazyRecovery && varIdx < 0 && !verify && map != NULL &&
+        FTI_LazyBegin(map, fs) == FTI_SCES;
+
+    MD5_CTX mdContext;
+    MD5_Init(&mdContext);
+
+    // a single dataset may be stored at another position in the file
+    int varPos = (varIdx < 0) ? -1 : FTI_GetMetaVarIdx(&FTI_Exec->meta[level], FTI_Data[varIdx].id, varIdx);
+
+    int res = FTI_SCES;
+    long offset = 0, pos;
+    int i;
+    for (i = 0; i < FTI_Exec->meta[level].nbVar[0] && res == FTI_SCES; i++) {
+        long size = FTI_Exec->meta[level].varSize[i];
+        FTIT_dataset* data = (varIdx < 0) ? &FTI_Data[i] : &FTI_Data[varIdx];
+        bool load = (varIdx < 0) ? i < FTI_Exec->nbVar : i == varPos;
+        if (offset + size > fs) {
+            snprintf(str, FTI_BUFS, "FTI checkpoint file (%s) is truncated.", fn);
+            FTI_Print(str, FTI_EROR);
+            res = FTI_NREC;
+            break;
+        }
+#ifdef GPUSUPPORT
+        if (load && data->isDevicePtr) {
+            // directly from the mapping to the device
+            if (FTI_Try(FTI_copy_to_device(data->devicePtr, map + offset, size, FTI_Exec), "copying data to GPU") != FTI_SCES) {
+                res = FTI_NREC;
+                break;
+            }
+            load = false;
+        }
+#endif
+        if (load && lazy) {
+            FTI_LazyAdd((char*) data->ptr, map + offset, size);
+        }
+        else if (load || verify) {
+            for (pos = 0; pos < size; pos += CHUNK_SIZE) {
+                long n = (size - pos < CHUNK_SIZE) ? size - pos : CHUNK_SIZE;
+                char* src = map + offset + pos;
+                if (load) {
+                    memcpy((char*) data->ptr + pos, src, n);
+                    src = (char*) data->ptr + pos;
+                }
+                if (verify) {
+                    MD5_Update(&mdContext, src, n);
+                }
+            }
+        }
+        offset += size;
+    }
+
+    if (res == FTI_SCES && verify) {
+        if (fs > offset) {
+            MD5_Update(&mdContext, map + offset, fs - offset);
+        }
+        res = FTI_CheckDigest(&mdContext, checksum, fn);
+        FTI_Exec->recoVerified = (res == FTI_SCES);
+    }
+
+    if (lazy) {
+        if (FTI_LazyStart() != FTI_SCES) {
+            res = FTI_NREC;
+        }
+    }
+    else if (map != NULL && munmap(map, fs) == -1) {
+        FTI_Print("Could not unmap FTI checkpoint file.", FTI_EROR);
+        res = FTI_NREC;
+    }
+    errno = 0;
+
+    return res;
+}
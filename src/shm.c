@@ -0,0 +1,322 @@
+/**
+ *  Copyright (c) 2017 Leonardo A. Bautista-Gomez
+ *  All rights reserved
+ *
+ *  FTI - A multi-level checkpointing library for C/C++/Fortran applications
+ *
+ *  Revision 1.0 : Fault Tolerance Interface (FTI)
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  @file   shm.c
+ *  @date   October, 2018
+ *  @brief  Node-level aggregation of checkpoints in shared memory.
+ */
+
+#include "interface.h"
+
+/** Pointer to the checkpoint data of a shared memory segment.             */
+#define FTI_SHM_DATA(seg) ((char*)(seg) + sizeof(FTIT_shmSegment))
+
+/** @typedef    FTIT_shmSegment
+ *  @brief      Header of the shared memory segment of an application process.
+ *
+ *  The header is followed by the checkpoint data, serialized in the same
+ *  way as the local checkpoint file written by FTI_WritePosix.
+ */
+typedef struct FTIT_shmSegment {
+    int             valid;              /**< 1 if segment holds the ckpt.   */
+    int             ckptID;             /**< Checkpoint ID.                 */
+    long            size;               /**< Size of the checkpoint data.   */
+    char            ckptFile[FTI_BUFS]; /**< Name of the ckpt. file.        */
+} FTIT_shmSegment;
+
+static MPI_Comm shmComm = MPI_COMM_NULL;    /**< Head and app. procs of node */
+static MPI_Win shmWin = MPI_WIN_NULL;       /**< Node shared memory window   */
+static FTIT_shmSegment* shmSeg = NULL;      /**< Own segment (app. process)  */
+static FTIT_shmSegment** shmSegs = NULL;    /**< All segments (head)         */
+static int shmNbSegs = 0;                   /**< Number of segments (head)   */
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Allocates the shared memory segments of the node.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @return     integer         FTI_SCES if successful.
+
+  Every application process allocates a segment of 'node_aggregation_size'
+  MB in a shared memory window of the node. The head allocates nothing but
+  maps the segments of all application processes of its node. This
+  function is collective on the head and the application processes of
+  the node.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_InitShm(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo)
+{
+    // head is rank 0 in the node communicator
+    int key = (FTI_Topo->amIaHead) ? 0 : 1;
+    if (FTI_Conf->test) {
+        MPI_Comm_split(FTI_Exec->globalComm, FTI_Topo->nodeID, key, &shmComm);
+    } else {
+        MPI_Comm_split_type(FTI_Exec->globalComm, MPI_COMM_TYPE_SHARED, key, MPI_INFO_NULL, &shmComm);
+    }
+
+    int size;
+    MPI_Comm_size(shmComm, &size);
+    if (size != FTI_Topo->nodeSize) {
+        char str[FTI_BUFS];
+        snprintf(str, FTI_BUFS, "Wrong size (%d != %d) of node communicator, node aggregation disabled.",
+                size, FTI_Topo->nodeSize);
+        FTI_Print(str, FTI_WARN);
+        MPI_Comm_free(&shmComm);
+        FTI_Conf->shmAggregation = false;
+        return FTI_NSCS;
+    }
+
+    MPI_Aint winSize = (FTI_Topo->amIaHead) ? 0 : sizeof(FTIT_shmSegment) + FTI_Conf->shmAggrSize;
+    void* base;
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    MPI_Win_allocate_shared(winSize, 1, info, shmComm, &base, &shmWin);
+    MPI_Info_free(&info);
+    // passive target epoch for the whole run, synchronized by MPI_Win_sync
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, shmWin);
+
+    if (FTI_Topo->amIaHead) {
+        shmNbSegs = size - 1;
+        shmSegs = talloc(FTIT_shmSegment*, shmNbSegs);
+        int i;
+        for (i = 0; i < shmNbSegs; i++) {
+            MPI_Aint qsize;
+            int qdisp;
+            MPI_Win_shared_query(shmWin, i + 1, &qsize, &qdisp, &shmSegs[i]);
+        }
+    }
+    else {
+        shmSeg = (FTIT_shmSegment*) base;
+        memset(shmSeg, 0x0, sizeof(FTIT_shmSegment));
+    }
+
+    char str[FTI_BUFS];
+    snprintf(str, FTI_BUFS, "Node aggregation enabled (%ld MB per process).", FTI_Conf->shmAggrSize / (1024 * 1024));
+    FTI_Print(str, FTI_DBUG);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Frees the shared memory segments of the node.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Topo        Topology metadata.
+
+  This function is collective on the head and the application processes
+  of the node.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_FinalizeShm(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo)
+{
+    MPI_Win_unlock_all(shmWin);
+    MPI_Win_free(&shmWin);
+    MPI_Comm_free(&shmComm);
+    free(shmSegs);
+    shmSegs = NULL;
+    shmSeg = NULL;
+    shmNbSegs = 0;
+    FTI_Conf->shmAggregation = false;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Copies the checkpoint into the shared memory segment.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Ckpt        Checkpoint metadata.
+  @param      FTI_Data        Dataset metadata.
+  @return     integer         FTI_SCES if the checkpoint was copied.
+
+  Only checkpoints post-processed by the head are copied. FTI_NSCS is
+  returned if the level is inline, if the checkpoint does not fit in the
+  segment or if data is on the GPU; the caller then writes the local
+  checkpoint file as usual.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_ShmWriteCkpt(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_checkpoint* FTI_Ckpt, FTIT_dataset* FTI_Data)
+{
+    if (shmSeg == NULL) {
+        return FTI_NSCS;
+    }
+    shmSeg->valid = 0;
+    if (FTI_Ckpt[FTI_Exec->ckptLvel].isInline) {
+        return FTI_NSCS;
+    }
+    if (FTI_Exec->ckptSize > FTI_Conf->shmAggrSize) {
+        FTI_Print("Checkpoint does not fit in the node segment, writing local file.", FTI_DBUG);
+        return FTI_NSCS;
+    }
+    int i;
+    for (i = 0; i < FTI_Exec->nbVar; i++) {
+        if (FTI_Data[i].isDevicePtr) {
+            return FTI_NSCS;
+        }
+    }
+
+    char* dst = FTI_SHM_DATA(shmSeg);
+    long size = 0;
+    for (i = 0; i < FTI_Exec->nbVar; i++) {
+        memcpy(dst + size, FTI_Data[i].ptr, FTI_Data[i].size);
+        size += FTI_Data[i].size;
+    }
+    shmSeg->ckptID = FTI_Exec->ckptID;
+    shmSeg->size = size;
+    snprintf(shmSeg->ckptFile, FTI_BUFS, "%s", FTI_Exec->meta[0].ckptFile);
+    // the data is visible before the flag, both are published to the
+    // head by the checkpoint request message
+    MPI_Win_sync(shmWin);
+    shmSeg->valid = 1;
+    MPI_Win_sync(shmWin);
+
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the checkpoint data of a process in shared memory.
+  @param      ckptFile        Name of the checkpoint file of the process.
+  @param      fs              Expected size of the checkpoint.
+  @return     char*           Pointer to the data, NULL if not in memory.
+ **/
+/*-------------------------------------------------------------------------*/
+char* FTI_ShmCkptData(const char* ckptFile, long fs)
+{
+    int i;
+    for (i = 0; i < shmNbSegs; i++) {
+        FTIT_shmSegment* seg = shmSegs[i];
+        if (seg->valid && seg->size == fs && strncmp(seg->ckptFile, ckptFile, FTI_BUFS) == 0) {
+            return FTI_SHM_DATA(seg);
+        }
+    }
+    return NULL;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Writes a buffer into a file descriptor.
+  @param      fd              File descriptor.
+  @param      buf             Buffer.
+  @param      size            Number of bytes to write.
+  @return     integer         FTI_SCES if successful.
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_ShmWriteFile(int fd, const char* buf, long size)
+{
+    while (size > 0) {
+        ssize_t bytes = write(fd, buf, size);
+        if (bytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FTI_NSCS;
+        }
+        buf += bytes;
+        size -= bytes;
+    }
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Writes the shared memory segment of one process to its file.
+  @param      proc            Node rank of the application process.
+  @param      arg             Configuration metadata.
+  @return     integer         FTI_SCES if successful.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_ShmFlushSegment(int proc, void* arg)
+{
+    FTIT_configuration* FTI_Conf = (FTIT_configuration*) arg;
+    FTIT_shmSegment* seg = shmSegs[proc - 1];
+    char str[FTI_BUFS], fn[FTI_BUFS];
+    if (!seg->valid) {
+        return FTI_SCES;
+    }
+    snprintf(fn, FTI_BUFS, "%s/%s", FTI_Conf->lTmpDir, seg->ckptFile);
+    int fd = open(fn, O_WRONLY|O_CREAT|O_TRUNC, (mode_t) 0600);
+    if (fd == -1) {
+        snprintf(str, FTI_BUFS, "FTI checkpoint file (%s) could not be opened.", fn);
+        FTI_Print(str, FTI_EROR);
+        return FTI_NSCS;
+    }
+    if (FTI_ShmWriteFile(fd, FTI_SHM_DATA(seg), seg->size) != FTI_SCES) {
+        snprintf(str, FTI_BUFS, "FTI checkpoint file (%s) could not be written.", fn);
+        FTI_Print(str, FTI_EROR);
+        close(fd);
+        return FTI_NSCS;
+    }
+    if (close(fd) != 0) {
+        FTI_Print("FTI checkpoint file could not be closed.", FTI_EROR);
+        return FTI_NSCS;
+    }
+    snprintf(str, FTI_BUFS, "Head wrote %s (%ld bytes) from shared memory.", seg->ckptFile, seg->size);
+    FTI_Print(str, FTI_DBUG);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Writes the local checkpoint files from shared memory.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @return     integer         FTI_SCES if successful.
+
+  Called by the head for every checkpoint request. The local checkpoint
+  files are needed for the recovery from L1, L2 and L3; the
+  post-processing of the head then reads the data from shared memory.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_ShmFlushLocal(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo)
+{
+    if (mkdir(FTI_Conf->lTmpDir, 0777) == -1) {
+        if (errno != EEXIST) {
+            FTI_Print("Cannot create local directory", FTI_EROR);
+            return FTI_NSCS;
+        }
+    }
+    // see the segments as written before the checkpoint requests
+    MPI_Win_sync(shmWin);
+    // the segment of node rank 'proc' is shmSegs[proc - 1]
+    return FTI_ForEachProc(1, shmNbSegs + 1, FTI_ShmFlushSegment, FTI_Conf, 0);
+}
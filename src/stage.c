@@ -47,10 +47,6 @@
  * @par
  * (2)  add flag to FTI_SendFile( ..., FTI_SI_RM ) that indicates if the
  * local file shall be deleted at success or failure.
- * @par
- * (3)  implement an interrupt for the staging process of the heads in
- * order to allow the heads to process the checkpoints as soon as
- * requested.
  **/
 
 /* @note 
@@ -71,19 +67,14 @@ static MPI_Datatype buf_t;
 /** 
  * @brief Look-up table for the stage info request array elements. 
  *
- * The elements of the array, 'idxRequest', keep informations about 'ID'
- * at 'idxRequest[ID]'.  These are a flag if for 'ID' exists an
- * allocated request element and if, the index of the ID corresponding
- * element fo 'FTI_Exec->stageInfo->request'. The two fields may be
- * requested by 'FTI_GetRequestFiled' and may be set by
- * 'FTI_SetRequestField'. The most significant 19 bits hold the indices
- * and the 20th bit holds a flag that indicates if the ID has a
- * corresponding request structure allocated. the bits 21 to 32 are
- * free. Only the application ranks allocate memory for this field. The
- * head processes use a linear search to locate the 'ID' corresponding
- * request element.
+ * Open addressing hash table (linear probing) that maps the key of a
+ * request to the index of its element in the request array. The key is
+ * the 'ID' on the application ranks and 'FTI_SI_HKEY( source, ID )' on
+ * the heads. The table is allocated with the first request and doubles
+ * its capacity if it gets half full, so insertion, look-up and removal
+ * take amortized constant time.
  **/
-static uint32_t *idxRequest;
+static FTIT_StageIdxTable idxTable;
 
 /** 
  * @brief holds status of the user requested staging action. 
@@ -112,6 +103,181 @@ static MPI_Win stageWin;
  **/
 static bool *enableStagingPtr;
 
+/** 
+ * @brief queue of the stage requests received by the head. 
+ *
+ * The requests are served in the order of arrival. The first
+ * 'FTI_Conf->stageStreams' elements are transferred concurrently, one
+ * chunk of 'FTI_Conf->stageChunkSize' bytes per call to
+ * 'FTI_ProgressStage'. Since the head returns to 'FTI_Listen' after
+ * each chunk, checkpoint requests interrupt the staging at chunk
+ * boundaries.
+ **/
+static FTIT_StageQueueEntry *stageQueue;
+static int stageQueueSize;
+static int stageQueueCap;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the home slot of 'key' in the look-up table.
+  @param      key             key of the request.
+  @return     slot index.
+ **/
+/*-------------------------------------------------------------------------*/
+static size_t FTI_StageIdxHash( int64_t key )
+{
+    uint64_t h = (uint64_t)key * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 32) & (idxTable.capacity - 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Doubles the capacity of the look-up table.
+  @return     'FTI_SCES' on success, 'FTI_NSCS' else.
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_StageIdxGrow( void )
+{
+    FTIT_StageIdxTable old = idxTable;
+    size_t capacity = ( old.capacity == 0 ) ? FTI_SI_IDX_MIN : 2 * old.capacity;
+    
+    idxTable.entry = malloc( capacity * sizeof(FTIT_StageIdxEntry) );
+    if ( idxTable.entry == NULL ) {
+        idxTable = old;
+        return FTI_NSCS;
+    }
+    idxTable.capacity = capacity;
+    idxTable.count = 0;
+    
+    size_t i;
+    for ( i=0; i<capacity; ++i ) {
+        idxTable.entry[i].key = -1;
+    }
+    for ( i=0; i<old.capacity; ++i ) {
+        if ( old.entry[i].key >= 0 ) {
+            size_t j = FTI_StageIdxHash( old.entry[i].key );
+            while ( idxTable.entry[j].key >= 0 ) {
+                j = (j+1) & (capacity-1);
+            }
+            idxTable.entry[j] = old.entry[i];
+            idxTable.count++;
+        }
+    }
+    free( old.entry );
+    
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Inserts or updates the index of a request in the look-up table.
+  @param      key             key of the request.
+  @param      idx             index of the request meta info element.
+  @return     'FTI_SCES' on success, 'FTI_NSCS' else.
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_StageIdxPut( int64_t key, int idx )
+{
+    if ( 2 * (idxTable.count + 1) > idxTable.capacity ) {
+        if ( FTI_StageIdxGrow() != FTI_SCES ) {
+            return FTI_NSCS;
+        }
+    }
+    size_t i = FTI_StageIdxHash( key );
+    while ( (idxTable.entry[i].key >= 0) && (idxTable.entry[i].key != key) ) {
+        i = (i+1) & (idxTable.capacity-1);
+    }
+    if ( idxTable.entry[i].key < 0 ) {
+        idxTable.entry[i].key = key;
+        idxTable.count++;
+    }
+    idxTable.entry[i].idx = idx;
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the index of a request from the look-up table.
+  @param      key             key of the request.
+  @return     index of the request meta info element, -1 if not found.
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_StageIdxGet( int64_t key )
+{
+    if ( idxTable.count == 0 ) {
+        return -1;
+    }
+    size_t i = FTI_StageIdxHash( key );
+    while ( idxTable.entry[i].key >= 0 ) {
+        if ( idxTable.entry[i].key == key ) {
+            return idxTable.entry[i].idx;
+        }
+        i = (i+1) & (idxTable.capacity-1);
+    }
+    return -1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Removes a request from the look-up table.
+  @param      key             key of the request.
+
+  The entries following the removed one in the same probe sequence are
+  shifted back, thus no tombstones are needed.
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_StageIdxDel( int64_t key )
+{
+    if ( idxTable.count == 0 ) {
+        return;
+    }
+    size_t mask = idxTable.capacity - 1;
+    size_t i = FTI_StageIdxHash( key );
+    while ( idxTable.entry[i].key != key ) {
+        if ( idxTable.entry[i].key < 0 ) {
+            return;
+        }
+        i = (i+1) & mask;
+    }
+    size_t j = i;
+    while ( 1 ) {
+        j = (j+1) & mask;
+        if ( idxTable.entry[j].key < 0 ) {
+            break;
+        }
+        // move entry j to the hole at i if its home slot is not in (i,j]
+        size_t home = FTI_StageIdxHash( idxTable.entry[j].key );
+        if ( ((j - home) & mask) >= ((j - i) & mask) ) {
+            idxTable.entry[i] = idxTable.entry[j];
+            i = j;
+        }
+    }
+    idxTable.entry[i].key = -1;
+    idxTable.count--;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Makes room for one more element in a request array.
+  @param      si              stage info holding the request array.
+  @param      type_size       size of the request array elements.
+  @return     pointer to the (re)allocated array, NULL on failure.
+
+  The capacity of the array is not stored. It is kept at the next power
+  of two of 'nbRequest' (at least 'FTI_SI_IDX_MIN'), so the array only
+  has to grow if 'nbRequest' is zero or a power of two.
+ **/
+/*-------------------------------------------------------------------------*/
+static void* FTI_GrowRequestArray( FTIT_StageInfo *si, size_t type_size )
+{
+    int n = si->nbRequest;
+    if ( (si->request != NULL) && ((n & (n-1)) != 0 || n < FTI_SI_IDX_MIN) ) {
+        return si->request;
+    }
+    size_t capacity = ( 2*n > FTI_SI_IDX_MIN ) ? 2*n : FTI_SI_IDX_MIN;
+    return realloc( si->request, capacity * type_size );
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      Initializes the FTI staging feature
@@ -119,8 +285,9 @@ static bool *enableStagingPtr;
   @param      FTI_Conf        Configuration metadata.
   @param      FTI_Topo        Topology metadata.
 
-  This function allocates memory for the 'idxRequest' and 'status'
-  fields, creates a node communicator and an MPI shared memory window.
+  This function creates a node communicator and an MPI shared memory
+  window for the 'status' field. The look-up table of the requests is
+  allocated on demand.
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_InitStage( FTIT_execution *FTI_Exec, FTIT_configuration *FTI_Conf, FTIT_topology *FTI_Topo ) 
@@ -131,15 +298,12 @@ int FTI_InitStage( FTIT_execution *FTI_Exec, FTIT_configuration *FTI_Conf, FTIT_
         return FTI_NSCS;
     }
 
-    MPI_Type_contiguous( 2*FTI_BUFS + sizeof(int), MPI_BYTE, &buf_t );
+    MPI_Type_contiguous( FTI_SI_REQ_SIZE, MPI_BYTE, &buf_t );
     MPI_Type_commit( &buf_t );
     
     // memory window size
     size_t win_size = FTI_SI_MAX_NUM * sizeof(uint8_t) * !(FTI_Topo->amIaHead);
     
-    // requestIdx array size
-    size_t arr_size = FTI_SI_MAX_NUM * sizeof(uint32_t);
-
     // keep ptr to enableStaging flag local to file
     enableStagingPtr = &FTI_Conf->stagingEnabled;
 
@@ -152,19 +316,6 @@ int FTI_InitStage( FTIT_execution *FTI_Exec, FTIT_configuration *FTI_Conf, FTIT_
         return FTI_NSCS;
     }
 
-    // allocate request idx array and init to 0x0. Head does not have one (would double memory consumption).
-    if ( FTI_Topo->amIaHead ) {
-        idxRequest = NULL;
-    } else {
-        idxRequest = calloc( 1, arr_size );
-        if ( idxRequest == NULL ) {
-            FTI_DISABLE_STAGING;
-            FTI_Print( "Failed to allocate memory for 'idxRequest'", FTI_EROR );
-            free( FTI_Exec->stageInfo );
-            return FTI_NSCS;
-        }
-    }
-
     // create node communicator
     // NOTE: head is assigned rank 0. This is important in order 
     // to access the stageInfo array at the  head rank in the 
@@ -187,7 +338,6 @@ int FTI_InitStage( FTIT_execution *FTI_Exec, FTIT_configuration *FTI_Conf, FTIT_
         FTI_Print(str, FTI_WARN );
         MPI_Comm_free( &FTI_Exec->nodeComm );
         free( FTI_Exec->stageInfo );
-        free( idxRequest );
         return FTI_NSCS;
     }
 
@@ -223,7 +373,6 @@ int FTI_InitStage( FTIT_execution *FTI_Exec, FTIT_configuration *FTI_Conf, FTIT_
             MPI_Win_free( &stageWin );
             MPI_Comm_free( &FTI_Exec->nodeComm );
             free( FTI_Exec->stageInfo );
-            free( idxRequest );
             FTI_Print("Cannot create stage directory", FTI_EROR);
         }
     }
@@ -257,6 +406,10 @@ void FTI_FinalizeStage( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, FTIT_
                 free( FTI_Exec->stageInfo[i].request );
             }
         }
+        free( stageQueue );
+        stageQueue = NULL;
+        stageQueueSize = 0;
+        stageQueueCap = 0;
 
     } else {
 
@@ -285,8 +438,9 @@ void FTI_FinalizeStage( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, FTIT_
     // free stage info
     free( FTI_Exec->stageInfo );
 
-    // free idxRequest field array
-    free( idxRequest );
+    // free look-up table
+    free( idxTable.entry );
+    memset( &idxTable, 0x0, sizeof(FTIT_StageIdxTable) );
    
     // free window 
     // NOTE: this also releases the ressources for the status field array
@@ -315,8 +469,8 @@ void FTI_FinalizeStage( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, FTIT_
   This function appends a new staging meta info element for the
   application ranks to 'FTI_Exec->stageInfo->request'. Beside that it
   also initializes the status field (status -> pending) corresponding to
-  'ID' and assigns the proper index of the meta info element to the 'ID'
-  corresponding 'idxRequest' field. 
+  'ID' and inserts the index of the meta info element into the look-up
+  table. 
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_InitStageRequestApp( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, uint32_t ID ) 
@@ -332,20 +486,24 @@ int FTI_InitStageRequestApp( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo,
         return FTI_NSCS;
     }
 
-    void *ptr = realloc( FTI_Exec->stageInfo->request, sizeof(FTIT_StageAppInfo) * (FTI_Exec->stageInfo->nbRequest+1) );
+    void *ptr = FTI_GrowRequestArray( FTI_Exec->stageInfo, sizeof(FTIT_StageAppInfo) );
     if( ptr == NULL ) {
         FTI_Print( "failed to allocate memory for 'FTI_Exec->stageInfo->request'", FTI_EROR );
         return FTI_NSCS;
     }
     FTI_Exec->stageInfo->request = ptr;
-    int idx = FTI_Exec->stageInfo->nbRequest++;
+    int idx = FTI_Exec->stageInfo->nbRequest;
+    
+    if ( FTI_StageIdxPut( ID, idx ) != FTI_SCES ) {
+        FTI_Print( "failed to allocate memory for the stage request look-up table", FTI_EROR );
+        return FTI_NSCS;
+    }
+    FTI_Exec->stageInfo->nbRequest++;
 
     FTI_SI_APTR(FTI_Exec->stageInfo->request)[idx].mpiReq = MPI_REQUEST_NULL;
     FTI_SI_APTR(FTI_Exec->stageInfo->request)[idx].sendBuf = NULL;
     
     FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_PEND, FTI_SIF_VAL, FTI_Topo->nodeRank );
-    FTI_SetRequestField( ID, FTI_SI_IALL, FTI_SIF_ALL );
-    FTI_SetRequestField( ID, idx, FTI_SIF_IDX );
     
     FTI_SI_APTR(FTI_Exec->stageInfo->request)[idx].ID = ID;
 
@@ -383,22 +541,30 @@ int FTI_InitStageRequestHead( char* lpath, char *rpath, FTIT_execution *FTI_Exec
         return FTI_NSCS;
     }
     
-    void *ptr = realloc( FTI_Exec->stageInfo[source-1].request, sizeof(FTIT_StageHeadInfo) * (FTI_Exec->stageInfo[source-1].nbRequest+1) );
+    FTIT_StageInfo *si = &(FTI_Exec->stageInfo[source-1]); 
+    void *ptr = FTI_GrowRequestArray( si, sizeof(FTIT_StageHeadInfo) );
     if( ptr == NULL ) {
         FTI_Print( "failed to allocate memory", FTI_EROR );
         return FTI_NSCS;
     }
-    FTIT_StageInfo *si = &(FTI_Exec->stageInfo[source-1]); 
     si->request = ptr;
-    int idx = si->nbRequest++;
+    int idx = si->nbRequest;
+
+    if ( FTI_StageIdxPut( FTI_SI_HKEY( source, ID ), idx ) != FTI_SCES ) {
+        FTI_Print( "failed to allocate memory for the stage request look-up table", FTI_EROR );
+        return FTI_NSCS;
+    }
+    si->nbRequest++;
 
     strncpy( FTI_SI_HPTR(si->request)[idx].lpath, lpath, FTI_BUFS );
     strncpy( FTI_SI_HPTR(si->request)[idx].rpath, rpath, FTI_BUFS );
     FTI_SI_HPTR(si->request)[idx].offset = 0;
     FTI_SI_HPTR(si->request)[idx].size = 0;
+    FTI_SI_HPTR(si->request)[idx].fdLocal = -1;
+    FTI_SI_HPTR(si->request)[idx].fdGlobal = -1;
     FTI_SI_HPTR(si->request)[idx].ID = ID;
 
-    FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_ACTV, FTI_SIF_VAL, source );
+    FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_PEND, FTI_SIF_VAL, source );
     
     return FTI_SCES;
     
@@ -413,9 +579,8 @@ int FTI_InitStageRequestHead( char* lpath, char *rpath, FTIT_execution *FTI_Exec
   @param      integer         'source', application rank of stage request
 
   This function eliminates the 'ID' corresponding element from the stage
-  meta info array and frees the corresponding memory. In the application
-  ranks it also reorders the index information in the 'idxRequestÄ array
-  corresponding to 'ID'. 
+  meta info array. The last element of the array is moved to the free
+  position, thus only its entry in the look-up table needs an update.
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_FreeStageRequest( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, int ID, int source ) 
@@ -428,117 +593,49 @@ int FTI_FreeStageRequest( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, int
 
     if ( !FTI_Topo->amIaHead ) {
         
+        int idx = FTI_StageIdxGet( ID );
+        
         // if request already free, just return
-        if ( !FTI_GetRequestField( ID, FTI_SIF_ALL ) ) {
+        if ( idx < 0 ) {
             return FTI_SCES;
         }
         
-        int idx = FTI_GetRequestField( ID, FTI_SIF_IDX );
-    
-        size_t type_size = sizeof(FTIT_StageAppInfo);
-  
-        // ptr is all we need
         FTIT_StageAppInfo *ptr = FTI_SI_APTR(FTI_Exec->stageInfo->request);
+        int last = --FTI_Exec->stageInfo->nbRequest;
 
-        // if last element in array, we just need to truncate the array.
-        if ( idx == (FTI_Exec->stageInfo->nbRequest-1) ) {
-            void *buf_ptr = ptr[idx].sendBuf;
-            ptr = realloc( ptr, type_size * (FTI_Exec->stageInfo->nbRequest-1) );
-            if ( (ptr == NULL) && (FTI_Exec->stageInfo->nbRequest > 1) ) {
-                FTI_Print( "failed to allocate memory for 'ptr' in 'FTI_FreeStageRequest'", FTI_EROR );
-                return FTI_NSCS;
-            }
-            free( buf_ptr );
-            --FTI_Exec->stageInfo->nbRequest;
-            FTI_Exec->stageInfo->request = (FTI_Exec->stageInfo->nbRequest == 0) ? NULL : (void*)ptr;
-        } 
-        // if not last element, we need to truncate array and move elements (before truncation)
-        else {
-            void *buf_ptr = ptr[idx].sendBuf;
-            void *dest = &ptr[idx];
-            void *dest_cpy = malloc( type_size );
-            if ( dest_cpy == NULL ) {
-                FTI_Print( "failed to allocate memory for 'dest_cpy' in 'FTI_FreeStageRequest'", FTI_EROR );
-                return FTI_NSCS;
-            }
-            memcpy( dest_cpy, dest, type_size );
-            void *src = &ptr[idx+1];
-            size_t mem_size = (FTI_Exec->stageInfo->nbRequest - (idx+1)) * type_size; 
-            memmove( dest, src, mem_size );
-            ptr = realloc( ptr, type_size * (FTI_Exec->stageInfo->nbRequest-1) );
-            if ( ptr == NULL ) {
-                FTI_Print( "failed to allocate memory for 'ptr' in 'FTI_FreeStageRequest'", FTI_EROR );
-                memmove( src, dest, mem_size );
-                memcpy( dest, dest_cpy, type_size );
-                free( dest_cpy);
-                return FTI_NSCS;
-            }
-            free( buf_ptr );
-            free( dest_cpy );
-            FTI_Exec->stageInfo->request = (void*)ptr;
-            --FTI_Exec->stageInfo->nbRequest;
-            // re-assign the correct values
-            int i = idx;
-            for ( ; i<FTI_Exec->stageInfo->nbRequest; ++i ) {
-                int ID_tmp = ptr[i].ID;
-                FTI_SetRequestField( ID_tmp, i, FTI_SIF_IDX );
-            }
+        free( ptr[idx].sendBuf );
+        if ( idx != last ) {
+            ptr[idx] = ptr[last];
+            FTI_StageIdxPut( ptr[idx].ID, idx );
+        }
+        FTI_StageIdxDel( ID );
+        
+        if ( last == 0 ) {
+            free( ptr );
+            FTI_Exec->stageInfo->request = NULL;
         }
-
-        FTI_SetRequestField( ID, FTI_SI_NALL, FTI_SIF_ALL );
     
     } else {
         
-        int nbRequest = FTI_Exec->stageInfo[source-1].nbRequest;
-        FTIT_StageHeadInfo *ptr = FTI_SI_HPTR(FTI_Exec->stageInfo[source-1].request);
-        int idx;
-        // locate idx, heads do not have a look-up table
-        for( idx=0; idx<nbRequest; ++idx ) {
-            if(ptr->ID == ID) {
-                break;
-            }
-        }
-        if ( idx == nbRequest ) {
+        FTIT_StageInfo *si = &(FTI_Exec->stageInfo[source-1]);
+        int idx = FTI_StageIdxGet( FTI_SI_HKEY( source, ID ) );
+        if ( idx < 0 ) {
             FTI_Print("invalid ID! Failed to free stage request meta info (FTI head process).", FTI_WARN);
             return FTI_NSCS;
         }
         
-        size_t type_size = sizeof(FTIT_StageHeadInfo);
-        
-        // if last element in array, we just need to truncate the array.
-        if ( idx == (nbRequest-1) ) {
-            ptr = realloc( ptr, type_size * (nbRequest-1) );
-            if ( (ptr == NULL) && (nbRequest > 1) ) {
-                FTI_Print( "failed to allocate memory for 'ptr' in 'FTI_FreeStageRequest'", FTI_EROR );
-                return FTI_NSCS;
-            }
-            --FTI_Exec->stageInfo[source-1].nbRequest;
-            FTI_Exec->stageInfo[source-1].request = (FTI_Exec->stageInfo[source-1].nbRequest == 0) ? NULL : (void*)ptr;
-        } 
+        FTIT_StageHeadInfo *ptr = FTI_SI_HPTR(si->request);
+        int last = --si->nbRequest;
+
+        if ( idx != last ) {
+            ptr[idx] = ptr[last];
+            FTI_StageIdxPut( FTI_SI_HKEY( source, ptr[idx].ID ), idx );
+        }
+        FTI_StageIdxDel( FTI_SI_HKEY( source, ID ) );
         
-        // if not last element, we need to truncate array and move elements (before truncation)
-        else {
-            void *dest = &(ptr[idx]);
-            void *dest_cpy = malloc( type_size );
-            if ( dest_cpy == NULL ) {
-                FTI_Print( "failed to allocate memory for 'dest_cpy' in 'FTI_FreeStageRequest'", FTI_EROR );
-                return FTI_NSCS;
-            }
-            memcpy( dest_cpy, dest, type_size );
-            void *src = &(ptr[idx+1]);
-            size_t mem_size = (nbRequest - (idx+1)) * type_size; 
-            memmove( dest, src, mem_size );
-            ptr = realloc( ptr, type_size * (nbRequest-1) );
-            if ( ptr == NULL ) {
-                FTI_Print( "failed to allocate memory for 'ptr' in 'FTI_FreeStageRequest'", FTI_EROR );
-                memmove( src, dest, mem_size );
-                memcpy( dest, dest_cpy, type_size );
-                free( dest_cpy);
-                return FTI_NSCS;
-            }
-            free( dest_cpy);
-            FTI_Exec->stageInfo[source-1].request = ptr;
-            --FTI_Exec->stageInfo[source-1].nbRequest;
+        if ( last == 0 ) {
+            free( ptr );
+            si->request = NULL;
         }
 
     }
@@ -557,12 +654,7 @@ int FTI_FreeStageRequest( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, int
 /*-------------------------------------------------------------------------*/
 int FTI_GetRequestIdx( int ID ) 
 {
-
-    if ( FTI_GetRequestField( ID, FTI_SIF_ALL ) ) {
-        return FTI_GetRequestField( ID, FTI_SIF_IDX );
-    } else {
-        return -1;
-    }
+    return FTI_StageIdxGet( ID );
 }
 
 /*-------------------------------------------------------------------------*/
@@ -666,57 +758,26 @@ int FTI_SyncStage( char* lpath, char *rpath, FTIT_execution *FTI_Exec,
         return FTI_NSCS;
     }
     // open file on remote fs
-    int fd_global = open( rpath, O_WRONLY|O_CREAT, (mode_t) 0600 );
+    int fd_global = open( rpath, O_WRONLY|O_CREAT|O_TRUNC, (mode_t) 0600 );
     if( fd_global == -1 ) {
         FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
         FTI_Print("Could not open the destination file for staging", FTI_EROR);
         close( fd_local );
         return FTI_NSCS;
     }
-    // allocate buffer
-    char *buf = (char*) malloc( bs );
-
-    // move file to destination
-    off_t pos = 0;
-    ssize_t read_bytes, write_bytes;
-    size_t buf_bytes;
-    while( pos < eof ) {
-        buf_bytes = ( (eof - pos) < bs ) ? eof - pos : bs;
-        // for the case we have written less then we have read
-        if( lseek( fd_local, pos, SEEK_SET ) == -1 ) {
-            snprintf( errstr, FTI_BUFS, "unable to seek in '%s'.", lpath );
-            FTI_Print( errstr, FTI_EROR );
-            errno = 0;
-            free( buf );
-            close( fd_local );
-            close( fd_global );
-            return FTI_NSCS;
-        }
-        if( (read_bytes = read( fd_local, buf, buf_bytes )) == -1 ) {
-            FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
-            snprintf( errstr, FTI_BUFS, "unable to read from '%s'.", lpath );
-            FTI_Print( errstr, FTI_EROR );
-            errno = 0;
-            free( buf );
-            close( fd_local );
-            close( fd_global );
-            return FTI_NSCS;
-        }
-        if( (write_bytes = write( fd_global, buf, read_bytes )) == -1 ) {  
-            FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
-            snprintf( errstr, FTI_BUFS, "unable to write to '%s'.", rpath );
-            FTI_Print( errstr, FTI_EROR );
-            errno = 0;
-            free( buf );
-            close( fd_local );
-            close( fd_global );
-            return FTI_NSCS;
-        }
-        pos += write_bytes;
+    // move file to destination (in-kernel if the file systems allow it,
+    // throttled if the node bandwidth is limited)
+    if( FTI_CopyFileThrottled( fd_local, fd_global, eof, bs ) != FTI_SCES ) {
+        FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
+        snprintf( errstr, FTI_BUFS, "unable to copy '%s' to '%s'.", lpath, rpath );
+        FTI_Print( errstr, FTI_EROR );
+        errno = 0;
+        close( fd_local );
+        close( fd_global );
+        return FTI_NSCS;
     }
 
-    // deallocate buffer and close file descriptors
-    free( buf );
+    // close file descriptors
     close( fd_local );
     fsync( fd_global );
     close( fd_global );
@@ -758,9 +819,9 @@ int FTI_AsyncStage( char *lpath, char *rpath, FTIT_configuration *FTI_Conf,
         return FTI_NSCS;
     }
 
-    int idx = FTI_GetRequestField( ID, FTI_SIF_IDX );
+    int idx = FTI_GetRequestIdx( ID );
     // serialize request before sending to the head
-    void *buf_ser = malloc ( 2*FTI_BUFS + sizeof(int) );
+    void *buf_ser = malloc ( FTI_SI_REQ_SIZE );
     if ( buf_ser == NULL ) {
         FTI_Print("failed to allocate memory for 'buf_ser' in FTI_AsyncStage'", FTI_EROR );
         return FTI_NSCS;
@@ -783,6 +844,24 @@ int FTI_AsyncStage( char *lpath, char *rpath, FTIT_configuration *FTI_Conf,
     return FTI_SCES;
 }
 
+/*-------------------------------------------------------------------------*/
+/**            
+  @brief      returns the head stage meta info element of a request.
+  @param      FTI_Exec        Execution metadata.
+  @param      integer         'ID' of staging request
+  @param      integer         'source', application rank of stage request
+  @return     pointer to the meta info element, NULL if not found.
+ **/
+/*-------------------------------------------------------------------------*/
+static FTIT_StageHeadInfo* FTI_GetStageRequestHead( FTIT_execution *FTI_Exec, int ID, int source )
+{
+    int idx = FTI_StageIdxGet( FTI_SI_HKEY( source, ID ) );
+    if ( idx < 0 ) {
+        return NULL;
+    }
+    return &(FTI_SI_HPTR(FTI_Exec->stageInfo[source-1].request)[idx]);
+}
+
 /*-------------------------------------------------------------------------*/
 /**            
   @brief      This function asynchronously stages the local file to the PFS.
@@ -791,12 +870,17 @@ int FTI_AsyncStage( char *lpath, char *rpath, FTIT_configuration *FTI_Conf,
   @param      FTI_Exec        Execution metadata.
   @param      FTI_Topo        Topology metadata.
   @param      FTI_Conf        Configuration metadata.
+  @param      buf_ser         serialized stage request (FTI_SI_REQ_SIZE bytes).
   @param      integer         'source', application rank of stage request.
   @return     'FTI_SCES' on success, 'FTI_NSCS' else.  
+
+  The request was received by the head in 'FTI_Listen'. The files are
+  opened and the request is appended to the stage queue, the transfer
+  itself is done in 'FTI_ProgressStage'.
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_HandleStageRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
-        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, int source)
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, void* buf_ser, int source)
 {      
 
     if ( !FTI_SI_ENABLED ) {
@@ -806,15 +890,6 @@ int FTI_HandleStageRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exe
 
     char errstr[FTI_BUFS];
  
-    size_t buf_ser_size = 2*FTI_BUFS + sizeof(int);
-    void *buf_ser = malloc ( buf_ser_size );
-    if ( buf_ser == NULL ) {
-        FTI_Print( "failed to allocate memory for 'buf_ser' in FTI_HandleStageRequest", FTI_EROR );
-        return FTI_NSCS; 
-    }
-    
-    MPI_Recv( buf_ser, 1, buf_t, source, FTI_Conf->stageTag, FTI_Exec->nodeComm, MPI_STATUS_IGNORE );
-    
     // set local file path
     char lpath[FTI_BUFS];
     char rpath[FTI_BUFS];
@@ -825,8 +900,6 @@ int FTI_HandleStageRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exe
     rpath[FTI_BUFS-1] = '\0';
     int ID = *(int*)(buf_ser+2*FTI_BUFS);
     
-    free( buf_ser );
-    
     // init Head staging meta data
     if ( FTI_InitStageRequestHead( lpath, rpath, FTI_Exec, FTI_Topo, source, ID ) != FTI_SCES ) {
         FTI_Print( "failed to initialize stage request meta info!", FTI_WARN );
@@ -834,9 +907,6 @@ int FTI_HandleStageRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exe
         return FTI_NSCS;
     }
     
-    // set buffer size for the file data transfer
-    size_t bs = FTI_Conf->transferSize;
-
     // check local file and get file size
     struct stat st;
     if(  stat( lpath, &st ) == -1 ) {
@@ -912,7 +982,7 @@ int FTI_HandleStageRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exe
         return FTI_NSCS;
     }
     // open file on remote fs
-    int fd_global = open( rpath, O_WRONLY|O_CREAT, (mode_t) 0600 );
+    int fd_global = open( rpath, O_WRONLY|O_CREAT|O_TRUNC, (mode_t) 0600 );
     if( fd_global == -1 ) {
         FTI_FreeStageRequest( FTI_Exec, FTI_Topo, ID, source );
         FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
@@ -920,174 +990,158 @@ int FTI_HandleStageRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exe
         close( fd_local );
         return FTI_NSCS;
     }
-    // allocate buffer
-    char *buf = (char*) malloc( bs );
-    if ( buf == NULL ) {
-        close ( fd_local );
-        close ( fd_global );
-        FTI_FreeStageRequest( FTI_Exec, FTI_Topo, ID, source );
-        FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
-        FTI_Print( "failed to allocate memory for 'buf' in 'FTI_HandleStageRequest'", FTI_EROR );
-        return FTI_NSCS;
-    }
-
-    // move file to destination
-    off_t pos = 0;
-    ssize_t read_bytes, write_bytes;
-    size_t buf_bytes;
-    while( pos < eof ) {
-        buf_bytes = ( (eof - pos) < bs ) ? eof - pos : bs;
-        // for the case we have written less then we have read
-        if( lseek( fd_local, pos, SEEK_SET ) == -1 ) {
-            FTI_FreeStageRequest( FTI_Exec, FTI_Topo, ID, source );
-            FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
-            snprintf( errstr, FTI_BUFS, "unable to seek in '%s'.", lpath );
-            FTI_Print( errstr, FTI_EROR );
-            errno = 0;
-            free( buf );
-            close( fd_local );
-            close( fd_global );
-            return FTI_NSCS;
-        }
-        if( (read_bytes = read( fd_local, buf, buf_bytes )) == -1 ) {
-            FTI_FreeStageRequest( FTI_Exec, FTI_Topo, ID, source );
-            FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
-            snprintf( errstr, FTI_BUFS, "unable to read from '%s'.", lpath );
-            FTI_Print( errstr, FTI_EROR );
-            errno = 0;
-            free( buf );
-            close( fd_local );
-            close( fd_global );
-            return FTI_NSCS;
-        }
-        if( (write_bytes = write( fd_global, buf, read_bytes )) == -1 ) {  
+    // append request to the stage queue
+    if ( stageQueueSize == stageQueueCap ) {
+        int cap = (stageQueueCap == 0) ? 16 : 2 * stageQueueCap;
+        void *ptr = realloc( stageQueue, sizeof(FTIT_StageQueueEntry) * cap );
+        if ( ptr == NULL ) {
             FTI_FreeStageRequest( FTI_Exec, FTI_Topo, ID, source );
             FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
-            snprintf( errstr, FTI_BUFS, "unable to write to '%s'.", rpath );
-            FTI_Print( errstr, FTI_EROR );
-            errno = 0;
-            free( buf );
+            FTI_Print( "failed to allocate memory for 'stageQueue' in 'FTI_HandleStageRequest'", FTI_EROR );
             close( fd_local );
             close( fd_global );
             return FTI_NSCS;
         }
-        pos += write_bytes;
+        stageQueue = ptr;
+        stageQueueCap = cap;
     }
 
-    // deallocate buffer and close file descriptors
-    free( buf );
-    close( fd_local );
-    fsync( fd_global );
-    close( fd_global );
- 
-    FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_SCES, FTI_SIF_VAL, source );
-    FTI_FreeStageRequest( FTI_Exec, FTI_Topo, ID, source );
-    
+    FTIT_StageHeadInfo *info = FTI_GetStageRequestHead( FTI_Exec, ID, source );
+    if ( info == NULL ) {
+        FTI_SetStatusField( FTI_Exec, FTI_Topo, ID, FTI_SI_FAIL, FTI_SIF_VAL, source );
+        snprintf( errstr, FTI_BUFS, "no meta info for stage request %d of rank %d, staging failed.", ID, source );
+        FTI_Print( errstr, FTI_EROR );
+        close( fd_local );
+        close( fd_global );
+        return FTI_NSCS;
+    }
+    info->size = eof;
+    info->fdLocal = fd_local;
+    info->fdGlobal = fd_global;
+
+    stageQueue[stageQueueSize].source = source;
+    stageQueue[stageQueueSize].ID = ID;
+    stageQueue[stageQueueSize].res = FTI_SCES;
+    stageQueue[stageQueueSize].info = NULL;
+    stageQueueSize++;
+
     return FTI_SCES;
 }
 
 /*-------------------------------------------------------------------------*/
 /**            
-  @brief      Returns value from the 'idxRequest' field array at 'ID'.
-  @param      integer           'ID' of staging request
-  @param      FTIT_StatusField  requested field
-  @return     Field value on success, 'FTI_NSCS' else.
+  @brief      Transfers the next chunk of a queued stage request.
+  @param      integer         'idx', index of the request in the queue.
+  @param      FTI_Conf        Configuration metadata (passed as void*).
+  @return     'FTI_SCES' always, the result is kept in the queue element.
+
+  Called for the active requests through 'FTI_ForEachProc', thus
+  possibly from several head threads at the same time. It does not
+  touch the status field (which requires MPI).
  **/
 /*-------------------------------------------------------------------------*/
-int FTI_GetRequestField( int ID, FTIT_RequestField val ) 
+static int FTI_StageChunk( int idx, void *arg )
 {
-
-    if ( !FTI_SI_ENABLED ) {
-        FTI_Print( "Staging disabled, invalid call to 'FTI_GetRequestField'", FTI_WARN );
-        return FTI_NSCS;
+    FTIT_configuration *FTI_Conf = (FTIT_configuration*) arg;
+    FTIT_StageHeadInfo *info = stageQueue[idx].info;
+ 
+    size_t count = info->size - info->offset;
+    if ( count > (size_t)FTI_Conf->stageChunkSize ) {
+        count = FTI_Conf->stageChunkSize;
     }
 
-    if( (val < FTI_SIF_ALL) || (val > FTI_SIF_IDX) ) {
-        FTI_Print( "invalid argument for 'FTI_GetRequestIdxField'", FTI_WARN );
-        return FTI_NSCS;
+    // in-kernel copy if the file systems allow it
+    FTI_Throttle( count );
+    stageQueue[idx].res = FTI_CopyFileRange( info->fdLocal, info->fdGlobal, 
+            info->offset, count, FTI_Conf->transferSize );
+    if ( stageQueue[idx].res == FTI_SCES ) {
+        info->offset += count;
     }
-    
-    const uint32_t all_mask = 0x00080000;
-    const uint32_t idx_mask = 0x0007FFFF; // 524,288 ID's, max ID: 524,287
-
-    uint32_t field = idxRequest[ID];
-
-    int query;
-
-    switch( val ) {
-
-        case FTI_SIF_ALL:
-            query = (int)((field & all_mask) >> 19);
-            break;
-        case FTI_SIF_IDX:
-            query = ((int)(field & idx_mask));
-            break;
-
-    }
-
-    return query;
 
+    return FTI_SCES;
 }
 
 /*-------------------------------------------------------------------------*/
 /**            
-  @brief      Sets value of the 'idxRequest' field array at 'ID'.
-  @param      integer           'ID' of staging request
-  @param      integer           'entry', new value of field
-  @param      FTIT_StatusField  requested field
-  @return     'entry' on success, 'FTI_NSCS' else.
+  @brief      Advances the queued stage requests by one chunk.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @return     Number of requests remaining in the queue.
+
+  The first 'FTI_Conf->stageStreams' requests of the queue are
+  transferred concurrently by one chunk each. Requests that are
+  completed or failed are finalized and removed from the queue. The
+  function is called by the head in 'FTI_Listen' while no checkpoint
+  request is pending.
  **/
 /*-------------------------------------------------------------------------*/
-int FTI_SetRequestField( int ID, uint32_t entry, FTIT_RequestField val )
+int FTI_ProgressStage( FTIT_configuration *FTI_Conf, FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo )
 {
 
-    if ( !FTI_SI_ENABLED ) {
-        FTI_Print( "Staging disabled, invalid call to 'FTI_SetRequestField'", FTI_WARN );
-        return FTI_NSCS;
+    // 'enableStagingPtr' is not set if staging was never initialized
+    if ( (stageQueueSize == 0) || !FTI_SI_ENABLED ) {
+        return 0;
     }
 
-    if( (val < FTI_SIF_ALL) || (val > FTI_SIF_IDX) ) {
-        FTI_Print( "invalid argument for 'FTI_SetRequestIdxField'", FTI_WARN );
-        return FTI_NSCS;
+    char errstr[FTI_BUFS];
+    
+    int nbActive = (stageQueueSize < FTI_Conf->stageStreams) ? stageQueueSize : FTI_Conf->stageStreams;
+
+    // the request arrays may have been reallocated since the last call
+    int i;
+    for ( i=0; i<nbActive; ++i ) {
+        FTIT_StageQueueEntry *entry = &stageQueue[i];
+        entry->info = FTI_GetStageRequestHead( FTI_Exec, entry->ID, entry->source );
+        if ( entry->info->offset == 0 ) {
+            FTI_SetStatusField( FTI_Exec, FTI_Topo, entry->ID, FTI_SI_ACTV, FTI_SIF_VAL, entry->source );
+        }
     }
 
-    const uint32_t all_mask = 0x00080000;
-    const uint32_t idx_mask = 0x0007FFFF; // 524,288 ID's, max ID: 524,287
+    FTI_ForEachProc( 0, nbActive, FTI_StageChunk, FTI_Conf, 0 );
 
-    bool err = false;
+    // finalize completed or failed transfers
+    int nbDone = 0;
+    for ( i=0; i<nbActive; ++i ) {
+        FTIT_StageQueueEntry *entry = &stageQueue[i];
+        FTIT_StageHeadInfo *info = entry->info;
+        if ( (entry->res == FTI_SCES) && (info->offset < info->size) ) {
+            continue;
+        }
+        close( info->fdLocal );
+        if ( entry->res == FTI_SCES ) {
+            fsync( info->fdGlobal );
+            FTI_SetStatusField( FTI_Exec, FTI_Topo, entry->ID, FTI_SI_SCES, FTI_SIF_VAL, entry->source );
+        } else {
+            FTI_SetStatusField( FTI_Exec, FTI_Topo, entry->ID, FTI_SI_FAIL, FTI_SIF_VAL, entry->source );
+            snprintf( errstr, FTI_BUFS, "unable to copy '%s' to '%s'.", info->lpath, info->rpath );
+            FTI_Print( errstr, FTI_EROR );
+            errno = 0;
+        }
+        close( info->fdGlobal );
+        entry->info = NULL;
+        nbDone++;
+    }
 
-    uint32_t field = idxRequest[ID];
+    if ( nbDone == 0 ) {
+        return stageQueueSize;
+    }
 
-    switch( val ) {
+    // remove finalized requests (keeps the order of the queue)
+    int j = 0;
+    for ( i=0; i<stageQueueSize; ++i ) {
+        if ( (i < nbActive) && (stageQueue[i].info == NULL) ) {
+            FTI_FreeStageRequest( FTI_Exec, FTI_Topo, stageQueue[i].ID, stageQueue[i].source );
+            continue;
+        }
+        stageQueue[j++] = stageQueue[i];
+    }
+    stageQueueSize = j;
 
-        case FTI_SIF_ALL:
-            if ( ( entry > 0x1 ) ) { 
-                FTI_Print( "invalid argument for 'FTI_SetRequestIdxField'", FTI_WARN );
-                err = true;
-                break;
-            }
-            field = (entry << 19) | ((~all_mask) & field);
-            break;
-        case FTI_SIF_IDX:
-            if ( entry > idx_mask ) {
-                FTI_Print( "invalid argument for 'FTI_SetRequestIdxField'", FTI_WARN );
-                err = true;
-                break;
-            }
-            field = entry | ((~idx_mask) & field);
-            break;
+    return stageQueueSize;
 
-    }
-    
-    if ( !err ) {
-        idxRequest[ID] = field;
-        return entry;
-    } else {
-        return FTI_NSCS;
-    }
-    
 }
-    
+
 /*-------------------------------------------------------------------------*/
 /**            
   @brief      Returns value from the 'status' field array at 'ID'.
@@ -1265,7 +1319,7 @@ void FTI_PrintStageStatus( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, in
     }
 
     // get idx string
-    val = FTI_GetRequestField( ID, FTI_SIF_IDX );
+    val = ( FTI_Topo->amIaHead ) ? FTI_StageIdxGet( FTI_SI_HKEY( source, ID ) ) : FTI_GetRequestIdx( ID );
     char idxstr[FTI_BUFS];
     if ( val < 0 ) {
         snprintf(idxstr, FTI_BUFS, "not valid ('%d')", val );
@@ -46,14 +46,20 @@
 #define FTI_SI_NAVL 0x1
 #define FTI_SI_IAVL 0x0
 
-#define FTI_SI_IALL 0x1
-#define FTI_SI_NALL 0x0
-
 #define FTI_SI_APTR( ptr ) ((FTIT_StageAppInfo*)ptr)
 #define FTI_SI_HPTR( ptr ) ((FTIT_StageHeadInfo*)ptr)
 
 #define FTI_SI_MAX_ID (0x7ffff)
 
+/** key of a request in the head look-up table */
+#define FTI_SI_HKEY( source, ID ) ((((int64_t)(source)) << 32) | (int64_t)(ID))
+
+/** initial capacity of the look-up table and the request arrays */
+#define FTI_SI_IDX_MIN 16
+
+/** size of a serialized stage request (local path, remote path, ID) */
+#define FTI_SI_REQ_SIZE (2*FTI_BUFS + sizeof(int))
+
 #define FTI_DISABLE_STAGING do{*enableStagingPtr = false;} while(0)
 #define FTI_SI_ENABLED (*(bool*)enableStagingPtr)
 
@@ -68,16 +74,22 @@ typedef enum {
     FTI_SIF_VAL,
 } FTIT_StatusField;
 
-/** @typedef    FTIT_RequestField
- *  @brief      valid fields of 'idxRequest'.
- * 
- *  enum that keeps the particular field identifiers for the
- *  'idxRequest' field.
+/** @typedef    FTIT_StageIdxEntry
+ *  @brief      Element of the request look-up table.
  */
-typedef enum {
-    FTI_SIF_ALL = 0,
-    FTI_SIF_IDX
-} FTIT_RequestField;
+typedef struct FTIT_StageIdxEntry {
+    int64_t key;                    /**< request key (-1 if empty)      */
+    int idx;                        /**< index in the request array     */
+} FTIT_StageIdxEntry;
+
+/** @typedef    FTIT_StageIdxTable
+ *  @brief      Open addressing hash table for the request look-up.
+ */
+typedef struct FTIT_StageIdxTable {
+    FTIT_StageIdxEntry *entry;      /**< slots (capacity is power of 2) */
+    size_t capacity;                /**< number of slots                */
+    size_t count;                   /**< number of occupied slots       */
+} FTIT_StageIdxTable;
 
 /** @typedef    FTIT_StageHeadInfo
  *  @brief      Head rank staging meta info.
@@ -87,9 +99,21 @@ typedef struct FTIT_StageHeadInfo {
     char rpath[FTI_BUFS];           /**< file name                      */
     size_t offset;                  /**< current offset of file pointer */
     size_t size;                    /**< file size                      */
+    int fdLocal;                    /**< file descriptor of local file  */
+    int fdGlobal;                   /**< file descriptor of remote file */
     int ID;                         /**< ID of request                  */
 } FTIT_StageHeadInfo;
 
+/** @typedef    FTIT_StageQueueEntry
+ *  @brief      Element of the head staging request queue.
+ */
+typedef struct FTIT_StageQueueEntry {
+    int source;                     /**< application rank of request    */
+    int ID;                         /**< ID of request                  */
+    int res;                        /**< result of last chunk transfer  */
+    FTIT_StageHeadInfo *info;       /**< request meta info (per round)  */
+} FTIT_StageQueueEntry;
+
 /** @typedef    FTIT_StageAppInfo
  *  @brief      Application rank staging meta info.
  */
@@ -110,11 +134,10 @@ int FTI_InitStageRequestHead( char* lpath, char *rpath, FTIT_execution *FTI_Exec
 int FTI_SyncStage( char* lpath, char *rpath, FTIT_execution *FTI_Exec, 
         FTIT_topology *FTI_Topo, FTIT_configuration *FTI_Conf, uint32_t ID ); 
 int FTI_HandleStageRequest(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
-        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, int source);
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt, void* buf_ser, int source);
+int FTI_ProgressStage( FTIT_configuration *FTI_Conf, FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo );
 int FTI_GetStatusField( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, int ID, FTIT_StatusField val, int source ); 
 int FTI_SetStatusField( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, int ID, uint8_t entry, FTIT_StatusField val, int source );
-int FTI_GetRequestField( int ID, FTIT_RequestField val ); 
-int FTI_SetRequestField( int ID, uint32_t entry, FTIT_RequestField val );
 int FTI_FreeStageRequest( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, int ID, int source ); 
 void FTI_PrintStageStatus( FTIT_execution *FTI_Exec, FTIT_topology *FTI_Topo, int ID, int source ); 
 int FTI_GetRequestIdx( int ID );
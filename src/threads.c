@@ -0,0 +1,426 @@
+/**
+ *  Copyright (c) 2017 Leonardo A. Bautista-Gomez
+ *  All rights reserved
+ *
+ *  FTI - A multi-level checkpointing library for C/C++/Fortran applications
+ *
+ *  Revision 1.0 : Fault Tolerance Interface (FTI)
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  @file   threads.c
+ *  @date   October, 2018
+ *  @brief  Threads for the asynchronous post-processing.
+ */
+
+#include "interface.h"
+#include <pthread.h>
+
+/** @typedef    FTIT_headJob
+ *  @brief      Loop over the application processes shared by the workers.
+ */
+typedef struct FTIT_headJob {
+    FTIT_procFunc   func;               /**< Post-processing of one proc.   */
+    void*           arg;                /**< Argument passed to func.       */
+    int             next;               /**< Next proc. to post-process.    */
+    int             end;                /**< End of the loop (excluded).    */
+    int             active;             /**< Procs. being post-processed.   */
+    int             res;                /**< FTI_NSCS if any proc. failed.  */
+    unsigned long   gen;                /**< Incremented for each new loop. */
+    int             stop;               /**< 1 when the workers must exit.  */
+} FTIT_headJob;
+
+static pthread_t* workers = NULL;       /**< Worker threads of the head     */
+static int nbWorkers = 0;               /**< Number of worker threads       */
+static int mpiThreadMultiple = 0;       /**< 1 if MPI_THREAD_MULTIPLE       */
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t jobOwner = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+static FTIT_headJob job;
+
+/** @typedef    FTIT_postCkptArgs
+ *  @brief      Arguments of the post-processing thread.
+ */
+typedef struct FTIT_postCkptArgs {
+    FTIT_configuration* FTI_Conf;       /**< Configuration metadata.        */
+    FTIT_execution*     FTI_Exec;       /**< Execution metadata.            */
+    FTIT_topology*      FTI_Topo;       /**< Topology metadata.             */
+    FTIT_checkpoint*    FTI_Ckpt;       /**< Checkpoint metadata.           */
+} FTIT_postCkptArgs;
+
+static pthread_t postThread;            /**< Post-processing thread         */
+static int postThreadActive = 0;        /**< 1 if postThread must be joined */
+static int postLevel = FTI_NSCS;        /**< Level post-processed or NSCS   */
+static double postTime = 0;             /**< Duration of the post-proc.     */
+static FTIT_postCkptArgs postArgs;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Post-processes procs. of the current loop until none is left.
+
+  Must be called with jobLock held, returns with jobLock held.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_RunHeadJob(void)
+{
+    while (job.next < job.end) {
+        int proc = job.next++;
+        job.active++;
+        pthread_mutex_unlock(&jobLock);
+        int res = job.func(proc, job.arg);
+        pthread_mutex_lock(&jobLock);
+        job.active--;
+        if (res != FTI_SCES) {
+            job.res = FTI_NSCS;
+        }
+    }
+    if (job.active == 0) {
+        pthread_cond_broadcast(&jobDone);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Main function of the worker threads of the head.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void* FTI_HeadWorker(void* unused)
+{
+    unsigned long seen = 0;
+    pthread_mutex_lock(&jobLock);
+    while (1) {
+        while (!job.stop && job.gen == seen) {
+            pthread_cond_wait(&jobStart, &jobLock);
+        }
+        if (job.stop) {
+            break;
+        }
+        seen = job.gen;
+        FTI_RunHeadJob();
+    }
+    pthread_mutex_unlock(&jobLock);
+    return NULL;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Starts the worker threads.
+  @param      nbThreads       Number of threads (the calling thread included).
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void FTI_StartWorkers(int nbThreads)
+{
+    int provided;
+    MPI_Query_thread(&provided);
+    mpiThreadMultiple = (provided == MPI_THREAD_MULTIPLE);
+
+    memset(&job, 0, sizeof(FTIT_headJob));
+    workers = talloc(pthread_t, nbThreads);
+    int i;
+    for (i = 0; i < nbThreads - 1; i++) {
+        if (pthread_create(&workers[i], NULL, FTI_HeadWorker, NULL) != 0) {
+            FTI_Print("Cannot create worker thread.", FTI_WARN);
+            break;
+        }
+        nbWorkers++;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Starts the worker threads of the head.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Topo        Topology metadata.
+  @return     integer         FTI_SCES if successful.
+
+  The head post-processes the checkpoints of the application processes of
+  its node with 'head_threads' threads (the calling thread included).
+  Post-processing that communicates with other heads (L2, L3 and MPI-IO
+  L4) is only done concurrently if MPI provides MPI_THREAD_MULTIPLE;
+  otherwise only the local file transfers are done concurrently.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_InitHeadThreads(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo)
+{
+    char str[FTI_BUFS];
+    int nbThreads = (FTI_Conf->headThreads < FTI_Topo->nbApprocs) ? FTI_Conf->headThreads : FTI_Topo->nbApprocs;
+    FTI_StartWorkers(nbThreads);
+
+    snprintf(str, FTI_BUFS, "Head post-processing with %d threads (MPI communication %s).",
+            nbWorkers + 1, (mpiThreadMultiple) ? "concurrent" : "serialized");
+    FTI_Print(str, FTI_DBUG);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Starts the worker threads of an application process.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @return     integer         FTI_SCES if successful.
+
+  The blocks of the compressed checkpoints are (de-)compressed by
+  'compress_threads' threads and, at restart, the checkpoint files are
+  read by 'recover_threads' threads (the calling thread included). The
+  workers are shared, there are as many as the larger of the two until
+  FTI_ShrinkAppThreads is called after the recovery.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_InitAppThreads(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec)
+{
+    char str[FTI_BUFS];
+    int nbThreads = (FTI_Conf->compressCodec != FTI_CODEC_NONE) ? FTI_Conf->compressThreads : 1;
+    if (FTI_Exec->reco && FTI_Conf->recoverThreads > nbThreads) {
+        nbThreads = FTI_Conf->recoverThreads;
+    }
+    FTI_StartWorkers(nbThreads);
+
+    snprintf(str, FTI_BUFS, "Checkpoint compression and recovery with %d threads.", nbWorkers + 1);
+    FTI_Print(str, FTI_DBUG);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Shrinks the worker threads of an application process.
+  @param      FTI_Conf        Configuration metadata.
+
+  Called once the recovery is over: if the workers were started for
+  'recover_threads', the surplus is stopped so that the checkpoints are
+  compressed by 'compress_threads' threads.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_ShrinkAppThreads(FTIT_configuration* FTI_Conf)
+{
+    char str[FTI_BUFS];
+    int nbThreads = (FTI_Conf->compressCodec != FTI_CODEC_NONE) ? FTI_Conf->compressThreads : 1;
+    if (nbWorkers + 1 <= nbThreads) {
+        return;
+    }
+    FTI_FinalizeWorkerThreads();
+    if (nbThreads > 1) {
+        FTI_StartWorkers(nbThreads);
+    }
+
+    snprintf(str, FTI_BUFS, "Checkpoint compression with %d threads.", nbWorkers + 1);
+    FTI_Print(str, FTI_DBUG);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Returns the number of threads running FTI_ForEachProc loops.
+  @return     integer         Number of workers plus the calling thread.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_GetThreadCount(void)
+{
+    return nbWorkers + 1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Stops the worker threads.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_FinalizeWorkerThreads(void)
+{
+    pthread_mutex_lock(&jobLock);
+    job.stop = 1;
+    pthread_cond_broadcast(&jobStart);
+    pthread_mutex_unlock(&jobLock);
+    int i;
+    for (i = 0; i < nbWorkers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    workers = NULL;
+    nbWorkers = 0;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Post-processes a range of application processes.
+  @param      startProc       First proc. to post-process.
+  @param      endProc         End of the range (excluded).
+  @param      func            Post-processing of one proc.
+  @param      arg             Argument passed to func.
+  @param      useMpi          1 if func communicates through MPI.
+  @return     integer         FTI_SCES if successful.
+
+  The procs. are distributed among the worker threads of the head and
+  the calling thread. If there are no workers, if func communicates and
+  MPI is not thread safe, or if the workers are busy with a loop of
+  another thread, the procs. are post-processed in order and the loop
+  stops at the first failure.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_ForEachProc(int startProc, int endProc, FTIT_procFunc func, void* arg,
+        int useMpi)
+{
+    if (nbWorkers == 0 || (useMpi && !mpiThreadMultiple) || endProc - startProc < 2 ||
+            pthread_mutex_trylock(&jobOwner) != 0) {
+        int proc;
+        for (proc = startProc; proc < endProc; proc++) {
+            if (func(proc, arg) != FTI_SCES) {
+                return FTI_NSCS;
+            }
+        }
+        return FTI_SCES;
+    }
+
+    pthread_mutex_lock(&jobLock);
+    job.func = func;
+    job.arg = arg;
+    job.next = startProc;
+    job.end = endProc;
+    job.active = 0;
+    job.res = FTI_SCES;
+    job.gen++;
+    pthread_cond_broadcast(&jobStart);
+    FTI_RunHeadJob();
+    while (job.next < job.end || job.active > 0) {
+        pthread_cond_wait(&jobDone, &jobLock);
+    }
+    int res = job.res;
+    pthread_mutex_unlock(&jobLock);
+    pthread_mutex_unlock(&jobOwner);
+    return res;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Main function of the post-processing thread.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static void* FTI_PostCkptThread(void* arg)
+{
+    FTIT_postCkptArgs* args = (FTIT_postCkptArgs*) arg;
+    double t0 = MPI_Wtime();
+    int res = FTI_Try(FTI_PostCkpt(args->FTI_Conf, args->FTI_Exec, args->FTI_Topo, args->FTI_Ckpt),
+            "postprocess the checkpoint.");
+    postLevel = (res == FTI_SCES) ? args->FTI_Exec->ckptLvel : FTI_NSCS;
+    postTime = MPI_Wtime() - t0;
+    return NULL;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Prepares the asynchronous post-processing without heads.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @return     integer         FTI_SCES if successful.
+
+  The post-processing thread communicates on a duplicate of
+  FTI_COMM_WORLD, so that its collectives do not interfere with the ones
+  of the application. Collective on FTI_COMM_WORLD.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_InitPostThread(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec)
+{
+    MPI_Comm_dup(FTI_COMM_WORLD, &FTI_Exec->postComm);
+    FTI_Print("Post-processing of levels with 'inline_lX = 0' done by a thread.", FTI_DBUG);
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Frees the resources of the asynchronous post-processing.
+  @param      FTI_Exec        Execution metadata.
+
+  The last post-processing must have been waited for.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_FinalizePostThread(FTIT_execution* FTI_Exec)
+{
+    MPI_Comm_free(&FTI_Exec->postComm);
+    FTI_Exec->postComm = FTI_COMM_WORLD;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Starts the post-processing of the last checkpoint.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      FTI_Ckpt        Checkpoint metadata.
+  @return     integer         FTI_SCES if successful.
+
+  FTI_PostCkpt runs in a thread while the application continues. The
+  result is obtained with FTI_JoinPostThread, before the next checkpoint.
+  Until then the thread owns the checkpoint fields of FTI_Exec (ckptID,
+  ckptLvel, meta) and FTI_Ckpt, so the application only changes them
+  after the join. If the thread cannot be created the post-processing is
+  done inline.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_StartPostThread(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, FTIT_checkpoint* FTI_Ckpt)
+{
+    postArgs.FTI_Conf = FTI_Conf;
+    postArgs.FTI_Exec = FTI_Exec;
+    postArgs.FTI_Topo = FTI_Topo;
+    postArgs.FTI_Ckpt = FTI_Ckpt;
+    postLevel = FTI_NSCS;
+    if (pthread_create(&postThread, NULL, FTI_PostCkptThread, &postArgs) != 0) {
+        FTI_Print("Cannot create post-processing thread, post-processing inline.", FTI_WARN);
+        FTI_PostCkptThread(&postArgs);
+        return FTI_SCES;
+    }
+    postThreadActive = 1;
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Waits for the post-processing of the last checkpoint.
+  @param      time            Duration of the post-processing.
+  @return     integer         Level post-processed, FTI_NSCS if it failed.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_JoinPostThread(double* time)
+{
+    if (postThreadActive) {
+        pthread_join(postThread, NULL);
+        postThreadActive = 0;
+    }
+    *time = postTime;
+    return postLevel;
+}
@@ -38,12 +38,33 @@
 
 #include "interface.h"
 #include <dirent.h>
+#include <pthread.h>
 #include "api_cuda.h"
 
+#ifdef __linux__
+#   include <sys/syscall.h>
+#   include <sys/sendfile.h>
+#endif
+
 int FTI_filemetastructsize;		        /**< size of FTIFF_db struct in file    */
 int FTI_dbstructsize;		        /**< size of FTIFF_db struct in file    */
 int FTI_dbvarstructsize;		        /**< size of FTIFF_db struct in file    */
 
+/** 
+ * @brief token bucket that limits the bandwidth of the background I/O. 
+ *
+ * 'throttleRate' is the rate of this process in bytes per second (0 if
+ * the bandwidth is not limited) and 'throttleTokens' the number of
+ * bytes that may be written without waiting. The bucket holds at most
+ * 'throttleBurst' bytes. The lock is needed since the head threads and
+ * the post-processing thread share the bucket.
+ **/
+static double throttleRate;
+static double throttleBurst;
+static double throttleTokens;
+static struct timespec throttleTime;
+static pthread_mutex_t throttleLock = PTHREAD_MUTEX_INITIALIZER;
+
 
 /*-------------------------------------------------------------------------*/
 /**
@@ -59,6 +80,8 @@ int FTI_InitExecVars(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     FTIT_injection* FTI_Inje) {
 
   // datablock size in file
+  // the codec is stored in the padding byte, hence the size is the same
+  // as for files written before compression was available.
   FTI_filemetastructsize
     = MD5_DIGEST_STRING_LENGTH
     + MD5_DIGEST_LENGTH
@@ -85,14 +108,18 @@ int FTI_InitExecVars(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   /* char[BUFS]       FTI_Exec->id */                 memset(FTI_Exec->id,0x0,FTI_BUFS);
   /* int           */ FTI_Exec->ckpt                  =0;
   /* int           */ FTI_Exec->reco                  =0;
+  /* bool          */ FTI_Exec->recoVerified          =false;
   /* int           */ FTI_Exec->ckptLvel              =0;
   /* int           */ FTI_Exec->ckptIntv              =0;
   /* int           */ FTI_Exec->lastCkptLvel          =0;
   /* int           */ FTI_Exec->wasLastOffline        =0;
+  /* double        */ FTI_Exec->lastWriteTime         =0;
   /* double        */ FTI_Exec->iterTime              =0;
   /* double        */ FTI_Exec->lastIterTime          =0;
   /* double        */ FTI_Exec->meanIterTime          =0;
   /* double        */ FTI_Exec->globMeanIter          =0;
+  /* double        */ FTI_Exec->iterSyncSum           =0;
+  /* MPI_Request   */ FTI_Exec->iterSyncReq           =MPI_REQUEST_NULL;
   /* double        */ FTI_Exec->totalIterTime         =0;
   /* unsigned int  */ FTI_Exec->syncIter              =0;
   /* int           */ FTI_Exec->syncIterMax           =0;
@@ -105,6 +132,9 @@ int FTI_InitExecVars(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   /* unsigned int  */ FTI_Exec->ckptLast              =0;
   /* long          */ FTI_Exec->ckptSize              =0;
   /* unsigned int  */ FTI_Exec->nbVar                 =0;
+  /* unsigned int  */ FTI_Exec->nbVarMax              =0;
+  /* FTIT_dataIdxEntry* */ FTI_Exec->dataIdx          =NULL;
+  /* int           */ FTI_Exec->dataIdxSize           =0;
   /* unsigned int  */ FTI_Exec->nbVarStored           =0;
   /* unsigned int  */ FTI_Exec->nbType                =0;
   /* int           */ FTI_Exec->metaAlloc             =0;
@@ -115,8 +145,11 @@ int FTI_InitExecVars(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
   /* FTIFF_db      */ FTI_Exec->lastdb                =NULL;
   FTI_Exec->stageInfo             =NULL;
   /* FTIFF_metaInfo   FTI_Exec->FTIFFMeta */          memset(&(FTI_Exec->FTIFFMeta),0x0,sizeof(FTIFF_metaInfo));
+  /* FTIFF_idx        FTI_Exec->FTIFFIdx */           memset(&(FTI_Exec->FTIFFIdx),0x0,sizeof(FTIFF_idx));
   /* MPI_Comm      */ FTI_Exec->globalComm            =0;
   /* MPI_Comm      */ FTI_Exec->groupComm             =0;
+  /* MPI_Comm      */ FTI_Exec->subfileComm           =MPI_COMM_NULL;
+  /* MPI_Comm      */ FTI_Exec->postComm              =MPI_COMM_NULL;
 
   // +--------- +
   // | FTI_Conf |
@@ -270,27 +303,33 @@ int FTI_Checksum(FTIT_execution* FTI_Exec, FTIT_dataset* FTI_Data,
 
   This function calculates checksum of the checkpoint file based on
   MD5 algorithm. It compares calculated hash value with the one saved
-  in the file.
+  in the file. The file is read by the worker threads (FTI_HashFile).
 
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_VerifyChecksum(char* fileName, char* checksumToCmp)
 {
-  FILE *fd = fopen(fileName, "rb");
-  if (fd == NULL) {
+  int fd = open(fileName, O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
     char str[FTI_BUFS];
     sprintf(str, "FTI failed to open file %s to calculate checksum.", fileName);
     FTI_Print(str, FTI_WARN);
+    if (fd != -1) {
+      close(fd);
+    }
     return FTI_NSCS;
   }
 
   MD5_CTX mdContext;
   MD5_Init (&mdContext);
 
-  int bytes;
-  unsigned char data[CHUNK_SIZE];
-  while ((bytes = fread (data, 1, CHUNK_SIZE, fd)) != 0) {
-    MD5_Update (&mdContext, data, bytes);
+  if (FTI_HashFile(fd, (long) st.st_size, &mdContext) != FTI_SCES) {
+    char str[FTI_BUFS];
+    sprintf(str, "FTI failed to read file %s to calculate checksum.", fileName);
+    FTI_Print(str, FTI_WARN);
+    close(fd);
+    return FTI_NSCS;
   }
   unsigned char hash[MD5_DIGEST_LENGTH];
   MD5_Final (hash, &mdContext);
@@ -309,12 +348,12 @@ int FTI_VerifyChecksum(char* fileName, char* checksumToCmp)
         fileName, checksum, checksumToCmp);
     FTI_Print(str, FTI_WARN);
 
-    fclose (fd);
+    close (fd);
 
     return FTI_NSCS;
   }
 
-  fclose (fd);
+  close (fd);
 
   return FTI_SCES;
 }
@@ -369,8 +408,10 @@ void FTI_MallocMeta(FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo)
       FTI_Exec->meta[i].ckptFile = calloc(FTI_BUFS * FTI_Topo->nodeSize, sizeof(char));
       FTI_Exec->meta[i].currentL4CkptFile = calloc(FTI_BUFS * FTI_Topo->nodeSize, sizeof(char));
       FTI_Exec->meta[i].nbVar = calloc(FTI_Topo->nodeSize, sizeof(int));
-      FTI_Exec->meta[i].varID = calloc(FTI_BUFS * FTI_Topo->nodeSize, sizeof(int));
-      FTI_Exec->meta[i].varSize = calloc(FTI_BUFS * FTI_Topo->nodeSize, sizeof(long));
+      FTI_Exec->meta[i].varID = calloc(FTI_DATA_MIN * FTI_Topo->nodeSize, sizeof(int));
+      FTI_Exec->meta[i].varSize = calloc(FTI_DATA_MIN * FTI_Topo->nodeSize, sizeof(long));
+      FTI_Exec->meta[i].varMax = FTI_DATA_MIN;
+      FTI_Exec->meta[i].nbProc = FTI_Topo->nodeSize;
     }
   } else {
     for (i = 0; i < 5; i++) {
@@ -381,8 +422,10 @@ void FTI_MallocMeta(FTIT_execution* FTI_Exec, FTIT_topology* FTI_Topo)
       FTI_Exec->meta[i].ckptFile = calloc(FTI_BUFS, sizeof(char));
       FTI_Exec->meta[i].currentL4CkptFile = calloc(FTI_BUFS, sizeof(char));
       FTI_Exec->meta[i].nbVar = calloc(1, sizeof(int));
-      FTI_Exec->meta[i].varID = calloc(FTI_BUFS, sizeof(int));
-      FTI_Exec->meta[i].varSize = calloc(FTI_BUFS, sizeof(long));
+      FTI_Exec->meta[i].varID = calloc(FTI_DATA_MIN, sizeof(int));
+      FTI_Exec->meta[i].varSize = calloc(FTI_DATA_MIN, sizeof(long));
+      FTI_Exec->meta[i].varMax = FTI_DATA_MIN;
+      FTI_Exec->meta[i].nbProc = 1;
     }
   }
   FTI_Exec->metaAlloc = 1;
@@ -410,11 +453,174 @@ void FTI_FreeMeta(FTIT_execution* FTI_Exec)
       free(FTI_Exec->meta[i].nbVar);
       free(FTI_Exec->meta[i].varID);
       free(FTI_Exec->meta[i].varSize);
+      FTI_Exec->meta[i].varMax = 0;
     }
     FTI_Exec->metaAlloc = 0;
   }
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It grows the variable arrays of the metadata if needed.
+  @param      meta            Metadata of one checkpoint level.
+  @param      nbVar           Number of variables per process to hold.
+  @return     integer         FTI_SCES if successful.
+
+  The variable arrays hold 'varMax' entries per process. If 'nbVar' does
+  not fit, the capacity is doubled until it does and the entries of every
+  process are moved to their new position.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_ReserveMetaVar(FTIT_metadata* meta, int nbVar)
+{
+  if (nbVar <= meta->varMax) {
+    return FTI_SCES;
+  }
+  int varMax = (meta->varMax > 0) ? meta->varMax : FTI_DATA_MIN;
+  while (varMax < nbVar) {
+    varMax *= 2;
+  }
+  int* varID = calloc((size_t) varMax * meta->nbProc, sizeof(int));
+  long* varSize = calloc((size_t) varMax * meta->nbProc, sizeof(long));
+  if (varID == NULL || varSize == NULL) {
+    free(varID);
+    free(varSize);
+    FTI_Print("Cannot allocate the metadata of the protected variables.", FTI_EROR);
+    return FTI_NSCS;
+  }
+  int i;
+  for (i = 0; i < meta->nbProc; i++) {
+    memcpy(&varID[i * varMax], &meta->varID[i * meta->varMax], meta->varMax * sizeof(int));
+    memcpy(&varSize[i * varMax], &meta->varSize[i * meta->varMax], meta->varMax * sizeof(long));
+  }
+  free(meta->varID);
+  free(meta->varSize);
+  meta->varID = varID;
+  meta->varSize = varSize;
+  meta->varMax = varMax;
+  return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It returns the position of a variable in the metadata.
+  @param      meta            Metadata of one checkpoint level.
+  @param      id              Dataset ID.
+  @param      hint            Expected position, usually the dataset index.
+  @return     integer         Position of the ID, -1 if not stored.
+
+  Datasets are stored in the order in which they are protected, so the
+  hint matches unless the datasets were protected in another order than
+  at checkpoint time. Only the entries of this process are searched.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_GetMetaVarIdx(FTIT_metadata* meta, int id, int hint)
+{
+  int nbVar = meta->nbVar[0];
+  if (hint >= 0 && hint < nbVar && meta->varID[hint] == id) {
+    return hint;
+  }
+  int i;
+  for (i = 0; i < nbVar; i++) {
+    if (meta->varID[i] == id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It hashes a dataset ID into the dataset index.
+  @param      id              Dataset ID.
+  @param      size            Size of the index (power of two).
+  @return     integer         Slot of the ID in the index.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_HashDataID(int id, int size)
+{
+  return (int) (((unsigned int) id * 2654435761u) & (unsigned int) (size - 1));
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It returns the position of a dataset in the registry.
+  @param      FTI_Exec        Execution metadata.
+  @param      id              Dataset ID.
+  @return     integer         Index in FTI_Data, -1 if not protected.
+
+  The lookup goes through an open addressing hash table, so it does not
+  depend on the number of protected datasets.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_GetDataIdx(FTIT_execution* FTI_Exec, int id)
+{
+  if (FTI_Exec->dataIdxSize == 0) {
+    return -1;
+  }
+  int slot = FTI_HashDataID(id, FTI_Exec->dataIdxSize);
+  while (FTI_Exec->dataIdx[slot].idx != -1) {
+    if (FTI_Exec->dataIdx[slot].id == id) {
+      return FTI_Exec->dataIdx[slot].idx;
+    }
+    slot = (slot + 1) & (FTI_Exec->dataIdxSize - 1);
+  }
+  return -1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It adds a dataset to the dataset index.
+  @param      FTI_Exec        Execution metadata.
+  @param      id              Dataset ID.
+  @param      idx             Index of the dataset in FTI_Data.
+  @return     integer         FTI_SCES if successful.
+
+  Datasets are registered with consecutive indexes, so 'idx + 1' is the
+  number of entries after the insertion. The table is doubled whenever it
+  would become more than half full.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_AddDataIdx(FTIT_execution* FTI_Exec, int id, int idx)
+{
+  int i, slot;
+  if ((idx + 1) * 2 > FTI_Exec->dataIdxSize) {
+    int size = (FTI_Exec->dataIdxSize > 0) ? FTI_Exec->dataIdxSize * 2 : FTI_DATA_MIN * 2;
+    FTIT_dataIdxEntry* table = malloc(size * sizeof(FTIT_dataIdxEntry));
+    if (table == NULL) {
+      FTI_Print("Cannot allocate the dataset index.", FTI_EROR);
+      return FTI_NSCS;
+    }
+    for (i = 0; i < size; i++) {
+      table[i].idx = -1;
+    }
+    for (i = 0; i < FTI_Exec->dataIdxSize; i++) {
+      if (FTI_Exec->dataIdx[i].idx != -1) {
+        slot = FTI_HashDataID(FTI_Exec->dataIdx[i].id, size);
+        while (table[slot].idx != -1) {
+          slot = (slot + 1) & (size - 1);
+        }
+        table[slot] = FTI_Exec->dataIdx[i];
+      }
+    }
+    free(FTI_Exec->dataIdx);
+    FTI_Exec->dataIdx = table;
+    FTI_Exec->dataIdxSize = size;
+  }
+  slot = FTI_HashDataID(id, FTI_Exec->dataIdxSize);
+  while (FTI_Exec->dataIdx[slot].idx != -1) {
+    slot = (slot + 1) & (FTI_Exec->dataIdxSize - 1);
+  }
+  FTI_Exec->dataIdx[slot].id = id;
+  FTI_Exec->dataIdx[slot].idx = idx;
+  return FTI_SCES;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      It mallocs memory for the metadata.
@@ -692,20 +898,15 @@ void FTI_CloseGroup(FTIT_H5Group* ftiGroup, FTIT_H5Group** FTI_Group)
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief      It creates the basic datatypes and the dataset array.
-  @param      FTI_Data        Dataset metadata.
+  @brief      It creates the basic datatypes.
   @return     integer         FTI_SCES if successful.
 
   This function creates the basic data types using FTIT_Type.
 
  **/
 /*-------------------------------------------------------------------------*/
-int FTI_InitBasicTypes(FTIT_dataset* FTI_Data)
+int FTI_InitBasicTypes()
 {
-  int i;
-  for (i = 0; i < FTI_BUFS; i++) {
-    FTI_Data[i].id = -1;
-  }
   FTI_InitType(&FTI_CHAR, sizeof(char));
   FTI_InitType(&FTI_SHRT, sizeof(short));
   FTI_InitType(&FTI_INTG, sizeof(int));
@@ -780,6 +981,235 @@ int FTI_RmDir(char path[FTI_BUFS], int flag)
   return FTI_SCES;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      Tells whether a failed in-kernel copy may be retried in user space.
+  @param      err             errno set by copy_file_range or sendfile.
+  @return     integer         1 if the fallback applies, 0 otherwise.
+ **/
+/*-------------------------------------------------------------------------*/
+static int FTI_CopyFallbackErr(int err)
+{
+  return (err == ENOSYS) || (err == EXDEV) || (err == EINVAL) ||
+    (err == EOPNOTSUPP) || (err == EBADF) || (err == ETXTBSY);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It copies the content of one file into another.
+  @param      fd_src          File descriptor of the source file.
+  @param      fd_dst          File descriptor of the destination file.
+  @param      size            Number of bytes to copy.
+  @param      bs              Buffer size for the user space fallback.
+  @return     integer         FTI_SCES if successful.
+
+  The copy is first attempted inside the kernel with copy_file_range,
+  which allows server side copies or reflinks on file systems that
+  support them, and then with sendfile. If neither is supported for the
+  given pair of file systems, the remaining bytes are moved with a
+  pread/pwrite loop through a buffer of 'bs' bytes. Both files are
+  accessed with explicit offsets starting at zero.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_CopyFile(int fd_src, int fd_dst, off_t size, size_t bs)
+{
+  return FTI_CopyFileRange(fd_src, fd_dst, 0, size, bs);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It initializes the bandwidth limit of the background I/O.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Topo        Topology metadata.
+
+  'Advanced:node_bandwidth_limit' is the limit of the whole node. The
+  head does the I/O of all the processes of its node and gets the whole
+  bandwidth, otherwise it is shared equally among the application
+  processes of the node.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_InitThrottle(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo)
+{
+  char str[FTI_BUFS];
+  if (FTI_Conf->nodeBwLimit <= 0) {
+    throttleRate = 0;
+    return;
+  }
+  throttleRate = (double)FTI_Conf->nodeBwLimit * 1024 * 1024;
+  if (!FTI_Topo->amIaHead && FTI_Topo->nbApprocs > 1) {
+    throttleRate /= FTI_Topo->nbApprocs;
+  }
+  throttleBurst = FTI_Conf->transferSize;
+  throttleTokens = throttleBurst;
+  clock_gettime(CLOCK_MONOTONIC, &throttleTime);
+  snprintf(str, FTI_BUFS, "Background I/O limited to %.2f MB/s.", throttleRate / (1024 * 1024));
+  FTI_Print(str, FTI_DBUG);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It waits until 'bytes' may be written.
+  @param      bytes           Number of bytes about to be written.
+
+  The bytes are taken from the bucket right away, thus concurrent
+  callers queue up behind each other. If the bucket runs into debt, the
+  caller sleeps until the debt is paid back at the configured rate.
+
+ **/
+/*-------------------------------------------------------------------------*/
+void FTI_Throttle(size_t bytes)
+{
+  if (throttleRate <= 0) {
+    return;
+  }
+  struct timespec now;
+  pthread_mutex_lock(&throttleLock);
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed = (now.tv_sec - throttleTime.tv_sec) + (now.tv_nsec - throttleTime.tv_nsec) * 1e-9;
+  throttleTime = now;
+  throttleTokens += elapsed * throttleRate;
+  if (throttleTokens > throttleBurst) {
+    throttleTokens = throttleBurst;
+  }
+  throttleTokens -= bytes;
+  double wait = (throttleTokens < 0) ? -throttleTokens / throttleRate : 0;
+  pthread_mutex_unlock(&throttleLock);
+  if (wait > 0) {
+    struct timespec pause;
+    pause.tv_sec = (time_t)wait;
+    pause.tv_nsec = (long)((wait - pause.tv_sec) * 1e9);
+    nanosleep(&pause, NULL);
+  }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It copies a file within the background I/O bandwidth limit.
+  @param      fd_src          File descriptor of the source file.
+  @param      fd_dst          File descriptor of the destination file.
+  @param      size            Number of bytes to copy.
+  @param      bs              Chunk size.
+  @return     integer         FTI_SCES if successful.
+
+  Same as FTI_CopyFile, but the file is copied in chunks of 'bs' bytes
+  passed through FTI_Throttle if the bandwidth is limited.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_CopyFileThrottled(int fd_src, int fd_dst, off_t size, size_t bs)
+{
+  if (throttleRate <= 0) {
+    return FTI_CopyFile(fd_src, fd_dst, size, bs);
+  }
+  off_t pos = 0;
+  while (pos < size) {
+    off_t count = ((size - pos) < (off_t)bs) ? (size - pos) : (off_t)bs;
+    FTI_Throttle(count);
+    if (FTI_CopyFileRange(fd_src, fd_dst, pos, count, bs) != FTI_SCES) {
+      return FTI_NSCS;
+    }
+    pos += count;
+  }
+  return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It copies a byte range of one file into another.
+  @param      fd_src          File descriptor of the source file.
+  @param      fd_dst          File descriptor of the destination file.
+  @param      offset          Offset of the range in both files.
+  @param      count           Number of bytes to copy.
+  @param      bs              Buffer size for the user space fallback.
+  @return     integer         FTI_SCES if successful.
+
+  Same as FTI_CopyFile, but only the bytes [offset, offset+count) are
+  copied. This allows to move large files in chunks.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_CopyFileRange(int fd_src, int fd_dst, off_t offset, off_t count, size_t bs)
+{
+  char str[FTI_BUFS];
+  off_t pos = offset;
+  off_t size = offset + count;
+
+#ifdef __linux__
+#ifdef SYS_copy_file_range
+  while (pos < size) {
+    int64_t off_in = pos, off_out = pos;
+    ssize_t bytes = syscall(SYS_copy_file_range, fd_src, &off_in, fd_dst, &off_out,
+        (size_t)(size - pos), 0);
+    if (bytes <= 0) {
+      if (bytes == -1 && !FTI_CopyFallbackErr(errno)) {
+        FTI_Print("Could not copy file with copy_file_range.", FTI_EROR);
+        return FTI_NSCS;
+      }
+      break;
+    }
+    pos += bytes;
+  }
+  errno = 0;
+#endif
+  if (pos < size && lseek(fd_dst, pos, SEEK_SET) != -1) {
+    while (pos < size) {
+      off_t off_in = pos;
+      ssize_t bytes = sendfile(fd_dst, fd_src, &off_in, (size_t)(size - pos));
+      if (bytes <= 0) {
+        if (bytes == -1 && !FTI_CopyFallbackErr(errno)) {
+          FTI_Print("Could not copy file with sendfile.", FTI_EROR);
+          return FTI_NSCS;
+        }
+        break;
+      }
+      pos += bytes;
+    }
+    errno = 0;
+  }
+  if (pos == size) {
+    return FTI_SCES;
+  }
+  snprintf(str, FTI_BUFS, "In-kernel copy not available, copying remaining %ld bytes through user space.",
+      (long)(size - pos));
+  FTI_Print(str, FTI_DBUG);
+#endif
+
+  char* buf = talloc(char, bs);
+  if (buf == NULL) {
+    FTI_Print("Failed to allocate copy buffer.", FTI_EROR);
+    return FTI_NSCS;
+  }
+  while (pos < size) {
+    size_t bytes = ((size - pos) < bs) ? (size_t)(size - pos) : bs;
+    ssize_t rbytes = pread(fd_src, buf, bytes, pos);
+    if (rbytes <= 0) {
+      if (rbytes == 0) {
+        snprintf(str, FTI_BUFS, "Unexpected end of file after %ld of %ld bytes.", (long)pos, (long)size);
+        FTI_Print(str, FTI_WARN);
+      } else {
+        FTI_Print("Could not read from source file.", FTI_EROR);
+      }
+      free(buf);
+      return FTI_NSCS;
+    }
+    ssize_t wbytes = 0;
+    while (wbytes < rbytes) {
+      ssize_t ret = pwrite(fd_dst, buf + wbytes, rbytes - wbytes, pos + wbytes);
+      if (ret == -1) {
+        FTI_Print("Could not write to destination file.", FTI_EROR);
+        free(buf);
+        return FTI_NSCS;
+      }
+      wbytes += ret;
+    }
+    pos += rbytes;
+  }
+  free(buf);
+  return FTI_SCES;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief      It erases the previous checkpoints and their metadata.
@@ -113,31 +113,41 @@ int FTI_SaveTopo(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo, char* na
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief      It reorders the nodes following the previous topology.
+  @brief      It hashes a node name.
+  @param      name            The node name.
+  @return     uint64_t        FNV-1a hash of the name.
+
+ **/
+/*-------------------------------------------------------------------------*/
+static uint64_t FTI_HashNodeName(char* name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    int i;
+    for (i = 0; i < FTI_BUFS && name[i] != '\0'; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It computes the old order of the nodes from the topology file.
   @param      FTI_Conf        Configuration metadata.
   @param      FTI_Topo        Topology metadata.
-  @param      nodeList        The list of the nodes.
   @param      nameList        The list of the node names.
+  @param      old             Old ID of each current node (-1 if new).
+  @param      new             Current node of each old ID (-1 if missing).
   @return     integer         FTI_SCES if successful.
 
-  This function writes the topology of the system (List of nodes and their
-  ID) in a topology file that will be read during recovery to detect which
-  nodes (and therefore checkpoit files) are missing in the new topology.
+  The current node names are indexed in a hash table, so each node of
+  the topology file is matched in constant time.
 
  **/
 /*-------------------------------------------------------------------------*/
-int FTI_ReorderNodes(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo,
-        int* nodeList, char* nameList)
+static int FTI_MatchNodes(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo,
+        char* nameList, int* old, int* new)
 {
-    int* nl = talloc(int, FTI_Topo->nbProc);
-    int* old = talloc(int, FTI_Topo->nbNodes);
-    int* new = talloc(int, FTI_Topo->nbNodes);
-    int i;
-    for (i = 0; i < FTI_Topo->nbNodes; i++) {
-        old[i] = -1;
-        new[i] = -1;
-    }
-
     char mfn[FTI_BUFS], str[FTI_BUFS];
     snprintf(mfn, FTI_BUFS, "%s/Topology.fti", FTI_Conf->metadDir);
     snprintf(str, FTI_BUFS, "Loading FTI topology file (%s) to reorder nodes...", mfn);
@@ -146,11 +156,6 @@ int FTI_ReorderNodes(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo,
     // Checking that the topology file exist
     if (access(mfn, F_OK) != 0) {
         FTI_Print("The topology file is NOT accessible.", FTI_WARN);
-
-        free(nl);
-        free(old);
-        free(new);
-
         return FTI_NSCS;
     }
 
@@ -158,14 +163,24 @@ int FTI_ReorderNodes(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo,
     ini = iniparser_load(mfn);
     if (ini == NULL) {
         FTI_Print("Iniparser could NOT parse the topology file.", FTI_WARN);
-
-        free(nl);
-        free(old);
-        free(new);
-
         return FTI_NSCS;
     }
 
+    // Index the current node names (table of node index + 1, 0 is empty)
+    int size = 16;
+    while (size < 2 * FTI_Topo->nbNodes) {
+        size *= 2;
+    }
+    int* table = calloc(size, sizeof(int));
+    int i;
+    for (i = 0; i < FTI_Topo->nbNodes; i++) {
+        int pos = FTI_HashNodeName(nameList + (i * FTI_BUFS)) & (size - 1);
+        while (table[pos] != 0) {
+            pos = (pos + 1) & (size - 1);
+        }
+        table[pos] = i + 1;
+    }
+
     // Get the old order of nodes
     for (i = 0; i < FTI_Topo->nbNodes; i++) {
         snprintf(str, FTI_BUFS, "Topology:%d", i);
@@ -173,40 +188,90 @@ int FTI_ReorderNodes(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo,
         snprintf(str, FTI_BUFS, "%s", tmp);
 
         // Search for same node in current nameList
-        int j;
-        for (j = 0; j < FTI_Topo->nbNodes; j++) {
+        int pos = FTI_HashNodeName(str) & (size - 1);
+        while (table[pos] != 0) {
+            int j = table[pos] - 1;
             // If found...
             if (strncmp(str, nameList + (j * FTI_BUFS), FTI_BUFS) == 0) {
                 old[j] = i;
                 new[i] = j;
                 break;
             } // ...set matching IDs and break out of the searching loop
+            pos = (pos + 1) & (size - 1);
         }
     }
 
+    free(table);
     iniparser_freedict(ini);
 
-    int j = 0;
-    // Introducing missing nodes
+    return FTI_SCES;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief      It reorders the nodes following the previous topology.
+  @param      FTI_Conf        Configuration metadata.
+  @param      FTI_Exec        Execution metadata.
+  @param      FTI_Topo        Topology metadata.
+  @param      nodeList        The list of the nodes.
+  @param      nameList        The list of the node names (only in rank 0).
+  @return     integer         FTI_SCES if successful.
+
+  The rank 0 reads the topology file written by the previous execution
+  and matches the node names, then the new order is broadcast so every
+  process gets the node ID it had before. Missing nodes are replaced by
+  the nodes that were not in the previous topology.
+
+ **/
+/*-------------------------------------------------------------------------*/
+int FTI_ReorderNodes(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
+        FTIT_topology* FTI_Topo, int* nodeList, char* nameList)
+{
+    int* nl = talloc(int, FTI_Topo->nbProc);
+    int* old = talloc(int, FTI_Topo->nbNodes);
+    int* new = talloc(int, FTI_Topo->nbNodes);
+    int i;
     for (i = 0; i < FTI_Topo->nbNodes; i++) {
-        // For each new node..
-        if (new[i] == -1) {
-            // ..search for an old node not present in the new list..
-            while (old[j] != -1) {
+        old[i] = -1;
+        new[i] = -1;
+    }
+
+    int res = FTI_SCES;
+    if (FTI_Topo->myRank == 0) {
+        res = FTI_MatchNodes(FTI_Conf, FTI_Topo, nameList, old, new);
+        int j = 0;
+        // Introducing missing nodes
+        for (i = 0; i < FTI_Topo->nbNodes && res == FTI_SCES; i++) {
+            // For each new node..
+            if (new[i] == -1) {
+                // ..search for an old node not present in the new list..
+                while (old[j] != -1) {
+                    j++;
+                }
+                // .. and set matching IDs
+                old[j] = i;
+                new[i] = j;
                 j++;
             }
-            // .. and set matching IDs
-            old[j] = i;
-            new[i] = j;
-            j++;
         }
     }
+    MPI_Bcast(&res, 1, MPI_INT, 0, FTI_Exec->globalComm);
+    if (res != FTI_SCES) {
+        free(nl);
+        free(old);
+        free(new);
+
+        return FTI_NSCS;
+    }
+    MPI_Bcast(new, FTI_Topo->nbNodes, MPI_INT, 0, FTI_Exec->globalComm);
+
     // Copying nodeList in nl
     for (i = 0; i < FTI_Topo->nbProc; i++) {
         nl[i] = nodeList[i];
     }
     // Creating the new nodeList with the old order
     for (i = 0; i < FTI_Topo->nbNodes; i++) {
+        int j;
         for (j = 0; j < FTI_Topo->nodeSize; j++) {
             nodeList[(i * FTI_Topo->nodeSize) + j] = nl[(new[i] * FTI_Topo->nodeSize) + j];
         }
@@ -227,73 +292,84 @@ int FTI_ReorderNodes(FTIT_configuration* FTI_Conf, FTIT_topology* FTI_Topo,
   @param      FTI_Exec        Execution metadata.
   @param      FTI_Topo        Topology metadata.
   @param      nodeList        The list of the nodes to fill.
-  @param      nameList        The list of the node names to fill.
+  @param      nameList        The list of the node names to fill (rank 0).
   @return     integer         FTI_SCES if successful.
 
   This function makes all the processes to detect in which node are they
   located and distributes the information globally to create an uniform
-  mapping structure between processes and nodes.
+  mapping structure between processes and nodes. The processes of a node
+  are found with a shared memory communicator, and the nodes are numbered
+  by their lowest rank. Only the node IDs are distributed to all
+  processes, the node names are gathered by the rank 0.
 
  **/
 /*-------------------------------------------------------------------------*/
 int FTI_BuildNodeList(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo, int* nodeList, char* nameList)
 {
-    char* lhn = talloc(char, FTI_BUFS* FTI_Topo->nbProc);
-    memset(lhn + (FTI_Topo->myRank * FTI_BUFS), 0, FTI_BUFS); // To get local hostname
-    if (!FTI_Conf->test) {
-        gethostname(lhn + (FTI_Topo->myRank * FTI_BUFS), FTI_BUFS); // NOT local test
+    MPI_Comm nodeComm;
+    if (FTI_Conf->test) {
+        MPI_Comm_split(FTI_Exec->globalComm, FTI_Topo->myRank / FTI_Topo->nodeSize, FTI_Topo->myRank, &nodeComm);
+    } else {
+        MPI_Comm_split_type(FTI_Exec->globalComm, MPI_COMM_TYPE_SHARED, FTI_Topo->myRank, MPI_INFO_NULL, &nodeComm);
     }
-    else {
-        snprintf(lhn + (FTI_Topo->myRank * FTI_BUFS), FTI_BUFS, "node%d", FTI_Topo->myRank / FTI_Topo->nodeSize); // Local
+    int nodeRank;
+    MPI_Comm_rank(nodeComm, &nodeRank);
+    int isLeader = (nodeRank == 0);
+
+    // The node ID is the number of nodes with a lower leading rank
+    int nodeID = 0;
+    MPI_Exscan(&isLeader, &nodeID, 1, MPI_INT, MPI_SUM, FTI_Exec->globalComm);
+    if (FTI_Topo->myRank == 0) {
+        nodeID = 0;
     }
-    char hname[FTI_BUFS];
-    strncpy(hname, lhn + (FTI_Topo->myRank * FTI_BUFS), FTI_BUFS - 1); // Distributing host names
-    MPI_Allgather(hname, FTI_BUFS, MPI_CHAR, lhn, FTI_BUFS, MPI_CHAR, FTI_Exec->globalComm);
+    MPI_Bcast(&nodeID, 1, MPI_INT, 0, nodeComm);
+    MPI_Comm_free(&nodeComm);
+
+    int* nodeIDs = talloc(int, FTI_Topo->nbProc);
+    MPI_Allgather(&nodeID, 1, MPI_INT, nodeIDs, 1, MPI_INT, FTI_Exec->globalComm);
 
-    int nbNodes = 0;
+    int* nbInNode = calloc(FTI_Topo->nbNodes, sizeof(int));
     int i;
     for (i = 0; i < FTI_Topo->nbProc; i++) { // Creating the node list: For each process
-        int found = 0;
-        int pos = 0;
-        strncpy(hname, lhn + (i * FTI_BUFS), FTI_BUFS - 1); // Get node name of process i
-        while ((pos < nbNodes) && (found == 0)) { // Search the node name in the current list of node names
-            if (strncmp(&(nameList[pos * FTI_BUFS]), hname, FTI_BUFS) == 0) { // If we find it break out
-                found = 1;
-            }
-            else { // Else move to the next name in the list
-                pos++;
-            }
-        }
-        if (found) { // If we found the node name in the current list...
-            int p = pos * FTI_Topo->nodeSize;
-            while (p < pos * FTI_Topo->nodeSize + FTI_Topo->nodeSize) { // ... we look for empty spot in this node
-                if (nodeList[p] == -1) {
-                    nodeList[p] = i;
-                    break;
-                }
-                else {
-                    p++;
-                }
-            }
-        }
-        else { // ... else, we add the new node to the end of the current list of nodes
-            strncpy(&(nameList[pos * FTI_BUFS]), hname, FTI_BUFS - 1);
-            nodeList[pos * FTI_Topo->nodeSize] = i;
-            nbNodes++;
+        int node = nodeIDs[i];
+        if (node >= FTI_Topo->nbNodes || nbInNode[node] == FTI_Topo->nodeSize) {
+            char str[FTI_BUFS];
+            snprintf(str, FTI_BUFS, "Node %d has more than %d processes", node, FTI_Topo->nodeSize);
+            FTI_Print(str, FTI_WARN);
+            free(nodeIDs);
+            free(nbInNode);
+            return FTI_NSCS;
         }
+        nodeList[node * FTI_Topo->nodeSize + nbInNode[node]] = i;
+        nbInNode[node]++;
     }
+    free(nodeIDs);
+    free(nbInNode);
     for (i = 0; i < FTI_Topo->nbProc; i++) { // Checking that all nodes have nodeSize processes
         if (nodeList[i] == -1) {
             char str[FTI_BUFS];
             snprintf(str, FTI_BUFS, "Node %d has no %d processes", i / FTI_Topo->nodeSize, FTI_Topo->nodeSize);
             FTI_Print(str, FTI_WARN);
-            free(lhn);
             return FTI_NSCS;
         }
     }
 
-    free(lhn);
+    // Gather the node names in rank 0, which leads the node 0
+    MPI_Comm leaderComm;
+    MPI_Comm_split(FTI_Exec->globalComm, (isLeader) ? 0 : MPI_UNDEFINED, FTI_Topo->myRank, &leaderComm);
+    if (isLeader) {
+        char hname[FTI_BUFS];
+        memset(hname, 0, FTI_BUFS); // To get local hostname
+        if (!FTI_Conf->test) {
+            gethostname(hname, FTI_BUFS - 1); // NOT local test
+        }
+        else {
+            snprintf(hname, FTI_BUFS, "node%d", FTI_Topo->myRank / FTI_Topo->nodeSize); // Local
+        }
+        MPI_Gather(hname, FTI_BUFS, MPI_CHAR, nameList, FTI_BUFS, MPI_CHAR, 0, leaderComm);
+        MPI_Comm_free(&leaderComm);
+    }
 
     return FTI_SCES;
 }
@@ -342,6 +418,11 @@ int FTI_CreateComms(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         }
     }
     MPI_Comm_rank(FTI_COMM_WORLD, &FTI_Topo->splitRank);
+    FTI_Exec->postComm = FTI_COMM_WORLD;
+    FTI_Exec->nodeAppComm = MPI_COMM_NULL;
+    if (FTI_Conf->dedup) { // Processes of the node sharing deduplicated chunks.
+        MPI_Comm_split(FTI_COMM_WORLD, FTI_Topo->nodeID, FTI_Topo->myRank, &FTI_Exec->nodeAppComm);
+    }
     int buf = FTI_Topo->sectorID * FTI_Topo->groupSize;
     int group[FTI_BUFS]; // FTI_BUFS > Max. group size
     int i;
@@ -376,7 +457,11 @@ int FTI_CreateComms(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
 int FTI_Topology(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
         FTIT_topology* FTI_Topo)
 {
-    char *nameList = talloc(char, FTI_Topo->nbNodes *FTI_BUFS);
+    // node names are only needed by rank 0 (topology file)
+    char *nameList = NULL;
+    if (FTI_Topo->myRank == 0) {
+        nameList = talloc(char, FTI_Topo->nbNodes *FTI_BUFS);
+    }
 
     int* nodeList = talloc(int, FTI_Topo->nbNodes* FTI_Topo->nodeSize);
     int i;
@@ -393,7 +478,7 @@ int FTI_Topology(FTIT_configuration* FTI_Conf, FTIT_execution* FTI_Exec,
     }
 
     if (FTI_Exec->reco > 0) {
-        res = FTI_Try(FTI_ReorderNodes(FTI_Conf, FTI_Topo, nodeList, nameList), "reorder nodes.");
+        res = FTI_Try(FTI_ReorderNodes(FTI_Conf, FTI_Exec, FTI_Topo, nodeList, nameList), "reorder nodes.");
         if (res == FTI_NSCS) {
             free(nameList);
             free(nodeList);
@@ -24,6 +24,7 @@ desc
 for config in ${configs[@]}; do
 	printRun 4.1.1.1 $config
 	cp ../configs/${config} config.fti
+	echo "meta_ini_export = 1" >> config.fti # node to rank mapping is read from the INI metadata
 	mpirun -n 16 ./ckptHierarchy 4 3 2 1 1 0
 	exec_id=$(grep "exec_id" ./config.fti | awk '{print $(NF)}')
 	for level in 1 2 3; do
@@ -58,6 +59,7 @@ desc
 for config in ${configs[@]}; do
 	printRun 4.1.1.2 $config 
 	cp ../configs/${config} config.fti
+	echo "meta_ini_export = 1" >> config.fti # node to rank mapping is read from the INI metadata
 	mpirun -n 16 ./ckptHierarchy 1 2 3 4 1 0
 	exec_id=$(grep "exec_id" ./config.fti | awk '{print $(NF)}')
 	for level in 1 2 3; do
@@ -95,6 +97,7 @@ for config in ${configs[@]}; do
 	for level in 1 2 3; do
 		printRun 4.1.2 $config $level
 		cp ../configs/${config} config.fti
+		echo "meta_ini_export = 1" >> config.fti # node to rank mapping is read from the INI metadata
 		mpirun -n 16 ./ckptHierarchy $level $level $level $level 0 0
 		exec_id=$(grep "exec_id" ./config.fti | awk '{print $(NF)}')
 		for node in 0 1 2 3; do
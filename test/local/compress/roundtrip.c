@@ -0,0 +1,414 @@
+/**
+ *  @file   roundtrip.c
+ *  @date   January, 2019
+ *  @brief  Round trips of data chunks through the compression stage.
+ *
+ *  Each rank writes data chunks of several patterns and sizes to a file
+ *  with FTI_WriteCompressed, reads them back with FTI_ReadCompressed and
+ *  compares them with the original chunks. The chunks are written with
+ *  every codec of the build and several block sizes, by the worker
+ *  threads that FTI_Init starts for 'compress_threads'. Elements of 2 to
+ *  24 bytes are written with every shuffle and delta setting, the sizes
+ *  of 2, 4, 8 and 16 bytes go through the SIMD kernels where available.
+ *  Floats and doubles with an error bound must be restored within the
+ *  bound, their non-finite values exactly. Streams with an inconsistent
+ *  block table must be rejected.
+ */
+#include <fti.h>
+#include <mpi.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../../../src/interface.h"
+
+#define EXIT_FAIL(MSG) \
+    do { \
+        printf("%s:%d [ERROR] rank %d (%s) -> %s\n", __FILE__, __LINE__, rank, info, MSG); \
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE); \
+    } while(0)
+
+#define F_BUFF 512
+#define OFFSET 13 // streams start at an unaligned file offset
+#define NB_SIZES 8
+#define NB_BLOCK_SIZES 3
+#define NB_ELE_SIZES 7
+#define NB_BOUNDS 4
+
+enum { P_ZERO, P_SMOOTH, P_RANDOM, P_MIXED, P_COUNTER, NB_PATTERNS };
+
+const char* patternNames[NB_PATTERNS] = { "zero", "smooth", "random", "mixed", "counter" };
+const long blockSizes[NB_BLOCK_SIZES] = { 1024, 4096, 65536 };
+const int eleSizes[NB_ELE_SIZES] = { 2, 3, 4, 8, 12, 16, 24 };
+const int boundModes[NB_BOUNDS] = { FTI_BOUND_ABS, FTI_BOUND_ABS, FTI_BOUND_REL, FTI_BOUND_REL };
+const double bounds[NB_BOUNDS] = { 1e-3, 1e-7, 1e-4, 1e-2 };
+
+enum { R_FIELD, R_SPECIAL, R_NOISE, NB_REAL_PATTERNS };
+
+const char* realPatternNames[NB_REAL_PATTERNS] = { "field", "special", "noise" };
+
+int rank;
+int fd;
+int nbTrips = 0;
+char info[F_BUFF];
+FTIT_configuration conf;
+
+// fills a chunk with a pattern of elements of 'ele' bytes
+void fillChunk( char* raw, long size, int pattern, int ele )
+{
+    long i;
+    uint64_t cnt;
+    switch( pattern ) {
+        case P_ZERO:
+            memset( raw, 0, size );
+            break;
+        case P_SMOOTH:
+            for( i=0; i<size; ++i ) {
+                raw[i] = (char) (64 * sin( i * 0.001 ) + rank);
+            }
+            break;
+        case P_RANDOM:
+            for( i=0; i<size; ++i ) {
+                raw[i] = (char) rand();
+            }
+            break;
+        case P_MIXED:
+            // compressible and incompressible blocks in the same stream
+            for( i=0; i<size; ++i ) {
+                raw[i] = ( (i / 3000) % 2 ) ? (char) rand() : (char) (i / 100);
+            }
+            break;
+        case P_COUNTER:
+            // slowly increasing elements, the delta leaves the low bytes
+            for( i=0; i<size; ++i ) {
+                cnt = 1000 * rank + (i / ele) * 3;
+                raw[i] = ( i % ele < sizeof(uint64_t) ) ? (char) (cnt >> (8 * (i % ele))) : 0;
+            }
+            break;
+    }
+}
+
+// stores a float or a double
+void storeReal( char* ptr, int ele, double val )
+{
+    if( ele == sizeof(float) ) {
+        float f = (float) val;
+        memcpy( ptr, &f, sizeof(float) );
+    } else {
+        memcpy( ptr, &val, sizeof(double) );
+    }
+}
+
+// loads a float or a double
+double loadReal( const char* ptr, int ele )
+{
+    if( ele == sizeof(float) ) {
+        float f;
+        memcpy( &f, ptr, sizeof(float) );
+        return f;
+    }
+    double d;
+    memcpy( &d, ptr, sizeof(double) );
+    return d;
+}
+
+// fills a chunk with floats or doubles, the remainder with bytes
+void fillReal( char* raw, long size, int pattern, int ele )
+{
+    long n = size / ele;
+    long i;
+    for( i=0; i<n; ++i ) {
+        double x = 100 * sin( i * 0.01 ) + rank;
+        switch( pattern ) {
+            case R_SPECIAL:
+                // values that cannot be quantized are stored exactly
+                if( i % 37 == 5 ) {
+                    x = NAN;
+                } else if( i % 101 == 7 ) {
+                    x = ( i % 2 ) ? INFINITY : -INFINITY;
+                } else if( i % 211 == 11 ) {
+                    x = 1e30;
+                }
+                break;
+            case R_NOISE:
+                // mostly stored exactly, thus the raw block is kept
+                x = ( (double) rand() / RAND_MAX - 0.5 ) * 1e6;
+                break;
+        }
+        storeReal( raw + i * ele, ele, x );
+    }
+    for( i=n*ele; i<size; ++i ) {
+        raw[i] = (char) rand();
+    }
+}
+
+// returns the absolute error bound of a chunk
+double errorBound( const char* raw, long size, int ele, int mode, double bound )
+{
+    if( mode != FTI_BOUND_REL ) {
+        return bound;
+    }
+    long n = size / ele;
+    double min = 0, max = 0;
+    int first = 1;
+    long i;
+    for( i=0; i<n; ++i ) {
+        double x = loadReal( raw + i * ele, ele );
+        if( !isfinite( x ) ) {
+            continue;
+        }
+        min = ( first || x < min ) ? x : min;
+        max = ( first || x > max ) ? x : max;
+        first = 0;
+    }
+    return ( bound * (max - min) > 0 ) ? bound * (max - min) : bound;
+}
+
+// checks the restored elements against the error bound
+void checkBound( const char* raw, const char* out, long size, int ele, double eb )
+{
+    long n = size / ele;
+    long i;
+    for( i=0; i<n; ++i ) {
+        double x = loadReal( raw + i * ele, ele );
+        double y = loadReal( out + i * ele, ele );
+        if( !isfinite( x ) ) {
+            if( memcmp( raw + i * ele, out + i * ele, ele ) != 0 ) {
+                EXIT_FAIL( "non-finite element not restored exactly." );
+            }
+        } else if( !( fabs( y - x ) <= eb ) ) {
+            printf( "element %ld: %.17g restored as %.17g (bound %g)\n", i, x, y, eb );
+            EXIT_FAIL( "element restored beyond the error bound." );
+        }
+    }
+    if( memcmp( raw + n * ele, out + n * ele, size - n * ele ) != 0 ) {
+        EXIT_FAIL( "remainder of the data chunk differs." );
+    }
+}
+
+// writes a chunk, reads it back and checks the digests
+long roundTrip( int codec, FTIT_dataset* data, char* raw, long size, char* out )
+{
+    MD5_CTX mdContext;
+    unsigned char hash[MD5_DIGEST_LENGTH];
+    unsigned char check[MD5_DIGEST_LENGTH];
+
+    if( ftruncate( fd, 0 ) != 0 ) {
+        EXIT_FAIL( "unable to truncate the stream file." );
+    }
+    MD5_Init( &mdContext );
+    long csize = FTI_WriteCompressed( &conf, codec, data, raw, size, fd, OFFSET, &mdContext, hash );
+    if( csize < 0 ) {
+        EXIT_FAIL( "FTI_WriteCompressed failed." );
+    }
+    memset( out, 0xA5, size );
+    if( FTI_ReadCompressed( codec, fd, OFFSET, csize, out, size ) != FTI_SCES ) {
+        EXIT_FAIL( "FTI_ReadCompressed failed." );
+    }
+
+    // the digest is the one of the data as restored
+    MD5( (unsigned char*) out, size, check );
+    if( memcmp( hash, check, MD5_DIGEST_LENGTH ) != 0 ) {
+        EXIT_FAIL( "digest of the data chunk differs." );
+    }
+
+    // the context is updated with the stream as written
+    char* stream = (char*) malloc( csize + 1 );
+    if( pread( fd, stream, csize, OFFSET ) != csize ) {
+        EXIT_FAIL( "unable to read the stream." );
+    }
+    MD5_Final( hash, &mdContext );
+    MD5( (unsigned char*) stream, csize, check );
+    if( memcmp( hash, check, MD5_DIGEST_LENGTH ) != 0 ) {
+        EXIT_FAIL( "digest of the stream differs." );
+    }
+    free( stream );
+
+    ++nbTrips;
+    return csize;
+}
+
+// a stream with an inconsistent block table must be rejected
+void checkCorrupt( int codec, FTIT_dataset* data, char* raw, long size, char* out )
+{
+    long csize = roundTrip( codec, data, raw, size, out );
+    long nbBlocks = (size + conf.compressBlockSize - 1) / conf.compressBlockSize;
+    long table = OFFSET + csize - (nbBlocks + 3) * sizeof(uint32_t);
+
+    if( FTI_ReadCompressed( codec, fd, OFFSET, csize - 1, out, size ) == FTI_SCES ) {
+        EXIT_FAIL( "truncated stream accepted." );
+    }
+    if( FTI_ReadCompressed( codec, fd, OFFSET, csize, out, size + conf.compressBlockSize ) == FTI_SCES ) {
+        EXIT_FAIL( "stream accepted for a larger data chunk." );
+    }
+    uint32_t bsize = 0x7FFFFFFF;
+    if( pwrite( fd, &bsize, sizeof(uint32_t), table ) != sizeof(uint32_t) ) {
+        EXIT_FAIL( "unable to corrupt the block table." );
+    }
+    if( FTI_ReadCompressed( codec, fd, OFFSET, csize, out, size ) == FTI_SCES ) {
+        EXIT_FAIL( "block larger than the block size accepted." );
+    }
+}
+
+int main() {
+
+    MPI_Init( NULL, NULL );
+    if( FTI_Init( "config.fti", MPI_COMM_WORLD ) != FTI_SCES ) {
+        printf( "FTI_Init failed.\n" );
+        MPI_Abort( MPI_COMM_WORLD, EXIT_FAILURE );
+    }
+    MPI_Comm_rank( FTI_COMM_WORLD, &rank );
+    srand( rank + 1 );
+    info[0] = '\0';
+
+    char fn[F_BUFF];
+    snprintf( fn, F_BUFF, "roundtrip-%04d.tmp", rank );
+    fd = open( fn, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+    if( fd == -1 ) {
+        EXIT_FAIL( "unable to create the stream file." );
+    }
+
+    long maxSize = 37 * blockSizes[NB_BLOCK_SIZES-1] + 5;
+    char* raw = (char*) malloc( maxSize );
+    char* out = (char*) malloc( maxSize );
+
+    FTIT_dataset data;
+    memset( &data, 0, sizeof(FTIT_dataset) );
+    data.eleSize = 1;
+    memset( &conf, 0, sizeof(FTIT_configuration) );
+    conf.compressLevel = 1;
+    conf.compressShuffle = FTI_SHUFFLE_NONE;
+
+    int codec, b, s, p;
+    for( codec=FTI_CODEC_NONE; codec<=FTI_CODEC_LZ4; ++codec ) {
+        if( !FTI_CodecAvailable( codec ) ) {
+            continue;
+        }
+        for( b=0; b<NB_BLOCK_SIZES; ++b ) {
+            long bs = blockSizes[b];
+            // single and partial blocks, several windows of blocks
+            long sizes[NB_SIZES] = { 0, 1, 1000, bs-1, bs, bs+1, 5*bs+3, 37*bs+5 };
+            conf.compressBlockSize = bs;
+            for( p=0; p<NB_PATTERNS; ++p ) {
+                for( s=0; s<NB_SIZES; ++s ) {
+                    snprintf( info, F_BUFF, "codec %d, block %ld, %s, size %ld", codec, bs, patternNames[p], sizes[s] );
+                    fillChunk( raw, sizes[s], p, 1 );
+                    roundTrip( codec, &data, raw, sizes[s], out );
+                    if( memcmp( raw, out, sizes[s] ) != 0 ) {
+                        EXIT_FAIL( "data chunk differs." );
+                    }
+                }
+            }
+            snprintf( info, F_BUFF, "codec %d, block %ld, corrupt", codec, bs );
+            fillChunk( raw, 5*bs+3, P_MIXED, 1 );
+            checkCorrupt( codec, &data, raw, 5*bs+3, out );
+        }
+    }
+
+    // elements transformed before the compression (not without codec)
+    int e, shuffle, delta;
+    for( codec=FTI_CODEC_ZLIB; codec<=FTI_CODEC_LZ4; ++codec ) {
+        if( !FTI_CodecAvailable( codec ) ) {
+            continue;
+        }
+        // the small block sizes already span several windows of blocks
+        for( b=0; b<2; ++b ) {
+            long bs = blockSizes[b];
+            conf.compressBlockSize = bs;
+            for( e=0; e<NB_ELE_SIZES; ++e ) {
+                int ele = eleSizes[e];
+                // partial elements and blocks, several windows of blocks
+                long sizes[NB_SIZES] = { 0, 1, ele, 33*ele+1, bs-1, bs+ele, 5*bs+3, 37*bs+5 };
+                data.eleSize = ele;
+                for( shuffle=FTI_SHUFFLE_NONE; shuffle<=FTI_SHUFFLE_BIT; ++shuffle ) {
+                    for( delta=0; delta<2; ++delta ) {
+                        conf.compressShuffle = shuffle;
+                        conf.compressDelta = delta;
+                        for( p=P_SMOOTH; p<NB_PATTERNS; ++p ) {
+                            for( s=0; s<NB_SIZES; ++s ) {
+                                snprintf( info, F_BUFF, "codec %d, block %ld, element %d, shuffle %d, delta %d, %s, size %ld",
+                                        codec, bs, ele, shuffle, delta, patternNames[p], sizes[s] );
+                                fillChunk( raw, sizes[s], p, ele );
+                                roundTrip( codec, &data, raw, sizes[s], out );
+                                if( memcmp( raw, out, sizes[s] ) != 0 ) {
+                                    EXIT_FAIL( "data chunk differs." );
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // floats and doubles with an error bound (exact without codec)
+    int m;
+    conf.compressShuffle = FTI_SHUFFLE_BYTE;
+    conf.compressDelta = 0;
+    for( codec=FTI_CODEC_ZLIB; codec<=FTI_CODEC_LZ4; ++codec ) {
+        if( !FTI_CodecAvailable( codec ) ) {
+            continue;
+        }
+        for( b=0; b<2; ++b ) {
+            long bs = blockSizes[b];
+            conf.compressBlockSize = bs;
+            for( e=0; e<NB_ELE_SIZES; ++e ) {
+                int ele = eleSizes[e];
+                if( ele != sizeof(float) && ele != sizeof(double) ) {
+                    continue;
+                }
+                long sizes[NB_SIZES] = { 0, 3, ele, 33*ele+3, bs-1, bs+ele, 5*bs+3, 37*bs+5 };
+                data.eleSize = ele;
+                for( m=0; m<NB_BOUNDS; ++m ) {
+                    data.boundMode = boundModes[m];
+                    data.bound = bounds[m];
+                    for( p=0; p<NB_REAL_PATTERNS; ++p ) {
+                        for( s=0; s<NB_SIZES; ++s ) {
+                            snprintf( info, F_BUFF, "codec %d, block %ld, element %d, bound mode %d, bound %g, %s, size %ld",
+                                    codec, bs, ele, boundModes[m], bounds[m], realPatternNames[p], sizes[s] );
+                            fillReal( raw, sizes[s], p, ele );
+                            roundTrip( codec, &data, raw, sizes[s], out );
+                            checkBound( raw, out, sizes[s], ele,
+                                    errorBound( raw, sizes[s], ele, boundModes[m], bounds[m] ) );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // the bound is ignored without codec and for other element sizes
+    data.boundMode = FTI_BOUND_ABS;
+    data.bound = 1e-3;
+    conf.compressBlockSize = blockSizes[0];
+    fillReal( raw, 5*blockSizes[0]+3, R_FIELD, sizeof(double) );
+    for( e=0; e<NB_ELE_SIZES; ++e ) {
+        int ele = eleSizes[e];
+        codec = ( ele == sizeof(float) || ele == sizeof(double) ) ? FTI_CODEC_NONE : FTI_CODEC_ZLIB;
+        if( !FTI_CodecAvailable( codec ) ) {
+            continue;
+        }
+        data.eleSize = ele;
+        snprintf( info, F_BUFF, "codec %d, element %d, bound ignored", codec, ele );
+        roundTrip( codec, &data, raw, 5*blockSizes[0]+3, out );
+        if( memcmp( raw, out, 5*blockSizes[0]+3 ) != 0 ) {
+            EXIT_FAIL( "data chunk differs." );
+        }
+    }
+
+    close( fd );
+    unlink( fn );
+    free( raw );
+    free( out );
+
+    MPI_Barrier( FTI_COMM_WORLD );
+    if( rank == 0 ) {
+        printf( "[%d round trips passed per rank]\n", nbTrips );
+    }
+    FTI_Finalize();
+    MPI_Finalize();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+/**
+ *  @file   test.c
+ *  @date   January, 2019
+ *  @brief  Checkpoint and restart of the protected data.
+ *
+ *  Usage: ./test RUN LEVEL [NBVAR [RECOVERVAR [GROW [STEPS]]]]
+ *
+ *  RUN 0 fills NBVAR variables (4 by default), checkpoints them at LEVEL
+ *  and stops without FTI_Finalize as after a failure, or with it if the
+ *  last checkpoint is kept. RUN 1 must restart from this checkpoint (one
+ *  variable after the other with FTI_RecoverVar if RECOVERVAR is 1),
+ *  checks the data and checkpoints again. RUN 2 follows a corruption of
+ *  the checkpoint files: either FTI_Init finds no checkpoint to recover
+ *  or the recovery fails.
+ *
+ *  The even variables are identical on all ranks, the odd ones differ.
+ *  Variable 1 has GROW more elements on each rank (0 by default), thus
+ *  the ranks write checkpoints of different sizes. With STEPS (0 by
+ *  default), RUN 0 takes STEPS checkpoints before the last one, with
+ *  variable 1 protected N_SMALL elements shorter at each step: it grows
+ *  over the checkpoints, as FTI-FF stores it in several containers.
+ */
+#include <fti.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../../deps/iniparser/iniparser.h"
+#include "../../../deps/iniparser/dictionary.h"
+
+#define EXIT_FAIL(MSG) \
+    do { \
+        printf("%s:%d [ERROR] rank %d -> %s\n", __FILE__, __LINE__, rank, MSG); \
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE); \
+    } while(0)
+
+#define N 32768 // elements of the large variables (256KB)
+#define N_SMALL 64 // elements of the variables beyond the first four
+
+int rank;
+
+// value of element i of variable v
+double value( int v, long i )
+{
+    return v * 1000.0 + i * 0.5 + ( (v % 2) ? rank * 1e6 : 0 );
+}
+
+int main( int argc, char** argv ) {
+
+    if( argc < 3 ) {
+        printf( "usage: %s RUN LEVEL [NBVAR [RECOVERVAR [GROW [STEPS]]]]\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    int run = atoi( argv[1] );
+    int level = atoi( argv[2] );
+    int nbVar = ( argc > 3 ) ? atoi( argv[3] ) : 4;
+    int recoverVar = ( argc > 4 ) ? atoi( argv[4] ) : 0;
+    long grow = ( argc > 5 ) ? atol( argv[5] ) : 0;
+    int steps = ( argc > 6 ) ? atoi( argv[6] ) : 0;
+
+    // the post-processing thread needs MPI_THREAD_MULTIPLE
+    dictionary *ini = iniparser_load( "config.fti" );
+    int async = (int)iniparser_getboolean( ini, "Basic:async_postckpt", 0 );
+    iniparser_freedict( ini );
+    int provided;
+    MPI_Init_thread( NULL, NULL, async ? MPI_THREAD_MULTIPLE : MPI_THREAD_SINGLE, &provided );
+    FTI_Init( "config.fti", MPI_COMM_WORLD );
+
+    int grank;
+    MPI_Comm_rank( FTI_COMM_WORLD, &rank );
+    MPI_Comm_rank( MPI_COMM_WORLD, &grank );
+
+    ini = iniparser_load( "config.fti" );
+    int nbHeads = (int)iniparser_getint( ini, "Basic:head", -1 );
+    int keep = (int)iniparser_getint( ini, "Basic:keep_last_ckpt", 0 );
+    int finalTag = (int)iniparser_getint( ini, "Advanced:final_tag", 3107 );
+    int nodeSize = (int)iniparser_getint( ini, "Basic:node_size", -1 );
+    int headRank = grank - grank%nodeSize;
+    iniparser_freedict( ini );
+
+    if ( (nbHeads<0) || (nodeSize<0) ) {
+        EXIT_FAIL( "wrong configuration (for head or node-size settings)!" );
+    }
+
+    double** data = (double**) malloc( nbVar * sizeof(double*) );
+    long* count = (long*) malloc( nbVar * sizeof(long) );
+    int v, s;
+    long i;
+    for( v=0; v<nbVar; ++v ) {
+        count[v] = ( v < 4 ) ? N : N_SMALL;
+        if( v == 1 ) {
+            count[v] += rank * grow;
+        }
+        data[v] = (double*) calloc( count[v], sizeof(double) );
+        FTI_Protect( v, data[v], count[v], FTI_DBLE );
+    }
+
+    if( run == 0 ) {
+        if( FTI_Status() != 0 ) {
+            EXIT_FAIL( "unexpected restart." );
+        }
+        for( v=0; v<nbVar; ++v ) {
+            for( i=0; i<count[v]; ++i ) {
+                data[v][i] = value( v, i );
+            }
+        }
+        for( s=steps; s>=0; --s ) {
+            if( nbVar > 1 ) {
+                FTI_Protect( 1, data[1], count[1] - s * N_SMALL, FTI_DBLE );
+            }
+            if( FTI_Checkpoint( steps - s + 1, level ) != FTI_DONE ) {
+                EXIT_FAIL( "checkpoint failed." );
+            }
+        }
+        if( keep ) {
+            FTI_Finalize();
+        } else if( nbHeads > 0 ) {
+            int endw = FTI_ENDW;
+            MPI_Send( &endw, 1, MPI_INT, headRank, finalTag, MPI_COMM_WORLD );
+            MPI_Barrier( MPI_COMM_WORLD );
+        }
+        MPI_Finalize();
+        return EXIT_SUCCESS;
+    }
+
+    // corrupted files must either not be recovered or fail the recovery
+    int res = FTI_NREC;
+    if( FTI_Status() == 0 && run != 2 ) {
+        EXIT_FAIL( "no checkpoint to restart from." );
+    }
+    if( FTI_Status() != 0 && recoverVar ) {
+        res = FTI_SCES;
+        for( v=0; v<nbVar && res==FTI_SCES; ++v ) {
+            res = FTI_RecoverVar( v );
+        }
+    } else if( FTI_Status() != 0 ) {
+        res = FTI_Recover();
+    }
+    if( run == 2 ) {
+        // only the files of some ranks are corrupted
+        int failed = ( res != FTI_SCES ), anyFailed;
+        MPI_Allreduce( &failed, &anyFailed, 1, MPI_INT, MPI_MAX, FTI_COMM_WORLD );
+        if( !anyFailed ) {
+            EXIT_FAIL( "recovery from corrupted files succeeded." );
+        }
+        FTI_Finalize();
+        MPI_Finalize();
+        return EXIT_SUCCESS;
+    }
+    if( res != FTI_SCES ) {
+        EXIT_FAIL( "recovery failed." );
+    }
+    for( v=0; v<nbVar; ++v ) {
+        for( i=0; i<count[v]; ++i ) {
+            if( data[v][i] != value( v, i ) ) {
+                printf( "variable %d, element %ld: %g instead of %g\n", v, i, data[v][i], value( v, i ) );
+                EXIT_FAIL( "wrong data recovered." );
+            }
+        }
+    }
+
+    // the next checkpoint after the restart
+    if( FTI_Checkpoint( steps + 2, level ) != FTI_DONE ) {
+        EXIT_FAIL( "checkpoint after the restart failed." );
+    }
+    FTI_Finalize();
+
+    if( rank == 0 ) {
+        printf( "[%d variables recovered from L%d]\n", nbVar, level );
+    }
+    for( v=0; v<nbVar; ++v ) {
+        free( data[v] );
+    }
+    free( data );
+    free( count );
+    MPI_Finalize();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/**
+ *  @file   snapshot.c
+ *  @date   January, 2019
+ *  @brief  Checkpoints of FTI_Snapshot with autotuned intervals.
+ *
+ *  Usage: ./snapshot LEVEL
+ *
+ *  The configuration sets an interval of 5 minutes for LEVEL and an MTBF
+ *  of 1 minute with 'ckpt_autotune'. Two checkpoints are first taken at
+ *  LEVEL with FTI_Checkpoint (the second one waits for the post-processing
+ *  of the first one). They cost a fraction of a second, thus the interval
+ *  is autotuned to 1 minute. The iterations then last from 0.15 to 0.3
+ *  seconds depending on the rank: FTI_Snapshot must take a checkpoint
+ *  after about one minute, at the same iteration on all ranks, although
+ *  the mean iteration time is synchronized without blocking.
+ *
+ *  With LEVEL 0 there is no checkpoint before the iterations, the
+ *  configuration sets an interval of 1 minute for some level.
+ */
+#include <fti.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define EXIT_FAIL(MSG) \
+    do { \
+        printf("%s:%d [ERROR] rank %d -> %s\n", __FILE__, __LINE__, rank, MSG); \
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE); \
+    } while(0)
+
+#define N 1024
+#define ITERS 320
+#define MAX_CKPT 8 // checkpoints recorded
+#define FIRST_ID 1001 // IDs of FTI_Checkpoint, FTI_Snapshot counts from 1
+
+int rank;
+
+int main( int argc, char** argv ) {
+
+    if( argc < 2 ) {
+        printf( "usage: %s LEVEL\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+    int level = atoi( argv[1] );
+
+    MPI_Init( NULL, NULL );
+    FTI_Init( "config.fti", MPI_COMM_WORLD );
+    MPI_Comm_rank( FTI_COMM_WORLD, &rank );
+
+    if( FTI_Status() != 0 ) {
+        EXIT_FAIL( "unexpected restart." );
+    }
+
+    double* data = (double*) calloc( N, sizeof(double) );
+    FTI_Protect( 0, data, N, FTI_DBLE );
+
+    int i, j;
+    for( i=0; i<2 && level>0; ++i ) {
+        if( FTI_Checkpoint( FIRST_ID + i, level ) != FTI_DONE ) {
+            EXIT_FAIL( "checkpoint failed." );
+        }
+    }
+
+    // iterations at which FTI_Snapshot took a checkpoint
+    int ckptIter[MAX_CKPT], nbCkpt = 0;
+    for( j=0; j<MAX_CKPT; ++j ) {
+        ckptIter[j] = -1;
+    }
+    for( i=0; i<ITERS; ++i ) {
+        int res = FTI_Snapshot();
+        if( res == FTI_DONE ) {
+            if( nbCkpt < MAX_CKPT ) {
+                ckptIter[nbCkpt] = i;
+            }
+            nbCkpt++;
+        } else if( res != FTI_SCES ) {
+            EXIT_FAIL( "snapshot failed." );
+        }
+        usleep( 150000 + ( rank % 4 ) * 50000 );
+        for( j=0; j<N; ++j ) {
+            data[j] += 1.0;
+        }
+    }
+
+    int minIter[MAX_CKPT], maxIter[MAX_CKPT], minCkpt, maxCkpt;
+    MPI_Allreduce( ckptIter, minIter, MAX_CKPT, MPI_INT, MPI_MIN, FTI_COMM_WORLD );
+    MPI_Allreduce( ckptIter, maxIter, MAX_CKPT, MPI_INT, MPI_MAX, FTI_COMM_WORLD );
+    MPI_Allreduce( &nbCkpt, &minCkpt, 1, MPI_INT, MPI_MIN, FTI_COMM_WORLD );
+    MPI_Allreduce( &nbCkpt, &maxCkpt, 1, MPI_INT, MPI_MAX, FTI_COMM_WORLD );
+    if( minCkpt != maxCkpt ) {
+        EXIT_FAIL( "the ranks took different numbers of checkpoints." );
+    }
+    for( j=0; j<MAX_CKPT; ++j ) {
+        if( minIter[j] != maxIter[j] ) {
+            EXIT_FAIL( "the ranks took a checkpoint at different iterations." );
+        }
+    }
+    if( nbCkpt == 0 ) {
+        EXIT_FAIL( "no checkpoint taken after one minute." );
+    }
+
+    FTI_Finalize();
+
+    if( rank == 0 ) {
+        printf( "[%d checkpoints taken by FTI_Snapshot, first at iteration %d]\n", nbCkpt, ckptIter[0] );
+    }
+    free( data );
+    MPI_Finalize();
+
+    return EXIT_SUCCESS;
+}
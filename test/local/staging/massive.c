@@ -18,6 +18,7 @@
         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE); \
     } while(0)
 
+// usage: ./massive [FILE_SIZE [NUM_ITER [CKPT_LEVEL]]]
 #define FILE_SIZE 1024 // 1KB
 #define NUM_ITER 100L
 #define FILES_PER_ITER 10L
@@ -27,12 +28,22 @@
 #define REMOTE_DIR "./rdir"
 
 void createFile( char *fn );
+bool checkFile( char *fn );
 bool check_status( int request_counter, int *reqID, bool printout );
 
 int rank, size;
 unsigned long num_files;
+long file_size = FILE_SIZE;
 
-int main() {
+int main( int argc, char** argv ) {
+
+    // larger files are staged in several chunks, checkpoints in between
+    // preempt the staging on the heads.
+    if ( argc > 1 ) {
+        file_size = atol( argv[1] );
+    }
+    unsigned long num_iter = ( argc > 2 ) ? atol( argv[2] ) : NUM_ITER;
+    int ckpt_level = ( argc > 3 ) ? atoi( argv[3] ) : 0;
 
     MPI_Init( NULL, NULL );
     FTI_Init( "config.fti", MPI_COMM_WORLD );
@@ -40,10 +51,14 @@ int main() {
     MPI_Comm_size( FTI_COMM_WORLD, &size );
 
     // total number of staged files
-    num_files = ((unsigned long)size)*FILES_PER_ITER*NUM_ITER;
+    num_files = ((unsigned long)size)*FILES_PER_ITER*num_iter;
 
     // request ID array
-    int *reqID = (int*) malloc( FILES_PER_ITER*NUM_ITER * sizeof(int) );
+    int *reqID = (int*) malloc( FILES_PER_ITER*num_iter * sizeof(int) );
+
+    // protected data of the checkpoints
+    int ckpt_data[F_BUFF];
+    FTI_Protect( 0, ckpt_data, F_BUFF, FTI_INTG );
 
     // set stage and remote directory
     char ldir[F_BUFF];
@@ -75,7 +90,7 @@ int main() {
 
     // perform staging
     unsigned long request_counter = 0;
-    for(i=0; i<NUM_ITER; ++i) {
+    for(i=0; i<num_iter; ++i) {
         unsigned long j = 0;
         for(; j<FILES_PER_ITER; ++j) {
             snprintf( filename[j], F_BUFF, F_FORM, rank, i, j );
@@ -91,6 +106,15 @@ int main() {
         }
         if ( i%CLEAN_FREQ == 0 ) {
             check_status( request_counter, reqID, true ); 
+            if ( ckpt_level > 0 ) {
+                int k;
+                for(k=0; k<F_BUFF; ++k) {
+                    ckpt_data[k] = rank + i + k;
+                }
+                if ( FTI_Checkpoint( i/CLEAN_FREQ+1, ckpt_level ) != FTI_DONE ) {
+                    EXIT_FAIL( "Checkpoint failed." );
+                }
+            }
         }
 
     }
@@ -99,12 +123,17 @@ int main() {
     
     FTI_Finalize();
 
-    // remove files
-    for(i=0; i<NUM_ITER; ++i) {
+    // check and remove files
+    for(i=0; i<num_iter; ++i) {
         unsigned long j = 0;
         for(; j<FILES_PER_ITER; ++j) {
             snprintf( filename[j], F_BUFF, F_FORM, rank, i, j );
             snprintf( rfile[j], F_BUFF, "%s/%s", rdir, filename[j] );
+            if ( !checkFile( rfile[j] ) ) {
+                char msg[F_BUFF];
+                snprintf( msg, F_BUFF, "Staged file %s differs from the local file.", filename[j] );
+                EXIT_FAIL( msg );
+            }
             errno = 0;
             if ( remove( rfile[j] ) != 0 ) {
                 if ( errno != ENOENT ) {
@@ -122,12 +151,37 @@ int main() {
 
 }
 
+// the content of byte i of the files of a rank
+#define FILE_BYTE( i ) ((char)(((i) + rank) % 251))
+
 void createFile( char *fn ) 
 {
     FILE *fstream = fopen( fn, "wb+" );
+    long i;
+    for( i=0; i<file_size; ++i ) {
+        fputc( FILE_BYTE( i ), fstream );
+    }
+    fflush( fstream );
     fsync(fileno(fstream));
     fclose( fstream );
-    truncate( fn, FILE_SIZE );
+}
+
+bool checkFile( char *fn ) 
+{
+    FILE *fstream = fopen( fn, "rb" );
+    if ( fstream == NULL ) {
+        return false;
+    }
+    long i;
+    int c;
+    for( i=0; (c = fgetc( fstream )) != EOF; ++i ) {
+        if ( i >= file_size || (char)c != FILE_BYTE( i ) ) {
+            break;
+        }
+    }
+    bool same = ( c == EOF && i == file_size );
+    fclose( fstream );
+    return same;
 }
 
 bool check_status( int request_counter, int *reqID, bool printout ) 